@@ -0,0 +1,438 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file mem_data.c
+ * @brief Sparse file data store for FSAL_MEM
+ *
+ * File contents are kept in fixed size pages, indexed by page number in an
+ * AVL tree on the handle.  A page that is not in the tree is a hole and
+ * reads as zeros.  Pages are allocated by writes and fallocate, and freed by
+ * truncate and hole punching, so a file can be many GiB in size while only
+ * the regions actually written take memory.
+ *
+ * All the functions here expect the caller to hold mh_file.data_lock, for
+ * read to look at the pages and for write to change them.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include "fsal.h"
+#include "abstract_atomic.h"
+#include "mem_int.h"
+
+/**
+ * @brief A page of file data
+ */
+struct mem_page {
+	struct avltree_node mp_node; /**< Entry in mh_file.pages */
+	uint64_t mp_index; /**< Page number in the file */
+	char mp_data[]; /**< MEM_PAGE_SIZE bytes of data */
+};
+
+static inline int mem_page_cmpf(const struct avltree_node *lhs,
+				const struct avltree_node *rhs)
+{
+	struct mem_page *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct mem_page, mp_node);
+	rk = avltree_container_of(rhs, struct mem_page, mp_node);
+
+	if (lk->mp_index < rk->mp_index)
+		return -1;
+
+	if (lk->mp_index == rk->mp_index)
+		return 0;
+
+	return 1;
+}
+
+static inline struct mem_page *mem_page_of(struct avltree_node *node)
+{
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct mem_page, mp_node);
+}
+
+/**
+ * @brief Find a page
+ *
+ * @param[in] hdl	File to look in
+ * @param[in] index	Page number
+ *
+ * @return The page, or NULL if that page is a hole.
+ */
+static struct mem_page *mem_page_lookup(struct mem_fsal_obj_handle *hdl,
+					uint64_t index)
+{
+	struct mem_page key;
+
+	key.mp_index = index;
+
+	return mem_page_of(
+		avltree_lookup(&key.mp_node, &hdl->mh_file.pages));
+}
+
+/**
+ * @brief Find the first page at or after a page number
+ *
+ * @param[in] hdl	File to look in
+ * @param[in] index	Page number
+ *
+ * @return The page, or NULL if there are no pages from index on.
+ */
+static struct mem_page *mem_page_ceil(struct mem_fsal_obj_handle *hdl,
+				      uint64_t index)
+{
+	struct mem_page key;
+	struct mem_page *page;
+
+	key.mp_index = index;
+
+	/* avltree_inf() returns the last page <= index, or the first page in
+	 * the tree if there is none.
+	 */
+	page = mem_page_of(avltree_inf(&key.mp_node, &hdl->mh_file.pages));
+
+	if (page != NULL && page->mp_index < index)
+		page = mem_page_of(avltree_next(&page->mp_node));
+
+	return page;
+}
+
+/**
+ * @brief Find or allocate a page
+ *
+ * A new page is zero filled.  Allocation fails if it would take the module
+ * past Max_Data_Size.
+ *
+ * @param[in]  hdl	File to look in
+ * @param[in]  index	Page number
+ * @param[out] page	The page
+ *
+ * @return 0 or ENOSPC.
+ */
+static int mem_page_get(struct mem_fsal_obj_handle *hdl, uint64_t index,
+			struct mem_page **page)
+{
+	uint64_t max = MEM.max_data_size;
+	uint64_t used;
+
+	*page = mem_page_lookup(hdl, index);
+
+	if (*page != NULL)
+		return 0;
+
+	used = atomic_add_uint64_t(&MEM.data_used, MEM_PAGE_SIZE);
+
+	if (max != 0 && used > max) {
+		atomic_sub_uint64_t(&MEM.data_used, MEM_PAGE_SIZE);
+		return ENOSPC;
+	}
+
+	*page = gsh_calloc(1, sizeof(struct mem_page) + MEM_PAGE_SIZE);
+	(*page)->mp_index = index;
+
+	avltree_insert(&(*page)->mp_node, &hdl->mh_file.pages);
+	hdl->mh_file.npages++;
+
+	return 0;
+}
+
+static void mem_page_free(struct mem_fsal_obj_handle *hdl,
+			  struct mem_page *page)
+{
+	avltree_remove(&page->mp_node, &hdl->mh_file.pages);
+	hdl->mh_file.npages--;
+	atomic_sub_uint64_t(&MEM.data_used, MEM_PAGE_SIZE);
+	gsh_free(page);
+}
+
+/**
+ * @brief Set up the data store of a new regular file
+ *
+ * @param[in] hdl	File
+ */
+void mem_data_init(struct mem_fsal_obj_handle *hdl)
+{
+	PTHREAD_RWLOCK_init(&hdl->mh_file.data_lock, NULL);
+	avltree_init(&hdl->mh_file.pages, mem_page_cmpf, 0);
+	hdl->mh_file.npages = 0;
+}
+
+/**
+ * @brief Free all the data of a file
+ *
+ * @param[in] hdl	File
+ */
+void mem_data_destroy(struct mem_fsal_obj_handle *hdl)
+{
+	struct avltree_node *node;
+
+	while ((node = avltree_first(&hdl->mh_file.pages)) != NULL)
+		mem_page_free(hdl, mem_page_of(node));
+
+	PTHREAD_RWLOCK_destroy(&hdl->mh_file.data_lock);
+}
+
+/**
+ * @brief Space used by a file
+ *
+ * @param[in] hdl	File
+ *
+ * @return Bytes of allocated pages.
+ */
+uint64_t mem_data_spaceused(struct mem_fsal_obj_handle *hdl)
+{
+	return hdl->mh_file.npages << MEM_PAGE_SHIFT;
+}
+
+/**
+ * @brief Copy data out of a file
+ *
+ * Holes read as zeros.  The caller is responsible for not reading past end
+ * of file.
+ *
+ * @param[in]  hdl	File
+ * @param[in]  offset	Offset to read at
+ * @param[out] buf	Buffer to fill
+ * @param[in]  len	Bytes to read
+ */
+void mem_data_read(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		   void *buf, size_t len)
+{
+	char *dst = buf;
+
+	while (len > 0) {
+		uint64_t pgoff = offset & (MEM_PAGE_SIZE - 1);
+		size_t n = MIN(len, MEM_PAGE_SIZE - pgoff);
+		struct mem_page *page;
+
+		page = mem_page_lookup(hdl, offset >> MEM_PAGE_SHIFT);
+
+		if (page != NULL)
+			memcpy(dst, page->mp_data + pgoff, n);
+		else
+			memset(dst, 0, n);
+
+		dst += n;
+		offset += n;
+		len -= n;
+	}
+}
+
+/**
+ * @brief Copy data into a file
+ *
+ * Pages are allocated as needed.  If the data limit is reached, the write
+ * stops short.
+ *
+ * @param[in]  hdl	File
+ * @param[in]  offset	Offset to write at
+ * @param[in]  buf	Data to write
+ * @param[in]  len	Bytes to write
+ * @param[out] written	Bytes actually written
+ *
+ * @return 0 or ENOSPC if nothing could be written.
+ */
+int mem_data_write(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		   const void *buf, size_t len, size_t *written)
+{
+	const char *src = buf;
+	int rc = 0;
+
+	*written = 0;
+
+	while (len > 0) {
+		uint64_t pgoff = offset & (MEM_PAGE_SIZE - 1);
+		size_t n = MIN(len, MEM_PAGE_SIZE - pgoff);
+		struct mem_page *page;
+
+		rc = mem_page_get(hdl, offset >> MEM_PAGE_SHIFT, &page);
+
+		if (rc != 0)
+			break;
+
+		memcpy(page->mp_data + pgoff, src, n);
+
+		src += n;
+		offset += n;
+		len -= n;
+		*written += n;
+	}
+
+	return *written > 0 ? 0 : rc;
+}
+
+/**
+ * @brief Allocate the pages backing a range
+ *
+ * Existing data is left alone.
+ *
+ * @param[in] hdl	File
+ * @param[in] offset	Start of range
+ * @param[in] length	Length of range
+ *
+ * @return 0 or ENOSPC.
+ */
+int mem_data_allocate(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		      uint64_t length)
+{
+	uint64_t index, last;
+	struct mem_page *page;
+	int rc;
+
+	if (length == 0)
+		return 0;
+
+	last = (offset + length - 1) >> MEM_PAGE_SHIFT;
+
+	for (index = offset >> MEM_PAGE_SHIFT; index <= last; index++) {
+		rc = mem_page_get(hdl, index, &page);
+
+		if (rc != 0)
+			return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Turn a range into a hole
+ *
+ * Pages entirely inside the range are freed, the ends of partially covered
+ * pages are zeroed.
+ *
+ * @param[in] hdl	File
+ * @param[in] offset	Start of range
+ * @param[in] length	Length of range, UINT64_MAX for "to end of file"
+ */
+void mem_data_punch(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		    uint64_t length)
+{
+	uint64_t end;
+	struct mem_page *page, *next;
+
+	if (length == 0)
+		return;
+
+	end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+
+	page = mem_page_ceil(hdl, offset >> MEM_PAGE_SHIFT);
+
+	while (page != NULL) {
+		uint64_t start = page->mp_index << MEM_PAGE_SHIFT;
+		uint64_t from, to;
+
+		if (start >= end)
+			break;
+
+		from = MAX(offset, start);
+		to = end - start > MEM_PAGE_SIZE ? start + MEM_PAGE_SIZE : end;
+		next = mem_page_of(avltree_next(&page->mp_node));
+
+		if (from == start && to == start + MEM_PAGE_SIZE)
+			mem_page_free(hdl, page);
+		else
+			memset(page->mp_data + (from - start), 0, to - from);
+
+		page = next;
+	}
+}
+
+/**
+ * @brief Find the next data or hole
+ *
+ * Allocated pages are data, everything else up to end of file is a hole,
+ * and end of file itself counts as a hole.
+ *
+ * @param[in]  hdl	File
+ * @param[in]  offset	Offset to start at, must be below filesize
+ * @param[in]  data	true to look for data, false for a hole
+ * @param[out] found	Offset of the data or hole
+ *
+ * @return false if looking for data and there is none before end of file.
+ */
+bool mem_data_seek(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		   bool data, uint64_t *found)
+{
+	uint64_t filesize = hdl->attrs.filesize;
+	uint64_t index = offset >> MEM_PAGE_SHIFT;
+	struct mem_page *page = mem_page_ceil(hdl, index);
+
+	if (data) {
+		if (page == NULL)
+			return false;
+
+		*found = MAX(offset, page->mp_index << MEM_PAGE_SHIFT);
+
+		return *found < filesize;
+	}
+
+	/* Walk the run of pages starting at offset looking for a gap */
+	while (page != NULL && page->mp_index == index) {
+		index++;
+		page = mem_page_of(avltree_next(&page->mp_node));
+	}
+
+	*found = MIN(MAX(offset, index << MEM_PAGE_SHIFT), filesize);
+
+	return true;
+}
+
+/**
+ * @brief Find the run of data or hole at an offset
+ *
+ * Used by READ_PLUS to decide what to return.
+ *
+ * @param[in]  hdl	File
+ * @param[in]  offset	Offset to look at
+ * @param[out] hole	true if offset is in a hole
+ *
+ * @return Bytes from offset to the end of the run, ignoring end of file.
+ */
+uint64_t mem_data_run(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		      bool *hole)
+{
+	uint64_t index = offset >> MEM_PAGE_SHIFT;
+	struct mem_page *page = mem_page_ceil(hdl, index);
+
+	if (page == NULL || page->mp_index != index) {
+		*hole = true;
+
+		if (page == NULL)
+			return UINT64_MAX - offset;
+
+		return (page->mp_index << MEM_PAGE_SHIFT) - offset;
+	}
+
+	*hole = false;
+
+	while (page != NULL && page->mp_index == index) {
+		index++;
+		page = mem_page_of(avltree_next(&page->mp_node));
+	}
+
+	return (index << MEM_PAGE_SHIFT) - offset;
+}
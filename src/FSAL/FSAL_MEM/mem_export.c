@@ -85,6 +85,7 @@ static void mem_release_export(struct fsal_export *exp_hdl)
 
 	glist_del(&myself->export_entry);
 
+	PTHREAD_MUTEX_destroy(&myself->mfe_io_lock);
 	PTHREAD_RWLOCK_destroy(&myself->mfe_exp_lock);
 	gsh_free(myself->export_path);
 	gsh_free(myself);
@@ -94,9 +95,13 @@ static fsal_status_t mem_get_dynamic_info(struct fsal_export *exp_hdl,
 					  struct fsal_obj_handle *obj_hdl,
 					  fsal_dynamicfsinfo_t *infop)
 {
-	infop->total_bytes = 0;
-	infop->free_bytes = 0;
-	infop->avail_bytes = 0;
+	uint64_t max = MEM.max_data_size;
+	uint64_t used = atomic_fetch_uint64_t(&MEM.data_used);
+
+	/* Only file data counts against the limit */
+	infop->total_bytes = max;
+	infop->free_bytes = max > used ? max - used : 0;
+	infop->avail_bytes = infop->free_bytes;
 	infop->total_files = 0;
 	infop->free_files = 0;
 	infop->avail_files = 0;
@@ -254,6 +259,36 @@ static struct config_item mem_export_params[] = {
 			mem_fsal_export, async_type),
 	CONF_ITEM_UI32("Async_Stall_Delay", 0, 1000, 0, mem_fsal_export,
 		       async_stall_delay),
+	CONF_ITEM_UI32("Lookup_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_LOOKUP]),
+	CONF_ITEM_UI32("Readdir_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_READDIR]),
+	CONF_ITEM_UI32("Getattr_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_GETATTR]),
+	CONF_ITEM_UI32("Setattr_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_SETATTR]),
+	CONF_ITEM_UI32("Create_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_CREATE]),
+	CONF_ITEM_UI32("Remove_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_REMOVE]),
+	CONF_ITEM_UI32("Readlink_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_READLINK]),
+	CONF_ITEM_UI32("Open_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_OPEN]),
+	CONF_ITEM_UI32("Read_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_READ]),
+	CONF_ITEM_UI32("Write_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_WRITE]),
+	CONF_ITEM_UI32("Commit_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_COMMIT]),
+	CONF_ITEM_UI32("Seek_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_SEEK]),
+	CONF_ITEM_UI32("Allocate_Latency", 0, 10000000, 0, mem_fsal_export,
+		       latency[MEM_LAT_ALLOCATE]),
+	CONF_ITEM_UI64("Read_Bandwidth", 0, UINT64_MAX, 0, mem_fsal_export,
+		       read_bandwidth),
+	CONF_ITEM_UI64("Write_Bandwidth", 0, UINT64_MAX, 0, mem_fsal_export,
+		       write_bandwidth),
 	CONFIG_EOL
 };
 
@@ -285,6 +320,7 @@ fsal_status_t mem_create_export(struct fsal_module *fsal_hdl, void *parse_node,
 
 	glist_init(&myself->mfe_objs);
 	PTHREAD_RWLOCK_init(&myself->mfe_exp_lock, NULL);
+	PTHREAD_MUTEX_init(&myself->mfe_io_lock, NULL);
 	fsal_export_init(&myself->export);
 	mem_export_ops_init(&myself->export.exp_ops);
 
@@ -321,6 +357,8 @@ fsal_status_t mem_create_export(struct fsal_module *fsal_hdl, void *parse_node,
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 
 err_free:
+	PTHREAD_MUTEX_destroy(&myself->mfe_io_lock);
+	PTHREAD_RWLOCK_destroy(&myself->mfe_exp_lock);
 	free_export_ops(&myself->export);
 	gsh_free(myself); /* elvis has left the building */
 	return fsal_status;
@@ -359,6 +397,7 @@ fsal_status_t mem_update_export(struct fsal_module *fsal_hdl, void *parse_node,
 {
 	struct mem_fsal_export myself;
 	int retval = 0;
+	int i;
 	struct mem_fsal_export *orig =
 		container_of(original, struct mem_fsal_export, export);
 	fsal_status_t status;
@@ -385,6 +424,13 @@ fsal_status_t mem_update_export(struct fsal_module *fsal_hdl, void *parse_node,
 			      myself.async_stall_delay);
 	atomic_store_uint32_t(&orig->async_type, myself.async_type);
 
+	/* And the injected latencies */
+	for (i = 0; i < MEM_LAT_COUNT; i++)
+		atomic_store_uint32_t(&orig->latency[i], myself.latency[i]);
+
+	atomic_store_uint64_t(&orig->read_bandwidth, myself.read_bandwidth);
+	atomic_store_uint64_t(&orig->write_bandwidth, myself.write_bandwidth);
+
 	LogEvent(COMPONENT_FSAL,
 		 "Updated FSAL_MEM aync parameters type=%s, delay=%" PRIu32
 		 ", stall_delay=%" PRIu32,
@@ -83,6 +83,93 @@ static inline int mem_i_cmpf(const struct avltree_node *lhs,
 	return 1;
 }
 
+/**
+ * @brief Current monotonic time in nsecs
+ */
+static inline uint64_t mem_now_nsecs(void)
+{
+	struct timespec ts;
+
+	now_mono(&ts);
+
+	return timespec_to_nsecs(&ts);
+}
+
+/**
+ * @brief Sleep until a point in monotonic time
+ *
+ * @param[in] deadline	Time to wake up, in nsecs
+ */
+static void mem_sleep_until(uint64_t deadline)
+{
+	struct timespec ts;
+
+	nsecs_to_timespec(deadline, &ts);
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+	       EINTR)
+		;
+}
+
+/**
+ * @brief Inject the configured latency of an operation
+ *
+ * Used by the synchronous operations, the calling thread is held for the
+ * whole latency just like it would be by a real filesystem.
+ *
+ * @param[in] op	Operation class
+ */
+static void mem_op_latency(enum mem_lat_op op)
+{
+	struct mem_fsal_export *mfe = container_of(
+		op_ctx->fsal_export, struct mem_fsal_export, export);
+	uint32_t usecs = atomic_fetch_uint32_t(&mfe->latency[op]);
+
+	if (usecs != 0)
+		mem_sleep_until(mem_now_nsecs() + usecs * NS_PER_USEC);
+}
+
+/**
+ * @brief Work out when an I/O should complete
+ *
+ * An I/O takes the configured latency, plus the time to move its data at
+ * the configured bandwidth.  The bandwidth is shared by all the I/O of the
+ * export, so an I/O only starts moving data once the ones before it are
+ * done, like on a real device.
+ *
+ * @param[in] mfe	Export doing the I/O
+ * @param[in] write	true for a write, false for a read
+ * @param[in] bytes	Bytes transferred
+ *
+ * @return Completion time in monotonic nsecs, or 0 for no delay.
+ */
+static uint64_t mem_io_deadline(struct mem_fsal_export *mfe, bool write,
+				size_t bytes)
+{
+	uint64_t bandwidth = atomic_fetch_uint64_t(
+		write ? &mfe->write_bandwidth : &mfe->read_bandwidth);
+	uint32_t usecs = atomic_fetch_uint32_t(
+		&mfe->latency[write ? MEM_LAT_WRITE : MEM_LAT_READ]);
+	uint64_t *busy = write ? &mfe->write_busy : &mfe->read_busy;
+	uint64_t done;
+
+	if (bandwidth == 0 && usecs == 0)
+		return 0;
+
+	done = mem_now_nsecs();
+
+	if (bandwidth != 0) {
+		uint64_t xfer = (uint64_t)bytes * NS_PER_SEC / bandwidth;
+
+		PTHREAD_MUTEX_lock(&mfe->mfe_io_lock);
+		done = MAX(done, *busy) + xfer;
+		*busy = done;
+		PTHREAD_MUTEX_unlock(&mfe->mfe_io_lock);
+	}
+
+	return done + usecs * NS_PER_USEC;
+}
+
 /**
  * @brief Clean up and free an object handle
  *
@@ -122,6 +209,7 @@ static void mem_cleanup(struct mem_fsal_obj_handle *myself)
 	case REGULAR_FILE:
 		/* destroy associated global FD */
 		destroy_fsal_fd(&myself->mh_file.fd);
+		mem_data_destroy(myself);
 		break;
 	case SYMBOLIC_LINK:
 		gsh_free(myself->mh_symlink.link_contents);
@@ -267,6 +355,8 @@ static fsal_status_t mem_getattrs(struct fsal_obj_handle *obj_hdl,
 	struct mem_fsal_obj_handle *myself =
 		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 
+	mem_op_latency(MEM_LAT_GETATTR);
+
 	if (!myself->is_export && glist_empty(&myself->dirents)) {
 		/* Removed entry - stale */
 		LogDebug(COMPONENT_FSAL,
@@ -560,16 +650,35 @@ void mem_clean_all_dirents(struct mem_fsal_obj_handle *parent)
 	}
 }
 
+/**
+ * @brief Change the size of a regular file
+ *
+ * Data past the new size is discarded, so that if the file grows again that
+ * range reads as a hole.
+ *
+ * @param[in] myself	File to resize
+ * @param[in] size	New size
+ */
+static void mem_set_size(struct mem_fsal_obj_handle *myself, uint64_t size)
+{
+	PTHREAD_RWLOCK_wrlock(&myself->mh_file.data_lock);
+
+	if (size < myself->attrs.filesize)
+		mem_data_punch(myself, size, UINT64_MAX);
+
+	myself->attrs.filesize = size;
+	myself->attrs.spaceused = mem_data_spaceused(myself);
+
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+}
+
+/* Size changes are done by mem_set_size() */
 static void mem_copy_attrs_mask(struct fsal_attrlist *attrs_in,
 				struct fsal_attrlist *attrs_out)
 {
 	/* Use full timer resolution */
 	now(&attrs_out->ctime);
 
-	if (FSAL_TEST_MASK(attrs_in->valid_mask, ATTR_SIZE)) {
-		attrs_out->filesize = attrs_in->filesize;
-	}
-
 	if (FSAL_TEST_MASK(attrs_in->valid_mask, ATTR_MODE)) {
 		attrs_out->mode = attrs_in->mode & (~S_IFMT & 0xFFFF) &
 				  ~op_ctx->fsal_export->exp_ops.fs_umask(
@@ -608,12 +717,6 @@ static void mem_copy_attrs_mask(struct fsal_attrlist *attrs_in,
 		attrs_out->creation = attrs_in->creation;
 	}
 
-	if (FSAL_TEST_MASK(attrs_in->valid_mask, ATTR_SPACEUSED)) {
-		attrs_out->spaceused = attrs_in->spaceused;
-	} else {
-		attrs_out->spaceused = attrs_out->filesize;
-	}
-
 	/* XXX TODO copy ACL */
 
 	/** @todo FSF - this calculation may be different than what particular
@@ -706,20 +809,12 @@ static struct mem_fsal_obj_handle *_mem_alloc_handle(
 	struct fsal_attrlist *parent_post_attrs_out, const char *func, int line)
 {
 	struct mem_fsal_obj_handle *hdl;
-	size_t isize;
 
-	isize = sizeof(struct mem_fsal_obj_handle);
-	if (type == REGULAR_FILE) {
-		/* Regular files need space to read/write */
-		isize += MEM.inode_size;
-	}
-
-	hdl = gsh_calloc(1, isize);
+	hdl = gsh_calloc(1, sizeof(struct mem_fsal_obj_handle));
 
 	/* Establish tree details for this directory */
 	hdl->m_name = gsh_strdup(name);
 	hdl->obj_handle.fileid = atomic_postinc_uint64_t(&mem_inode_number);
-	hdl->datasize = MEM.inode_size;
 	glist_init(&hdl->dirents);
 	PTHREAD_RWLOCK_wrlock(&mfe->mfe_exp_lock);
 	glist_add_tail(&mfe->mfe_objs, &hdl->mfo_exp_entry);
@@ -775,13 +870,13 @@ static struct mem_fsal_obj_handle *_mem_alloc_handle(
 
 	switch (type) {
 	case REGULAR_FILE:
-		if ((attrs && attrs->valid_mask & ATTR_SIZE) != 0) {
+		mem_data_init(hdl);
+		if ((attrs && attrs->valid_mask & ATTR_SIZE) != 0)
 			hdl->attrs.filesize = attrs->filesize;
-			hdl->attrs.spaceused = attrs->filesize;
-		} else {
+		else
 			hdl->attrs.filesize = 0;
-			hdl->attrs.spaceused = 0;
-		}
+		/* The file starts out as one big hole */
+		hdl->attrs.spaceused = 0;
 		hdl->attrs.numlinks = 1;
 		break;
 	case BLOCK_FILE:
@@ -945,6 +1040,8 @@ static fsal_status_t mem_lookup(struct fsal_obj_handle *parent,
 	struct mem_fsal_obj_handle *myself, *hdl = NULL;
 	fsal_status_t status;
 
+	mem_op_latency(MEM_LAT_LOOKUP);
+
 	myself = container_of(parent, struct mem_fsal_obj_handle, obj_handle);
 
 	/* Check if this context already holds the lock on
@@ -1000,6 +1097,8 @@ static fsal_status_t mem_readdir(struct fsal_obj_handle *dir_hdl,
 	enum fsal_dir_result cb_rc;
 	int count = 0;
 
+	mem_op_latency(MEM_LAT_READDIR);
+
 	myself = container_of(dir_hdl, struct mem_fsal_obj_handle, obj_handle);
 
 	if (whence != NULL)
@@ -1100,6 +1199,8 @@ static fsal_status_t mem_mkdir(struct fsal_obj_handle *dir_hdl,
 	struct mem_fsal_obj_handle *parent =
 		container_of(dir_hdl, struct mem_fsal_obj_handle, obj_handle);
 
+	mem_op_latency(MEM_LAT_CREATE);
+
 	LogDebug(COMPONENT_FSAL, "mkdir %s", name);
 
 	GSH_AUTO_TRACEPOINT(fsalmem, mem_mkdir, TRACE_DEBUG,
@@ -1142,6 +1243,8 @@ static fsal_status_t mem_mknode(struct fsal_obj_handle *dir_hdl,
 				       obj_handle);
 	fsal_status_t status;
 
+	mem_op_latency(MEM_LAT_CREATE);
+
 	LogDebug(COMPONENT_FSAL, "mknode %s", name);
 
 	status = mem_create_obj(parent, nodetype, name, attrs_in, new_obj,
@@ -1189,6 +1292,8 @@ static fsal_status_t mem_symlink(struct fsal_obj_handle *dir_hdl,
 				       obj_handle);
 	fsal_status_t status;
 
+	mem_op_latency(MEM_LAT_CREATE);
+
 	LogDebug(COMPONENT_FSAL, "symlink %s", name);
 
 	status = mem_create_obj(parent, SYMBOLIC_LINK, name, attrs_in, new_obj,
@@ -1219,6 +1324,8 @@ static fsal_status_t mem_readlink(struct fsal_obj_handle *obj_hdl,
 	struct mem_fsal_obj_handle *myself =
 		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 
+	mem_op_latency(MEM_LAT_READLINK);
+
 	if (obj_hdl->type != SYMBOLIC_LINK) {
 		LogCrit(COMPONENT_FSAL, "Handle is not a symlink. hdl = 0x%p",
 			obj_hdl);
@@ -1251,6 +1358,8 @@ fsal_status_t mem_setattr2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	struct mem_fsal_obj_handle *myself =
 		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 
+	mem_op_latency(MEM_LAT_SETATTR);
+
 	/* apply umask, if mode attribute is to be changed */
 	if (FSAL_TEST_MASK(attrs_set->valid_mask, ATTR_MODE))
 		attrs_set->mode &= ~op_ctx->fsal_export->exp_ops.fs_umask(
@@ -1266,6 +1375,9 @@ fsal_status_t mem_setattr2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		return fsalstat(ERR_FSAL_INVAL, EINVAL);
 	}
 
+	if (FSAL_TEST_MASK(attrs_set->valid_mask, ATTR_SIZE))
+		mem_set_size(myself, attrs_set->filesize);
+
 	mem_copy_attrs_mask(attrs_set, &myself->attrs);
 
 	GSH_AUTO_TRACEPOINT(
@@ -1302,6 +1414,8 @@ fsal_status_t mem_link(struct fsal_obj_handle *obj_hdl,
 	struct mem_fsal_obj_handle *hdl;
 	fsal_status_t status = { 0, 0 };
 
+	mem_op_latency(MEM_LAT_REMOVE);
+
 	status = mem_int_lookup(dir, name, &hdl);
 	if (!FSAL_IS_ERROR(status)) {
 		/* It already exists */
@@ -1349,6 +1463,8 @@ static fsal_status_t mem_unlink(struct fsal_obj_handle *dir_hdl,
 	uint32_t numkids;
 	struct mem_dirent *dirent;
 
+	mem_op_latency(MEM_LAT_REMOVE);
+
 	parent = container_of(dir_hdl, struct mem_fsal_obj_handle, obj_handle);
 	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 
@@ -1473,6 +1589,8 @@ mem_rename(struct fsal_obj_handle *obj_hdl, struct fsal_obj_handle *olddir_hdl,
 	struct mem_fsal_obj_handle *mem_lookup_dst = NULL;
 	fsal_status_t status;
 
+	mem_op_latency(MEM_LAT_REMOVE);
+
 	status = mem_int_lookup(mem_newdir, new_name, &mem_lookup_dst);
 	if (!FSAL_IS_ERROR(status)) {
 		uint32_t numkids;
@@ -1620,7 +1738,7 @@ static fsal_status_t mem_open2_by_handle(struct fsal_obj_handle *obj_hdl,
 	}
 
 	if (truncated)
-		myself->attrs.filesize = myself->attrs.spaceused = 0;
+		mem_set_size(myself, 0);
 
 	/* Now check verifier for exclusive, but not for
 	 * FSAL_EXCLUSIVE_9P.
@@ -1707,6 +1825,8 @@ mem_open2(struct fsal_obj_handle *obj_hdl, struct state_t *state,
 	bool created = false;
 	struct fsal_attrlist verifier_attr;
 
+	mem_op_latency(MEM_LAT_OPEN);
+
 	if (state != NULL)
 		my_fd = &container_of(state, struct mem_state_fd, state)
 				 ->fsal_fd;
@@ -1807,6 +1927,8 @@ mem_open2(struct fsal_obj_handle *obj_hdl, struct state_t *state,
 		/* Create sets and gets attributes, so only do this if not
 		 * creating */
 		if (setattrs && attrs_set->valid_mask != 0) {
+			if (FSAL_TEST_MASK(attrs_set->valid_mask, ATTR_SIZE))
+				mem_set_size(hdl, attrs_set->filesize);
 			mem_copy_attrs_mask(attrs_set, &hdl->attrs);
 		}
 
@@ -1876,6 +1998,8 @@ fsal_openflags_t mem_status2(struct fsal_obj_handle *obj_hdl,
 fsal_status_t mem_reopen2(struct fsal_obj_handle *obj_hdl,
 			  struct state_t *state, fsal_openflags_t openflags)
 {
+	mem_op_latency(MEM_LAT_OPEN);
+
 	return mem_open2_by_handle(obj_hdl, state, openflags, FSAL_NO_CREATE,
 				   NULL, NULL);
 }
@@ -1889,6 +2013,8 @@ struct mem_async_arg {
 	struct fsal_export *fsal_export;
 	struct fsal_fd *out_fd;
 	uint32_t share;
+	/** When the I/O should complete, 0 for no delay */
+	uint64_t deadline;
 	struct fsal_fd temp_fd;
 };
 
@@ -1903,8 +2029,12 @@ static void mem_async_complete(struct fridgethr_context *ctx)
 		async_arg->obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 	struct req_op_context opctx;
 
+	if (async_arg->deadline != 0)
+		mem_sleep_until(async_arg->deadline);
+
 	/* Now check if we need to delay the call back */
-	if (atomic_fetch_uint32_t(&mem_export->async_type) != MEM_FIXED) {
+	if (atomic_fetch_uint32_t(&mem_export->async_type) != MEM_FIXED &&
+	    async_delay != 0) {
 		/* Randomize delay */
 		async_delay = random() % async_delay;
 	}
@@ -1981,13 +2111,8 @@ void mem_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	uint32_t async_stall_delay =
 		atomic_fetch_uint32_t(&mem_export->async_stall_delay);
 	struct mem_async_arg *async_arg;
-
-	if (read_arg->info != NULL) {
-		/* Currently we don't support READ_PLUS */
-		done_cb(obj_hdl, fsalstat(ERR_FSAL_NOTSUPP, 0), read_arg,
-			caller_arg);
-		return;
-	}
+	struct io_info *info = read_arg->info;
+	uint64_t filesize, deadline;
 
 	/* We always meed async_arg because that's where temp_fd is located
 	 * and we may need temp_fd before we know we actually are going async.
@@ -2011,36 +2136,58 @@ void mem_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 
 	read_arg->io_amount = 0;
 
+	PTHREAD_RWLOCK_rdlock(&myself->mh_file.data_lock);
+
+	filesize = myself->attrs.filesize;
+
+	if (info != NULL && offset < filesize) {
+		/* READ_PLUS returns a single hole or data segment */
+		bool hole;
+		uint64_t run = mem_data_run(myself, offset, &hole);
+		uint64_t want = MIN(read_arg->iov[0].iov_len,
+				    filesize - offset);
+
+		if (hole) {
+			info->io_content.what = NFS4_CONTENT_HOLE;
+			info->io_content.hole.di_offset = offset;
+			info->io_content.hole.di_length = MIN(run, want);
+			read_arg->end_of_file = offset + MIN(run, want) >=
+						filesize;
+			goto unlock;
+		}
+
+		want = MIN(run, want);
+		mem_data_read(myself, offset, read_arg->iov[0].iov_base, want);
+		read_arg->io_amount = want;
+		read_arg->end_of_file = offset + want >= filesize;
+
+		info->io_content.what = NFS4_CONTENT_DATA;
+		info->io_content.data.d_offset = offset;
+		info->io_content.data.d_data.data_len = want;
+		info->io_content.data.d_data.data_val =
+			read_arg->iov[0].iov_base;
+		goto unlock;
+	}
+
 	for (i = 0; i < read_arg->iov_count; i++) {
 		size_t bufsize;
 
-		if (offset > myself->attrs.filesize) {
-			/* Past end of file */
-			read_arg->end_of_file = true;
+		if (offset >= filesize)
 			break;
-		}
 
-		bufsize = read_arg->iov[i].iov_len;
-		if (offset + bufsize > myself->attrs.filesize) {
-			bufsize = myself->attrs.filesize - offset;
-		}
-		if (offset < myself->datasize) {
-			size_t readsize;
-
-			/* Data to read */
-			readsize = MIN(bufsize, myself->datasize - offset);
-			memcpy(read_arg->iov[i].iov_base, myself->data + offset,
-			       readsize);
-			if (readsize < bufsize)
-				memset(read_arg->iov[i].iov_base + readsize,
-				       'a', bufsize - readsize);
-		} else {
-			memset(read_arg->iov[i].iov_base, 'a', bufsize);
-		}
+		bufsize = MIN(read_arg->iov[i].iov_len, filesize - offset);
+		mem_data_read(myself, offset, read_arg->iov[i].iov_base,
+			      bufsize);
 		read_arg->io_amount += bufsize;
 		offset += bufsize;
 	}
 
+	read_arg->end_of_file = offset >= filesize;
+
+unlock:
+
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+
 	GSH_AUTO_TRACEPOINT(
 		fsalmem, mem_read, TRACE_DEBUG,
 		"Read. Handle: {}, name: {}, state: {}, size: {}, spaceused: {}",
@@ -2049,6 +2196,8 @@ void mem_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 
 	now(&myself->attrs.atime);
 
+	deadline = mem_io_deadline(mem_export, false, read_arg->io_amount);
+
 	if (MEM.async_threads > 0 &&
 	    (async_type > MEM_RANDOM_OR_INLINE ||
 	     ((async_type == MEM_RANDOM_OR_INLINE) && ((random() % 1) == 1)))) {
@@ -2061,6 +2210,7 @@ void mem_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		async_arg->fsal_export = op_ctx->fsal_export;
 		async_arg->out_fd = out_fd;
 		async_arg->share = FSAL_O_READ;
+		async_arg->deadline = deadline;
 
 		if (fridgethr_submit(mem_async_fridge, mem_async_complete,
 				     async_arg) == 0) {
@@ -2071,6 +2221,9 @@ void mem_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		}
 	}
 
+	if (deadline != 0)
+		mem_sleep_until(deadline);
+
 	status2 = fsal_complete_io(obj_hdl, out_fd);
 
 	LogFullDebug(COMPONENT_FSAL, "fsal_complete_io returned %s",
@@ -2089,7 +2242,7 @@ void mem_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 
 exit:
 
-	done_cb(obj_hdl, fsalstat(ERR_FSAL_NO_ERROR, 0), read_arg, caller_arg);
+	done_cb(obj_hdl, status, read_arg, caller_arg);
 
 	destroy_fsal_fd(&async_arg->temp_fd);
 
@@ -2141,6 +2294,9 @@ void mem_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	uint32_t async_stall_delay =
 		atomic_fetch_uint32_t(&mem_export->async_stall_delay);
 	struct mem_async_arg *async_arg;
+	uint64_t deadline;
+	size_t written;
+	int rc = 0;
 
 	if (obj_hdl->type != REGULAR_FILE) {
 		/* Currently can only write to a file */
@@ -2169,24 +2325,29 @@ void mem_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		goto exit;
 	}
 
+	PTHREAD_RWLOCK_wrlock(&myself->mh_file.data_lock);
+
 	for (i = 0; i < write_arg->iov_count; i++) {
-		size_t bufsize;
+		rc = mem_data_write(myself, offset, write_arg->iov[i].iov_base,
+				    write_arg->iov[i].iov_len, &written);
+		write_arg->io_amount += written;
+		offset += written;
 
-		bufsize = write_arg->iov[i].iov_len;
-		if (offset + bufsize > myself->attrs.filesize) {
-			myself->attrs.filesize = myself->attrs.spaceused =
-				offset + bufsize;
-		}
-		if (offset < myself->datasize) {
-			size_t writesize;
+		if (rc != 0)
+			break;
+	}
 
-			/* Data to write */
-			writesize = MIN(bufsize, myself->datasize - offset);
-			memcpy(myself->data + offset,
-			       write_arg->iov[i].iov_base, writesize);
-		}
-		write_arg->io_amount += bufsize;
-		offset += bufsize;
+	if (offset > myself->attrs.filesize)
+		myself->attrs.filesize = offset;
+
+	myself->attrs.spaceused = mem_data_spaceused(myself);
+
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+
+	if (write_arg->io_amount == 0 && rc != 0) {
+		/* Out of space, and nothing was written */
+		status = posix2fsal_status(rc);
+		goto complete;
 	}
 
 	GSH_AUTO_TRACEPOINT(
@@ -2204,16 +2365,14 @@ void mem_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	 */
 	myself->attrs.change = timespec_to_nsecs(&myself->attrs.mtime);
 
+	deadline = mem_io_deadline(mem_export, true, write_arg->io_amount);
+
 	if (MEM.async_threads > 0 &&
 	    (async_type > MEM_RANDOM_OR_INLINE ||
 	     ((async_type == MEM_RANDOM_OR_INLINE) && ((random() % 1) == 1)))) {
-		struct mem_async_arg *async_arg;
-
 		/* Was MEM_FIXED, MEM_RANDOM, or MEM_RANDOM_OR_INLINE and we
 		 * scored a non-inline.
 		 */
-		async_arg = gsh_malloc(sizeof(*async_arg));
-
 		async_arg->obj_hdl = obj_hdl;
 		async_arg->io_arg = write_arg;
 		async_arg->caller_arg = caller_arg;
@@ -2222,6 +2381,7 @@ void mem_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		async_arg->fsal_export = op_ctx->fsal_export;
 		async_arg->out_fd = out_fd;
 		async_arg->share = FSAL_O_WRITE;
+		async_arg->deadline = deadline;
 
 		if (fridgethr_submit(mem_async_fridge, mem_async_complete,
 				     async_arg) == 0) {
@@ -2232,6 +2392,11 @@ void mem_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		}
 	}
 
+	if (deadline != 0)
+		mem_sleep_until(deadline);
+
+complete:
+
 	status2 = fsal_complete_io(obj_hdl, out_fd);
 
 	LogFullDebug(COMPONENT_FSAL, "fsal_complete_io returned %s",
@@ -2250,7 +2415,7 @@ void mem_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 
 exit:
 
-	done_cb(obj_hdl, fsalstat(ERR_FSAL_NO_ERROR, 0), write_arg, caller_arg);
+	done_cb(obj_hdl, status, write_arg, caller_arg);
 
 	destroy_fsal_fd(&async_arg->temp_fd);
 
@@ -2287,9 +2452,182 @@ bye:
 fsal_status_t mem_commit2(struct fsal_obj_handle *obj_hdl, off_t offset,
 			  size_t len)
 {
+	mem_op_latency(MEM_LAT_COMMIT);
+
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
+/**
+ * @brief Seek to data or hole
+ *
+ * Allocated pages are data, anything else before end of file is a hole.
+ *
+ * @param[in]     obj_hdl	File on which to operate
+ * @param[in]     state		state_t to use for this operation
+ * @param[in,out] info		Information about the data
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t mem_seek2(struct fsal_obj_handle *obj_hdl, struct state_t *state,
+			struct io_info *info)
+{
+	struct mem_fsal_obj_handle *myself =
+		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+	uint64_t offset = info->io_content.hole.di_offset;
+	uint64_t found;
+	fsal_status_t status, status2;
+	struct fsal_fd temp_fd;
+	struct fsal_fd *out_fd;
+
+	mem_op_latency(MEM_LAT_SEEK);
+
+	init_fsal_fd(&temp_fd, FSAL_FD_TEMP, op_ctx->fsal_export);
+
+	/* Indicate a desire to start io and get a usable file descritor */
+	status = fsal_start_io(&out_fd, obj_hdl, &myself->mh_file.fd, &temp_fd,
+			       state, FSAL_O_ANY, false, NULL, true, NULL);
+
+	if (FSAL_IS_ERROR(status)) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "fsal_start_io failed returning %s",
+			     fsal_err_txt(status));
+		goto exit;
+	}
+
+	PTHREAD_RWLOCK_rdlock(&myself->mh_file.data_lock);
+
+	/* RFC7862 15.11.3,
+	 * If the sa_offset is beyond the end of the file,
+	 * then SEEK MUST return NFS4ERR_NXIO. */
+	if (offset >= myself->attrs.filesize) {
+		status = posix2fsal_status(ENXIO);
+		goto unlock;
+	}
+
+	if (info->io_content.what != NFS4_CONTENT_DATA &&
+	    info->io_content.what != NFS4_CONTENT_HOLE) {
+		status = fsalstat(ERR_FSAL_UNION_NOTSUPP, 0);
+		goto unlock;
+	}
+
+	if (mem_data_seek(myself, offset,
+			  info->io_content.what == NFS4_CONTENT_DATA, &found)) {
+		info->io_eof = found >= myself->attrs.filesize;
+		info->io_content.hole.di_offset = found;
+	} else {
+		/* No data before end of file */
+		info->io_eof = true;
+	}
+
+unlock:
+
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+
+	status2 = fsal_complete_io(obj_hdl, out_fd);
+
+	LogFullDebug(COMPONENT_FSAL, "fsal_complete_io returned %s",
+		     fsal_err_txt(status2));
+
+	/* We did FSAL_O_ANY so no share reservation was acquired */
+
+exit:
+
+	destroy_fsal_fd(&temp_fd);
+
+	return status;
+}
+
+/**
+ * @brief Reserve/Deallocate space in a region of a file
+ *
+ * Allocating may extend the file, deallocating punches a hole and never
+ * changes the size.
+ *
+ * @param[in] obj_hdl	File to which bytes should be allocated
+ * @param[in] state	open stateid under which to do the allocation
+ * @param[in] offset	offset at which to begin the allocation
+ * @param[in] length	length of the data to be allocated
+ * @param[in] allocate	Should space be allocated or deallocated?
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t mem_fallocate(struct fsal_obj_handle *obj_hdl,
+			    struct state_t *state, uint64_t offset,
+			    uint64_t length, bool allocate)
+{
+	struct mem_fsal_obj_handle *myself =
+		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+	fsal_status_t status, status2;
+	struct fsal_fd temp_fd;
+	struct fsal_fd *out_fd;
+	int rc = 0;
+
+	mem_op_latency(MEM_LAT_ALLOCATE);
+
+	init_fsal_fd(&temp_fd, FSAL_FD_TEMP, op_ctx->fsal_export);
+
+	/* Indicate a desire to start io and get a usable file descritor */
+	status = fsal_start_io(&out_fd, obj_hdl, &myself->mh_file.fd, &temp_fd,
+			       state, FSAL_O_WRITE, false, NULL, false,
+			       &myself->mh_file.share);
+
+	if (FSAL_IS_ERROR(status)) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "fsal_start_io failed returning %s",
+			     fsal_err_txt(status));
+		goto exit;
+	}
+
+	PTHREAD_RWLOCK_wrlock(&myself->mh_file.data_lock);
+
+	if (allocate) {
+		rc = mem_data_allocate(myself, offset, length);
+
+		if (rc == 0 && offset + length > myself->attrs.filesize)
+			myself->attrs.filesize = offset + length;
+	} else {
+		mem_data_punch(myself, offset, length);
+	}
+
+	myself->attrs.spaceused = mem_data_spaceused(myself);
+
+	if (rc != 0) {
+		LogFullDebug(COMPONENT_FSAL, "allocate returned %s (%d)",
+			     strerror(rc), rc);
+		status = posix2fsal_status(rc);
+	} else {
+		now(&myself->attrs.mtime);
+		myself->attrs.ctime = myself->attrs.mtime;
+		myself->attrs.change = timespec_to_nsecs(&myself->attrs.mtime);
+	}
+
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+
+	status2 = fsal_complete_io(obj_hdl, out_fd);
+
+	LogFullDebug(COMPONENT_FSAL, "fsal_complete_io returned %s",
+		     fsal_err_txt(status2));
+
+	if (state == NULL) {
+		/* We did I/O without a state so we need to release the temp
+		 * share reservation acquired.
+		 */
+
+		/* Release the share reservation now by updating the counters.
+		 */
+		update_share_counters_locked(obj_hdl, &myself->mh_file.share,
+					     FSAL_O_WRITE, FSAL_O_CLOSED);
+	}
+
+exit:
+
+	destroy_fsal_fd(&temp_fd);
+
+	return status;
+}
+
 /**
  * @brief Manage closing a file when a state is no longer needed.
  *
@@ -2311,6 +2649,8 @@ fsal_status_t mem_close2(struct fsal_obj_handle *obj_hdl, struct state_t *state)
 	struct mem_fsal_obj_handle *myself =
 		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 
+	mem_op_latency(MEM_LAT_OPEN);
+
 	GSH_AUTO_TRACEPOINT(fsalmem, mem_close, TRACE_DEBUG,
 			    "Close. Handle: {}, name: {}, state: {}", obj_hdl,
 			    TP_STR(myself->m_name), state);
@@ -2512,6 +2852,8 @@ void mem_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->read2 = mem_read2;
 	ops->write2 = mem_write2;
 	ops->commit2 = mem_commit2;
+	ops->seek2 = mem_seek2;
+	ops->fallocate = mem_fallocate;
 	ops->close2 = mem_close2;
 	ops->close_func = mem_close_func;
 	ops->reopen_func = mem_reopen_func;
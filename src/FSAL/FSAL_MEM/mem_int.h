@@ -44,6 +44,30 @@ enum async_types {
 	MEM_FIXED,
 };
 
+/**
+ * @brief Operation classes for latency injection
+ */
+enum mem_lat_op {
+	MEM_LAT_LOOKUP,
+	MEM_LAT_READDIR,
+	MEM_LAT_GETATTR,
+	MEM_LAT_SETATTR,
+	MEM_LAT_CREATE, /**< create, mkdir, mknode, symlink */
+	MEM_LAT_REMOVE, /**< unlink, rename, link */
+	MEM_LAT_READLINK,
+	MEM_LAT_OPEN, /**< open2, reopen2, close2 */
+	MEM_LAT_READ,
+	MEM_LAT_WRITE,
+	MEM_LAT_COMMIT,
+	MEM_LAT_SEEK,
+	MEM_LAT_ALLOCATE,
+	MEM_LAT_COUNT
+};
+
+/* File data is stored in pages of this size, see mem_data.c */
+#define MEM_PAGE_SHIFT 16
+#define MEM_PAGE_SIZE (1 << MEM_PAGE_SHIFT)
+
 /**
  * MEM internal export
  */
@@ -66,6 +90,18 @@ struct mem_fsal_export {
 	uint32_t async_stall_delay;
 	/** Type of async */
 	uint32_t async_type;
+	/** Injected latency per operation class, in usecs */
+	uint32_t latency[MEM_LAT_COUNT];
+	/** Injected read bandwidth in bytes per second, 0 for unlimited */
+	uint64_t read_bandwidth;
+	/** Injected write bandwidth in bytes per second, 0 for unlimited */
+	uint64_t write_bandwidth;
+	/** Lock protecting read_busy and write_busy */
+	pthread_mutex_t mfe_io_lock;
+	/** Time (monotonic nsecs) until which reads use up the bandwidth */
+	uint64_t read_busy;
+	/** Time (monotonic nsecs) until which writes use up the bandwidth */
+	uint64_t write_busy;
 };
 
 fsal_status_t mem_lookup_path(struct fsal_export *exp_hdl, const char *path,
@@ -104,6 +140,12 @@ struct mem_fsal_obj_handle {
 		struct {
 			struct fsal_share share;
 			struct fsal_fd fd;
+			/** Protects pages and npages */
+			pthread_rwlock_t data_lock;
+			/** Data pages, indexed by page number */
+			struct avltree pages;
+			/** Number of pages allocated */
+			uint64_t npages;
 		} mh_file;
 		struct {
 			object_file_type_t nodetype;
@@ -117,10 +159,8 @@ struct mem_fsal_obj_handle {
 	struct glist_head mfo_exp_entry; /**< Link into mfs_objs */
 	struct mem_fsal_export *mfo_exp; /**< Export owning object */
 	char *m_name; /**< Base name of obj, for debugging */
-	uint32_t datasize;
 	bool is_export;
 	uint32_t refcount; /**< We persist handles, so we need a refcount */
-	char data[0]; /* Allocated data */
 };
 
 /**
@@ -192,6 +232,23 @@ static inline void _mem_free_handle(struct mem_fsal_obj_handle *hdl)
 void mem_clean_export(struct mem_fsal_obj_handle *root);
 void mem_clean_all_dirents(struct mem_fsal_obj_handle *parent);
 
+/* Sparse data store */
+void mem_data_init(struct mem_fsal_obj_handle *hdl);
+void mem_data_destroy(struct mem_fsal_obj_handle *hdl);
+uint64_t mem_data_spaceused(struct mem_fsal_obj_handle *hdl);
+void mem_data_read(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		   void *buf, size_t len);
+int mem_data_write(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		   const void *buf, size_t len, size_t *written);
+int mem_data_allocate(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		      uint64_t length);
+void mem_data_punch(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		    uint64_t length);
+bool mem_data_seek(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		   bool data, uint64_t *found);
+uint64_t mem_data_run(struct mem_fsal_obj_handle *hdl, uint64_t offset,
+		      bool *hole);
+
 /**
  * @brief FSAL Module wrapper for MEM
  */
@@ -202,8 +259,10 @@ struct mem_fsal_module {
 	struct fsal_obj_ops handle_ops;
 	/** List of MEM exports. TODO Locking when we care */
 	struct glist_head mem_exports;
-	/** Config - size of data in inode */
-	uint32_t inode_size;
+	/** Config - limit on file data held by all exports, 0 for none */
+	uint64_t max_data_size;
+	/** Bytes of file data pages allocated */
+	uint64_t data_used;
 	/** Config - Interval for UP call thread */
 	uint32_t up_interval;
 	/** Next unused inode */
@@ -79,8 +79,10 @@ struct mem_fsal_module
 			  } } };
 
 static struct config_item mem_items[] = {
-	CONF_ITEM_UI32("Inode_Size", 0, 0x200000, 0, mem_fsal_module,
-		       inode_size),
+	CONF_ITEM_DEPRECATED("Inode_Size",
+			     "File data is now stored sparsely without a per file limit, see Max_Data_Size"),
+	CONF_ITEM_UI64("Max_Data_Size", 0, UINT64_MAX, 0, mem_fsal_module,
+		       max_data_size),
 	CONF_ITEM_UI32("Up_Test_Interval", 0, UINT32_MAX, 0, mem_fsal_module,
 		       up_interval),
 	CONF_ITEM_UI32("Async_Threads", 0, 100, 0, mem_fsal_module,
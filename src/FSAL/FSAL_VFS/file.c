@@ -40,9 +40,14 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/uio.h>
+#include <sys/ioctl.h>
+#ifdef LINUX
+#include <linux/fs.h>
+#endif
 #include "vfs_methods.h"
 #include "os/subr.h"
 #include "sal_data.h"
+#include "export_mgr.h"
 
 fsal_status_t vfs_open_my_fd(struct vfs_fsal_obj_handle *myself,
 			     fsal_openflags_t openflags, int posix_flags,
@@ -106,6 +111,87 @@ fsal_status_t vfs_close_my_fd(struct vfs_fd *my_fd)
 	return fsalstat(fsal_error, retval);
 }
 
+void vfs_sync_group_init(struct vfs_sync_group *sg)
+{
+	PTHREAD_MUTEX_init(&sg->mutex, NULL);
+	PTHREAD_COND_init(&sg->cond, NULL);
+	sg->started = 0;
+	sg->completed = 0;
+	sg->failed = 0;
+	sg->error = 0;
+	sg->flushing = false;
+}
+
+void vfs_sync_group_destroy(struct vfs_sync_group *sg)
+{
+	PTHREAD_COND_destroy(&sg->cond);
+	PTHREAD_MUTEX_destroy(&sg->mutex);
+}
+
+/**
+ * @brief Make all data written to a file so far stable
+ *
+ * Group commit: a flush that is already running may have started before the
+ * caller's data was written, so the caller needs the flush after it. The
+ * first caller to find no flush running issues it for everyone waiting, so
+ * any number of concurrent stable writes and COMMITs share one fdatasync.
+ *
+ * fdatasync covers the file size along with the data, which is everything
+ * needed to read the data back. sync_file_range is not used as it neither
+ * writes metadata nor flushes the disk cache.
+ *
+ * @param[in] sg	Group commit state of the file
+ * @param[in] fd	Open fd of the file, used if we do the flush
+ *
+ * @return 0 or the errno of the flush that covered our data.
+ */
+
+int vfs_sync_group_flush(struct vfs_sync_group *sg, int fd)
+{
+	uint64_t target;
+	int rc;
+
+	PTHREAD_MUTEX_lock(&sg->mutex);
+
+	target = sg->started + 1;
+
+	while (sg->completed < target) {
+		if (sg->flushing) {
+			PTHREAD_COND_wait(&sg->cond, &sg->mutex);
+			continue;
+		}
+
+		sg->flushing = true;
+		sg->started++;
+
+		PTHREAD_MUTEX_unlock(&sg->mutex);
+
+		rc = fdatasync(fd);
+		rc = rc == -1 ? errno : 0;
+
+		PTHREAD_MUTEX_lock(&sg->mutex);
+
+		sg->completed = sg->started;
+
+		if (rc != 0) {
+			sg->failed = sg->completed;
+			sg->error = rc;
+		}
+
+		sg->flushing = false;
+		PTHREAD_COND_broadcast(&sg->cond);
+	}
+
+	/* If we slept through more than one flush, a later failure is
+	 * reported too; the caller can not tell which flush covered it.
+	 */
+	rc = sg->failed >= target ? sg->error : 0;
+
+	PTHREAD_MUTEX_unlock(&sg->mutex);
+
+	return rc;
+}
+
 /**
  * @brief VFS Function to open or reopen a fsal_fd.
  *
@@ -1214,6 +1300,198 @@ success:
 	return status;
 }
 
+#ifdef USE_FSAL_VFS_IO_URING
+struct vfs_async_io {
+	struct vfs_uring_req req;
+	struct fsal_io_arg *arg;
+	struct gsh_export *exp;
+	struct fsal_export *fsal_export;
+	struct vfs_fd *my_fd;
+	struct fsal_obj_handle *obj_hdl;
+	fsal_async_cb done_cb;
+	void *caller_arg;
+	/** Result of the I/O, kept across a resume */
+	fsal_status_t status;
+	struct vfs_fd temp_fd;
+};
+
+static struct vfs_async_io *vfs_async_io_alloc(struct fsal_obj_handle *obj_hdl)
+{
+	struct vfs_async_io *aio;
+
+	if (!container_of(obj_hdl->fsal, struct vfs_fsal_module, module)
+		     ->async_io)
+		return NULL;
+
+	aio = gsh_calloc(1, sizeof(*aio));
+
+	init_fsal_fd(&aio->temp_fd.fsal_fd, FSAL_FD_TEMP, op_ctx->fsal_export);
+	aio->temp_fd.fd = -1;
+
+	return aio;
+}
+
+static void vfs_async_io_free(struct vfs_async_io *aio)
+{
+	destroy_fsal_fd(&aio->temp_fd.fsal_fd);
+	gsh_free(aio);
+}
+
+/**
+ * @brief Complete an asynchronous read or write
+ *
+ * Called on the io_uring completion thread, and again on a worker thread
+ * if we asked to be resumed because a stable write has to be synced or a
+ * temporary fd has to be closed.
+ *
+ * @param[in] req	The completed request
+ */
+
+static void vfs_async_io_done(struct vfs_uring_req *req)
+{
+	struct vfs_async_io *aio = container_of(req, struct vfs_async_io, req);
+	struct fsal_io_arg *io_arg = aio->arg;
+	struct fsal_obj_handle *obj_hdl = aio->obj_hdl;
+	struct vfs_fsal_obj_handle *myself =
+		container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+	fsal_status_t status = { 0, 0 }, status2;
+	struct req_op_context ctx;
+	int rc;
+
+	/* The request that drove this I/O can not complete until done_cb is
+	 * called, so its op context, and the export reference it holds, is
+	 * still valid. Build a simple op context of our own from that export;
+	 * release_op_context() will drop the reference taken here.
+	 */
+	get_gsh_export_ref(aio->exp);
+	init_op_context_simple(&ctx, aio->exp, aio->fsal_export);
+
+	if (io_arg->fsal_resume == VFS_RESUME_SYNC) {
+		/* Join the file's group commit, as a synchronous stable
+		 * write does.
+		 */
+		rc = vfs_sync_group_flush(&myself->u.file.sync,
+					  aio->my_fd->fd);
+		if (rc != 0) {
+			io_arg->fsal_stable = false;
+			LogFullDebug(COMPONENT_FSAL, "fdatasync returned %s",
+				     strerror(rc));
+		}
+		io_arg->fsal_resume = FSAL_NORESUME;
+		goto resume;
+	}
+
+	if (io_arg->fsal_resume) {
+		assert(io_arg->fsal_resume == FSAL_CLOSEFD);
+		io_arg->fsal_resume = FSAL_NORESUME;
+		goto resume;
+	}
+
+	if (req->result < 0) {
+		status = posix2fsal_status(-req->result);
+		LogFullDebug(COMPONENT_FSAL, "%s failed returning %s",
+			     req->write ? "pwritev" : "preadv",
+			     fsal_err_txt(status));
+	} else if (req->write) {
+		io_arg->io_amount = req->result;
+	} else {
+		io_arg->io_amount = req->result;
+		io_arg->end_of_file = (req->result == 0);
+	}
+
+	aio->status = status;
+
+	if (req->write && req->result >= 0 && io_arg->fsal_stable) {
+		/* fdatasync blocks, and the flush is shared with the other
+		 * writers of the file, so do it from a worker.
+		 */
+		io_arg->fsal_resume = VFS_RESUME_SYNC;
+	} else if (aio->my_fd->fsal_fd.close_on_complete) {
+		/* Closing the fd may block, so don't do it on the completion
+		 * thread; ask to be resumed on a worker instead.
+		 */
+		io_arg->fsal_resume = FSAL_CLOSEFD;
+	}
+
+	if (io_arg->fsal_resume) {
+		aio->done_cb(obj_hdl, status, io_arg, aio->caller_arg);
+		release_op_context();
+		return;
+	}
+
+resume:
+
+	status2 = fsal_complete_io(obj_hdl, &aio->my_fd->fsal_fd);
+
+	LogFullDebug(COMPONENT_FSAL, "fsal_complete_io returned %s",
+		     fsal_err_txt(status2));
+
+	if (io_arg->state == NULL) {
+		/* We did I/O without a state so we need to release the temp
+		 * share reservation acquired.
+		 */
+
+		/* Release the share reservation now by updating the counters.
+		 */
+		update_share_counters_locked(obj_hdl, &myself->u.file.share,
+					     req->write ? FSAL_O_WRITE
+							: FSAL_O_READ,
+					     FSAL_O_CLOSED);
+	}
+
+	aio->done_cb(obj_hdl, aio->status, io_arg, aio->caller_arg);
+
+	release_op_context();
+
+	vfs_async_io_free(aio);
+}
+
+/**
+ * @brief Hand a read or write to the io_uring engine
+ *
+ * @return true if the I/O was submitted; it will then be completed by
+ *         vfs_async_io_done() and neither aio nor obj_hdl may be touched
+ *         any more. false if the caller must do the I/O itself.
+ */
+
+static bool vfs_async_io_submit(struct vfs_async_io *aio,
+				struct fsal_obj_handle *obj_hdl,
+				struct vfs_fd *my_fd, bool write,
+				fsal_async_cb done_cb,
+				struct fsal_io_arg *io_arg, void *caller_arg)
+{
+	int rc;
+
+	aio->req.done = vfs_async_io_done;
+	aio->req.fd = my_fd->fd;
+	aio->req.iov = io_arg->iov;
+	aio->req.iov_count = io_arg->iov_count;
+	aio->req.offset = io_arg->offset;
+	aio->req.write = write;
+	aio->arg = io_arg;
+	aio->exp = op_ctx->ctx_export;
+	aio->fsal_export = op_ctx->fsal_export;
+	aio->my_fd = my_fd;
+	aio->obj_hdl = obj_hdl;
+	aio->done_cb = done_cb;
+	aio->caller_arg = caller_arg;
+
+	io_arg->cbi = &aio->req;
+	io_arg->io_amount = 0;
+
+	rc = vfs_uring_submit(&aio->req);
+
+	if (rc < 0) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "vfs_uring_submit failed (%s), doing synchronous I/O",
+			     strerror(-rc));
+		return false;
+	}
+
+	return true;
+}
+#endif
+
 /**
  * @brief Read data from a file
  *
@@ -1241,8 +1519,17 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	fsal_status_t status = { 0, 0 }, status2;
 	struct vfs_fd *my_fd;
 	struct vfs_fd temp_fd = { FSAL_FD_INIT, -1 };
+	struct vfs_fd *tmp_fd = &temp_fd;
 	struct fsal_fd *out_fd;
 	struct vfs_fsal_obj_handle *myself;
+#ifdef USE_FSAL_VFS_IO_URING
+	struct vfs_async_io *aio = NULL;
+
+	if (read_arg->fsal_resume) {
+		vfs_async_io_done(read_arg->cbi);
+		return;
+	}
+#endif
 
 	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
 
@@ -1261,9 +1548,16 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		goto exit;
 	}
 
+#ifdef USE_FSAL_VFS_IO_URING
+	aio = vfs_async_io_alloc(obj_hdl);
+
+	if (aio != NULL)
+		tmp_fd = &aio->temp_fd;
+#endif
+
 	/* Indicate a desire to start io and get a usable file descritor */
 	status = fsal_start_io(&out_fd, obj_hdl, &myself->u.file.fd.fsal_fd,
-			       &temp_fd.fsal_fd, read_arg->state, FSAL_O_READ,
+			       &tmp_fd->fsal_fd, read_arg->state, FSAL_O_READ,
 			       false, NULL, bypass, &myself->u.file.share);
 
 	if (FSAL_IS_ERROR(status)) {
@@ -1275,6 +1569,12 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 
 	my_fd = container_of(out_fd, struct vfs_fd, fsal_fd);
 
+#ifdef USE_FSAL_VFS_IO_URING
+	if (aio != NULL && vfs_async_io_submit(aio, obj_hdl, my_fd, false,
+					       done_cb, read_arg, caller_arg))
+		return;
+#endif
+
 	nb_read = preadv(my_fd->fd, read_arg->iov, read_arg->iov_count,
 			 read_arg->offset);
 
@@ -1326,6 +1626,11 @@ out:
 exit:
 
 	done_cb(obj_hdl, status, read_arg, caller_arg);
+
+#ifdef USE_FSAL_VFS_IO_URING
+	if (aio != NULL)
+		vfs_async_io_free(aio);
+#endif
 }
 
 /**
@@ -1358,8 +1663,18 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	int retval = 0;
 	struct vfs_fd *my_fd;
 	struct vfs_fd temp_fd = { FSAL_FD_INIT, -1 };
+	struct vfs_fd *tmp_fd = &temp_fd;
 	struct fsal_fd *out_fd;
 	struct vfs_fsal_obj_handle *myself;
+#ifdef USE_FSAL_VFS_IO_URING
+	struct vfs_async_io *aio = NULL;
+	struct fsal_module *fsal = obj_hdl->fsal;
+
+	if (write_arg->fsal_resume) {
+		vfs_async_io_done(write_arg->cbi);
+		return;
+	}
+#endif
 
 	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
 
@@ -1372,9 +1687,16 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		goto exit;
 	}
 
+#ifdef USE_FSAL_VFS_IO_URING
+	aio = vfs_async_io_alloc(obj_hdl);
+
+	if (aio != NULL)
+		tmp_fd = &aio->temp_fd;
+#endif
+
 	/* Indicate a desire to start io and get a usable file descritor */
 	status = fsal_start_io(&out_fd, obj_hdl, &myself->u.file.fd.fsal_fd,
-			       &temp_fd.fsal_fd, write_arg->state, FSAL_O_WRITE,
+			       &tmp_fd->fsal_fd, write_arg->state, FSAL_O_WRITE,
 			       false, NULL, bypass, &myself->u.file.share);
 
 	if (FSAL_IS_ERROR(status)) {
@@ -1394,6 +1716,18 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		goto out2;
 	}
 
+#ifdef USE_FSAL_VFS_IO_URING
+	/* Submit with the caller's credentials; the kernel does the I/O with
+	 * the credentials of the submitter.
+	 */
+	if (aio != NULL && vfs_async_io_submit(aio, obj_hdl, my_fd, true,
+					       done_cb, write_arg, caller_arg)) {
+		/* obj_hdl may already be released by the completion. */
+		vfs_restore_ganesha_credentials(fsal);
+		return;
+	}
+#endif
+
 	nb_written = pwritev(my_fd->fd, write_arg->iov, write_arg->iov_count,
 			     write_arg->offset);
 
@@ -1407,11 +1741,11 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	write_arg->io_amount = nb_written;
 
 	if (write_arg->fsal_stable) {
-		retval = fsync(my_fd->fd);
-		if (retval == -1) {
-			status2 = posix2fsal_status(errno);
+		retval = vfs_sync_group_flush(&myself->u.file.sync, my_fd->fd);
+		if (retval != 0) {
+			status2 = posix2fsal_status(retval);
 			write_arg->fsal_stable = false;
-			LogFullDebug(COMPONENT_FSAL, "fsync returned %s",
+			LogFullDebug(COMPONENT_FSAL, "fdatasync returned %s",
 				     fsal_err_txt(status2));
 		}
 	}
@@ -1441,6 +1775,11 @@ out2:
 exit:
 
 	done_cb(obj_hdl, status, write_arg, caller_arg);
+
+#ifdef USE_FSAL_VFS_IO_URING
+	if (aio != NULL)
+		vfs_async_io_free(aio);
+#endif
 }
 
 /**
@@ -1640,6 +1979,305 @@ exit:
 }
 #endif
 
+/**
+ * @brief Copy a range through a bounce buffer
+ *
+ * Used when copy_file_range() is unavailable or refuses the pair of files.
+ *
+ * @param[in]  src_fd     File descriptor to read from
+ * @param[in]  src_offset Offset to start reading at
+ * @param[in]  dst_fd     File descriptor to write to
+ * @param[in]  dst_offset Offset to start writing at
+ * @param[in]  count      Number of bytes to copy
+ * @param[out] copied     Number of bytes copied
+ *
+ * @return 0 or an errno value.
+ */
+
+#define VFS_COPY_BOUNCE_SIZE (1024 * 1024)
+
+static int vfs_copy_bounce(int src_fd, uint64_t src_offset, int dst_fd,
+			   uint64_t dst_offset, uint64_t count,
+			   uint64_t *copied)
+{
+	size_t bufsize = MIN(count, VFS_COPY_BOUNCE_SIZE);
+	char *buf = gsh_malloc(bufsize);
+	int ret = 0;
+
+	while (*copied < count) {
+		ssize_t nr, nw, put = 0;
+
+		nr = pread(src_fd, buf, MIN(count - *copied, bufsize),
+			   src_offset + *copied);
+
+		if (nr < 0) {
+			ret = errno;
+			break;
+		}
+
+		if (nr == 0)
+			break;
+
+		while (put < nr) {
+			nw = pwrite(dst_fd, buf + put, nr - put,
+				    dst_offset + *copied + put);
+			if (nw < 0) {
+				ret = errno;
+				break;
+			}
+			if (nw == 0) {
+				ret = EIO;
+				break;
+			}
+			put += nw;
+		}
+
+		*copied += put;
+
+		if (ret != 0)
+			break;
+	}
+
+	gsh_free(buf);
+
+	return ret;
+}
+
+/**
+ * @brief Copy or clone a range between two files
+ *
+ * Both files are opened for I/O through their states; when source and
+ * destination are the same open file a single read/write descriptor is
+ * used so that the global fd is never re-opened underneath itself.
+ *
+ * @param[in]  src_hdl    File to copy from
+ * @param[in]  src_state  State for src_hdl (or NULL)
+ * @param[in]  src_offset Offset in src_hdl
+ * @param[in]  dst_hdl    File to copy to
+ * @param[in]  dst_state  State for dst_hdl (or NULL)
+ * @param[in]  dst_offset Offset in dst_hdl
+ * @param[in]  count      Number of bytes
+ * @param[in]  clone      Share blocks with FICLONERANGE instead of copying
+ * @param[out] copied     Number of bytes copied (copy only)
+ *
+ * @return FSAL status.
+ */
+
+static fsal_status_t vfs_copy_range(struct fsal_obj_handle *src_hdl,
+				    struct state_t *src_state,
+				    uint64_t src_offset,
+				    struct fsal_obj_handle *dst_hdl,
+				    struct state_t *dst_state,
+				    uint64_t dst_offset, uint64_t count,
+				    bool clone, uint64_t *copied)
+{
+	int ret = 0;
+	fsal_status_t status, status2;
+	struct vfs_fd src_temp_fd = { FSAL_FD_INIT, -1 };
+	struct vfs_fd dst_temp_fd = { FSAL_FD_INIT, -1 };
+	struct fsal_fd *src_out_fd, *dst_out_fd = NULL;
+	struct vfs_fsal_obj_handle *src, *dst;
+	fsal_openflags_t src_flags = FSAL_O_READ;
+	bool same = src_hdl == dst_hdl && src_state == dst_state;
+	int src_fd, dst_fd;
+
+	src = container_of(src_hdl, struct vfs_fsal_obj_handle, obj_handle);
+	dst = container_of(dst_hdl, struct vfs_fsal_obj_handle, obj_handle);
+
+	if (same)
+		src_flags = FSAL_O_RDWR;
+
+	status = fsal_start_io(&src_out_fd, src_hdl, &src->u.file.fd.fsal_fd,
+			       &src_temp_fd.fsal_fd, src_state, src_flags,
+			       false, NULL, false, &src->u.file.share);
+
+	if (FSAL_IS_ERROR(status)) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "fsal_start_io (source) failed returning %s",
+			     fsal_err_txt(status));
+		return status;
+	}
+
+	src_fd = container_of(src_out_fd, struct vfs_fd, fsal_fd)->fd;
+
+	if (same) {
+		dst_fd = src_fd;
+	} else {
+		status = fsal_start_io(&dst_out_fd, dst_hdl,
+				       &dst->u.file.fd.fsal_fd,
+				       &dst_temp_fd.fsal_fd, dst_state,
+				       FSAL_O_WRITE, false, NULL, false,
+				       &dst->u.file.share);
+
+		if (FSAL_IS_ERROR(status)) {
+			LogFullDebug(COMPONENT_FSAL,
+				     "fsal_start_io (destination) failed returning %s",
+				     fsal_err_txt(status));
+			goto out_src;
+		}
+
+		dst_fd = container_of(dst_out_fd, struct vfs_fd, fsal_fd)->fd;
+	}
+
+	if (!vfs_set_credentials(&op_ctx->creds, dst_hdl->fsal)) {
+		status = posix2fsal_status(EPERM);
+		LogFullDebug(COMPONENT_FSAL,
+			     "vfs_set_credentials failed returning %s",
+			     fsal_err_txt(status));
+		goto out_dst;
+	}
+
+	if (clone) {
+#ifdef FICLONERANGE
+		struct file_clone_range fcr = {
+			.src_fd = src_fd,
+			.src_offset = src_offset,
+			.src_length = count,
+			.dest_offset = dst_offset,
+		};
+
+		if (ioctl(dst_fd, FICLONERANGE, &fcr) < 0)
+			ret = errno;
+#else
+		ret = ENOTSUP;
+#endif
+	} else {
+		*copied = 0;
+#ifdef HAVE_COPY_FILE_RANGE
+		while (*copied < count) {
+			off64_t in = src_offset + *copied;
+			off64_t out = dst_offset + *copied;
+			ssize_t n;
+
+			n = copy_file_range(src_fd, &in, dst_fd, &out,
+					    count - *copied, 0);
+			if (n < 0) {
+				ret = errno;
+				break;
+			}
+
+			if (n == 0)
+				break;
+
+			*copied += n;
+		}
+
+		/* Older kernels refuse cross file system copies and some
+		 * file systems don't implement it at all, do it by hand.
+		 */
+		if (*copied == 0 &&
+		    (ret == EXDEV || ret == ENOSYS || ret == EOPNOTSUPP ||
+		     ret == EINVAL))
+			ret = vfs_copy_bounce(src_fd, src_offset, dst_fd,
+					      dst_offset, count, copied);
+#else
+		ret = vfs_copy_bounce(src_fd, src_offset, dst_fd, dst_offset,
+				      count, copied);
+#endif
+		/* A short copy is reported as such, not as an error */
+		if (*copied != 0)
+			ret = 0;
+	}
+
+	if (ret != 0) {
+		LogFullDebug(COMPONENT_FSAL, "%s returned %s (%d)",
+			     clone ? "FICLONERANGE" : "copy", strerror(ret),
+			     ret);
+		status = posix2fsal_status(ret);
+	}
+
+	vfs_restore_ganesha_credentials(dst_hdl->fsal);
+
+out_dst:
+
+	if (!same) {
+		status2 = fsal_complete_io(dst_hdl, dst_out_fd);
+
+		LogFullDebug(COMPONENT_FSAL,
+			     "fsal_complete_io (destination) returned %s",
+			     fsal_err_txt(status2));
+
+		if (dst_state == NULL)
+			update_share_counters_locked(dst_hdl,
+						     &dst->u.file.share,
+						     FSAL_O_WRITE,
+						     FSAL_O_CLOSED);
+	}
+
+out_src:
+
+	status2 = fsal_complete_io(src_hdl, src_out_fd);
+
+	LogFullDebug(COMPONENT_FSAL, "fsal_complete_io (source) returned %s",
+		     fsal_err_txt(status2));
+
+	if (src_state == NULL) {
+		/* We did I/O without a state so we need to release the temp
+		 * share reservation acquired.
+		 */
+		update_share_counters_locked(src_hdl, &src->u.file.share,
+					     src_flags, FSAL_O_CLOSED);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Copy a range of bytes from one file to another
+ *
+ * Uses copy_file_range() so the kernel (or the underlying file system) moves
+ * the data, falling back to a bounce buffer where that is not possible.
+ *
+ * @param[in]  src_hdl    File to copy from
+ * @param[in]  src_state  State for src_hdl (or NULL)
+ * @param[in]  src_offset Offset in src_hdl
+ * @param[in]  dst_hdl    File to copy to
+ * @param[in]  dst_state  State for dst_hdl (or NULL)
+ * @param[in]  dst_offset Offset in dst_hdl
+ * @param[in]  count      Number of bytes to copy
+ * @param[out] copied     Number of bytes copied
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_copy(struct fsal_obj_handle *src_hdl,
+		       struct state_t *src_state, uint64_t src_offset,
+		       struct fsal_obj_handle *dst_hdl,
+		       struct state_t *dst_state, uint64_t dst_offset,
+		       uint64_t count, uint64_t *copied)
+{
+	return vfs_copy_range(src_hdl, src_state, src_offset, dst_hdl,
+			      dst_state, dst_offset, count, false, copied);
+}
+
+/**
+ * @brief Share a range of blocks between two files
+ *
+ * @param[in] src_hdl    File to clone from
+ * @param[in] src_state  State for src_hdl (or NULL)
+ * @param[in] src_offset Offset in src_hdl
+ * @param[in] dst_hdl    File to clone into
+ * @param[in] dst_state  State for dst_hdl (or NULL)
+ * @param[in] dst_offset Offset in dst_hdl
+ * @param[in] count      Number of bytes to clone, 0 for to end of file
+ *
+ * @return FSAL status.
+ */
+
+#ifdef FICLONERANGE
+fsal_status_t vfs_clone(struct fsal_obj_handle *src_hdl,
+			struct state_t *src_state, uint64_t src_offset,
+			struct fsal_obj_handle *dst_hdl,
+			struct state_t *dst_state, uint64_t dst_offset,
+			uint64_t count)
+{
+	uint64_t unused;
+
+	return vfs_copy_range(src_hdl, src_state, src_offset, dst_hdl,
+			      dst_state, dst_offset, count, true, &unused);
+}
+#endif
+
 /**
  * @brief Commit written data
  *
@@ -1687,10 +2325,13 @@ fsal_status_t vfs_commit2(struct fsal_obj_handle *obj_hdl, off_t offset,
 
 	my_fd = container_of(out_fd, struct vfs_fd, fsal_fd);
 
-	retval = fsync(my_fd->fd);
+	/* Flushing the whole file costs no more than the range, and lets this
+	 * COMMIT share a flush with any others and with stable writes.
+	 */
+	retval = vfs_sync_group_flush(&myself->u.file.sync, my_fd->fd);
 
-	if (retval == -1)
-		status = posix2fsal_status(errno);
+	if (retval != 0)
+		status = posix2fsal_status(retval);
 
 	vfs_restore_ganesha_credentials(obj_hdl->fsal);
 
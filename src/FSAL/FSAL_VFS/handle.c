@@ -99,6 +99,7 @@ void free_vfs_fsal_obj_handle(struct vfs_fsal_obj_handle **hdl_ref)
 		handle_to_key(&myself->obj_handle, &key);
 		vfs_state_release(&key);
 		destroy_fsal_fd(&myself->u.file.fd.fsal_fd);
+		vfs_sync_group_destroy(&myself->u.file.sync);
 	} else if (vfs_unopenable_type(type)) {
 		gsh_free(myself->u.unopenable.name);
 		gsh_free(myself->u.unopenable.dir);
@@ -152,6 +153,7 @@ alloc_handle(int dirfd, vfs_file_handle_t *fh, struct fsal_filesystem *fs,
 		init_fsal_fd(&hdl->u.file.fd.fsal_fd, FSAL_FD_GLOBAL,
 			     op_ctx->fsal_export);
 		hdl->u.file.fd.fd = -1; /* no open on this yet */
+		vfs_sync_group_init(&hdl->u.file.sync);
 	} else if (hdl->obj_handle.type == SYMBOLIC_LINK) {
 		ssize_t retlink;
 		size_t len = stat->st_size + 1;
@@ -1740,6 +1742,10 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->close = vfs_close;
 #ifdef FALLOC_FL_PUNCH_HOLE
 	ops->fallocate = vfs_fallocate;
+#endif
+	ops->copy = vfs_copy;
+#ifdef FICLONERANGE
+	ops->clone = vfs_clone;
 #endif
 	ops->handle_to_wire = handle_to_wire;
 	ops->handle_to_key = handle_to_key;
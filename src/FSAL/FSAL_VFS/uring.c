@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* uring.c
+ * io_uring submission and completion engine for VFS module
+ *
+ * Every thread that submits I/O gets its own ring, so submission never takes
+ * a lock. All rings share the kernel async worker pool of an anchor ring and
+ * signal completions through an eventfd. A single completion thread waits on
+ * all of those eventfds and runs the request callbacks.
+ *
+ * A ring belonging to a thread that exits is orphaned; the completion thread
+ * tears it down once the last of its I/O has completed.
+ */
+
+#include "config.h"
+
+#ifdef USE_FSAL_VFS_IO_URING
+
+#include <liburing.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "fsal.h"
+#include "gsh_list.h"
+#include "abstract_atomic.h"
+#include "vfs_methods.h"
+
+struct vfs_uring {
+	struct io_uring ring;
+	/** Registered with the ring, signalled on every completion */
+	int efd;
+	/** Number of CQEs still expected on this ring */
+	uint32_t inflight;
+	/** The owning thread has exited */
+	bool orphaned;
+	struct glist_head list;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_key_t key;
+	pthread_t thread;
+	int epfd;
+	/** Wakes the completion thread for shutdown */
+	int stop_efd;
+	unsigned int depth;
+	struct io_uring anchor;
+	struct glist_head rings;
+	bool running;
+} vfs_uring;
+
+static void vfs_uring_destroy(struct vfs_uring *ur)
+{
+	(void)epoll_ctl(vfs_uring.epfd, EPOLL_CTL_DEL, ur->efd, NULL);
+	(void)io_uring_unregister_eventfd(&ur->ring);
+	io_uring_queue_exit(&ur->ring);
+	close(ur->efd);
+
+	PTHREAD_MUTEX_lock(&vfs_uring.mutex);
+	glist_del(&ur->list);
+	PTHREAD_MUTEX_unlock(&vfs_uring.mutex);
+
+	gsh_free(ur);
+}
+
+/**
+ * @brief Hand a thread's ring over to the completion thread
+ *
+ * Called as the thread exits. I/O may still be in flight on the ring, so
+ * only the completion thread may free it.
+ *
+ * @param[in] arg The ring
+ */
+
+static void vfs_uring_orphan(void *arg)
+{
+	struct vfs_uring *ur = arg;
+
+	PTHREAD_MUTEX_lock(&vfs_uring.mutex);
+	ur->orphaned = true;
+	PTHREAD_MUTEX_unlock(&vfs_uring.mutex);
+
+	(void)eventfd_write(ur->efd, 1);
+}
+
+/**
+ * @brief Get (creating if necessary) the calling thread's ring
+ *
+ * @return The ring, or NULL if one could not be set up.
+ */
+
+static struct vfs_uring *vfs_uring_get(void)
+{
+	struct vfs_uring *ur = pthread_getspecific(vfs_uring.key);
+	struct io_uring_params params;
+	struct epoll_event ev;
+	int rc;
+
+	if (ur != NULL)
+		return ur;
+
+	ur = gsh_calloc(1, sizeof(*ur));
+
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_ATTACH_WQ;
+	params.wq_fd = vfs_uring.anchor.ring_fd;
+
+	rc = io_uring_queue_init_params(vfs_uring.depth, &ur->ring, &params);
+
+	if (rc == -EINVAL) {
+		/* Kernel too old to share the async worker pool */
+		memset(&params, 0, sizeof(params));
+		rc = io_uring_queue_init_params(vfs_uring.depth, &ur->ring,
+						&params);
+	}
+
+	if (rc < 0) {
+		LogMajor(COMPONENT_FSAL, "io_uring_queue_init failed: %s",
+			 strerror(-rc));
+		gsh_free(ur);
+		return NULL;
+	}
+
+	ur->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (ur->efd < 0) {
+		rc = errno;
+		LogMajor(COMPONENT_FSAL, "eventfd failed: %s", strerror(rc));
+		goto err_ring;
+	}
+
+	rc = io_uring_register_eventfd(&ur->ring, ur->efd);
+
+	if (rc < 0) {
+		LogMajor(COMPONENT_FSAL, "io_uring_register_eventfd failed: %s",
+			 strerror(-rc));
+		goto err_efd;
+	}
+
+	PTHREAD_MUTEX_lock(&vfs_uring.mutex);
+	glist_add_tail(&vfs_uring.rings, &ur->list);
+	PTHREAD_MUTEX_unlock(&vfs_uring.mutex);
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = ur;
+
+	if (epoll_ctl(vfs_uring.epfd, EPOLL_CTL_ADD, ur->efd, &ev) < 0) {
+		rc = errno;
+		LogMajor(COMPONENT_FSAL, "epoll_ctl failed: %s", strerror(rc));
+		PTHREAD_MUTEX_lock(&vfs_uring.mutex);
+		glist_del(&ur->list);
+		PTHREAD_MUTEX_unlock(&vfs_uring.mutex);
+		goto err_efd;
+	}
+
+	(void)pthread_setspecific(vfs_uring.key, ur);
+
+	return ur;
+
+err_efd:
+	close(ur->efd);
+err_ring:
+	io_uring_queue_exit(&ur->ring);
+	gsh_free(ur);
+	return NULL;
+}
+
+/**
+ * @brief Submit a request on the calling thread's ring
+ *
+ * On success, req->done will be called on the completion thread once the
+ * I/O has completed. On failure nothing was queued and the caller should do
+ * the I/O synchronously.
+ *
+ * @param[in] req	The request to submit
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+
+int vfs_uring_submit(struct vfs_uring_req *req)
+{
+	struct vfs_uring *ur;
+	struct io_uring_sqe *sqe;
+	int rc;
+
+	if (!vfs_uring.running)
+		return -ENOSYS;
+
+	ur = vfs_uring_get();
+
+	if (ur == NULL)
+		return -ENOMEM;
+
+	/* Nothing is ever left queued, so there is always room */
+	sqe = io_uring_get_sqe(&ur->ring);
+
+	if (sqe == NULL)
+		return -EAGAIN;
+
+	req->result = 0;
+
+	if (req->write)
+		io_uring_prep_writev(sqe, req->fd, req->iov, req->iov_count,
+				     req->offset);
+	else
+		io_uring_prep_readv(sqe, req->fd, req->iov, req->iov_count,
+				    req->offset);
+
+	io_uring_sqe_set_data(sqe, req);
+
+	(void)atomic_inc_uint32_t(&ur->inflight);
+
+	do {
+		rc = io_uring_submit(&ur->ring);
+	} while (rc == -EINTR || rc == -EAGAIN || rc == -EBUSY);
+
+	if (rc < 0) {
+		/* The entries are stuck in the submission queue. Stop using
+		 * this ring so they can never be picked up behind our back,
+		 * and let the caller fall back to synchronous I/O.
+		 */
+		LogCrit(COMPONENT_FSAL, "io_uring_submit failed: %s",
+			strerror(-rc));
+		(void)atomic_dec_uint32_t(&ur->inflight);
+		(void)pthread_setspecific(vfs_uring.key, NULL);
+		vfs_uring_orphan(ur);
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Run the callbacks for all completions posted to a ring
+ *
+ * @param[in] ur	The ring
+ *
+ * @return true if the ring is orphaned and idle.
+ */
+
+static bool vfs_uring_reap(struct vfs_uring *ur)
+{
+	struct io_uring_cqe *cqe;
+	struct vfs_uring_req *req;
+	uint32_t inflight;
+	bool orphaned;
+	eventfd_t val;
+
+	(void)eventfd_read(ur->efd, &val);
+
+	while (io_uring_peek_cqe(&ur->ring, &cqe) == 0) {
+		req = io_uring_cqe_get_data(cqe);
+		req->result = cqe->res;
+
+		io_uring_cqe_seen(&ur->ring, cqe);
+
+		req->done(req);
+
+		(void)atomic_dec_uint32_t(&ur->inflight);
+	}
+
+	PTHREAD_MUTEX_lock(&vfs_uring.mutex);
+	orphaned = ur->orphaned;
+	PTHREAD_MUTEX_unlock(&vfs_uring.mutex);
+
+	inflight = atomic_fetch_uint32_t(&ur->inflight);
+
+	return orphaned && inflight == 0;
+}
+
+static void *vfs_uring_thread(void *arg)
+{
+	struct epoll_event events[64];
+	int i, n;
+
+	SetNameFunction("vfs_uring");
+
+	while (true) {
+		n = epoll_wait(vfs_uring.epfd, events, ARRAY_SIZE(events), -1);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			LogCrit(COMPONENT_FSAL, "epoll_wait failed: %s",
+				strerror(errno));
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct vfs_uring *ur = events[i].data.ptr;
+
+			if (ur == NULL)
+				return NULL;
+
+			if (vfs_uring_reap(ur))
+				vfs_uring_destroy(ur);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Start the io_uring engine
+ *
+ * If io_uring is not usable the engine stays off and read2/write2 remain
+ * synchronous.
+ *
+ * @param[in] depth	Submission queue entries per ring
+ *
+ * @return 0 on success, errno otherwise.
+ */
+
+int vfs_uring_init(unsigned int depth)
+{
+	struct epoll_event ev;
+	int rc;
+
+	if (vfs_uring.running)
+		return 0;
+
+	rc = io_uring_queue_init(depth, &vfs_uring.anchor, 0);
+
+	if (rc < 0) {
+		LogWarn(COMPONENT_FSAL,
+			"io_uring unavailable (%s), using synchronous I/O",
+			strerror(-rc));
+		return -rc;
+	}
+
+	vfs_uring.depth = depth;
+	glist_init(&vfs_uring.rings);
+	PTHREAD_MUTEX_init(&vfs_uring.mutex, NULL);
+
+	rc = pthread_key_create(&vfs_uring.key, vfs_uring_orphan);
+
+	if (rc != 0)
+		goto err_mutex;
+
+	vfs_uring.epfd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (vfs_uring.epfd < 0) {
+		rc = errno;
+		goto err_key;
+	}
+
+	vfs_uring.stop_efd = eventfd(0, EFD_CLOEXEC);
+
+	if (vfs_uring.stop_efd < 0) {
+		rc = errno;
+		goto err_epfd;
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+
+	if (epoll_ctl(vfs_uring.epfd, EPOLL_CTL_ADD, vfs_uring.stop_efd,
+		      &ev) < 0) {
+		rc = errno;
+		goto err_stop;
+	}
+
+	rc = pthread_create(&vfs_uring.thread, NULL, vfs_uring_thread, NULL);
+
+	if (rc != 0)
+		goto err_stop;
+
+	vfs_uring.running = true;
+
+	LogInfo(COMPONENT_FSAL, "io_uring engine started, %u entries per ring",
+		depth);
+
+	return 0;
+
+err_stop:
+	close(vfs_uring.stop_efd);
+err_epfd:
+	close(vfs_uring.epfd);
+err_key:
+	(void)pthread_key_delete(vfs_uring.key);
+err_mutex:
+	PTHREAD_MUTEX_destroy(&vfs_uring.mutex);
+	io_uring_queue_exit(&vfs_uring.anchor);
+
+	LogCrit(COMPONENT_FSAL, "Could not start io_uring engine: %s",
+		strerror(rc));
+
+	return rc;
+}
+
+/**
+ * @brief Stop the io_uring engine
+ *
+ * No I/O may be outstanding. The thread key is deleted first so exiting
+ * threads do not call back into an unloaded module.
+ */
+
+void vfs_uring_shutdown(void)
+{
+	struct vfs_uring *ur;
+
+	if (!vfs_uring.running)
+		return;
+
+	vfs_uring.running = false;
+
+	(void)pthread_key_delete(vfs_uring.key);
+	(void)eventfd_write(vfs_uring.stop_efd, 1);
+	(void)pthread_join(vfs_uring.thread, NULL);
+
+	while ((ur = glist_first_entry(&vfs_uring.rings, struct vfs_uring,
+				       list)) != NULL) {
+		if (atomic_fetch_uint32_t(&ur->inflight) != 0)
+			LogCrit(COMPONENT_FSAL,
+				"io_uring ring %p still has I/O in flight",
+				ur);
+		vfs_uring_destroy(ur);
+	}
+
+	close(vfs_uring.stop_efd);
+	close(vfs_uring.epfd);
+	io_uring_queue_exit(&vfs_uring.anchor);
+	PTHREAD_MUTEX_destroy(&vfs_uring.mutex);
+}
+
+#endif /* USE_FSAL_VFS_IO_URING */
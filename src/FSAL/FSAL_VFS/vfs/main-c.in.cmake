@@ -105,6 +105,10 @@ static struct config_item vfs_params[] = {
 		       module.fs_info.auth_exportpath_xdev),
 	CONF_ITEM_BOOL("only_one_user", false, vfs_fsal_module,
 		       only_one_user),
+	CONF_ITEM_BOOL("async_io", false, vfs_fsal_module,
+		       async_io),
+	CONF_ITEM_UI32("async_io_depth", 8, 4096, 128, vfs_fsal_module,
+		       async_io_depth),
 	CONFIG_EOL
 };
 
@@ -191,6 +195,19 @@ static fsal_status_t init_config(struct fsal_module *vfs_fsal_module,
 	    !config_error_is_harmless(err_type))
 		return fsalstat(ERR_FSAL_INVAL, 0);
 
+#ifdef USE_FSAL_VFS_IO_URING
+	if (vfs_module->async_io &&
+	    vfs_uring_init(vfs_module->async_io_depth) != 0)
+		vfs_module->async_io = false;
+#else
+	if (vfs_module->async_io) {
+		LogWarn(COMPONENT_FSAL,
+			"FSAL_%s built without io_uring, async_io disabled",
+			myname);
+		vfs_module->async_io = false;
+	}
+#endif
+
 	display_fsinfo(&vfs_module->module);
 	LogFullDebug(COMPONENT_FSAL,
 		     "Supported attributes constant = 0x%" PRIx64,
@@ -232,6 +249,10 @@ MODULE_FINI void vfs_unload(void)
 {
 	int retval;
 
+#ifdef USE_FSAL_VFS_IO_URING
+	vfs_uring_shutdown();
+#endif
+
 	retval = unregister_fsal(&VFS.module);
 	if (retval != 0) {
 		fprintf(stderr, "VFS module failed to unregister");
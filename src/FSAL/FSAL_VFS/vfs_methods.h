@@ -47,6 +47,10 @@ struct vfs_fsal_module {
 	struct fsal_module module;
 	struct fsal_obj_ops handle_ops;
 	bool only_one_user;
+	/** Submit read2/write2 through io_uring and complete them async */
+	bool async_io;
+	/** Submission queue entries in each per-thread ring */
+	uint32_t async_io_depth;
 };
 
 /*
@@ -146,6 +150,27 @@ struct vfs_state_fd {
 	struct vfs_fd vfs_fd;
 };
 
+/**
+ * @brief Group commit state of a regular file
+ *
+ * Stable writes and COMMITs that arrive while a flush of the file is running
+ * wait for the next flush, which one of them issues on behalf of all.
+ */
+struct vfs_sync_group {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/** Sequence number of the last flush started */
+	uint64_t started;
+	/** Sequence number of the last flush completed */
+	uint64_t completed;
+	/** Sequence number of the last flush that failed */
+	uint64_t failed;
+	/** errno of that flush */
+	int error;
+	/** A flush is running */
+	bool flushing;
+};
+
 /**
  * @brief VFS internal object handle
  *
@@ -174,6 +199,7 @@ struct vfs_fsal_obj_handle {
 		struct {
 			struct fsal_share share;
 			struct vfs_fd fd;
+			struct vfs_sync_group sync;
 		} file;
 		struct {
 			unsigned char *link_content;
@@ -263,6 +289,10 @@ struct state_hdl *vfs_state_locate(struct fsal_obj_handle *obj);
 /* I/O management */
 fsal_status_t vfs_close_my_fd(struct vfs_fd *my_fd);
 
+void vfs_sync_group_init(struct vfs_sync_group *sg);
+void vfs_sync_group_destroy(struct vfs_sync_group *sg);
+int vfs_sync_group_flush(struct vfs_sync_group *sg, int fd);
+
 fsal_status_t vfs_close(struct fsal_obj_handle *obj_hdl);
 
 /* Multiple file descriptor methods */
@@ -296,6 +326,28 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl, bool bypass,
 		fsal_async_cb done_cb, struct fsal_io_arg *write_arg,
 		void *caller_arg);
 
+#ifdef USE_FSAL_VFS_IO_URING
+/* io_uring engine */
+struct vfs_uring_req {
+	/** Called on the completion thread when all the I/O is done */
+	void (*done)(struct vfs_uring_req *req);
+	int fd;
+	const struct iovec *iov;
+	int iov_count;
+	uint64_t offset;
+	bool write;
+	/** Result of the read or write, bytes or negative errno */
+	int32_t result;
+};
+
+/* Resume reason: a stable write is waiting for the sync group */
+#define VFS_RESUME_SYNC 1001
+
+int vfs_uring_init(unsigned int depth);
+void vfs_uring_shutdown(void);
+int vfs_uring_submit(struct vfs_uring_req *req);
+#endif
+
 #ifdef __USE_GNU
 fsal_status_t vfs_seek2(struct fsal_obj_handle *obj_hdl, struct state_t *state,
 			struct io_info *info);
@@ -307,6 +359,20 @@ fsal_status_t vfs_fallocate(struct fsal_obj_handle *obj_hdl,
 			    uint64_t length, bool allocate);
 #endif
 
+fsal_status_t vfs_copy(struct fsal_obj_handle *src_hdl,
+		       struct state_t *src_state, uint64_t src_offset,
+		       struct fsal_obj_handle *dst_hdl,
+		       struct state_t *dst_state, uint64_t dst_offset,
+		       uint64_t count, uint64_t *copied);
+
+#ifdef FICLONERANGE
+fsal_status_t vfs_clone(struct fsal_obj_handle *src_hdl,
+			struct state_t *src_state, uint64_t src_offset,
+			struct fsal_obj_handle *dst_hdl,
+			struct state_t *dst_state, uint64_t dst_offset,
+			uint64_t count);
+#endif
+
 fsal_status_t vfs_commit2(struct fsal_obj_handle *obj_hdl, off_t offset,
 			  size_t len);
 
@@ -43,6 +43,14 @@
  * @brief Structure to hold MDCACHE parameters
  */
 
+/**
+ * @brief Replacement policies for the MDCACHE entry LRU
+ */
+enum mdcache_lru_policy {
+	MDCACHE_LRU_POLICY_LRU, /*< Multi-level L1/L2 LRU (default) */
+	MDCACHE_LRU_POLICY_ARC, /*< Adaptive Replacement Cache */
+};
+
 struct mdcache_parameter {
 	/** Partitions in the MDCACHE tree.  Defaults to 7,
 	 * settable with NParts. */
@@ -66,6 +74,11 @@ struct mdcache_parameter {
 		uint32_t avl_detached_mult;
 		/** Computed max detached dirents */
 		uint32_t avl_detached_max;
+		/** Number of chunks to populate ahead of a sequential
+		 *  readdir, 0 disables prefetch.  Settable with
+		 *  Dir_Chunk_Prefetch.
+		 */
+		uint32_t prefetch_chunks;
 	} dir;
 	/** High water mark for cache entries.  Defaults to 100000,
 	    settable by Entries_HWMark. */
@@ -144,6 +157,16 @@ struct mdcache_parameter {
 	    can significantly improve performance saving the need to update
 	    attributes on many read/write operations. */
 	bool use_cached_owner_on_owner_override;
+	/** Replacement policy for cache entries (enum mdcache_lru_policy).
+	    Defaults to LRU, settable with LRU_Policy. */
+	uint32_t lru_policy;
+	/** Number of LRU lanes, split between NUMA nodes and rounded up to
+	    a prime per node.  Defaults to 0, meaning twice the number of
+	    CPUs with a minimum of 17, settable with LRU_Lanes. */
+	uint32_t lru_lanes;
+	/** Place entries and LRU threads on the NUMA node of the allocating
+	    CPU.  Defaults to true, settable with LRU_NUMA_Aware. */
+	bool lru_numa_aware;
 };
 
 extern struct mdcache_parameter mdcache_param;
@@ -1555,6 +1555,8 @@ void mdcache_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->setattr2 = mdcache_setattr2;
 	ops->close2 = mdcache_close2;
 	ops->fallocate = mdcache_fallocate;
+	ops->copy = mdcache_copy;
+	ops->clone = mdcache_clone;
 
 	/* xattr related functions */
 	ops->list_ext_attrs = mdcache_list_ext_attrs;
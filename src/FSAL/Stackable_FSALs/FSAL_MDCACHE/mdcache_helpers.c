@@ -50,6 +50,7 @@
 #include "mdcache_lru.h"
 #include "mdcache_hash.h"
 #include "mdcache_avl.h"
+#include "fridgethr.h"
 #ifdef USE_MONITORING
 #include "monitoring.h"
 #endif /* USE_MONITORING */
@@ -625,6 +626,10 @@ void mdcache_dirent_invalidate_all(mdcache_entry_t *entry)
 	/* Clean the active and deleted trees */
 	mdcache_avl_clean_trees(entry);
 
+	/* Cookies may be handed out again by the reloaded chunks */
+	atomic_store_uint64_t(&entry->fsobj.fsdir.readdir_ck, 0);
+	atomic_store_uint64_t(&entry->fsobj.fsdir.prefetch_ck, 0);
+
 	atomic_clear_uint32_t_bits(&entry->mde_flags, MDCACHE_DIR_POPULATED);
 
 	atomic_set_uint32_t_bits(&entry->mde_flags,
@@ -2814,6 +2819,256 @@ again:
 	return status;
 }
 
+/**
+ * @brief Readdir chunk prefetch
+ *
+ * When a client reads a directory sequentially, the chunks following the one
+ * it is consuming are populated on a background thread, so that by the time
+ * the client walks off the end of its chunk the next one is already cached
+ * instead of stalling on the sub-FSAL.
+ */
+
+static struct fridgethr *prefetch_fridge;
+
+struct mdc_prefetch {
+	mdcache_entry_t *directory;
+	struct gsh_export *exp;
+	struct fsal_export *fsal_export;
+	/** A cookie in the chunk to populate after */
+	fsal_cookie_t ck;
+};
+
+/**
+ * @brief Populate the chunks following a chunk being read
+ *
+ * The content lock is taken and dropped for each chunk so readers of the
+ * chunks already cached are not held up for the whole prefetch.
+ *
+ * @param[in] ctx	Thread context, ctx->arg is the struct mdc_prefetch
+ */
+
+static void mdc_readdir_prefetch_run(struct fridgethr_context *ctx)
+{
+	struct mdc_prefetch *pf = ctx->arg;
+	mdcache_entry_t *directory = pf->directory;
+	struct req_op_context op_context;
+	mdcache_dir_entry_t *dirent, *last;
+	struct dir_chunk *chunk;
+	fsal_cookie_t ck = pf->ck;
+	fsal_status_t status;
+	uint32_t n;
+	bool eod;
+
+	/* Consumes the export reference taken when the job was queued */
+	init_op_context_simple(&op_context, pf->exp, pf->fsal_export);
+
+	for (n = 0; n < mdcache_param.dir.prefetch_chunks; n++) {
+		if (fridgethr_you_should_break(ctx))
+			break;
+
+		PTHREAD_RWLOCK_wrlock(&directory->content_lock);
+
+		if (!test_mde_flags(directory, MDCACHE_TRUST_CONTENT |
+						       MDCACHE_TRUST_DIR_CHUNKS) ||
+		    !mdcache_avl_lookup_ck(directory, ck, &dirent)) {
+			/* Invalidated, or the chunk was reaped */
+			PTHREAD_RWLOCK_unlock(&directory->content_lock);
+			break;
+		}
+
+		/* dirent->chunk has a ref from the lookup */
+		chunk = dirent->chunk;
+
+		if (chunk->next_ck != 0 &&
+		    mdcache_avl_lookup_ck(directory, chunk->next_ck, &dirent)) {
+			/* Next chunk is already cached, move on to it. */
+			mdcache_lru_unref_chunk(chunk);
+			chunk = dirent->chunk;
+		} else {
+			last = glist_last_entry(&chunk->dirents,
+						mdcache_dir_entry_t,
+						chunk_list);
+
+			if (last->eod ||
+			    atomic_fetch_uint64_t(&lru_state.chunks_used) >=
+				    lru_state.chunks_hiwat) {
+				/* Don't push out chunks just to read ahead */
+				mdcache_lru_unref_chunk(chunk);
+				PTHREAD_RWLOCK_unlock(&directory->content_lock);
+				break;
+			}
+
+			LogFullDebugAlt(COMPONENT_NFS_READDIR,
+					COMPONENT_MDCACHE,
+					"Prefetching chunk of %p after cookie %"
+					PRIx64, directory, last->ck);
+
+			dirent = NULL;
+			eod = false;
+
+			/* Passes our ref on chunk */
+			status = mdcache_populate_dir_chunk(directory, last->ck,
+							    &dirent, chunk,
+							    &eod);
+
+			if (FSAL_IS_ERROR(status) || dirent == NULL) {
+				PTHREAD_RWLOCK_unlock(&directory->content_lock);
+
+				LogFullDebugAlt(COMPONENT_NFS_READDIR,
+						COMPONENT_MDCACHE,
+						"Prefetch of %p stopped status=%s",
+						directory, fsal_err_txt(status));
+
+				if (status.major == ERR_FSAL_STALE)
+					mdcache_kill_entry(directory);
+				break;
+			}
+
+			/* As in mdcache_readdir_chunked, a chunk populated
+			 * from the middle of the directory means we don't
+			 * know the whole directory is cached.
+			 */
+			atomic_clear_uint32_t_bits(&directory->mde_flags,
+						   MDCACHE_DIR_POPULATED);
+
+			chunk = dirent->chunk;
+		}
+
+		last = glist_last_entry(&chunk->dirents, mdcache_dir_entry_t,
+					chunk_list);
+		ck = last->ck;
+
+		mdcache_lru_unref_chunk(chunk);
+		PTHREAD_RWLOCK_unlock(&directory->content_lock);
+	}
+
+	mdcache_lru_unref(directory, LRU_ACTIVE_REF);
+	release_op_context();
+	gsh_free(pf);
+}
+
+/**
+ * @brief Queue prefetch of the chunks following a chunk a client has started
+ *        to read
+ *
+ * @note The content lock MUST be held
+ *
+ * @param[in] directory	The directory being read
+ * @param[in] chunk	The chunk the client is reading
+ */
+
+static void mdc_readdir_prefetch(mdcache_entry_t *directory,
+				 struct dir_chunk *chunk)
+{
+	mdcache_dir_entry_t *first, *last;
+	struct mdc_prefetch *pf;
+	int rc;
+
+	if (prefetch_fridge == NULL)
+		return;
+
+	first = glist_first_entry(&chunk->dirents, mdcache_dir_entry_t,
+				  chunk_list);
+	last = glist_last_entry(&chunk->dirents, mdcache_dir_entry_t,
+				chunk_list);
+
+	if (first == NULL || last->eod)
+		return;
+
+	/* Only queue once per chunk, not for every READDIR that reads some
+	 * of it.
+	 */
+	if (atomic_fetch_uint64_t(&directory->fsobj.fsdir.prefetch_ck) ==
+	    first->ck)
+		return;
+
+	atomic_store_uint64_t(&directory->fsobj.fsdir.prefetch_ck, first->ck);
+
+	if (atomic_fetch_uint64_t(&lru_state.chunks_used) >=
+	    lru_state.chunks_hiwat)
+		return;
+
+	pf = gsh_malloc(sizeof(*pf));
+	pf->directory = directory;
+	pf->exp = op_ctx->ctx_export;
+	pf->fsal_export = op_ctx->fsal_export;
+	pf->ck = last->ck;
+
+	mdcache_lru_ref(directory, LRU_ACTIVE_REF);
+	get_gsh_export_ref(pf->exp);
+
+	rc = fridgethr_submit(prefetch_fridge, mdc_readdir_prefetch_run, pf);
+
+	if (rc != 0) {
+		LogDebugAlt(COMPONENT_NFS_READDIR, COMPONENT_MDCACHE,
+			    "Unable to queue readdir prefetch, error %d", rc);
+		put_gsh_export(pf->exp);
+		mdcache_lru_unref(directory, LRU_ACTIVE_REF);
+		gsh_free(pf);
+	}
+}
+
+/**
+ * @brief Start the readdir prefetch threads
+ *
+ * @return 0 or an errno value.
+ */
+
+int mdcache_readdir_prefetch_init(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (mdcache_param.dir.avl_chunk == 0 ||
+	    mdcache_param.dir.prefetch_chunks == 0)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 4;
+	frp.thr_min = 0;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&prefetch_fridge, "MDC_prefetch", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_MDCACHE,
+			 "Unable to initialize readdir prefetch fridge, error code %d.",
+			 rc);
+		prefetch_fridge = NULL;
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Stop the readdir prefetch threads
+ */
+
+void mdcache_readdir_prefetch_shutdown(void)
+{
+	int rc;
+
+	if (prefetch_fridge == NULL)
+		return;
+
+	rc = fridgethr_sync_command(prefetch_fridge, fridgethr_comm_stop, 120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_MDCACHE,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(prefetch_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_MDCACHE,
+			 "Failed shutting down readdir prefetch threads: %d",
+			 rc);
+	}
+
+	if (rc == 0)
+		fridgethr_destroy(prefetch_fridge);
+
+	prefetch_fridge = NULL;
+}
+
 /**
  * @brief Read the contents of a directory
  *
@@ -2866,12 +3121,19 @@ fsal_status_t mdcache_readdir_chunked(mdcache_entry_t *directory,
 	mdcache_dir_entry_t *dirent = NULL;
 	bool has_write, set_first_ck;
 	fsal_cookie_t next_ck = whence, look_ck = whence;
-	fsal_cookie_t save_ck = 0;
+	fsal_cookie_t save_ck = 0, last_ck = whence;
 	struct dir_chunk *chunk = NULL;
 	bool eod = false;
 	bool reload_chunk = false;
 	bool whence_is_name = op_ctx->fsal_export->exp_ops.fs_supports(
 		op_ctx->fsal_export, fso_whence_is_name);
+	/* Reading from the start, or continuing where the last READDIR of
+	 * this directory left off, looks like a sequential listing.
+	 */
+	bool sequential =
+		whence == 0 ||
+		whence == atomic_fetch_uint64_t(
+				  &directory->fsobj.fsdir.readdir_ck);
 
 	GSH_AUTO_TRACEPOINT(mdcache, mdc_readdir, TRACE_DEBUG,
 			    "Readdir for obj handle: {}",
@@ -3102,6 +3364,9 @@ again:
 	/* Bump the chunk in the LRU */
 	lru_bump_chunk(chunk);
 
+	if (sequential)
+		mdc_readdir_prefetch(directory, chunk);
+
 	LogFullDebugAlt(COMPONENT_NFS_READDIR, COMPONENT_MDCACHE,
 			"About to read directory=%p cookie=%" PRIx64, directory,
 			next_ck);
@@ -3302,6 +3567,9 @@ again:
 
 		fsal_release_attrs(&attrs);
 
+		if (cb_result != DIR_TERMINATE)
+			last_ck = dirent->ck;
+
 		if (whence_is_name) {
 			/* Save the dirmap for the dirents so that
 			 * whence-is-name doesn't need to restart a readdir to
@@ -3329,6 +3597,12 @@ again:
 			 */
 			*eod_met = cb_result != DIR_TERMINATE && dirent->eod;
 
+			/* The next READDIR continues from the last entry the
+			 * callback consumed.
+			 */
+			atomic_store_uint64_t(
+				&directory->fsobj.fsdir.readdir_ck, last_ck);
+
 			if (*eod_met && whence == 0) {
 				/* Since eod is true and whence is 0, we know
 				 * the entire directory is populated.
@@ -151,6 +151,8 @@ enum lru_q_id {
 	LRU_ENTRY_L2,
 	LRU_ENTRY_CLEANUP,
 	LRU_ENTRY_ACTIVE,
+	LRU_GHOST_B1, /* ARC ghosts of entries evicted from L2 (never entries) */
+	LRU_GHOST_B2, /* ARC ghosts of entries evicted from L1 (never entries) */
 };
 
 #define LRU_CLEANUP 0x00000001 /* Entry is on cleanup queue */
@@ -160,6 +162,14 @@ enum lru_q_id {
 				   * last active reference (never cleared).
 				   */
 #define LRU_SENTINEL_HELD 0x00000008 /* true if sentinel reference is held */
+#define LRU_REFERENCED \
+	0x00000020 /* Entry became active since it was last queued,
+				   * it has to be requeued before reaping.
+				   */
+#define LRU_ARC_FREQUENT \
+	0x00000010 /* ARC policy: entry has been re-referenced and
+				   * belongs in L1 (T2) when inactive.
+				   */
 
 typedef struct mdcache_lru__ {
 	struct glist_head q; /*< Link in the physical deque
@@ -176,6 +186,8 @@ typedef struct mdcache_lru__ {
 				 *< decrement the correct counter when moving
 				 *< or deleting the entry. */
 	uint32_t cf; /*< Confounder */
+	uint32_t stamp; /*< ARC policy: lane clock when the entry was last
+			 *< queued on L2 (T1). */
 } mdcache_lru_t;
 
 /**
@@ -347,6 +359,14 @@ struct mdcache_fsal_obj_handle {
 			 *  0 if not known.
 			 */
 			fsal_cookie_t first_ck;
+			/** Cookie of the last entry returned by readdir, a
+			 *  readdir continuing from it is sequential.
+			 */
+			fsal_cookie_t readdir_ck;
+			/** First cookie of the chunk the last prefetch was
+			 *  queued from.
+			 */
+			fsal_cookie_t prefetch_ck;
 			struct {
 				/** Children by name hash */
 				struct avltree t;
@@ -519,6 +539,8 @@ fsal_status_t mdcache_readdir_chunked(mdcache_entry_t *directory,
 				      fsal_cookie_t whence, void *dir_state,
 				      fsal_readdir_cb cb, attrmask_t attrmask,
 				      bool *eod_met);
+int mdcache_readdir_prefetch_init(void);
+void mdcache_readdir_prefetch_shutdown(void);
 
 fsal_status_t mdc_get_parent(struct mdcache_fsal_export *exp,
 			     mdcache_entry_t *entry,
@@ -1061,6 +1083,16 @@ fsal_status_t mdcache_close2(struct fsal_obj_handle *obj_hdl,
 fsal_status_t mdcache_fallocate(struct fsal_obj_handle *obj_hdl,
 				struct state_t *state, uint64_t offset,
 				uint64_t length, bool allocate);
+fsal_status_t mdcache_copy(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state, uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state, uint64_t dst_offset,
+			   uint64_t count, uint64_t *copied);
+fsal_status_t mdcache_clone(struct fsal_obj_handle *src_hdl,
+			    struct state_t *src_state, uint64_t src_offset,
+			    struct fsal_obj_handle *dst_hdl,
+			    struct state_t *dst_state, uint64_t dst_offset,
+			    uint64_t count);
 
 /* extended attributes management */
 fsal_status_t
@@ -39,6 +39,7 @@
 #include <sys/param.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -46,7 +47,13 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#ifdef LINUX
+#include <sys/syscall.h>
+#endif
 #include "fsal.h"
 #include "fsal_convert.h"
 #include "FSAL/fsal_commonlib.h"
@@ -91,6 +98,21 @@
  * under the MDCACHE hash table latch.  Likewise, entries must first be
  * made unreachable to the MDCACHE hash table, then independently reach
  * a refcnt of 0, before they may be disposed or recycled.
+ *
+ * Which inactive queue an entry is placed on, and which queue is reaped
+ * first, is decided by a replacement policy selected with LRU_Policy.
+ * The default policy is the multi-level LRU described below.  The ARC
+ * policy [Megiddo and Modha 2003] treats L2 as T1 (entries referenced
+ * once) and L1 as T2 (entries referenced again), keeps per-lane ghost
+ * lists of recently evicted keys, and adapts the T1 target on ghost hits,
+ * so that a single walk over a large tree cannot flush the hot set.
+ *
+ * Taking and releasing references never takes a lane lock.  An entry
+ * that becomes active while on L1 or L2 is only flagged LRU_REFERENCED,
+ * and an entry whose last active reference is released stays on ACTIVE.
+ * The reaper requeues flagged entries it finds at the head of L1 or L2,
+ * and the reaper and the LRU thread demote idle entries from ACTIVE in
+ * batches, one lane lock acquisition per batch.
  */
 
 struct lru_state lru_state;
@@ -114,6 +136,12 @@ struct lru_q_lane {
 	struct lru_q L2;
 	struct lru_q cleanup; /* deferred cleanup */
 	struct lru_q ACTIVE; /* active references */
+	struct lru_q B1; /* ARC ghosts evicted from L2 (T1) */
+	struct lru_q B2; /* ARC ghosts evicted from L1 (T2) */
+	struct glist_head *ghost_hash; /* ARC ghost lookup buckets */
+	uint32_t ghost_mask;
+	uint32_t arc_p; /* ARC target size of L2 (T1) in this lane */
+	uint32_t arc_clock; /* ARC count of entries queued on L2 (T1) */
 	pthread_mutex_t ql_mtx;
 
 	CACHE_PAD(0);
@@ -149,8 +177,204 @@ struct lru_q_lane {
  * processing onto L2 constrains oscillation in this algorithm.
  */
 
-static struct lru_q_lane LRU[LRU_N_Q_LANES];
-static struct lru_q_lane CHUNK_LRU[LRU_N_Q_LANES];
+static struct lru_q_lane *LRU;
+static struct lru_q_lane *CHUNK_LRU;
+
+/**
+ * Lanes are split evenly between the NUMA nodes that have CPUs: lanes
+ * [node * lanes_per_node, (node + 1) * lanes_per_node) belong to node.
+ * An entry is allocated from the pool of, queued on, and preferentially
+ * reaped by, the node of the CPU that allocated it, so that the lane
+ * lock and the entry stay on one socket.  Each node runs its own
+ * lru_run thread bound to the node's CPUs.
+ */
+#define LRU_MAX_NODES 64
+
+static int lru_ncpus;
+static uint32_t *lru_cpu_node; /* CPU number to node index */
+#ifdef LINUX
+static cpu_set_t *lru_node_cpus; /* CPUs of each node index */
+static int lru_node_id[LRU_MAX_NODES]; /* System node id of each index */
+#endif
+
+/**
+ * @brief Parse a sysfs CPU list such as "0-7,16-23"
+ *
+ * @param[in]  list  The list
+ * @param[out] set   CPUs in the list are added to this set
+ *
+ * @return 0 on success, -1 if the list is malformed.
+ */
+#ifdef LINUX
+static int lru_parse_cpulist(const char *list, cpu_set_t *set)
+{
+	while (*list != '\0' && *list != '\n') {
+		char *end;
+		long first, last;
+
+		first = strtol(list, &end, 10);
+		if (end == list)
+			return -1;
+
+		last = first;
+		if (*end == '-') {
+			list = end + 1;
+			last = strtol(list, &end, 10);
+			if (end == list)
+				return -1;
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; ++first)
+			CPU_SET(first, set);
+
+		list = end;
+		if (*list == ',')
+			++list;
+	}
+
+	return 0;
+}
+#endif
+
+/**
+ * @brief Discover the NUMA nodes that have CPUs
+ *
+ * Falls back to a single node if NUMA awareness is disabled or sysfs
+ * does not describe any node.
+ */
+static void lru_topology_init(void)
+{
+	uint32_t nodes = 0;
+
+	lru_ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (lru_ncpus < 1)
+		lru_ncpus = 1;
+
+	lru_cpu_node = gsh_calloc(lru_ncpus, sizeof(*lru_cpu_node));
+
+#ifdef LINUX
+	lru_node_cpus = gsh_calloc(LRU_MAX_NODES, sizeof(cpu_set_t));
+
+	if (mdcache_param.lru_numa_aware) {
+		char path[64];
+		char buf[4096];
+		int id, cpu;
+
+		for (id = 0; id < LRU_MAX_NODES; ++id) {
+			cpu_set_t *set = &lru_node_cpus[nodes];
+			FILE *f;
+
+			(void)snprintf(path, sizeof(path),
+				       "/sys/devices/system/node/node%d/cpulist",
+				       id);
+			f = fopen(path, "r");
+			if (f == NULL)
+				continue;
+
+			if (fgets(buf, sizeof(buf), f) == NULL)
+				buf[0] = '\0';
+			(void)fclose(f);
+
+			CPU_ZERO(set);
+			if (lru_parse_cpulist(buf, set) != 0 ||
+			    CPU_COUNT(set) == 0) {
+				/* Memory-only or unreadable node */
+				continue;
+			}
+
+			for (cpu = 0; cpu < lru_ncpus; ++cpu) {
+				if (CPU_ISSET(cpu, set))
+					lru_cpu_node[cpu] = nodes;
+			}
+
+			lru_node_id[nodes] = id;
+			++nodes;
+		}
+	}
+#endif
+
+	if (nodes == 0) {
+		/* Everything on one node */
+		memset(lru_cpu_node, 0, lru_ncpus * sizeof(*lru_cpu_node));
+		nodes = 1;
+	}
+
+	lru_state.nodes = nodes;
+}
+
+static void lru_topology_destroy(void)
+{
+	gsh_free(lru_cpu_node);
+	lru_cpu_node = NULL;
+#ifdef LINUX
+	gsh_free(lru_node_cpus);
+	lru_node_cpus = NULL;
+#endif
+}
+
+/**
+ * @brief Return the node index of the calling thread's CPU
+ */
+static inline uint32_t lru_current_node(void)
+{
+#ifdef LINUX
+	int cpu;
+
+	if (lru_state.nodes == 1)
+		return 0;
+
+	cpu = sched_getcpu();
+	if (cpu >= 0 && cpu < lru_ncpus)
+		return lru_cpu_node[cpu];
+#endif
+	return 0;
+}
+
+/**
+ * @brief Return the node index owning a lane
+ */
+static inline uint32_t lru_node_of_lane(uint32_t lane)
+{
+	return lane / lru_state.lanes_per_node;
+}
+
+static bool lru_is_prime(uint32_t n)
+{
+	uint32_t d;
+
+	if (n < 2)
+		return false;
+
+	for (d = 2; d * d <= n; ++d) {
+		if (n % d == 0)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Size the lanes
+ *
+ * LRU_Lanes of 0 scales the lane count with the number of CPUs.  The
+ * per-node lane count is rounded up to a prime, since lanes are chosen by
+ * taking pointers and hashes modulo it.
+ */
+static void lru_lanes_init(void)
+{
+	uint32_t want = mdcache_param.lru_lanes;
+	uint32_t per_node;
+
+	if (want == 0)
+		want = MAX(LRU_MIN_Q_LANES, 2 * lru_ncpus);
+
+	per_node = (want + lru_state.nodes - 1) / lru_state.nodes;
+	while (!lru_is_prime(per_node))
+		++per_node;
+
+	lru_state.lanes_per_node = per_node;
+	lru_state.lanes = per_node * lru_state.nodes;
+}
 
 /**
  * The refcount mechanism distinguishes 3 key object states:
@@ -180,8 +404,6 @@ static struct fridgethr *lru_fridge;
 static const uint32_t FD_FALLBACK_LIMIT = 0x400;
 
 /* Some helper macros */
-#define LRU_NEXT(n) (atomic_inc_uint32_t(&(n)) % LRU_N_Q_LANES)
-
 /* Delete lru, use iif the current thread is not the LRU
  * thread.  The node being removed is lru, glist a pointer to L1's q,
  * qlane its lane. */
@@ -221,7 +443,10 @@ static inline void lru_init_queues(void)
 {
 	int ix;
 
-	for (ix = 0; ix < LRU_N_Q_LANES; ++ix) {
+	LRU = gsh_calloc(lru_state.lanes, sizeof(struct lru_q_lane));
+	CHUNK_LRU = gsh_calloc(lru_state.lanes, sizeof(struct lru_q_lane));
+
+	for (ix = 0; ix < lru_state.lanes; ++ix) {
 		struct lru_q_lane *qlane;
 
 		/* Initialize mdcache_entry_t LRU */
@@ -253,7 +478,7 @@ static inline void lru_destroy_queues(void)
 {
 	int ix;
 
-	for (ix = 0; ix < LRU_N_Q_LANES; ++ix) {
+	for (ix = 0; ix < lru_state.lanes; ++ix) {
 		struct lru_q_lane *qlane;
 
 		/* Destroy mdcache_entry_t LRU */
@@ -264,6 +489,11 @@ static inline void lru_destroy_queues(void)
 		qlane = &CHUNK_LRU[ix];
 		PTHREAD_MUTEX_destroy(&qlane->ql_mtx);
 	}
+
+	gsh_free(LRU);
+	LRU = NULL;
+	gsh_free(CHUNK_LRU);
+	CHUNK_LRU = NULL;
 }
 
 /**
@@ -346,17 +576,40 @@ static inline struct lru_q *chunk_lru_queue_of(struct dir_chunk *chunk)
 /**
  * @brief Get the appropriate lane for a LRU chunk or entry
  *
- * This function gets the LRU lane by taking the modulus of the
- * supplied pointer.
+ * This function gets the LRU lane among the lanes of a node by taking
+ * the modulus of the supplied pointer.
  *
  * @param[in] entry  A pointer to a LRU chunk or entry
+ * @param[in] node   The node whose lanes to use
  *
  * @return The LRU lane in which that entry should be stored.
  */
-static inline uint32_t lru_lane_of(void *entry)
+static inline uint32_t lru_lane_of(void *entry, uint32_t node)
 {
-	return (uint32_t)((((uintptr_t)entry) / 2 * sizeof(uintptr_t)) %
-			  LRU_N_Q_LANES);
+	return node * lru_state.lanes_per_node +
+	       (uint32_t)((((uintptr_t)entry) / 2 * sizeof(uintptr_t)) %
+			  lru_state.lanes_per_node);
+}
+
+/**
+ * @brief Return the i-th lane to try when reaping
+ *
+ * The lanes of the calling thread's node come first, starting at
+ * @a start, then the lanes of the other nodes, so every lane is visited
+ * once for ix in [0, lru_state.lanes).
+ *
+ * @param[in] node   The preferred node
+ * @param[in] start  Rotating start offset within a node
+ * @param[in] ix     Iteration index
+ */
+static inline uint32_t lru_reap_lane_at(uint32_t node, uint32_t start,
+					uint32_t ix)
+{
+	uint32_t per_node = lru_state.lanes_per_node;
+
+	node = (node + ix / per_node) % lru_state.nodes;
+
+	return node * per_node + (start + ix) % per_node;
 }
 
 /**
@@ -408,46 +661,317 @@ static inline void lru_insert_chunk(struct dir_chunk *chunk, struct lru_q *q)
 	QUNLOCK(qlane);
 }
 
-/*
- * @brief Move an entry from LRU L1 or L2 queues to the ACTIVE queue.
+/**
+ * @brief Entry replacement policy
  *
- * @param [in] entry  Entry to adjust.
+ * All hooks except lane_of are called with the lane lock held.
  */
-static inline void make_active_lru(mdcache_entry_t *entry)
+struct lru_policy_ops {
+	const char *name;
+	/** Allocate policy state, called after the lanes are initialized */
+	void (*init)(void);
+	/** Release policy state, called before the lanes are destroyed */
+	void (*destroy)(void);
+	/** Choose the lane for a new entry, its key is already set */
+	uint32_t (*lane_of)(mdcache_entry_t *entry);
+	/** A new entry is about to be queued on ACTIVE (optional) */
+	void (*inserted)(mdcache_entry_t *entry, struct lru_q_lane *qlane);
+	/** An inactive entry is being referenced again (optional) */
+	void (*hit)(mdcache_entry_t *entry, struct lru_q_lane *qlane);
+	/** Queue an entry that lost its last active reference */
+	void (*inactive)(mdcache_entry_t *entry, struct lru_q_lane *qlane);
+	/** Queue to reap first (qid L2) or second (qid L1) */
+	struct lru_q *(*reap_q)(struct lru_q_lane *qlane, enum lru_q_id qid);
+	/** An entry has been reaped from q (optional) */
+	void (*evicted)(mdcache_entry_t *entry, struct lru_q_lane *qlane,
+			struct lru_q *q);
+	/** Background maintenance for one lane (optional) */
+	int (*run_lane)(int lane);
+};
+
+static const struct lru_policy_ops *lru_policy;
+
+static uint32_t lru_mq_lane_of(mdcache_entry_t *entry)
+{
+	return entry->lru.lane;
+}
+
+static void lru_mq_inactive(mdcache_entry_t *entry, struct lru_q_lane *qlane)
+{
+	struct lru_q *q;
+
+	if (atomic_fetch_uint32_t(&entry->lru.flags) & LRU_EVER_PROMOTED) {
+		/* If entry was ever promoted, insert into L1. */
+		q = &qlane->L1;
+	} else {
+		/* Entry was never promoted, only ever used in a
+		 * directory scan, return to L2.
+		 */
+		q = &qlane->L2;
+	}
+
+	lru_insert(&entry->lru, q);
+}
+
+static struct lru_q *lru_mq_reap_q(struct lru_q_lane *qlane,
+				   enum lru_q_id qid)
+{
+	return (qid == LRU_ENTRY_L1) ? &qlane->L1 : &qlane->L2;
+}
+
+static int lru_run_lane(int lane);
+
+static const struct lru_policy_ops lru_policy_mq = {
+	.name = "LRU",
+	.lane_of = lru_mq_lane_of,
+	.inactive = lru_mq_inactive,
+	.reap_q = lru_mq_reap_q,
+	.run_lane = lru_run_lane,
+};
+
+/**
+ * @brief ARC ghost of an evicted entry
+ *
+ * Only the hash and the sub-FSAL of the mdcache_key_t are remembered, a
+ * false match merely nudges the adaptation target.
+ */
+struct lru_ghost {
+	struct glist_head q; /* link in B1 or B2, LRU at head */
+	struct glist_head hash; /* link in the lane's ghost_hash bucket */
+	uint64_t hk;
+	void *fsal;
+	enum lru_q_id qid;
+};
+
+/**
+ * A re-reference of an entry still on T1 only counts as frequency if at
+ * least this many entries were queued on T1 of the lane in between.
+ * Otherwise it is the same walk touching the entry twice (READDIR then
+ * LOOKUP or GETATTR), which must not let a scan pollute T2.
+ */
+#define LRU_ARC_CORRELATED 32
+
+/* Per-lane cache size c, and therefore bound on the ghost lists. */
+static uint32_t lru_arc_lane_size;
+
+static inline struct glist_head *lru_arc_bucket(struct lru_q_lane *qlane,
+						uint64_t hk)
+{
+	/* The hash modulo the node's lane count picked the lane */
+	return &qlane->ghost_hash[(hk / lru_state.lanes_per_node) &
+				  qlane->ghost_mask];
+}
+
+static void lru_arc_init(void)
+{
+	uint32_t nbuckets = 64;
+	uint32_t b;
+	int ix;
+
+	lru_arc_lane_size = lru_state.entries_hiwat / lru_state.lanes;
+	if (lru_arc_lane_size == 0)
+		lru_arc_lane_size = 1;
+
+	while (nbuckets < lru_arc_lane_size / 2)
+		nbuckets <<= 1;
+
+	for (ix = 0; ix < lru_state.lanes; ++ix) {
+		struct lru_q_lane *qlane = &LRU[ix];
+
+		lru_init_queue(&qlane->B1, LRU_GHOST_B1);
+		lru_init_queue(&qlane->B2, LRU_GHOST_B2);
+		qlane->ghost_hash =
+			gsh_malloc(nbuckets * sizeof(struct glist_head));
+		for (b = 0; b < nbuckets; ++b)
+			glist_init(&qlane->ghost_hash[b]);
+		qlane->ghost_mask = nbuckets - 1;
+		qlane->arc_p = 0;
+		qlane->arc_clock = 0;
+	}
+}
+
+static void lru_arc_destroy(void)
+{
+	struct glist_head *glist, *glistn;
+	int ix;
+
+	for (ix = 0; ix < lru_state.lanes; ++ix) {
+		struct lru_q_lane *qlane = &LRU[ix];
+
+		glist_for_each_safe(glist, glistn, &qlane->B1.q)
+		{
+			glist_del(glist);
+			gsh_free(glist_entry(glist, struct lru_ghost, q));
+		}
+		glist_for_each_safe(glist, glistn, &qlane->B2.q)
+		{
+			glist_del(glist);
+			gsh_free(glist_entry(glist, struct lru_ghost, q));
+		}
+		gsh_free(qlane->ghost_hash);
+		qlane->ghost_hash = NULL;
+	}
+}
+
+static inline void lru_arc_ghost_del(struct lru_q *gq, struct lru_ghost *ghost)
+{
+	glist_del(&ghost->q);
+	glist_del(&ghost->hash);
+	--(gq->size);
+}
+
+static uint32_t lru_arc_lane_of(mdcache_entry_t *entry)
+{
+	/* Entries live in the lane of their key within their node, so that
+	 * the ghost of an evicted entry is found in the lane the entry comes
+	 * back to (when it comes back on the same node).
+	 */
+	return lru_node_of_lane(entry->lru.lane) * lru_state.lanes_per_node +
+	       entry->fh_hk.key.hk % lru_state.lanes_per_node;
+}
+
+static void lru_arc_inserted(mdcache_entry_t *entry, struct lru_q_lane *qlane)
+{
+	struct glist_head *bucket = lru_arc_bucket(qlane, entry->fh_hk.key.hk);
+	struct glist_head *glist;
+	struct lru_ghost *ghost = NULL;
+	struct lru_q *gq;
+	uint32_t delta;
+
+	glist_for_each(glist, bucket)
+	{
+		struct lru_ghost *g = glist_entry(glist, struct lru_ghost, hash);
+
+		if (g->hk == entry->fh_hk.key.hk &&
+		    g->fsal == entry->fh_hk.key.fsal) {
+			ghost = g;
+			break;
+		}
+	}
+
+	if (ghost == NULL)
+		return;
+
+	/* A ghost hit: the entry was evicted too early.  Grow T1 on a B1
+	 * hit, shrink it on a B2 hit, and admit the entry to T2.
+	 */
+	if (ghost->qid == LRU_GHOST_B1) {
+		gq = &qlane->B1;
+		delta = MAX(qlane->B2.size / gq->size, 1);
+		qlane->arc_p = MIN(qlane->arc_p + delta, lru_arc_lane_size);
+	} else {
+		gq = &qlane->B2;
+		delta = MAX(qlane->B1.size / gq->size, 1);
+		qlane->arc_p = (qlane->arc_p > delta) ? qlane->arc_p - delta
+						      : 0;
+	}
+
+	lru_arc_ghost_del(gq, ghost);
+	gsh_free(ghost);
+
+	atomic_set_uint32_t_bits(&entry->lru.flags, LRU_ARC_FREQUENT);
+}
+
+static void lru_arc_hit(mdcache_entry_t *entry, struct lru_q_lane *qlane)
+{
+	if (entry->lru.qid == LRU_ENTRY_L2 &&
+	    qlane->arc_clock - entry->lru.stamp < LRU_ARC_CORRELATED)
+		return;
+
+	if (entry->lru.qid != LRU_ENTRY_L1 && entry->lru.qid != LRU_ENTRY_L2)
+		return;
+
+	atomic_set_uint32_t_bits(&entry->lru.flags, LRU_ARC_FREQUENT);
+}
+
+static void lru_arc_inactive(mdcache_entry_t *entry, struct lru_q_lane *qlane)
 {
 	mdcache_lru_t *lru = &entry->lru;
-	struct lru_q_lane *qlane = &LRU[lru->lane];
 	struct lru_q *q;
 
-	QLOCK(qlane);
-	switch (lru->qid) {
-	case LRU_ENTRY_L1:
-		q = lru_queue_of(entry);
-		/* move entry to MRU of ACTIVE */
-		LRU_DQ(lru, q);
-		q = &qlane->ACTIVE;
-		lru_insert(lru, q);
-		break;
-	case LRU_ENTRY_L2:
-		q = lru_queue_of(entry);
-		/* move entry to MRU of ACTIVE */
-		LRU_DQ(lru, q);
-		q = &qlane->ACTIVE;
-		lru_insert(lru, q);
-		break;
-	case LRU_ENTRY_ACTIVE:
-		q = lru_queue_of(entry);
-		/* advance entry to MRU (of ACTIVE) */
-		LRU_DQ(lru, q);
-		lru_insert(lru, q);
-		break;
-	default:
-		/* do nothing */
-		break;
-	} /* switch qid */
-	QUNLOCK(qlane);
+	if (atomic_fetch_uint32_t(&lru->flags) & LRU_ARC_FREQUENT) {
+		q = &qlane->L1;
+	} else {
+		q = &qlane->L2;
+		lru->stamp = qlane->arc_clock++;
+	}
+
+	/* ARC keeps strict recency order, MRU at tail */
+	lru->qid = q->id;
+	glist_add_tail(&q->q, &lru->q);
+	++(q->size);
+}
+
+static struct lru_q *lru_arc_reap_q(struct lru_q_lane *qlane,
+				    enum lru_q_id qid)
+{
+	struct lru_q *t1 = &qlane->L2;
+	struct lru_q *t2 = &qlane->L1;
+	bool t1_first = t1->size > 0 &&
+			(t1->size > qlane->arc_p || t2->size == 0);
+
+	if (qid == LRU_ENTRY_L2)
+		return t1_first ? t1 : t2;
+
+	return t1_first ? t2 : t1;
+}
+
+static void lru_arc_evicted(mdcache_entry_t *entry, struct lru_q_lane *qlane,
+			    struct lru_q *q)
+{
+	struct lru_q *gq = (q->id == LRU_ENTRY_L2) ? &qlane->B1 : &qlane->B2;
+	struct lru_q *victim = NULL;
+	struct lru_ghost *ghost;
+
+	/* Keep |T1| + |B1| <= c and |B1| + |B2| <= c */
+	if (q->id == LRU_ENTRY_L2 &&
+	    qlane->L2.size + qlane->B1.size >= lru_arc_lane_size)
+		victim = &qlane->B1;
+	else if (qlane->B1.size + qlane->B2.size >= lru_arc_lane_size)
+		victim = (qlane->B2.size > 0) ? &qlane->B2 : &qlane->B1;
+
+	if (victim != NULL) {
+		ghost = glist_first_entry(&victim->q, struct lru_ghost, q);
+		if (ghost == NULL) {
+			/* T1 alone fills the lane, nothing to remember */
+			return;
+		}
+		lru_arc_ghost_del(victim, ghost);
+	} else {
+		ghost = gsh_malloc(sizeof(*ghost));
+	}
+
+	ghost->hk = entry->fh_hk.key.hk;
+	ghost->fsal = entry->fh_hk.key.fsal;
+	ghost->qid = gq->id;
+	glist_add_tail(&gq->q, &ghost->q);
+	++(gq->size);
+	glist_add(lru_arc_bucket(qlane, ghost->hk), &ghost->hash);
 }
 
+static const struct lru_policy_ops lru_policy_arc = {
+	.name = "ARC",
+	.init = lru_arc_init,
+	.destroy = lru_arc_destroy,
+	.lane_of = lru_arc_lane_of,
+	.inserted = lru_arc_inserted,
+	.hit = lru_arc_hit,
+	.inactive = lru_arc_inactive,
+	.reap_q = lru_arc_reap_q,
+	.evicted = lru_arc_evicted,
+};
+
+/**
+ * Maximum number of entries the reaper requeues at the head of a queue
+ * before giving up on the lane.
+ */
+#define LRU_REQUEUE_MAX 8
+
+/**
+ * Number of idle entries demoted from ACTIVE per lane lock hold.
+ */
+#define LRU_DRAIN_BATCH 64
+
 /*
  * @brief Move an active entry from ACTIVE queue to MRU of L1 or L2.
  *
@@ -469,22 +993,12 @@ static inline void make_inactive_lru(mdcache_entry_t *entry)
 		assert(false);
 		break;
 	case LRU_ENTRY_ACTIVE:
-		/* Move entry to MRU of L1 or L2 */
+		/* Re-references while on ACTIVE say nothing to the policy */
+		atomic_clear_uint32_t_bits(&lru->flags, LRU_REFERENCED);
+		/* Move entry to MRU of L1 or L2, as the policy decides */
 		q = lru_queue_of(entry);
 		LRU_DQ(&entry->lru, q);
-
-		if (atomic_fetch_uint32_t(&entry->lru.flags) &
-		    LRU_EVER_PROMOTED) {
-			/* If entry was ever promoted, insert into L1. */
-			q = &qlane->L1;
-		} else {
-			/* Entry was never promoted, only ever used in a
-			 * directory scan, return to L2.
-			 */
-			q = &qlane->L2;
-		}
-
-		lru_insert(&entry->lru, q);
+		lru_policy->inactive(entry, qlane);
 		break;
 	case LRU_ENTRY_CLEANUP:
 	default:
@@ -493,6 +1007,118 @@ static inline void make_inactive_lru(mdcache_entry_t *entry)
 	} /* switch qid */
 }
 
+/*
+ * @brief Requeue an entry on L1 or L2 that was referenced since queued
+ *
+ * References do not move entries (see _mdcache_lru_ref), so an entry
+ * re-referenced while on L1 or L2 stays there until the reaper finds it.
+ * It goes to ACTIVE if it is still active, otherwise back to MRU of L1 or
+ * L2 as the policy decides.
+ *
+ * Assumes qlane lock is held.
+ *
+ * @param [in] entry  Entry to adjust.
+ * @param [in] qlane  Its lane
+ */
+static inline void lru_requeue_referenced(mdcache_entry_t *entry,
+					  struct lru_q_lane *qlane)
+{
+	mdcache_lru_t *lru = &entry->lru;
+	struct lru_q *q = lru_queue_of(entry);
+
+	/* Let the policy see the hit while the entry is still on L1/L2 */
+	if ((atomic_postclear_uint32_t_bits(&lru->flags, LRU_REFERENCED) &
+	     LRU_REFERENCED) &&
+	    lru_policy->hit)
+		lru_policy->hit(entry, qlane);
+
+	LRU_DQ(lru, q);
+
+	if (atomic_fetch_int32_t(&lru->active_refcnt) > 0)
+		lru_insert(lru, &qlane->ACTIVE);
+	else
+		lru_policy->inactive(entry, qlane);
+}
+
+/**
+ * @brief Demote idle entries from ACTIVE
+ *
+ * Releasing the last active reference leaves the entry on ACTIVE, so the
+ * queue doubles as the buffer of deferred moves.  This walks it from the
+ * oldest end and demotes entries without active references in one batch
+ * under the lane lock.
+ *
+ * @note The caller MUST hold the lane lock.
+ *
+ * @param[in] qlane  The lane
+ * @param[in] max    Maximum number of entries to demote
+ *
+ * @return The number of entries demoted.
+ */
+static size_t lru_drain_active(struct lru_q_lane *qlane, size_t max)
+{
+	struct lru_q *q = &qlane->ACTIVE;
+	mdcache_lru_t *lru, *prev;
+	size_t moved = 0, visited = 0;
+
+	lru = glist_last_entry(&q->q, mdcache_lru_t, q);
+
+	while (lru != NULL && moved < max && visited < 4 * max) {
+		mdcache_entry_t *entry = container_of(lru, mdcache_entry_t, lru);
+
+		prev = glist_prev_entry(&q->q, mdcache_lru_t, q, &lru->q);
+		++visited;
+
+		if (atomic_fetch_int32_t(&lru->active_refcnt) == 0) {
+			make_inactive_lru(entry);
+			++moved;
+		}
+
+		lru = prev;
+	}
+
+	return moved;
+}
+
+/**
+ * @brief Find a reap candidate at the head of a queue
+ *
+ * Catches up with queue moves skipped by the reference fast path: entries
+ * referenced since they were queued are requeued, and an empty queue is
+ * refilled from the idle entries on ACTIVE.
+ *
+ * @note The caller MUST hold the lane lock.
+ *
+ * @param[in] qlane  The lane
+ * @param[in] lq     The queue to reap from
+ *
+ * @return The candidate, or NULL if there is none in this lane.
+ */
+static mdcache_lru_t *lru_reap_candidate(struct lru_q_lane *qlane,
+					 struct lru_q *lq)
+{
+	mdcache_lru_t *lru;
+	int ix;
+
+	if (glist_empty(&lq->q))
+		(void)lru_drain_active(qlane, LRU_DRAIN_BATCH);
+
+	for (ix = 0; ix < LRU_REQUEUE_MAX; ++ix) {
+		lru = glist_first_entry(&lq->q, mdcache_lru_t, q);
+		if (lru == NULL)
+			return NULL;
+
+		if (atomic_fetch_int32_t(&lru->active_refcnt) == 0 &&
+		    !(atomic_fetch_uint32_t(&lru->flags) & LRU_REFERENCED))
+			return lru;
+
+		lru_requeue_referenced(container_of(lru, mdcache_entry_t, lru),
+				       qlane);
+	}
+
+	return NULL;
+}
+
 /**
  * @brief Clean an entry for recycling.
  *
@@ -676,15 +1302,17 @@ static inline mdcache_lru_t *lru_reap_impl(enum lru_q_id qid)
 	mdcache_entry_t *entry;
 	uint32_t refcnt;
 	cih_latch_t latch;
+	uint32_t node = lru_current_node();
+	uint32_t start = atomic_inc_uint32_t(&reap_lane);
 	int ix;
 
-	lane = LRU_NEXT(reap_lane);
-	for (ix = 0; ix < LRU_N_Q_LANES; ++ix, lane = LRU_NEXT(reap_lane)) {
+	for (ix = 0; ix < lru_state.lanes; ++ix) {
+		lane = lru_reap_lane_at(node, start, ix);
 		qlane = &LRU[lane];
-		lq = (qid == LRU_ENTRY_L1) ? &qlane->L1 : &qlane->L2;
 
 		QLOCK(qlane);
-		lru = glist_first_entry(&lq->q, mdcache_lru_t, q);
+		lq = lru_policy->reap_q(qlane, qid);
+		lru = lru_reap_candidate(qlane, lq);
 		if (!lru) {
 			QUNLOCK(qlane);
 			continue;
@@ -733,6 +1361,8 @@ static inline mdcache_lru_t *lru_reap_impl(enum lru_q_id qid)
 
 			LRU_DQ(lru, q);
 			entry->lru.qid = LRU_ENTRY_NONE;
+			if (lru_policy->evicted)
+				lru_policy->evicted(entry, qlane, q);
 			QUNLOCK(qlane);
 			cih_remove_latched(entry, &latch, CIH_REMOVE_UNLOCK);
 			/* Note, we're not releasing our ref here.
@@ -808,11 +1438,11 @@ static inline mdcache_lru_t *lru_reap_chunk_impl(enum lru_q_id qid,
 	struct dir_chunk *chunk;
 	int ix;
 	int32_t refcnt;
+	uint32_t node = lru_current_node();
+	uint32_t start = atomic_inc_uint32_t(&chunk_reap_lane);
 
-	lane = LRU_NEXT(chunk_reap_lane);
-
-	for (ix = 0; ix < LRU_N_Q_LANES;
-	     ++ix, lane = LRU_NEXT(chunk_reap_lane)) {
+	for (ix = 0; ix < lru_state.lanes; ++ix) {
+		lane = lru_reap_lane_at(node, start, ix);
 		qlane = &CHUNK_LRU[lane];
 		lq = (qid == LRU_ENTRY_L1) ? &qlane->L1 : &qlane->L2;
 
@@ -963,7 +1593,7 @@ struct dir_chunk *mdcache_get_chunk(mdcache_entry_t *parent,
 
 	chunk->chunk_lru.refcnt = 2;
 	chunk->chunk_lru.cf = 0;
-	chunk->chunk_lru.lane = lru_lane_of(chunk);
+	chunk->chunk_lru.lane = lru_lane_of(chunk, lru_current_node());
 
 	/* Enqueue into MRU of L2.
 	 *
@@ -1086,7 +1716,7 @@ void mdcache_lru_cleanup_try_push(mdcache_entry_t *entry)
  *
  */
 
-static inline int lru_run_lane(int lane)
+static int lru_run_lane(int lane)
 {
 	struct lru_q *q;
 	/* The amount of work done on this lane on this pass. */
@@ -1152,6 +1782,35 @@ static inline int lru_run_lane(int lane)
 	return workdone;
 }
 
+/**
+ * @brief Demote all idle entries from ACTIVE of one lane
+ *
+ * The lane lock is dropped between batches so that references and
+ * reaping are not held up behind a long ACTIVE queue.
+ *
+ * @param[in] lane  The lane to process
+ *
+ * @returns the number of entries demoted
+ */
+static int lru_drain_lane(int lane)
+{
+	struct lru_q_lane *qlane = &LRU[lane];
+	size_t moved, total = 0;
+
+	do {
+		QLOCK(qlane);
+		moved = lru_drain_active(qlane, LRU_DRAIN_BATCH);
+		QUNLOCK(qlane);
+		total += moved;
+	} while (moved == LRU_DRAIN_BATCH);
+
+	LogFullDebug(COMPONENT_MDCACHE_LRU,
+		     "Demoted %zu idle entries from ACTIVE on lane %d", total,
+		     lane);
+
+	return total;
+}
+
 /**
  * @brief Function that executes in the lru thread
  *
@@ -1199,7 +1858,11 @@ static inline int lru_run_lane(int lane)
  * This function uses the lock discipline for functions accessing LRU
  * entries through a queue partition.
  *
- * @param[in] ctx Fridge context
+ * There is one such thread per NUMA node, bound to the node's CPUs; it
+ * only demotes entries on the node's lanes, and releases entries
+ * preferring the node's lanes.
+ *
+ * @param[in] ctx Fridge context, arg is the node index
  */
 
 static void lru_run(struct fridgethr_context *ctx)
@@ -1210,16 +1873,31 @@ static void lru_run(struct fridgethr_context *ctx)
 
 	/* Index */
 	int lane = 0;
+	uint32_t node = (uint32_t)(uintptr_t)ctx->arg;
+	uint32_t first_lane = node * lru_state.lanes_per_node;
 	time_t threadwait = mdcache_param.lru_run_interval;
 	/* Total work done in all passes so far. */
 	int totalwork = 0;
-	static bool first_time = TRUE;
+	static __thread bool first_time = TRUE;
 	time_t curr_time;
 
 	if (first_time) {
 		/* Wait for NFS server to properly initialize */
 		nfs_init_wait();
 		first_time = FALSE;
+#ifdef LINUX
+		if (lru_state.nodes > 1) {
+			int rc = pthread_setaffinity_np(pthread_self(),
+							sizeof(cpu_set_t),
+							&lru_node_cpus[node]);
+
+			if (rc != 0)
+				LogWarn(COMPONENT_MDCACHE_LRU,
+					"Could not bind LRU thread to node %" PRIu32
+					": %s",
+					node, strerror(rc));
+		}
+#endif
 	}
 
 	SetNameFunction("cache_lru");
@@ -1238,37 +1916,44 @@ static void lru_run(struct fridgethr_context *ctx)
 	/* Loop over all lanes to perform L1 to L2 demotion. Track the work
 	 * done for logging.
 	 */
-	for (lane = 0; lane < LRU_N_Q_LANES; ++lane) {
+	for (lane = first_lane;
+	     lane < first_lane + lru_state.lanes_per_node; ++lane) {
 		LogDebug(COMPONENT_MDCACHE_LRU,
 			 "Demoting up to %d entries from lane %d",
 			 lru_state.per_lane_work, lane);
 
 		LogFullDebug(COMPONENT_MDCACHE_LRU, "totalwork=%d", totalwork);
 
-		totalwork += lru_run_lane(lane);
+		totalwork += lru_drain_lane(lane);
+
+		if (lru_policy->run_lane)
+			totalwork += lru_policy->run_lane(lane);
 	}
 
 	/* We're trying to release the entry cache if the amount
 	 * used is higher than the water level. every time we can
 	 * try best to release the number of entries until entries
 	 * cache below the high water mark. the max number of entries
-	 * released per time is entries_release_size.
+	 * released per time is entries_release_size, shared between the
+	 * per-node threads.
 	 */
 	if (lru_state.entries_release_size > 0) {
 		if (atomic_fetch_uint64_t(&lru_state.entries_used) >
 		    lru_state.entries_hiwat) {
 			size_t released = 0;
+			int32_t want = (lru_state.entries_release_size +
+					lru_state.nodes - 1) /
+				       lru_state.nodes;
 
 			LogFullDebug(
 				COMPONENT_MDCACHE_LRU,
 				"Entries used is %" PRIu64
 				" and above water mark, LRU want release %d entries",
 				atomic_fetch_uint64_t(&lru_state.entries_used),
-				lru_state.entries_release_size);
+				want);
 
 			EXPORT_ADMIN_LOCK();
-			released = mdcache_lru_release_entries(
-				lru_state.entries_release_size);
+			released = mdcache_lru_release_entries(want);
 			EXPORT_ADMIN_UNLOCK();
 
 			LogFullDebug(COMPONENT_MDCACHE_LRU,
@@ -1296,8 +1981,9 @@ static void lru_run(struct fridgethr_context *ctx)
 		 "After work, count:%" PRIu64 " new_thread_wait=%" PRIu64,
 		 atomic_fetch_uint64_t(&lru_state.entries_used),
 		 ((uint64_t)threadwait));
-	LogFullDebug(COMPONENT_MDCACHE_LRU, "totalwork=%d lanes=%d", totalwork,
-		     LRU_N_Q_LANES);
+	LogFullDebug(COMPONENT_MDCACHE_LRU,
+		     "totalwork=%d node=%" PRIu32 " lanes=%" PRIu32, totalwork,
+		     node, lru_state.lanes_per_node);
 }
 
 /**
@@ -1407,7 +2093,7 @@ static void chunk_lru_run(struct fridgethr_context *ctx)
 		     lru_state.chunks_used);
 
 	/* Total chunks demoted to L2 between all lanes and all current runs. */
-	for (lane = 0; lane < LRU_N_Q_LANES; ++lane) {
+	for (lane = 0; lane < lru_state.lanes; ++lane) {
 		LogFullDebug(
 			COMPONENT_MDCACHE_LRU,
 			"Reaping up to %d chunks from lane %zd totalwork=%zd",
@@ -1574,6 +2260,7 @@ fsal_status_t mdcache_lru_pkginit(void)
 	struct fridgethr_params frp;
 	fsal_status_t status;
 	struct fd_lru_parameter fd_lru_parameter;
+	uint32_t node;
 
 	memset(&frp, 0, sizeof(struct fridgethr_params));
 	frp.thr_max = 2;
@@ -1581,11 +2268,21 @@ fsal_status_t mdcache_lru_pkginit(void)
 	frp.thread_delay = mdcache_param.lru_run_interval;
 	frp.flavor = fridgethr_flavor_looper;
 
+	/* One entry LRU thread per node and one chunk LRU thread */
+	frp.thr_max = lru_state.nodes + 1;
+	frp.thr_min = lru_state.nodes + 1;
+
+	lru_lanes_init();
+
+	LogInfo(COMPONENT_MDCACHE_LRU,
+		"Using %" PRIu32 " LRU lanes on %" PRIu32 " NUMA node(s)",
+		lru_state.lanes, lru_state.nodes);
+
 	if (mdcache_param.reaper_work) {
 		/* Backwards compatibility */
 		lru_state.per_lane_work =
-			(mdcache_param.reaper_work + LRU_N_Q_LANES - 1) /
-			LRU_N_Q_LANES;
+			(mdcache_param.reaper_work + lru_state.lanes - 1) /
+			lru_state.lanes;
 	} else {
 		/* New parameter */
 		lru_state.per_lane_work = mdcache_param.reaper_work_per_lane;
@@ -1606,6 +2303,22 @@ fsal_status_t mdcache_lru_pkginit(void)
 	/* init queue complex */
 	lru_init_queues();
 
+	switch (mdcache_param.lru_policy) {
+	case MDCACHE_LRU_POLICY_ARC:
+		lru_policy = &lru_policy_arc;
+		break;
+	case MDCACHE_LRU_POLICY_LRU:
+	default:
+		lru_policy = &lru_policy_mq;
+		break;
+	}
+
+	if (lru_policy->init)
+		lru_policy->init();
+
+	LogInfo(COMPONENT_MDCACHE_LRU, "Using %s entry replacement policy",
+		lru_policy->name);
+
 	/* spawn LRU background thread */
 	code = fridgethr_init(&lru_fridge, "LRU_fridge", &frp);
 	if (code != 0) {
@@ -1615,12 +2328,16 @@ fsal_status_t mdcache_lru_pkginit(void)
 		return fsalstat(posix2fsal_error(code), code);
 	}
 
-	code = fridgethr_submit(lru_fridge, lru_run, NULL);
-	if (code != 0) {
-		LogMajor(COMPONENT_MDCACHE_LRU,
-			 "Unable to start Entry LRU thread, error code %d.",
-			 code);
-		return fsalstat(posix2fsal_error(code), code);
+	for (node = 0; node < lru_state.nodes; ++node) {
+		code = fridgethr_submit(lru_fridge, lru_run,
+					(void *)(uintptr_t)node);
+		if (code != 0) {
+			LogMajor(COMPONENT_MDCACHE_LRU,
+				 "Unable to start Entry LRU thread for node %"
+				 PRIu32 ", error code %d.",
+				 node, code);
+			return fsalstat(posix2fsal_error(code), code);
+		}
 	}
 
 	code = fridgethr_submit(lru_fridge, chunk_lru_run, NULL);
@@ -1674,6 +2391,9 @@ fsal_status_t mdcache_lru_pkgshutdown(void)
 	else
 		status = fsalstat(posix2fsal_error(rc), rc);
 
+	if (lru_policy->destroy)
+		lru_policy->destroy();
+
 	lru_destroy_queues();
 
 	return status;
@@ -1686,11 +2406,188 @@ static inline void init_rw_locks(mdcache_entry_t *entry)
 	PTHREAD_RWLOCK_init(&entry->content_lock, NULL);
 }
 
-mdcache_entry_t *alloc_cache_entry(void)
+/**
+ * Cache entries of a node are carved out of slabs whose pages are
+ * placed on that node with mbind(), before anything touches them, and
+ * freed entries go back to the free list of the node they came from.
+ * Slabs are only returned to the system on shutdown; the number of
+ * entries is bounded by Entries_HWMark anyway.
+ */
+#define LRU_SLAB_SIZE (2 * 1024 * 1024)
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+struct mdcache_free_entry {
+	struct mdcache_free_entry *next;
+};
+
+struct mdcache_entry_slab {
+	struct mdcache_entry_slab *next;
+};
+
+struct mdcache_entry_pool {
+	pthread_mutex_t lock;
+	struct mdcache_free_entry *free;
+	struct mdcache_entry_slab *slabs;
+	int node_id; /* System node id to place slabs on, -1 for none */
+	GSH_CACHE_PAD(0);
+};
+
+/* Entries are cache line aligned within a slab */
+static const size_t lru_entry_size =
+	(sizeof(mdcache_entry_t) + GSH_CACHE_LINE_SIZE - 1) &
+	~((size_t)GSH_CACHE_LINE_SIZE - 1);
+
+/**
+ * @brief Prefer a node for the pages of a range not yet touched
+ *
+ * This is best effort: without a usable mbind(), the pages land on the
+ * node of the CPU that first touches them, which is where the entries
+ * are being allocated from anyway.
+ */
+static void lru_slab_place(void *addr, size_t len, int node_id)
 {
+#if defined(LINUX) && defined(SYS_mbind)
+	unsigned long mask = 1UL << node_id;
+
+	/* The kernel ignores the last bit of maxnode */
+	if (syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &mask,
+		    sizeof(mask) * 8 + 1, 0) != 0)
+		LogDebug(COMPONENT_MDCACHE_LRU,
+			 "mbind to node %d failed: %s", node_id,
+			 strerror(errno));
+#endif
+}
+
+/**
+ * @brief Add a slab of entries to a pool
+ *
+ * @param[in] pool  The pool, locked
+ */
+static void lru_pool_grow(struct mdcache_entry_pool *pool)
+{
+	struct mdcache_entry_slab *slab;
+	char *entry;
+	char *end;
+
+	slab = mmap(NULL, LRU_SLAB_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (slab == MAP_FAILED)
+		LogFatal(COMPONENT_MDCACHE_LRU,
+			 "Could not allocate %d bytes of cache entries: %s",
+			 LRU_SLAB_SIZE, strerror(errno));
+
+	if (pool->node_id >= 0)
+		lru_slab_place(slab, LRU_SLAB_SIZE, pool->node_id);
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	entry = (char *)slab + GSH_CACHE_LINE_SIZE;
+	end = (char *)slab + LRU_SLAB_SIZE - lru_entry_size;
+
+	for (; entry <= end; entry += lru_entry_size) {
+		struct mdcache_free_entry *fe = (void *)entry;
+
+		fe->next = pool->free;
+		pool->free = fe;
+	}
+}
+
+/**
+ * @brief Create the per-node cache entry pools
+ *
+ * This discovers the NUMA topology, so it must be called after the
+ * configuration is parsed and before mdcache_lru_pkginit.
+ */
+void mdcache_entry_pools_init(void)
+{
+	uint32_t node;
+
+	lru_topology_init();
+
+	mdcache_entry_pools =
+		gsh_calloc(lru_state.nodes, sizeof(*mdcache_entry_pools));
+
+	for (node = 0; node < lru_state.nodes; ++node) {
+		struct mdcache_entry_pool *pool = &mdcache_entry_pools[node];
+
+		PTHREAD_MUTEX_init(&pool->lock, NULL);
+		pool->node_id = -1;
+#ifdef LINUX
+		if (lru_state.nodes > 1)
+			pool->node_id = lru_node_id[node];
+#endif
+	}
+}
+
+/**
+ * @brief Destroy the per-node cache entry pools
+ */
+void mdcache_entry_pools_destroy(void)
+{
+	uint32_t node;
+	bool in_use;
+
+	if (mdcache_entry_pools == NULL)
+		return;
+
+	/* Don't pull the memory from under entries still referenced */
+	in_use = atomic_fetch_int64_t(&lru_state.entries_used) != 0;
+
+	for (node = 0; node < lru_state.nodes; ++node) {
+		struct mdcache_entry_pool *pool = &mdcache_entry_pools[node];
+		struct mdcache_entry_slab *slab;
+
+		while (!in_use && (slab = pool->slabs) != NULL) {
+			pool->slabs = slab->next;
+			(void)munmap(slab, LRU_SLAB_SIZE);
+		}
+
+		PTHREAD_MUTEX_destroy(&pool->lock);
+	}
+
+	gsh_free(mdcache_entry_pools);
+	mdcache_entry_pools = NULL;
+
+	lru_topology_destroy();
+}
+
+/**
+ * @brief Return a cache entry to the pool of its node
+ *
+ * @param[in] node   Node index the entry was allocated on
+ * @param[in] entry  The entry
+ */
+static void free_cache_entry(uint32_t node, mdcache_entry_t *entry)
+{
+	struct mdcache_entry_pool *pool = &mdcache_entry_pools[node];
+	struct mdcache_free_entry *fe = (void *)entry;
+
+	PTHREAD_MUTEX_lock(&pool->lock);
+	fe->next = pool->free;
+	pool->free = fe;
+	PTHREAD_MUTEX_unlock(&pool->lock);
+}
+
+mdcache_entry_t *alloc_cache_entry(uint32_t node)
+{
+	struct mdcache_entry_pool *pool = &mdcache_entry_pools[node];
 	mdcache_entry_t *nentry;
 
-	nentry = pool_alloc(mdcache_entry_pool);
+	PTHREAD_MUTEX_lock(&pool->lock);
+
+	if (pool->free == NULL)
+		lru_pool_grow(pool);
+
+	nentry = (mdcache_entry_t *)pool->free;
+	pool->free = pool->free->next;
+
+	PTHREAD_MUTEX_unlock(&pool->lock);
+
+	memset(nentry, 0, sizeof(*nentry));
 
 	/* Initialize the entry locks */
 	init_rw_locks(nentry);
@@ -1722,6 +2619,7 @@ mdcache_entry_t *mdcache_lru_get(struct fsal_obj_handle *sub_handle,
 {
 	mdcache_lru_t *lru;
 	mdcache_entry_t *nentry = NULL;
+	uint32_t node;
 
 	assert(flags & LRU_ACTIVE_REF);
 
@@ -1735,9 +2633,15 @@ mdcache_entry_t *mdcache_lru_get(struct fsal_obj_handle *sub_handle,
 		mdcache_lru_clean(nentry);
 		memset(&nentry->attrs, 0, sizeof(nentry->attrs));
 		init_rw_locks(nentry);
+		/* The memory stays with the node it was allocated on, which
+		 * is the local node unless the local lanes had nothing to
+		 * reap.
+		 */
+		node = lru_node_of_lane(nentry->lru.lane);
 	} else {
 		/* alloc entry (if fails, aborts) */
-		nentry = alloc_cache_entry();
+		node = lru_current_node();
+		nentry = alloc_cache_entry(node);
 	}
 
 	nentry->attr_generation = 0;
@@ -1749,7 +2653,8 @@ mdcache_entry_t *mdcache_lru_get(struct fsal_obj_handle *sub_handle,
 	nentry->lru.refcnt = 2;
 	nentry->lru.active_refcnt = 1;
 	nentry->lru.cf = 0;
-	nentry->lru.lane = lru_lane_of(nentry);
+	nentry->lru.stamp = 0;
+	nentry->lru.lane = lru_lane_of(nentry, node);
 	nentry->lru.flags = LRU_SENTINEL_HELD;
 	nentry->sub_handle = sub_handle;
 
@@ -1773,12 +2678,19 @@ mdcache_entry_t *mdcache_lru_get(struct fsal_obj_handle *sub_handle,
 void mdcache_lru_insert_active(mdcache_entry_t *entry)
 {
 	mdcache_lru_t *lru = &entry->lru;
-	struct lru_q_lane *qlane = &LRU[lru->lane];
+	struct lru_q_lane *qlane;
+
+	/* Nobody else can see the entry yet, so its lane may still move */
+	lru->lane = lru_policy->lane_of(entry);
+	qlane = &LRU[lru->lane];
 
 	QLOCK(qlane);
 
+	if (lru_policy->inserted)
+		lru_policy->inserted(entry, qlane);
+
 	/* Enqueue. */
-	lru_insert(lru, &LRU[entry->lru.lane].ACTIVE);
+	lru_insert(lru, &qlane->ACTIVE);
 
 	QUNLOCK(qlane);
 }
@@ -1799,11 +2711,16 @@ void mdcache_lru_insert_active(mdcache_entry_t *entry)
  * and strongly influences LRU.  Essentially, the first ref during a callpath
  * should take an LRU_PROMOTE ref, and all subsequent callpaths should take
  * LRU_FLAG_NONE refs.
+ *
+ * No reference takes the lane lock.  The first active reference only marks
+ * the entry LRU_REFERENCED; the queue move it implies is done later, in a
+ * batch, by the reaper or the LRU thread (see lru_reap_candidate).
  */
 void _mdcache_lru_ref(mdcache_entry_t *entry, uint32_t flags, const char *func,
 		      int line)
 {
 	int32_t refcnt, active_refcnt = -999;
+	uint32_t bits = 0;
 
 	/* Always take a normal reference so unref to 0 works right */
 	refcnt = atomic_inc_int32_t(&entry->lru.refcnt);
@@ -1824,14 +2741,20 @@ void _mdcache_lru_ref(mdcache_entry_t *entry, uint32_t flags, const char *func,
 
 	if (flags & LRU_PROMOTE) {
 		/* If entry is ever promoted, remember that. */
-		atomic_set_uint32_t_bits(&entry->lru.flags, LRU_EVER_PROMOTED);
+		bits |= LRU_EVER_PROMOTED;
 		assert(flags & LRU_ACTIVE_REF);
 	}
 
-	if (flags & LRU_ACTIVE_REF) {
-		/* Move into ACTIVE queue or adjust to MRU */
-		make_active_lru(entry);
+	if (active_refcnt == 1) {
+		/* Entry became active, it will be requeued when found */
+		bits |= LRU_REFERENCED;
 	}
+
+	/* Avoid dirtying the flags when the bits are already set, which is
+	 * the common case for an entry that is already active.
+	 */
+	if (bits && (atomic_fetch_uint32_t(&entry->lru.flags) & bits) != bits)
+		atomic_set_uint32_t_bits(&entry->lru.flags, bits);
 }
 
 /**
@@ -1909,20 +2832,11 @@ bool _mdcache_lru_unref(mdcache_entry_t *entry, uint32_t flags,
 	 * cleanup will occur.
 	 */
 
-	/* Handle active unref first */
-	if (flags & LRU_ACTIVE_REF &&
-	    PTHREAD_MUTEX_dec_int32_t_and_lock(&entry->lru.active_refcnt,
-					       &qlane->ql_mtx)) {
-		/* active_refcnt is zero and we hold the QLOCK. */
-#if 0
-		/* For clarity... */
-		QLOCK(qlane);
-#endif
-		/* Move entry to MRU of L1 or L2 or leave in cleanup queue. */
-		make_inactive_lru(entry);
-
-		QUNLOCK(qlane);
-	}
+	/* Handle active unref first.  The entry stays on its queue, an idle
+	 * entry on ACTIVE is demoted to L1 or L2 by lru_drain_active().
+	 */
+	if (flags & LRU_ACTIVE_REF)
+		(void)atomic_dec_int32_t(&entry->lru.active_refcnt);
 
 	/* Handle normal unref next for all unrefs. */
 	if (PTHREAD_MUTEX_dec_int32_t_and_lock(&entry->lru.refcnt,
@@ -1952,7 +2866,7 @@ bool _mdcache_lru_unref(mdcache_entry_t *entry, uint32_t flags,
 		QUNLOCK(qlane);
 
 		mdcache_lru_clean(entry);
-		pool_free(mdcache_entry_pool, entry);
+		free_cache_entry(lru_node_of_lane(lane), entry);
 		freed = true;
 
 		(void)atomic_dec_int64_t(&lru_state.entries_used);
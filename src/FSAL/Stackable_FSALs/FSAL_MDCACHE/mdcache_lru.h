@@ -74,12 +74,19 @@ struct lru_state {
 	uint64_t chunks_used;
 	uint32_t per_lane_work;
 	time_t prev_time; /* previous time the gc thread was run. */
+	uint32_t nodes; /* NUMA nodes with CPUs, at least 1 */
+	uint32_t lanes_per_node;
+	uint32_t lanes; /* nodes * lanes_per_node */
 };
 
 extern struct lru_state lru_state;
 
-/** Cache entries pool */
-extern pool_t *mdcache_entry_pool;
+/** Cache entries pools, one per NUMA node */
+struct mdcache_entry_pool;
+extern struct mdcache_entry_pool *mdcache_entry_pools;
+
+void mdcache_entry_pools_init(void);
+void mdcache_entry_pools_destroy(void);
 
 /**
  * Reference type Flags for functions in the LRU package
@@ -97,10 +104,11 @@ extern pool_t *mdcache_entry_pool;
 #define LRU_SENTINEL_REFCOUNT 1
 
 /**
- * The number of lanes comprising a logical queue.  This must be
- * prime.
+ * The minimum number of lanes comprising a logical queue when the lane
+ * count is scaled with the CPU count.  The per-node lane count is always
+ * rounded up to a prime.
  */
-#define LRU_N_Q_LANES 17
+#define LRU_MIN_Q_LANES 17
 
 fsal_status_t mdcache_lru_pkginit(void);
 fsal_status_t mdcache_lru_pkgshutdown(void);
@@ -49,7 +49,7 @@
 #include "mdcache_hash.h"
 #include "mdcache_lru.h"
 
-pool_t *mdcache_entry_pool;
+struct mdcache_entry_pool *mdcache_entry_pools;
 
 struct mdcache_stats cache_st;
 struct mdcache_stats *cache_stp = &cache_st;
@@ -303,6 +303,9 @@ static int mdcache_fsal_unload(struct fsal_module *fsal_hdl)
 	fsal_status_t status;
 	int retval;
 
+	/* Prefetch jobs hold references on entries */
+	mdcache_readdir_prefetch_shutdown();
+
 	/* Destroy the MDCACHE AVL tree */
 	cih_pkgdestroy();
 
@@ -310,9 +313,8 @@ static int mdcache_fsal_unload(struct fsal_module *fsal_hdl)
 	if (FSAL_IS_ERROR(status))
 		fprintf(stderr, "MDCACHE LRU failed to shut down");
 
-	/* Destroy the MDCACHE entry pool */
-	pool_destroy(mdcache_entry_pool);
-	mdcache_entry_pool = NULL;
+	/* Destroy the MDCACHE entry pools */
+	mdcache_entry_pools_destroy();
 
 	retval = unregister_fsal(&MDCACHE.module);
 	if (retval != 0)
@@ -353,21 +355,21 @@ fsal_status_t mdcache_pkginit(void)
 {
 	fsal_status_t status;
 
-	if (mdcache_entry_pool)
+	if (mdcache_entry_pools)
 		return fsalstat(ERR_FSAL_NO_ERROR, 0);
 
-	mdcache_entry_pool =
-		pool_basic_init("MDCACHE Entry Pool", sizeof(mdcache_entry_t));
+	mdcache_entry_pools_init();
 
 	status = mdcache_lru_pkginit();
 	if (FSAL_IS_ERROR(status)) {
-		pool_destroy(mdcache_entry_pool);
-		mdcache_entry_pool = NULL;
+		mdcache_entry_pools_destroy();
 		return status;
 	}
 
 	cih_pkginit();
 
+	(void)mdcache_readdir_prefetch_init();
+
 	return status;
 }
 
@@ -54,6 +54,12 @@
 
 struct mdcache_parameter mdcache_param;
 
+static struct config_item_list lru_policies[] = {
+	CONFIG_LIST_TOK("LRU", MDCACHE_LRU_POLICY_LRU),
+	CONFIG_LIST_TOK("ARC", MDCACHE_LRU_POLICY_ARC),
+	CONFIG_LIST_EOL
+};
+
 static struct config_item mdcache_params[] = {
 	CONF_ITEM_UI32("NParts", 1, 32633, 7, mdcache_parameter, nparts),
 	CONF_ITEM_UI32("Cache_Size", 1, UINT32_MAX, 32633, mdcache_parameter,
@@ -64,6 +70,8 @@ static struct config_item mdcache_params[] = {
 		       dir.avl_chunk),
 	CONF_ITEM_UI32("Detached_Mult", 1, UINT32_MAX, 1, mdcache_parameter,
 		       dir.avl_detached_mult),
+	CONF_ITEM_UI32("Dir_Chunk_Prefetch", 0, 64, 0, mdcache_parameter,
+		       dir.prefetch_chunks),
 	CONF_ITEM_UI32("Entries_HWMark", 1, UINT32_MAX, 100000,
 		       mdcache_parameter, entries_hwmark),
 	CONF_ITEM_UI32("Entries_Release_Size", 0, UINT32_MAX, 100,
@@ -98,6 +106,12 @@ static struct config_item mdcache_params[] = {
 		      mdcache_parameter, files_delegatable_percent),
 	CONF_ITEM_BOOL("Use_Cached_Owner_On_Owner_Override", true,
 		       mdcache_parameter, use_cached_owner_on_owner_override),
+	CONF_ITEM_TOKEN("LRU_Policy", MDCACHE_LRU_POLICY_LRU, lru_policies,
+			mdcache_parameter, lru_policy),
+	CONF_ITEM_UI32("LRU_Lanes", 0, 65521, 0, mdcache_parameter,
+		       lru_lanes),
+	CONF_ITEM_BOOL("LRU_NUMA_Aware", true, mdcache_parameter,
+		       lru_numa_aware),
 	CONFIG_EOL
 };
 
@@ -1431,6 +1431,127 @@ static bool is_referral(struct fsal_obj_handle *obj_hdl,
 	return false;
 }
 
+/* copy
+ * default case bounces the data through read2 and write2
+ */
+
+#define COPY_BOUNCE_SIZE (1024 * 1024)
+
+static fsal_status_t file_copy(struct fsal_obj_handle *src_hdl,
+			       struct state_t *src_state, uint64_t src_offset,
+			       struct fsal_obj_handle *dst_hdl,
+			       struct state_t *dst_state, uint64_t dst_offset,
+			       uint64_t count, uint64_t *copied)
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct async_process_data io_data;
+	struct fsal_io_arg *io_arg =
+		alloca(sizeof(*io_arg) + sizeof(struct iovec));
+	size_t bufsize = MIN(count, COPY_BOUNCE_SIZE);
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	void *buf;
+
+	*copied = 0;
+
+	if (count == 0)
+		return status;
+
+	buf = gsh_malloc(bufsize);
+
+	PTHREAD_MUTEX_init(&mutex, NULL);
+	PTHREAD_COND_init(&cond, NULL);
+
+	io_data.fsa_mutex = &mutex;
+	io_data.fsa_cond = &cond;
+
+	while (*copied < count) {
+		size_t want = MIN(count - *copied, bufsize);
+		size_t got, put = 0;
+		bool eof;
+
+		memset(io_arg, 0, sizeof(*io_arg));
+		io_arg->state = src_state;
+		io_arg->offset = src_offset + *copied;
+		io_arg->io_request = want;
+		io_arg->iov_count = 1;
+		io_arg->iov = (struct iovec *)(io_arg + 1);
+		io_arg->iov[0].iov_base = buf;
+		io_arg->iov[0].iov_len = want;
+
+		io_data.ret = fsalstat(ERR_FSAL_NO_ERROR, 0);
+		io_data.done = false;
+
+		fsal_read(src_hdl, false, io_arg, &io_data);
+
+		if (FSAL_IS_ERROR(io_data.ret)) {
+			status = io_data.ret;
+			break;
+		}
+
+		got = io_arg->io_amount;
+		eof = io_arg->end_of_file;
+
+		while (put < got) {
+			memset(io_arg, 0, sizeof(*io_arg));
+			io_arg->state = dst_state;
+			io_arg->offset = dst_offset + *copied + put;
+			io_arg->io_request = got - put;
+			io_arg->iov_count = 1;
+			io_arg->iov = (struct iovec *)(io_arg + 1);
+			io_arg->iov[0].iov_base = (char *)buf + put;
+			io_arg->iov[0].iov_len = got - put;
+			io_arg->fsal_stable = false;
+
+			io_data.ret = fsalstat(ERR_FSAL_NO_ERROR, 0);
+			io_data.done = false;
+
+			fsal_write(dst_hdl, false, io_arg, &io_data);
+
+			if (FSAL_IS_ERROR(io_data.ret)) {
+				status = io_data.ret;
+				break;
+			}
+
+			if (io_arg->io_amount == 0) {
+				/* No progress, don't spin */
+				status = fsalstat(ERR_FSAL_IO, EIO);
+				break;
+			}
+
+			put += io_arg->io_amount;
+		}
+
+		*copied += put;
+
+		if (FSAL_IS_ERROR(status) || eof || got < want)
+			break;
+	}
+
+	PTHREAD_COND_destroy(&cond);
+	PTHREAD_MUTEX_destroy(&mutex);
+	gsh_free(buf);
+
+	/* Report a partial copy as success, the caller picks up from there */
+	if (FSAL_IS_ERROR(status) && *copied != 0)
+		status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	return status;
+}
+
+/* clone
+ * default case not supported
+ */
+
+static fsal_status_t file_clone(struct fsal_obj_handle *src_hdl,
+				struct state_t *src_state, uint64_t src_offset,
+				struct fsal_obj_handle *dst_hdl,
+				struct state_t *dst_state, uint64_t dst_offset,
+				uint64_t count)
+{
+	return fsalstat(ERR_FSAL_NOTSUPP, ENOTSUP);
+}
+
 /* Default fsal handle object method vector.
  * copied to allocated vector at register time
  */
@@ -1488,6 +1609,8 @@ struct fsal_obj_ops def_handle_ops = {
 	.setattr2 = setattr2,
 	.close2 = close2,
 	.is_referral = is_referral,
+	.copy = file_copy,
+	.clone = file_clone,
 };
 
 /* fsal_pnfs_ds common methods */
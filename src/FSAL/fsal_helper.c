@@ -52,6 +52,7 @@
 #include "sal_data.h"
 #include "sal_functions.h"
 #include "FSAL/fsal_commonlib.h"
+#include "io_buf_pool.h"
 #include "sal_functions.h"
 
 static bool fsal_not_in_group_list(gid_t gid)
@@ -1843,11 +1844,6 @@ fsal_status_t get_optional_attrs(struct fsal_obj_handle *obj_hdl,
 	return status;
 }
 
-static void fsal_iov_release(void *release_data)
-{
-	gsh_free(release_data);
-}
-
 /**
  * @brief Read data from a file
  *
@@ -1901,12 +1897,13 @@ void fsal_read2(struct fsal_obj_handle *obj_hdl, bool bypass,
 	/* Check if FSAL will allocate the buffer */
 	if (!op_ctx->fsal_export->exp_ops.fs_supports(
 		    op_ctx->fsal_export, fso_allocate_own_read_buffer)) {
-		/* FSAL will not allocate a buffer, so allocate one. */
-		read_arg->iov[0].iov_base =
-			gsh_malloc(read_arg->iov[0].iov_len);
+		/* FSAL will not allocate a buffer, get one from the pool. */
+		struct io_buf *buf = io_buf_get(read_arg->iov[0].iov_len);
+
+		read_arg->iov[0].iov_base = buf->ib_base;
 		/* Set up release function */
-		read_arg->iov_release = fsal_iov_release;
-		read_arg->release_data = read_arg->iov[0].iov_base;
+		read_arg->iov_release = io_buf_release;
+		read_arg->release_data = buf;
 	}
 
 call_read2:
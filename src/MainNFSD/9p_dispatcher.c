@@ -63,10 +63,25 @@
 #include <stdbool.h>
 #include <urcu-bp.h>
 
-#include "ff_api.h"
-#include <sys/ioctl.h>
+#include "delayed_exec.h"
+#include "spsc_ring.h"
+#include "io_buf_pool.h"
+#include "9p_sock.h"
+#include <sys/epoll.h>
+#include <sched.h>
 
-#define P_FAMILY AF_INET6
+/* Replies a worker can have waiting for the dispatcher */
+#define _9P_REPLY_RING_SIZE 1024
+
+/* Events handled per pass of the event loop */
+#define _9P_LOOP_EVENTS 256
+
+/* Messages read from a connection per pass, so that a busy client does not
+ * hold up the others */
+#define _9P_LOOP_READ_BUDGET 16
+
+/* Buffers gathered per send, two per reply */
+#define _9P_LOOP_SEND_IOV 64
 
 static struct fridgethr *_9p_worker_fridge;
 
@@ -76,6 +91,61 @@ static const char *req_q_s[N_REQ_QUEUES] = {
 	"REQ_Q_LOW_LATENCY",
 };
 
+/**
+ * @brief A 9P/TCP connection, owned by the dispatcher
+ */
+struct _9p_tcp_conn {
+	struct _9p_conn conn;
+	int fd;
+	bool closed;
+	bool want_out; /*< EPOLLOUT is armed */
+	uint32_t hdr_len; /*< Bytes of the length header read so far */
+	char hdr[_9P_HDR_SIZE];
+	struct io_buf *msg; /*< Message being read, once its length is known */
+	uint32_t msg_len;
+	uint32_t msg_read;
+	struct glist_head out_q; /*< Replies not yet fully sent */
+	uint32_t out_off; /*< Bytes of the first reply already sent */
+	struct glist_head list; /*< On the closing list */
+	char strcaller[SOCK_NAME_MAX];
+};
+
+/**
+ * @brief A worker's ring of replies for the dispatcher
+ */
+struct _9p_reply_ring {
+	struct spsc_ring ring;
+	struct glist_head list;
+};
+
+/**
+ * @brief State of the 9P/TCP event loop
+ *
+ * Everything but the ring list and sleeping is only touched by the
+ * dispatcher thread.
+ */
+static struct {
+	const struct _9p_sock_ops *sock;
+	int listen_fd;
+	int epfd;
+	/* Connections waiting for their requests to be released */
+	struct glist_head closing;
+	pthread_mutex_t rings_lock;
+	struct glist_head rings;
+	uint32_t rings_count;
+	uint32_t rings_gen; /*< Bumped when a ring is added */
+	/* The dispatcher's copy of the ring list */
+	uint32_t rings_seen;
+	unsigned int nrings;
+	struct _9p_reply_ring **ring_array;
+	/* The dispatcher may be blocked in poll(), workers must wake it */
+	uint32_t sleeping;
+} _9p_loop;
+
+static __thread struct _9p_reply_ring *_9p_reply_ring;
+
+static void _9p_tcp_reply(struct _9p_request_data *req9p);
+
 /* static */
 uint32_t _9p_outstanding_reqs_est(void)
 {
@@ -333,12 +403,28 @@ static void _9p_execute(struct _9p_request_data *req9p)
 static void _9p_free_reqdata(struct _9p_request_data *req9p)
 {
 	if (req9p->pconn->trans_type == _9P_TCP)
-		gsh_free(req9p->_9pmsg);
+		io_buf_release(req9p->_9pmsg_buf);
 
 	/* decrease connection refcount */
 	(void)atomic_dec_uint32_t(&req9p->pconn->refcount);
 }
 
+/**
+ * @brief Free a 9p request that has been processed
+ *
+ * @param[in] req9p 9p request
+ */
+static void _9p_release_req(struct _9p_request_data *req9p)
+{
+	_9p_free_reqdata(req9p);
+
+	/* Free the req by releasing the entry */
+	LogFullDebug(COMPONENT_DISPATCH, "Invalidating processed entry");
+
+	gsh_free(req9p);
+	(void)atomic_inc_uint64_t(&nfs_health_.dequeued_reqs);
+}
+
 static uint32_t worker_indexer;
 
 /**
@@ -362,6 +448,17 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 
 	/* Initialize thr waitq */
 	init_wait_q_entry(&wd->wqe);
+
+	/* Our ring of replies for the dispatcher.  Workers only go away at
+	 * shutdown, so rings are never removed. */
+	_9p_reply_ring = gsh_calloc(1, sizeof(*_9p_reply_ring));
+	spsc_ring_init(&_9p_reply_ring->ring, _9P_REPLY_RING_SIZE);
+
+	PTHREAD_MUTEX_lock(&_9p_loop.rings_lock);
+	glist_add_tail(&_9p_loop.rings, &_9p_reply_ring->list);
+	_9p_loop.rings_count++;
+	(void)atomic_inc_uint32_t(&_9p_loop.rings_gen);
+	PTHREAD_MUTEX_unlock(&_9p_loop.rings_lock);
 }
 
 /**
@@ -412,14 +509,13 @@ static void _9p_worker_run(struct fridgethr_context *ctx)
 		reqdata->_9prq_mutex = &_9pw_mutex;
 
 		_9p_execute(reqdata);
-		_9p_free_reqdata(reqdata);
-
-		/* Free the req by releasing the entry */
-		LogFullDebug(COMPONENT_DISPATCH,
-			     "Invalidating processed entry");
 
-		gsh_free(reqdata);
-		(void)atomic_inc_uint64_t(&nfs_health_.dequeued_reqs);
+		/* The dispatcher sends a 9P/TCP reply, then releases the
+		 * request itself. */
+		if (reqdata->pconn->trans_type == _9P_TCP)
+			_9p_tcp_reply(reqdata);
+		else
+			_9p_release_req(reqdata);
 	}
 
 	PTHREAD_MUTEX_destroy(&_9pw_mutex);
@@ -448,6 +544,10 @@ int _9p_worker_init(void)
 	glist_init(&_9p_req_st.reqs.wait_list);
 	_9p_req_st.reqs.waiters = 0;
 
+	/* Workers register their reply ring as they start */
+	PTHREAD_MUTEX_init(&_9p_loop.rings_lock, NULL);
+	glist_init(&_9p_loop.rings);
+
 	memset(&frp, 0, sizeof(struct fridgethr_params));
 	frp.thr_max = _9p_param.nb_worker;
 	frp.thr_min = _9p_param.nb_worker;
@@ -533,360 +633,618 @@ void DispatchWork9P(struct _9p_request_data *req)
 }
 
 /**
- * _9p_socket_thread: 9p socket manager.
+ * @brief Hand a processed 9P/TCP request back to the dispatcher
  *
- * This function is the main loop for the 9p socket manager.
- * One such thread exists per connection.
+ * Called by the worker that processed the request, with the reply built in
+ * req9p->_9preply.  Sockets are only used from the dispatcher's thread, so
+ * the reply goes through this worker's ring; if the dispatcher is that far
+ * behind, wait for it.
  *
- * @param Arg the socket number cast as a void * in pthread_create
+ * @param[in] req9p 9p request, no longer ours
+ */
+static void _9p_tcp_reply(struct _9p_request_data *req9p)
+{
+	while (!spsc_ring_push(&_9p_reply_ring->ring, req9p))
+		sched_yield();
+
+	/* Pairs with the barrier in _9p_loop_pass() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (atomic_fetch_uint32_t(&_9p_loop.sleeping))
+		_9p_loop.sock->wake();
+}
+
+/**
+ * @brief Release a 9P/TCP request once its reply is sent or dropped
  *
- * @return NULL
+ * @param[in] req9p 9p request
+ */
+static void _9p_tcp_release_req(struct _9p_request_data *req9p)
+{
+	if (req9p->_9preplydata_release != NULL)
+		req9p->_9preplydata_release(req9p->_9preplydata_release_data);
+
+	if (req9p->_9preply_buf != NULL)
+		io_buf_release(req9p->_9preply_buf);
+	_9p_release_req(req9p);
+}
+
+/**
+ * @brief Free a closed connection once no request holds it
  *
+ * Clunking the remaining fids may block in the FSAL, so this runs from the
+ * delayed executor rather than the dispatcher.
+ *
+ * @param[in] arg The connection
  */
+static void _9p_tcp_conn_free(void *arg)
+{
+	struct _9p_tcp_conn *tconn = arg;
+	unsigned int i;
+
+	_9p_cleanup_fids(&tconn->conn);
+
+	if (tconn->conn.client != NULL)
+		put_gsh_client(tconn->conn.client);
+
+	for (i = 0; i < FLUSH_BUCKETS; i++)
+		PTHREAD_MUTEX_destroy(&tconn->conn.flush_buckets[i].flb_lock);
+	PTHREAD_MUTEX_destroy(&tconn->conn.fid_lock);
+
+	gsh_free(tconn);
+}
 
-void *_9p_socket_thread(void *Arg)
+/**
+ * @brief Close a connection
+ *
+ * Requests still being processed hold the connection, it is freed by
+ * _9p_loop_reap() once they are all released.
+ *
+ * @param[in] tconn The connection
+ */
+static void _9p_tcp_conn_close(struct _9p_tcp_conn *tconn)
 {
-	long tcp_sock = (long)Arg;
-	int rc = -1;
-	struct pollfd fds[1];
-	int fdcount = 1;
-	static char my_name[32];
-	char strcaller[SOCK_NAME_MAX];
-	struct display_buffer dspbuf = { sizeof(strcaller), strcaller,
-					 strcaller };
-	struct _9p_request_data *req = NULL;
-	int tag;
-	unsigned long sequence = 0;
-	unsigned int i = 0;
-	char *_9pmsg = NULL;
-	uint32_t msglen;
+	struct glist_head *node, *noden;
 
-	struct _9p_conn _9p_conn;
-	socklen_t addrpeerlen;
+	if (tconn->closed)
+		return;
 
-	int readlen = 0;
-	int total_readlen = 0;
+	LogEvent(COMPONENT_9P, "Closing connection on socket %d", tconn->fd);
 
-	/* We don't care about too long string, truncated is fine and we don't
-	 * expect EOVERRUN or EINVAL.
-	 */
-	(void)snprintf(my_name, sizeof(my_name), "9p_sock_mgr#fd=%ld",
-		       tcp_sock);
-	SetNameFunction(my_name);
-	rcu_register_thread();
+	tconn->closed = true;
+	(void)_9p_loop.sock->poll_ctl(_9p_loop.epfd, EPOLL_CTL_DEL, tconn->fd,
+				      NULL);
+	_9p_loop.sock->close(tconn->fd);
 
-	/* Init the struct _9p_conn structure */
-	memset(&_9p_conn, 0, sizeof(_9p_conn));
-	PTHREAD_MUTEX_init(&_9p_conn.sock_lock, NULL);
-	_9p_conn.trans_type = _9P_TCP;
-	_9p_conn.trans_data.sockfd = tcp_sock;
-	for (i = 0; i < FLUSH_BUCKETS; i++) {
-		PTHREAD_MUTEX_init(&_9p_conn.flush_buckets[i].flb_lock, NULL);
-		glist_init(&_9p_conn.flush_buckets[i].list);
+	if (tconn->msg != NULL) {
+		io_buf_release(tconn->msg);
+		tconn->msg = NULL;
 	}
-	atomic_store_uint32_t(&_9p_conn.refcount, 0);
 
-	/* Init the fids pointers array */
-	memset(&_9p_conn.fids, 0, _9P_FID_PER_CONN * sizeof(struct _9p_fid *));
+	glist_for_each_safe(node, noden, &tconn->out_q) {
+		struct _9p_request_data *req9p =
+			glist_entry(node, struct _9p_request_data, req_q);
 
-	/* Set initial msize.
-	 * Client may request a lower value during TVERSION */
-	_9p_conn.msize = _9p_param._9p_tcp_msize;
+		glist_del(&req9p->req_q);
+		_9p_tcp_release_req(req9p);
+	}
 
-	if (gettimeofday(&_9p_conn.birth, NULL) == -1)
-		LogFatal(COMPONENT_9P, "Cannot get connection's time of birth");
+	glist_add_tail(&_9p_loop.closing, &tconn->list);
+}
 
-	addrpeerlen = sizeof(_9p_conn.addrpeer);
-	rc = getpeername(tcp_sock, (struct sockaddr *)&_9p_conn.addrpeer,
-			 &addrpeerlen);
-	if (rc == -1) {
-		LogMajor(
-			COMPONENT_9P,
-			"Cannot get peername to tcp socket for 9p, error %d (%s)",
-			errno, strerror(errno));
-		/* XXX */
-		display_cat(&dspbuf, "(unresolved)");
-		goto end;
-	} else {
-		display_sockaddr(&dspbuf, &_9p_conn.addrpeer);
+static void _9p_tcp_conn_want_out(struct _9p_tcp_conn *tconn, bool want_out)
+{
+	struct epoll_event ev;
+
+	if (tconn->want_out == want_out)
+		return;
 
-		LogEvent(COMPONENT_9P, "9p socket #%ld is connected to %s",
-			 tcp_sock, strcaller);
+	memset(&ev, 0, sizeof(ev));
+	ev.events = want_out ? EPOLLIN | EPOLLOUT : EPOLLIN;
+	ev.data.ptr = tconn;
+	(void)_9p_loop.sock->poll_ctl(_9p_loop.epfd, EPOLL_CTL_MOD, tconn->fd,
+				      &ev);
+	tconn->want_out = want_out;
+}
+
+/**
+ * @brief Describe what is left to send of a reply
+ *
+ * @param[in]  req9p The request
+ * @param[in]  off   Bytes of the reply already sent
+ * @param[out] iov   Room for two buffers
+ *
+ * @return The number of buffers filled in.
+ */
+static int _9p_tcp_reply_iov(struct _9p_request_data *req9p, uint32_t off,
+			     struct iovec *iov)
+{
+	int iovcnt = 0;
+
+	if (off < req9p->_9preplylen) {
+		iov[iovcnt].iov_base = req9p->_9preply + off;
+		iov[iovcnt++].iov_len = req9p->_9preplylen - off;
+		off = 0;
+	} else {
+		off -= req9p->_9preplylen;
 	}
-	_9p_conn.client = get_gsh_client(&_9p_conn.addrpeer, false);
 
-	/* Set up the structure used by poll */
-	memset((char *)fds, 0, sizeof(struct pollfd));
-	fds[0].fd = tcp_sock;
-	fds[0].events = POLLIN | POLLPRI | POLLRDBAND | POLLRDNORM | POLLRDHUP |
-			POLLHUP | POLLERR | POLLNVAL;
+	if (off < req9p->_9preplydata.iov_len) {
+		iov[iovcnt].iov_base = (char *)req9p->_9preplydata.iov_base + off;
+		iov[iovcnt++].iov_len = req9p->_9preplydata.iov_len - off;
+	}
 
-	for (;;) {
-		total_readlen = 0; /* new message */
-		rc = ff_poll(fds, fdcount, -1);
-		if (rc == -1) {
-			/* timeout = -1 => Wait indefinitely for events */
-			/* Interruption if not an issue */
-			if (errno == EINTR)
-				continue;
+	return iovcnt;
+}
 
-			LogCrit(COMPONENT_9P,
-				"Got error %u (%s) on fd %ld connect to %s while polling on socket",
-				errno, strerror(errno), tcp_sock, strcaller);
+/**
+ * @brief Send queued replies until the socket would block
+ *
+ * Replies are gathered as they are: a read's data goes to the socket
+ * straight from the buffer the FSAL read it into.
+ *
+ * @param[in] tconn The connection
+ *
+ * @return false if the connection must be closed.
+ */
+static bool _9p_tcp_conn_write(struct _9p_tcp_conn *tconn)
+{
+	struct iovec iov[_9P_LOOP_SEND_IOV];
+	struct _9p_request_data *req9p;
+	struct glist_head *node, *noden;
+	size_t gathered, sent, total;
+	uint32_t off;
+	ssize_t len;
+	int iovcnt, i;
+
+	while (!glist_empty(&tconn->out_q)) {
+		iovcnt = 0;
+		off = tconn->out_off;
+
+		glist_for_each(node, &tconn->out_q) {
+			if (iovcnt + 2 > _9P_LOOP_SEND_IOV)
+				break;
+
+			req9p = glist_entry(node, struct _9p_request_data,
+					    req_q);
+			iovcnt += _9p_tcp_reply_iov(req9p, off, iov + iovcnt);
+			off = 0;
 		}
 
-		if (fds[0].revents & POLLNVAL) {
-			LogEvent(COMPONENT_9P,
-				 "Client %s on socket %lu produced POLLNVAL",
-				 strcaller, tcp_sock);
-			goto end;
+		for (gathered = 0, i = 0; i < iovcnt; i++)
+			gathered += iov[i].iov_len;
+
+		len = _9p_loop.sock->send(tconn->fd, iov, iovcnt);
+
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK ||
+			    errno == EINTR) {
+				/* Carry on when the socket drains */
+				_9p_tcp_conn_want_out(tconn, true);
+				return true;
+			}
+
+			server_stats_transport_done(tconn->conn.client, 0, 0, 0,
+						    0, 0, 1);
+			LogMajor(COMPONENT_9P,
+				 "Could not send 9P/TCP reply correctly on socket #%d, errno=%d",
+				 tconn->fd, errno);
+			return false;
 		}
 
-		if (fds[0].revents & (POLLERR | POLLHUP | POLLRDHUP)) {
-			LogEvent(
-				COMPONENT_9P,
-				"Client %s on socket %lu has shut down and closed",
-				strcaller, tcp_sock);
-			goto end;
+		/* Release the replies that are now completely sent */
+		sent = tconn->out_off + len;
+
+		glist_for_each_safe(node, noden, &tconn->out_q) {
+			req9p = glist_entry(node, struct _9p_request_data,
+					    req_q);
+			total = req9p->_9preplylen +
+				req9p->_9preplydata.iov_len;
+
+			if (sent < total)
+				break;
+
+			sent -= total;
+			server_stats_transport_done(tconn->conn.client, 0, 0,
+						    0, total, 1, 0);
+			glist_del(&req9p->req_q);
+			_9p_tcp_release_req(req9p);
 		}
 
-		if (!(fds[0].revents & (POLLIN | POLLRDNORM)))
-			continue;
+		tconn->out_off = sent;
 
-		/* Prepare to read the message */
-		_9pmsg = gsh_malloc(_9p_conn.msize);
-
-		/* An incoming 9P request: the msg has a 4 bytes header
-		   showing the size of the msg including the header */
-		readlen = ff_recv(fds[0].fd, _9pmsg, _9P_HDR_SIZE, MSG_WAITALL);
-		if (readlen != _9P_HDR_SIZE)
-			goto badmsg;
-
-		msglen = *(uint32_t *)_9pmsg;
-		if (msglen > _9p_conn.msize) {
-			LogCrit(COMPONENT_9P,
-				"Message size too big! got %u, max = %u",
-				msglen, _9p_conn.msize);
-			goto end;
+		if ((size_t)len < gathered) {
+			/* The socket is full */
+			_9p_tcp_conn_want_out(tconn, true);
+			return true;
 		}
+	}
 
-		LogFullDebug(
-			COMPONENT_9P,
-			"Received 9P/TCP message of size %u from client %s on socket %lu",
-			msglen, strcaller, tcp_sock);
+	_9p_tcp_conn_want_out(tconn, false);
+	return true;
+}
 
-		total_readlen += readlen;
-		while (total_readlen < msglen) {
-			readlen = ff_recv(fds[0].fd, _9pmsg + total_readlen,
-				       msglen - total_readlen, 0);
+/**
+ * @brief Queue a reply handed back by a worker
+ *
+ * @param[in] req9p 9p request with its reply
+ */
+static void _9p_tcp_conn_reply(struct _9p_request_data *req9p)
+{
+	struct _9p_tcp_conn *tconn =
+		container_of(req9p->pconn, struct _9p_tcp_conn, conn);
 
-			if (readlen > 0) {
-				total_readlen += readlen;
-				continue;
-			}
-			if (readlen == 0 || (readlen < 0 && errno != EINTR))
-				goto badmsg;
-		} /* while */
+	/* Replies reach the socket in the order they are queued here, so a
+	 * TFLUSH waiting for this request may answer from now on.
+	 */
+	_9p_DiscardFlushHook(req9p);
 
-		server_stats_transport_done(_9p_conn.client, total_readlen, 1,
-					    0, 0, 0, 0);
+	if (tconn->closed || req9p->_9preplylen == 0) {
+		_9p_tcp_release_req(req9p);
+		return;
+	}
 
-		/* Message is good. */
-		(void)atomic_inc_uint64_t(&nfs_health_.enqueued_reqs);
-		req = gsh_calloc(1, sizeof(struct _9p_request_data));
+	glist_add_tail(&tconn->out_q, &req9p->req_q);
 
-		req->_9pmsg = _9pmsg;
-		req->pconn = &_9p_conn;
+	/* Otherwise it goes out when the socket drains */
+	if (!tconn->want_out && !_9p_tcp_conn_write(tconn))
+		_9p_tcp_conn_close(tconn);
+}
 
-		/* Add this request to the request list,
-		 * should it be flushed later. */
-		tag = *(u16 *)(_9pmsg + _9P_HDR_SIZE + _9P_TYPE_SIZE);
-		_9p_AddFlushHook(req, tag, sequence++);
-		LogFullDebug(COMPONENT_9P, "Request tag is %d", tag);
+/**
+ * @brief Queue a whole message for the workers
+ *
+ * @param[in] tconn The connection the message was read from
+ */
+static void _9p_tcp_conn_dispatch(struct _9p_tcp_conn *tconn)
+{
+	struct _9p_request_data *req;
+	int tag;
 
-		/* Message was OK push it */
-		DispatchWork9P(req);
+	server_stats_transport_done(tconn->conn.client, tconn->msg_len, 1, 0,
+				    0, 0, 0);
 
-		/* Not our buffer anymore */
-		_9pmsg = NULL;
-		continue;
+	/* Message is good. */
+	(void)atomic_inc_uint64_t(&nfs_health_.enqueued_reqs);
+	req = gsh_calloc(1, sizeof(struct _9p_request_data));
 
-badmsg:
-		if (readlen == 0)
-			LogEvent(
-				COMPONENT_9P,
-				"Premature end for Client %s on socket %lu, total read = %u",
-				strcaller, tcp_sock, total_readlen);
-		else if (readlen < 0) {
-			LogEvent(
-				COMPONENT_9P,
-				"Read error client %s on socket %lu errno=%d, total read = %u",
-				strcaller, tcp_sock, errno, total_readlen);
-		} else
-			LogEvent(
+	req->_9pmsg = tconn->msg->ib_base;
+	req->_9pmsg_buf = tconn->msg;
+	req->pconn = &tconn->conn;
+
+	/* Not our buffer anymore */
+	tconn->msg = NULL;
+
+	/* Add this request to the request list,
+	 * should it be flushed later. */
+	tag = *(u16 *)(req->_9pmsg + _9P_HDR_SIZE + _9P_TYPE_SIZE);
+	_9p_AddFlushHook(req, tag, tconn->conn.sequence++);
+	LogFullDebug(COMPONENT_9P, "Request tag is %d", tag);
+
+	/* Message was OK push it */
+	DispatchWork9P(req);
+}
+
+/**
+ * @brief Read what a connection has to offer
+ *
+ * Messages are framed as their bytes arrive: first the 4 byte length
+ * header, then the rest of the message, in a pool buffer of just the right
+ * size class that is handed to the worker with the request.
+ *
+ * @param[in] tconn The connection
+ *
+ * @return false if the connection must be closed.
+ */
+static bool _9p_tcp_conn_read(struct _9p_tcp_conn *tconn)
+{
+	unsigned int budget = _9P_LOOP_READ_BUDGET;
+	ssize_t len;
+
+	while (budget > 0) {
+		if (tconn->msg == NULL) {
+			len = _9p_loop.sock->recv(tconn->fd,
+						  tconn->hdr + tconn->hdr_len,
+						  _9P_HDR_SIZE - tconn->hdr_len);
+			if (len <= 0)
+				goto check;
+
+			tconn->hdr_len += len;
+			if (tconn->hdr_len < _9P_HDR_SIZE)
+				continue;
+
+			tconn->msg_len = *(uint32_t *)tconn->hdr;
+			tconn->hdr_len = 0;
+
+			if (tconn->msg_len < _9P_STD_HDR_SIZE ||
+			    tconn->msg_len > tconn->conn.msize) {
+				LogCrit(COMPONENT_9P,
+					"Bad message size from client %s on socket %d: got %u, max = %u",
+					tconn->strcaller, tconn->fd,
+					tconn->msg_len, tconn->conn.msize);
+				return false;
+			}
+
+			LogFullDebug(
 				COMPONENT_9P,
-				"Header too small! for client %s on socket %lu: readlen=%u expected=%u",
-				strcaller, tcp_sock, readlen, _9P_HDR_SIZE);
-
-		/* Either way, we close the connection.
-		 * It is not possible to survive
-		 * once we get out of sync in the TCP stream
-		 * with the client
-		 */
-		break; /* bail out */
-	} /* for( ;; ) */
-
-end:
-	LogEvent(COMPONENT_9P, "Closing connection on socket %lu", tcp_sock);
-	close(tcp_sock);
-
-	/* Free buffer if we encountered an error
-	 * before we could give it to a worker */
-	if (_9pmsg)
-		gsh_free(_9pmsg);
-
-	while (atomic_fetch_uint32_t(&_9p_conn.refcount)) {
-		LogEvent(COMPONENT_9P, "Waiting for workers to release pconn");
-		sleep(1);
-	}
+				"Receiving 9P/TCP message of size %u from client %s on socket %d",
+				tconn->msg_len, tconn->strcaller, tconn->fd);
 
-	_9p_cleanup_fids(&_9p_conn);
+			tconn->msg = io_buf_get(tconn->msg_len);
+			memcpy(tconn->msg->ib_base, tconn->hdr, _9P_HDR_SIZE);
+			tconn->msg_read = _9P_HDR_SIZE;
+		}
 
-	if (_9p_conn.client != NULL)
-		put_gsh_client(_9p_conn.client);
+		len = _9p_loop.sock->recv(tconn->fd,
+					  (char *)tconn->msg->ib_base +
+						  tconn->msg_read,
+					  tconn->msg_len - tconn->msg_read);
+		if (len <= 0)
+			goto check;
 
-	rcu_unregister_thread();
+		tconn->msg_read += len;
+		if (tconn->msg_read < tconn->msg_len)
+			continue;
 
-	PTHREAD_MUTEX_destroy(&_9p_conn.sock_lock);
+		_9p_tcp_conn_dispatch(tconn);
+		budget--;
+	}
 
-	for (i = 0; i < FLUSH_BUCKETS; i++)
-		PTHREAD_MUTEX_destroy(&_9p_conn.flush_buckets[i].flb_lock);
+	/* More may be waiting, the next pass will tell */
+	return true;
 
-	pthread_exit(NULL);
-} /* _9p_socket_thread */
+check:
+	if (len == 0) {
+		LogEvent(COMPONENT_9P,
+			 "Client %s on socket %d has shut down and closed",
+			 tconn->strcaller, tconn->fd);
+		return false;
+	}
+
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		return true;
+
+	LogEvent(COMPONENT_9P, "Read error client %s on socket %d errno=%d",
+		 tconn->strcaller, tconn->fd, errno);
+	return false;
+}
 
 /**
- * _9p_create_socket_V4 : create the socket and bind for 9P using
- * the available V4 interfaces on the host. This is not the default
- * for ganesha. We expect _9p_create_socket_V6 to be called first
- * and succeed. Only when the V6 function returns failure is this
- * function expected to be called. See _9p_create_socket().
- *
- * @return socket fd or -1 in case of failure
+ * @brief Set up a newly accepted connection
  *
+ * @param[in] fd   The connection's socket
+ * @param[in] peer The client's address
  */
-static int _9p_create_socket_V4(void)
+static void _9p_tcp_conn_create(int fd, sockaddr_t *peer)
 {
-	int sock = -1;
-	int one = 1;
-	int centvingt = 120;
-	int neuf = 9;
-	struct sockaddr_in sinaddr_tcp;
-
-	FILE *logfile = fopen("/tmp/log.lyp", "aw");
-
-	fprintf(logfile, "ready to ff_socket\n");
-	fflush(logfile);
-
-	sock = ff_socket(AF_INET, SOCK_STREAM, 0);
-	if (sock == -1) {
-		fprintf(logfile, "Error creating 9p V4 socket, error %d(%s)", errno, strerror(errno));
-		fflush(logfile);
-		LogWarn(COMPONENT_9P_DISPATCH,
-			"Error creating 9p V4 socket, error %d(%s)", errno,
-			strerror(errno));
-		return -1;
+	struct _9p_tcp_conn *tconn = gsh_calloc(1, sizeof(*tconn));
+	struct _9p_conn *conn = &tconn->conn;
+	struct display_buffer dspbuf = { sizeof(tconn->strcaller),
+					 tconn->strcaller, tconn->strcaller };
+	struct epoll_event ev;
+	unsigned int i;
+
+	tconn->fd = fd;
+	glist_init(&tconn->out_q);
+
+	conn->trans_type = _9P_TCP;
+	conn->trans_data.sockfd = fd;
+	for (i = 0; i < FLUSH_BUCKETS; i++) {
+		PTHREAD_MUTEX_init(&conn->flush_buckets[i].flb_lock, NULL);
+		glist_init(&conn->flush_buckets[i].list);
 	}
+	PTHREAD_MUTEX_init(&conn->fid_lock, NULL);
+	atomic_store_uint32_t(&conn->refcount, 0);
 
-	fprintf(logfile, "ff_socket succeeded\n");
-	fflush(logfile);
-
-	if ((ff_setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ==
-	     -1) ||
-	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) ==
-	     -1) ||
-	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &centvingt,
-			sizeof(centvingt)) == -1) ||
-	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &centvingt,
-			sizeof(centvingt)) == -1) ||
-	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &neuf, sizeof(neuf)) ==
-	     -1)) {
-		LogWarn(COMPONENT_9P_DISPATCH,
-			"Error setting 9p V4 socket option, error %d(%s)",
-			errno, strerror(errno));
+	/* Set initial msize.
+	 * Client may request a lower value during TVERSION */
+	conn->msize = _9p_param._9p_tcp_msize;
+
+	if (gettimeofday(&conn->birth, NULL) == -1)
+		LogFatal(COMPONENT_9P, "Cannot get connection's time of birth");
+
+	conn->addrpeer = *peer;
+	display_sockaddr(&dspbuf, &conn->addrpeer);
+	LogEvent(COMPONENT_9P, "9p socket #%d is connected to %s", fd,
+		 tconn->strcaller);
+
+	conn->client = get_gsh_client(&conn->addrpeer, false);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = tconn;
+
+	if (_9p_loop.sock->poll_ctl(_9p_loop.epfd, EPOLL_CTL_ADD, fd, &ev) ==
+	    -1) {
+		LogMajor(COMPONENT_9P,
+			 "Cannot poll 9p socket #%d, error %d (%s)", fd, errno,
+			 strerror(errno));
 		goto err;
 	}
 
-	fprintf(logfile, "ff_setsockopt succeeded\n");
-	fflush(logfile);
+	return;
 
-	int on = 1;
-	ff_ioctl(sock, FIONBIO, &on);
+err:
+	/* Not in the epoll set, and no request could hold it yet */
+	tconn->closed = true;
+	_9p_loop.sock->close(fd);
+	glist_add_tail(&_9p_loop.closing, &tconn->list);
+}
 
-	memset(&sinaddr_tcp, 0, sizeof(sinaddr_tcp));
-	sinaddr_tcp.sin_family = AF_INET;
+static void _9p_loop_accept(void)
+{
+	sockaddr_t peer;
+	int fd;
 
-	/* All the interfaces on the machine are used */
-	sinaddr_tcp.sin_addr.s_addr = htonl(INADDR_ANY);
-	sinaddr_tcp.sin_port = htons(_9p_param._9p_tcp_port);
+	for (;;) {
+		fd = _9p_loop.sock->accept(_9p_loop.listen_fd, &peer);
+
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR)
+				LogCrit(COMPONENT_9P_DISPATCH,
+					"accept failed: %d", errno);
+			return;
+		}
 
-	if (ff_bind(sock, (struct linux_sockaddr *)&sinaddr_tcp, sizeof(sinaddr_tcp)) == -1) {
-		LogWarn(COMPONENT_9P_DISPATCH,
-			"Cannot bind 9p tcp V4 socket, error %d(%s)", errno,
-			strerror(errno));
-		goto err;
+		_9p_tcp_conn_create(fd, &peer);
 	}
+}
+
+/**
+ * @brief Check whether the workers handed back any reply
+ */
+static bool _9p_loop_replies_pending(void)
+{
+	unsigned int i;
 
-	fprintf(logfile, "ff_bind succeeded\n");
-	fflush(logfile);
+	/* A new ring may already have something */
+	if (atomic_fetch_uint32_t(&_9p_loop.rings_gen) != _9p_loop.rings_seen)
+		return true;
 
-	if (ff_listen(sock, 20) == -1) {
-		LogWarn(COMPONENT_9P_DISPATCH,
-			"Cannot bind 9p tcp V4 socket, error %d(%s)", errno,
-			strerror(errno));
-		goto err;
+	for (i = 0; i < _9p_loop.nrings; i++)
+		if (!spsc_ring_empty(&_9p_loop.ring_array[i]->ring))
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief Queue the replies the workers handed back
+ */
+static void _9p_loop_replies(void)
+{
+	struct _9p_request_data *req9p;
+	struct glist_head *node;
+	uint32_t gen = atomic_fetch_uint32_t(&_9p_loop.rings_gen);
+	unsigned int i;
+
+	/* Workers register their ring as they start */
+	if (gen != _9p_loop.rings_seen) {
+		PTHREAD_MUTEX_lock(&_9p_loop.rings_lock);
+		_9p_loop.ring_array =
+			gsh_realloc(_9p_loop.ring_array,
+				    _9p_loop.rings_count *
+					    sizeof(*_9p_loop.ring_array));
+		_9p_loop.nrings = 0;
+		glist_for_each(node, &_9p_loop.rings) {
+			_9p_loop.ring_array[_9p_loop.nrings++] = glist_entry(
+				node, struct _9p_reply_ring, list);
+		}
+		_9p_loop.rings_seen = gen;
+		PTHREAD_MUTEX_unlock(&_9p_loop.rings_lock);
 	}
-	fprintf(logfile, "ff_listen succeeded\n");
-	fflush(logfile);
 
-	return sock;
+	for (i = 0; i < _9p_loop.nrings; i++)
+		while ((req9p = spsc_ring_pop(&_9p_loop.ring_array[i]->ring)))
+			_9p_tcp_conn_reply(req9p);
+}
 
-err:
+/**
+ * @brief Free the closed connections no request holds anymore
+ */
+static void _9p_loop_reap(void)
+{
+	struct glist_head *node, *noden;
+	struct _9p_tcp_conn *tconn;
+
+	glist_for_each_safe(node, noden, &_9p_loop.closing) {
+		tconn = glist_entry(node, struct _9p_tcp_conn, list);
+
+		if (atomic_fetch_uint32_t(&tconn->conn.refcount) != 0)
+			continue;
 
-	close(sock);
-	return -1;
+		glist_del(&tconn->list);
+
+		if (delayed_submit(_9p_tcp_conn_free, tconn, 0) != 0)
+			_9p_tcp_conn_free(tconn);
+	}
 }
 
 /**
- * _9p_create_socket_V6 : create the socket and bind for 9P using
- * the available V6 interfaces on the host
+ * @brief One pass of the 9P/TCP event loop
+ *
+ * Called over and over on the dispatcher thread.  When the socket backend
+ * drives the loop itself, as F-Stack does between its own packet
+ * processing, a pass must never block; otherwise it sleeps in poll() until
+ * a socket or a worker has something.
  *
- * @return socket fd or -1 in case of failure
+ * @param[in] arg Unused
  *
+ * @return 0
  */
-static int _9p_create_socket_V6(void)
+static int _9p_loop_pass(void *arg)
 {
-	int sock = -1;
-
-	// sock = socket(P_FAMILY, SOCK_STREAM, IPPROTO_TCP);
-	if (sock == -1) {
-		// if (errno == EAFNOSUPPORT) {
-		//	LogWarn(COMPONENT_9P_DISPATCH,
-		//		"Error creating socket, V6 intfs disabled? error %d(%s)",
-		//		errno, strerror(errno));
-			return _9p_create_socket_V4();
-		//}
-
-		//return -1;
+	struct epoll_event events[_9P_LOOP_EVENTS];
+	struct _9p_tcp_conn *tconn;
+	bool may_sleep = _9p_loop.sock->wake != NULL;
+	int timeout = 0;
+	int nevents, i;
+
+	if (may_sleep) {
+		/* A worker queueing a reply after the rings were looked at
+		 * sees sleeping set, and wakes us up. */
+		atomic_store_uint32_t(&_9p_loop.sleeping, 1);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+		if (!_9p_loop_replies_pending())
+			timeout = -1;
 	}
-	return -1;
+
+	nevents = _9p_loop.sock->poll(_9p_loop.epfd, events, _9P_LOOP_EVENTS,
+				      timeout);
+
+	if (may_sleep)
+		atomic_store_uint32_t(&_9p_loop.sleeping, 0);
+
+	if (nevents < 0 && errno != EINTR)
+		LogCrit(COMPONENT_9P_DISPATCH, "epoll_wait failed: %d", errno);
+
+	for (i = 0; i < nevents; i++) {
+		tconn = events[i].data.ptr;
+
+		if (tconn == NULL) {
+			_9p_loop_accept();
+			continue;
+		}
+
+		/* Closed earlier in this pass */
+		if (tconn->closed)
+			continue;
+
+		if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+			LogEvent(COMPONENT_9P,
+				 "Client %s on socket %d has shut down and closed",
+				 tconn->strcaller, tconn->fd);
+			_9p_tcp_conn_close(tconn);
+			continue;
+		}
+
+		if ((events[i].events & EPOLLIN) && !_9p_tcp_conn_read(tconn)) {
+			_9p_tcp_conn_close(tconn);
+			continue;
+		}
+
+		if ((events[i].events & EPOLLOUT) &&
+		    !_9p_tcp_conn_write(tconn))
+			_9p_tcp_conn_close(tconn);
+	}
+
+	_9p_loop_replies();
+	_9p_loop_reap();
+
+	return 0;
 }
 
 /**
  * _9p_dispatcher_thread: thread used for RPC dispatching.
  *
- * This function is the main loop for the 9p dispatcher.
- * It never returns because it is an infinite loop.
+ * This function runs the 9P/TCP event loop.  Every connection is
+ * multiplexed on one poll set, messages are framed as they arrive and
+ * queued for the workers, and the replies the workers hand back are sent
+ * from here.  Sockets come from the backend chosen by _9P_Socket_Backend;
+ * F-Stack requires every socket call to come from the thread that
+ * initialized it, which is this one.
  *
  * @param Arg (unused)
  *
@@ -895,77 +1253,77 @@ static int _9p_create_socket_V6(void)
  */
 void *_9p_dispatcher_thread(void *Arg)
 {
-        char *ff_argv[4] = {
-                "./ganesha.nfsd",
-                "--conf=/data/f-stack/config.ini",
-                "--proc-type=primary",
-                "--proc-id=0"
-        };
-        ff_init(4, ff_argv);
-	int _9p_socket;
-	int rc = 0;
-	long newsock = -1;
-	pthread_attr_t attr_thr;
-	pthread_t tcp_thrid;
+	struct epoll_event ev;
 
 	SetNameFunction("_9p_disp");
-
-	FILE *logfile = fopen("/tmp/log.lyp", "aw");
-	fprintf(logfile, "Inside _9p_dispatcher_thread\n");
 	rcu_register_thread();
 
+	switch (_9p_param._9p_sock_backend) {
+#ifdef USE_FSTACK
+	case _9P_SOCK_FSTACK:
+		_9p_loop.sock = &_9p_sock_fstack;
+		break;
+#endif
+	case _9P_SOCK_LOOPBACK:
+		_9p_loop.sock = &_9p_sock_loopback;
+		break;
+	default:
+		_9p_loop.sock = &_9p_sock_kernel;
+		break;
+	}
+
+	if (_9p_loop.sock->init != NULL && _9p_loop.sock->init() != 0) {
+		LogFatal(COMPONENT_9P_DISPATCH,
+			 "Can't start %s sockets for 9p dispatcher",
+			 _9p_loop.sock->name);
+	}
+
 	/* Calling dispatcher main loop */
 	LogInfo(COMPONENT_9P_DISPATCH, "Entering 9P dispatcher");
 
 	LogDebug(COMPONENT_9P_DISPATCH, "My pthread id is %p",
 		 (void *)pthread_self());
 
-	/* Set up the _9p_socket (trying V6 first, will fall back to V4
-	 * if V6 fails).
-	 */
-	_9p_socket = _9p_create_socket_V6();
+	glist_init(&_9p_loop.closing);
+
+	_9p_loop.listen_fd = _9p_loop.sock->listen();
 
-	if (_9p_socket == -1) {
+	if (_9p_loop.listen_fd == -1) {
 		LogFatal(COMPONENT_9P_DISPATCH,
 			 "Can't get socket for 9p dispatcher");
 	}
 
-	fprintf(logfile, "socket fd = %d\n", _9p_socket);
-
-	/* Init for thread parameter (mostly for scheduling) */
-	PTHREAD_ATTR_init(&attr_thr);
-	PTHREAD_ATTR_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
-	PTHREAD_ATTR_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
+	_9p_loop.epfd = _9p_loop.sock->poll_create();
 
-	LogEvent(COMPONENT_9P_DISPATCH, "9P dispatcher started");
+	if (_9p_loop.epfd == -1) {
+		LogFatal(COMPONENT_9P_DISPATCH,
+			 "Can't create poll set for 9p dispatcher, error %d (%s)",
+			 errno, strerror(errno));
+	}
 
-	fprintf(logfile, "ready to accept new connection\n");
-	fflush(logfile);
+	/* The listening socket is the only one without a connection */
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
 
-	while (true) {
-		newsock = ff_accept(_9p_socket, NULL, NULL);
+	if (_9p_loop.sock->poll_ctl(_9p_loop.epfd, EPOLL_CTL_ADD,
+				    _9p_loop.listen_fd, &ev) == -1) {
+		LogFatal(COMPONENT_9P_DISPATCH,
+			 "Can't poll 9p socket, error %d (%s)", errno,
+			 strerror(errno));
+	}
 
-		if (newsock < 0) {
-			LogCrit(COMPONENT_9P_DISPATCH, "accept failed: %d",
-				errno);
-			continue;
-		}
+	LogEvent(COMPONENT_9P_DISPATCH, "9P dispatcher started on %s sockets",
+		 _9p_loop.sock->name);
 
-		fprintf(logfile, "new connection: %ld\n", newsock);
-		fflush(logfile);
-		/* Starting the thread dedicated to signal handling */
-		rc = pthread_create(&tcp_thrid, &attr_thr, _9p_socket_thread,
-				    (void *)newsock);
-		if (rc != 0) {
-			LogFatal(
-				COMPONENT_THREAD,
-				"Could not create 9p socket manager thread, error = %d (%s)",
-				errno, strerror(errno));
-		}
-	} /* while */
+	if (_9p_loop.sock->run != NULL)
+		_9p_loop.sock->run(_9p_loop_pass, NULL);
+	else
+		for (;;)
+			(void)_9p_loop_pass(NULL);
 
-	close(_9p_socket);
-	PTHREAD_ATTR_destroy(&attr_thr);
+	_9p_loop.sock->close(_9p_loop.epfd);
+	_9p_loop.sock->close(_9p_loop.listen_fd);
 
 	rcu_unregister_thread();
 	return NULL;
@@ -131,7 +131,8 @@ void _9p_rdma_process_request(struct _9p_request_data *req9p)
 	dataout->next = NULL;
 	PTHREAD_MUTEX_unlock(&priv->outqueue->oq_lock);
 
-	dataout->size = 0;
+	/* Room for the reply, replaced by its size */
+	dataout->size = dataout->max_size;
 	dataout->mr = priv->pernic->outmr;
 
 	/* Use buffer received via RDMA as a 9P message */
@@ -88,6 +88,7 @@ static void *_9p_rdma_cleanup_conn_thread(void *arg)
 				put_gsh_client(priv->pconn->client);
 
 			_9p_cleanup_fids(priv->pconn);
+			PTHREAD_MUTEX_destroy(&priv->pconn->fid_lock);
 		}
 
 		if (priv->pconn)
@@ -161,6 +162,7 @@ void *_9p_rdma_thread(void *Arg)
 		PTHREAD_MUTEX_init(&p_9p_conn->flush_buckets[i].flb_lock, NULL);
 		glist_init(&p_9p_conn->flush_buckets[i].list);
 	}
+	PTHREAD_MUTEX_init(&p_9p_conn->fid_lock, NULL);
 	p_9p_conn->sequence = 0;
 	atomic_store_uint32_t(&p_9p_conn->refcount, 0);
 	p_9p_conn->trans_type = _9P_RDMA;
@@ -175,10 +177,6 @@ void *_9p_rdma_thread(void *Arg)
 	       MIN(sizeof(*addrpeer), sizeof(p_9p_conn->addrpeer)));
 	p_9p_conn->client = get_gsh_client(&p_9p_conn->addrpeer, false);
 
-	/* Init the fids pointers array */
-	memset(&p_9p_conn->fids, 0,
-	       _9P_FID_PER_CONN * sizeof(struct _9p_fid *));
-
 	/* Set initial msize.
 	 * Client may request a lower value during TVERSION */
 	p_9p_conn->msize = _9p_param._9p_rdma_msize;
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file 9p_sock_fstack.c
+ * @brief 9P/TCP over F-Stack
+ *
+ * F-Stack requires every socket call to come from the thread that called
+ * ff_init(), and owns that thread's main loop: ff_run() polls the NIC and
+ * calls the dispatcher in between, so the dispatcher must never block.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/param.h>
+#include "log.h"
+#include "9p.h"
+#include "9p_sock.h"
+
+#include "ff_api.h"
+
+static int _9p_fstack_init(void)
+{
+	char conf[MAXPATHLEN + sizeof("--conf=")];
+	char *ff_argv[4] = { "ganesha.nfsd", conf, "--proc-type=primary",
+			     "--proc-id=0" };
+
+	(void)snprintf(conf, sizeof(conf), "--conf=%s",
+		       _9p_param._9p_fstack_config);
+
+	LogEvent(COMPONENT_9P_DISPATCH, "Starting F-Stack with %s",
+		 _9p_param._9p_fstack_config);
+
+	return ff_init(4, ff_argv);
+}
+
+/**
+ * @brief Create the listening socket on the V4 interfaces F-Stack serves
+ *
+ * @return socket fd or -1 in case of failure
+ */
+static int _9p_fstack_listen(void)
+{
+	int sock;
+	int one = 1;
+	int centvingt = 120;
+	int neuf = 9;
+	struct sockaddr_in sinaddr_tcp;
+
+	sock = ff_socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == -1) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Error creating 9p V4 socket, error %d(%s)", errno,
+			strerror(errno));
+		return -1;
+	}
+
+	if ((ff_setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one,
+			   sizeof(one)) == -1) ||
+	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one,
+			   sizeof(one)) == -1) ||
+	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &centvingt,
+			   sizeof(centvingt)) == -1) ||
+	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &centvingt,
+			   sizeof(centvingt)) == -1) ||
+	    (ff_setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &neuf,
+			   sizeof(neuf)) == -1)) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Error setting 9p V4 socket option, error %d(%s)",
+			errno, strerror(errno));
+		goto err;
+	}
+
+	ff_ioctl(sock, FIONBIO, &one);
+
+	memset(&sinaddr_tcp, 0, sizeof(sinaddr_tcp));
+	sinaddr_tcp.sin_family = AF_INET;
+
+	/* All the interfaces on the machine are used */
+	sinaddr_tcp.sin_addr.s_addr = htonl(INADDR_ANY);
+	sinaddr_tcp.sin_port = htons(_9p_param._9p_tcp_port);
+
+	if (ff_bind(sock, (struct linux_sockaddr *)&sinaddr_tcp,
+		    sizeof(sinaddr_tcp)) == -1) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Cannot bind 9p tcp V4 socket, error %d(%s)", errno,
+			strerror(errno));
+		goto err;
+	}
+
+	if (ff_listen(sock, 20) == -1) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Cannot listen on 9p tcp V4 socket, error %d(%s)",
+			errno, strerror(errno));
+		goto err;
+	}
+
+	return sock;
+
+err:
+	ff_close(sock);
+	return -1;
+}
+
+static int _9p_fstack_accept(int listen_fd, struct sockaddr_storage *peer)
+{
+	socklen_t len = sizeof(*peer);
+	int one = 1;
+	int fd;
+
+	fd = ff_accept(listen_fd, (struct linux_sockaddr *)peer, &len);
+	if (fd >= 0)
+		ff_ioctl(fd, FIONBIO, &one);
+
+	return fd;
+}
+
+static int _9p_fstack_poll_create(void)
+{
+	return ff_epoll_create(1);
+}
+
+static void _9p_fstack_run(int (*pass)(void *arg), void *arg)
+{
+	ff_run(pass, arg);
+}
+
+static ssize_t _9p_fstack_recv(int fd, void *buf, size_t len)
+{
+	return ff_read(fd, buf, len);
+}
+
+static ssize_t _9p_fstack_send(int fd, const struct iovec *iov, int iovcnt)
+{
+	return ff_writev(fd, iov, iovcnt);
+}
+
+const struct _9p_sock_ops _9p_sock_fstack = {
+	.name = "fstack",
+	.init = _9p_fstack_init,
+	.run = _9p_fstack_run,
+	.listen = _9p_fstack_listen,
+	.accept = _9p_fstack_accept,
+	.poll_create = _9p_fstack_poll_create,
+	.poll_ctl = ff_epoll_ctl,
+	.poll = ff_epoll_wait,
+	.recv = _9p_fstack_recv,
+	.send = _9p_fstack_send,
+	.close = ff_close,
+};
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file 9p_sock_kernel.c
+ * @brief 9P/TCP over kernel sockets
+ *
+ * The dispatcher sleeps in epoll_wait(), workers wake it up with an
+ * eventfd that is part of the epoll set but never reported.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include "log.h"
+#include "9p.h"
+#include "9p_sock.h"
+
+static int _9p_kernel_wake_fd = -1;
+
+/**
+ * @brief Create the listening socket for one address family
+ *
+ * @param[in] family AF_INET6 or AF_INET
+ *
+ * @return socket fd or -1 in case of failure
+ */
+static int _9p_kernel_listen_family(int family)
+{
+	int sock;
+	int one = 1;
+	int centvingt = 120;
+	int neuf = 9;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+
+	sock = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		      IPPROTO_TCP);
+	if (sock == -1)
+		return -1;
+
+	if ((setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ==
+	     -1) ||
+	    (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) ==
+	     -1) ||
+	    (setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &centvingt,
+			sizeof(centvingt)) == -1) ||
+	    (setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &centvingt,
+			sizeof(centvingt)) == -1) ||
+	    (setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &neuf, sizeof(neuf)) ==
+	     -1)) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Error setting 9p socket option, error %d(%s)", errno,
+			strerror(errno));
+		goto err;
+	}
+
+	/* All the interfaces on the machine are used */
+	memset(&addr, 0, sizeof(addr));
+	if (family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&addr;
+
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_addr = in6addr_any;
+		sin6->sin6_port = htons(_9p_param._9p_tcp_port);
+		addrlen = sizeof(*sin6);
+	} else {
+		struct sockaddr_in *sin = (struct sockaddr_in *)&addr;
+
+		sin->sin_family = AF_INET;
+		sin->sin_addr.s_addr = htonl(INADDR_ANY);
+		sin->sin_port = htons(_9p_param._9p_tcp_port);
+		addrlen = sizeof(*sin);
+	}
+
+	if (bind(sock, (struct sockaddr *)&addr, addrlen) == -1) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Cannot bind 9p tcp socket, error %d(%s)", errno,
+			strerror(errno));
+		goto err;
+	}
+
+	if (listen(sock, 20) == -1) {
+		LogWarn(COMPONENT_9P_DISPATCH,
+			"Cannot listen on 9p tcp socket, error %d(%s)", errno,
+			strerror(errno));
+		goto err;
+	}
+
+	return sock;
+
+err:
+	close(sock);
+	return -1;
+}
+
+/**
+ * @brief Create the listening socket, V6 if the host has it
+ */
+static int _9p_kernel_listen(void)
+{
+	int sock = _9p_kernel_listen_family(AF_INET6);
+
+	if (sock != -1 || errno != EAFNOSUPPORT)
+		return sock;
+
+	LogWarn(COMPONENT_9P_DISPATCH,
+		"Error creating socket, V6 intfs disabled? error %d(%s)", errno,
+		strerror(errno));
+
+	return _9p_kernel_listen_family(AF_INET);
+}
+
+static int _9p_kernel_accept(int listen_fd, struct sockaddr_storage *peer)
+{
+	socklen_t len = sizeof(*peer);
+
+	return accept4(listen_fd, (struct sockaddr *)peer, &len,
+		       SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+static int _9p_kernel_poll_create(void)
+{
+	struct epoll_event ev;
+	int epfd;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd == -1)
+		return -1;
+
+	_9p_kernel_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_9p_kernel_wake_fd == -1)
+		goto err;
+
+	/* Told apart from the sockets by its address */
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &_9p_kernel_wake_fd;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, _9p_kernel_wake_fd, &ev) == -1)
+		goto err;
+
+	return epfd;
+
+err:
+	if (_9p_kernel_wake_fd != -1) {
+		close(_9p_kernel_wake_fd);
+		_9p_kernel_wake_fd = -1;
+	}
+	close(epfd);
+	return -1;
+}
+
+static int _9p_kernel_poll_ctl(int epfd, int op, int fd,
+			       struct epoll_event *event)
+{
+	return epoll_ctl(epfd, op, fd, event);
+}
+
+static int _9p_kernel_poll(int epfd, struct epoll_event *events,
+			   int maxevents, int timeout)
+{
+	uint64_t count;
+	int nevents, i;
+
+	nevents = epoll_wait(epfd, events, maxevents, timeout);
+
+	for (i = 0; i < nevents; i++) {
+		if (events[i].data.ptr != &_9p_kernel_wake_fd)
+			continue;
+
+		(void)read(_9p_kernel_wake_fd, &count, sizeof(count));
+		events[i] = events[--nevents];
+		break;
+	}
+
+	return nevents;
+}
+
+static void _9p_kernel_wake(void)
+{
+	uint64_t one = 1;
+
+	(void)write(_9p_kernel_wake_fd, &one, sizeof(one));
+}
+
+static ssize_t _9p_kernel_recv(int fd, void *buf, size_t len)
+{
+	return recv(fd, buf, len, 0);
+}
+
+static ssize_t _9p_kernel_send(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg = { .msg_iov = (struct iovec *)iov,
+			      .msg_iovlen = iovcnt };
+
+	return sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+
+const struct _9p_sock_ops _9p_sock_kernel = {
+	.name = "kernel",
+	.listen = _9p_kernel_listen,
+	.accept = _9p_kernel_accept,
+	.poll_create = _9p_kernel_poll_create,
+	.poll_ctl = _9p_kernel_poll_ctl,
+	.poll = _9p_kernel_poll,
+	.wake = _9p_kernel_wake,
+	.recv = _9p_kernel_recv,
+	.send = _9p_kernel_send,
+	.close = close,
+};
@@ -0,0 +1,526 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file 9p_sock_loopback.c
+ * @brief In-process 9P/TCP connections
+ *
+ * A connection is a pair of byte pipes between a client thread of this
+ * process and the dispatcher, so the 9P interpreter can be measured with
+ * no network stack in the way.  There is a single lock for everything and
+ * poll() looks at every connection, which is fine for the handful of
+ * connections a benchmark opens.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/param.h>
+#include <netinet/in.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "common_utils.h"
+#include "gsh_list.h"
+#include "9p_sock.h"
+
+/* Bytes buffered each way */
+#define _9P_LOOPBACK_PIPE_SIZE (256 * 1024)
+
+#define _9P_LOOPBACK_LISTEN_FD 0
+#define _9P_LOOPBACK_EPOLL_FD 1
+/* Connections are numbered from here */
+#define _9P_LOOPBACK_FD_BASE 2
+
+struct _9p_loopback_pipe {
+	char *buf;
+	uint32_t head; /*< Next byte to read */
+	uint32_t len; /*< Bytes buffered */
+};
+
+struct _9p_loopback_conn {
+	int fd;
+	struct _9p_loopback_pipe in; /*< Client to server */
+	struct _9p_loopback_pipe out; /*< Server to client */
+	bool client_closed;
+	bool server_closed;
+	uint32_t events; /*< Watched by poll(), 0 if not */
+	epoll_data_t data;
+	pthread_cond_t cond; /*< The client waits here */
+	struct glist_head pending; /*< Connected, not yet accepted */
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /*< The dispatcher waits here */
+	bool listening;
+	bool woken;
+	uint32_t listen_events;
+	epoll_data_t listen_data;
+	struct glist_head pending;
+	/* Accepted connections, indexed by fd - _9P_LOOPBACK_FD_BASE */
+	struct _9p_loopback_conn **conns;
+	unsigned int nconns;
+} _9p_lb = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static uint32_t _9p_loopback_pipe_put(struct _9p_loopback_pipe *pipe,
+				      const char *src, size_t len)
+{
+	uint32_t n = MIN(len, _9P_LOOPBACK_PIPE_SIZE - pipe->len);
+	uint32_t tail = (pipe->head + pipe->len) % _9P_LOOPBACK_PIPE_SIZE;
+	uint32_t first = MIN(n, _9P_LOOPBACK_PIPE_SIZE - tail);
+
+	memcpy(pipe->buf + tail, src, first);
+	memcpy(pipe->buf, src + first, n - first);
+	pipe->len += n;
+
+	return n;
+}
+
+static uint32_t _9p_loopback_pipe_get(struct _9p_loopback_pipe *pipe,
+				      char *dst, size_t len)
+{
+	uint32_t n = MIN(len, pipe->len);
+	uint32_t first = MIN(n, _9P_LOOPBACK_PIPE_SIZE - pipe->head);
+
+	memcpy(dst, pipe->buf + pipe->head, first);
+	memcpy(dst + first, pipe->buf, n - first);
+	pipe->head = (pipe->head + n) % _9P_LOOPBACK_PIPE_SIZE;
+	pipe->len -= n;
+
+	return n;
+}
+
+static void _9p_loopback_conn_free(struct _9p_loopback_conn *conn)
+{
+	gsh_free(conn->in.buf);
+	gsh_free(conn->out.buf);
+	PTHREAD_COND_destroy(&conn->cond);
+	gsh_free(conn);
+}
+
+/* Called with _9p_lb.lock held */
+static struct _9p_loopback_conn *_9p_loopback_conn_get(int fd)
+{
+	unsigned int slot = fd - _9P_LOOPBACK_FD_BASE;
+
+	if (fd < _9P_LOOPBACK_FD_BASE || slot >= _9p_lb.nconns ||
+	    _9p_lb.conns[slot] == NULL) {
+		errno = EBADF;
+		return NULL;
+	}
+
+	return _9p_lb.conns[slot];
+}
+
+/* Called with _9p_lb.lock held */
+static uint32_t _9p_loopback_conn_ready(struct _9p_loopback_conn *conn)
+{
+	uint32_t events = 0;
+
+	if ((conn->events & EPOLLIN) &&
+	    (conn->in.len != 0 || conn->client_closed))
+		events |= EPOLLIN;
+
+	if ((conn->events & EPOLLOUT) &&
+	    conn->out.len < _9P_LOOPBACK_PIPE_SIZE)
+		events |= EPOLLOUT;
+
+	return events;
+}
+
+static int _9p_loopback_listen(void)
+{
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+	glist_init(&_9p_lb.pending);
+	_9p_lb.listening = true;
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+
+	LogEvent(COMPONENT_9P_DISPATCH,
+		 "9P dispatcher serving in-process connections only");
+
+	return _9P_LOOPBACK_LISTEN_FD;
+}
+
+static int _9p_loopback_accept(int listen_fd, struct sockaddr_storage *peer)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *)peer;
+	struct _9p_loopback_conn *conn;
+	unsigned int slot;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	conn = glist_first_entry(&_9p_lb.pending, struct _9p_loopback_conn,
+				 pending);
+	if (conn == NULL) {
+		PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	glist_del(&conn->pending);
+
+	for (slot = 0; slot < _9p_lb.nconns; slot++)
+		if (_9p_lb.conns[slot] == NULL)
+			break;
+
+	if (slot == _9p_lb.nconns) {
+		_9p_lb.nconns = _9p_lb.nconns ? _9p_lb.nconns * 2 : 16;
+		_9p_lb.conns = gsh_realloc(_9p_lb.conns,
+					   _9p_lb.nconns *
+						   sizeof(*_9p_lb.conns));
+		memset(_9p_lb.conns + slot, 0,
+		       (_9p_lb.nconns - slot) * sizeof(*_9p_lb.conns));
+	}
+
+	_9p_lb.conns[slot] = conn;
+	conn->fd = slot + _9P_LOOPBACK_FD_BASE;
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+
+	/* Looks like a local client, told apart by its port */
+	memset(peer, 0, sizeof(*peer));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin->sin_port = htons(conn->fd);
+
+	return conn->fd;
+}
+
+static int _9p_loopback_poll_create(void)
+{
+	return _9P_LOOPBACK_EPOLL_FD;
+}
+
+static int _9p_loopback_poll_ctl(int epfd, int op, int fd,
+				 struct epoll_event *event)
+{
+	struct _9p_loopback_conn *conn;
+	uint32_t *events;
+	epoll_data_t *data;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	if (fd == _9P_LOOPBACK_LISTEN_FD) {
+		events = &_9p_lb.listen_events;
+		data = &_9p_lb.listen_data;
+	} else {
+		conn = _9p_loopback_conn_get(fd);
+		if (conn == NULL) {
+			PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+			return -1;
+		}
+		events = &conn->events;
+		data = &conn->data;
+	}
+
+	if (op == EPOLL_CTL_DEL) {
+		*events = 0;
+	} else {
+		*events = event->events;
+		*data = event->data;
+	}
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return 0;
+}
+
+static int _9p_loopback_poll(int epfd, struct epoll_event *events,
+			     int maxevents, int timeout)
+{
+	struct _9p_loopback_conn *conn;
+	struct timespec deadline;
+	unsigned int slot;
+	int nevents;
+
+	if (timeout > 0) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		timespec_add_nsecs((nsecs_elapsed_t)timeout * NS_PER_MSEC,
+				   &deadline);
+	}
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	for (;;) {
+		nevents = 0;
+
+		if ((_9p_lb.listen_events & EPOLLIN) &&
+		    !glist_empty(&_9p_lb.pending)) {
+			events[nevents].events = EPOLLIN;
+			events[nevents++].data = _9p_lb.listen_data;
+		}
+
+		for (slot = 0; slot < _9p_lb.nconns && nevents < maxevents;
+		     slot++) {
+			conn = _9p_lb.conns[slot];
+			if (conn == NULL)
+				continue;
+
+			events[nevents].events = _9p_loopback_conn_ready(conn);
+			if (events[nevents].events != 0)
+				events[nevents++].data = conn->data;
+		}
+
+		if (nevents != 0 || timeout == 0 || _9p_lb.woken)
+			break;
+
+		if (timeout < 0)
+			PTHREAD_COND_wait(&_9p_lb.cond, &_9p_lb.lock);
+		else if (pthread_cond_timedwait(&_9p_lb.cond, &_9p_lb.lock,
+						&deadline) == ETIMEDOUT)
+			break;
+	}
+
+	_9p_lb.woken = false;
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return nevents;
+}
+
+static void _9p_loopback_wake(void)
+{
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+	_9p_lb.woken = true;
+	PTHREAD_COND_signal(&_9p_lb.cond);
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+}
+
+static ssize_t _9p_loopback_recv(int fd, void *buf, size_t len)
+{
+	struct _9p_loopback_conn *conn;
+	ssize_t n = -1;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	conn = _9p_loopback_conn_get(fd);
+	if (conn == NULL)
+		goto out;
+
+	n = _9p_loopback_pipe_get(&conn->in, buf, len);
+	if (n != 0)
+		PTHREAD_COND_signal(&conn->cond);
+	else if (!conn->client_closed) {
+		errno = EAGAIN;
+		n = -1;
+	}
+
+out:
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return n;
+}
+
+static ssize_t _9p_loopback_send(int fd, const struct iovec *iov,
+				 int iovcnt)
+{
+	struct _9p_loopback_conn *conn;
+	size_t len = 0;
+	ssize_t n = -1;
+	uint32_t put;
+	int i;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	conn = _9p_loopback_conn_get(fd);
+	if (conn == NULL)
+		goto out;
+
+	if (conn->client_closed) {
+		errno = EPIPE;
+		goto out;
+	}
+
+	for (n = 0, i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+		put = _9p_loopback_pipe_put(&conn->out, iov[i].iov_base,
+					    iov[i].iov_len);
+		n += put;
+		if (put < iov[i].iov_len)
+			break;
+	}
+
+	if (n != 0)
+		PTHREAD_COND_signal(&conn->cond);
+	else if (len != 0) {
+		errno = EAGAIN;
+		n = -1;
+	}
+
+out:
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return n;
+}
+
+static int _9p_loopback_server_close(int fd)
+{
+	struct _9p_loopback_conn *conn;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	if (fd == _9P_LOOPBACK_LISTEN_FD) {
+		_9p_lb.listening = false;
+		PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+		return 0;
+	}
+
+	if (fd == _9P_LOOPBACK_EPOLL_FD) {
+		PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+		return 0;
+	}
+
+	conn = _9p_loopback_conn_get(fd);
+	if (conn == NULL) {
+		PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+		return -1;
+	}
+
+	_9p_lb.conns[fd - _9P_LOOPBACK_FD_BASE] = NULL;
+	conn->server_closed = true;
+
+	if (conn->client_closed)
+		_9p_loopback_conn_free(conn);
+	else
+		PTHREAD_COND_signal(&conn->cond);
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return 0;
+}
+
+const struct _9p_sock_ops _9p_sock_loopback = {
+	.name = "loopback",
+	.listen = _9p_loopback_listen,
+	.accept = _9p_loopback_accept,
+	.poll_create = _9p_loopback_poll_create,
+	.poll_ctl = _9p_loopback_poll_ctl,
+	.poll = _9p_loopback_poll,
+	.wake = _9p_loopback_wake,
+	.recv = _9p_loopback_recv,
+	.send = _9p_loopback_send,
+	.close = _9p_loopback_server_close,
+};
+
+/**
+ * @brief Open an in-process connection to the 9P dispatcher
+ *
+ * @return The connection, or NULL if the dispatcher is not serving
+ *         in-process connections.
+ */
+struct _9p_loopback_conn *_9p_loopback_connect(void)
+{
+	struct _9p_loopback_conn *conn;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	if (!_9p_lb.listening) {
+		PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+		errno = ECONNREFUSED;
+		return NULL;
+	}
+
+	conn = gsh_calloc(1, sizeof(*conn));
+	conn->fd = -1;
+	conn->in.buf = gsh_malloc(_9P_LOOPBACK_PIPE_SIZE);
+	conn->out.buf = gsh_malloc(_9P_LOOPBACK_PIPE_SIZE);
+	PTHREAD_COND_init(&conn->cond, NULL);
+
+	glist_add_tail(&_9p_lb.pending, &conn->pending);
+	PTHREAD_COND_signal(&_9p_lb.cond);
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return conn;
+}
+
+/**
+ * @brief Write a whole buffer to an in-process connection
+ *
+ * @return len, or -1 if the dispatcher closed the connection.
+ */
+ssize_t _9p_loopback_write(struct _9p_loopback_conn *conn, const void *buf,
+			   size_t len)
+{
+	size_t done = 0;
+	uint32_t n;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	while (done < len) {
+		if (conn->server_closed) {
+			PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+			errno = EPIPE;
+			return -1;
+		}
+
+		n = _9p_loopback_pipe_put(&conn->in, (const char *)buf + done,
+					  len - done);
+		if (n != 0) {
+			done += n;
+			PTHREAD_COND_signal(&_9p_lb.cond);
+		} else {
+			PTHREAD_COND_wait(&conn->cond, &_9p_lb.lock);
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return len;
+}
+
+/**
+ * @brief Read what an in-process connection has, waiting for something
+ *
+ * @return Bytes read, 0 once the dispatcher closed the connection.
+ */
+ssize_t _9p_loopback_read(struct _9p_loopback_conn *conn, void *buf,
+			  size_t len)
+{
+	uint32_t n;
+
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	while (conn->out.len == 0 && !conn->server_closed)
+		PTHREAD_COND_wait(&conn->cond, &_9p_lb.lock);
+
+	n = _9p_loopback_pipe_get(&conn->out, buf, len);
+	if (n != 0)
+		PTHREAD_COND_signal(&_9p_lb.cond);
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+	return n;
+}
+
+/**
+ * @brief Close the client side of an in-process connection
+ */
+void _9p_loopback_close(struct _9p_loopback_conn *conn)
+{
+	PTHREAD_MUTEX_lock(&_9p_lb.lock);
+
+	conn->client_closed = true;
+
+	if (conn->server_closed)
+		_9p_loopback_conn_free(conn);
+	else
+		PTHREAD_COND_signal(&_9p_lb.cond);
+
+	PTHREAD_MUTEX_unlock(&_9p_lb.lock);
+}
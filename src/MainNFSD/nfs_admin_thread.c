@@ -58,6 +58,8 @@
 #endif
 #include "conf_url.h"
 #include "nfs_rpc_callback.h"
+#include "nfs_rpc_capture.h"
+#include "nfs_proto_functions.h"
 
 /**
  * @brief Mutex protecting shutdown flag.
@@ -728,6 +730,8 @@ static void do_shutdown(void)
 	LogEvent(COMPONENT_MAIN, "Shutting down RPC services");
 	(void)svc_shutdown(SVC_SHUTDOWN_FLAG_NONE);
 
+	nfs_rpc_capture_shutdown();
+
 	LogEvent(COMPONENT_MAIN, "Stopping reaper threads");
 	rc = reaper_shutdown();
 	if (rc != 0) {
@@ -754,6 +758,15 @@ static void do_shutdown(void)
 	}
 #endif
 
+	rc = nfs4_copy_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD, "Error shutting down copy threads: %d",
+			 rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Copy threads shut down.");
+	}
+
 	rc = general_fridge_shutdown();
 	if (rc != 0) {
 		LogMajor(COMPONENT_THREAD,
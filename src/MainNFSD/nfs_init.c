@@ -84,6 +84,7 @@
 #ifdef USE_MONITORING
 #include "nfs_metrics.h"
 #endif
+#include "nfs_rpc_capture.h"
 
 #include <stdio.h>
 
@@ -470,6 +471,7 @@ static void *sigmgr_thread(void *UnusedArg)
 			LogEvent(
 				COMPONENT_MAIN,
 				"SIGHUP_HANDLER: Received SIGHUP.... initiating export list reload");
+			log_reopen_files();
 			reread_config();
 		}
 	}
@@ -863,9 +865,6 @@ static void nfs_Start_threads(void)
 
 #ifdef _USE_9P
 	if (nfs_param.core_param.core_options & CORE_OPTION_9P) {
-		FILE *logfile = fopen("/tmp/log.lyp", "aw");
-		fprintf(logfile, "_9p_worker_init()\n");
-		fflush(logfile);
 		/* Start 9P worker threads */
 		rc = _9p_worker_init();
 		if (rc != 0) {
@@ -882,8 +881,6 @@ static void nfs_Start_threads(void)
 				"Could not create  9P/TCP dispatcher, error = %d (%s)",
 				errno, strerror(errno));
 		}
-		fprintf(logfile, "9P/TCP dispatcher thread was started successfully\n");
-		fflush(logfile);
 		LogEvent(COMPONENT_THREAD,
 			 "9P/TCP dispatcher thread was started successfully");
 	}
@@ -944,6 +941,14 @@ static void nfs_Start_threads(void)
 	}
 	LogEvent(COMPONENT_THREAD, "General fridge was started successfully");
 
+	/* Starting the NFSv4.2 copy threads */
+	rc = nfs4_copy_init();
+	if (rc != 0) {
+		LogFatal(COMPONENT_THREAD,
+			 "Could not create copy fridge, error = %d (%s)", rc,
+			 strerror(rc));
+	}
+
 	PTHREAD_ATTR_destroy(&attr_thr);
 }
 
@@ -1129,6 +1134,10 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Save Ganesha thread credentials with Frank's routine for later use */
 	fsal_save_ganesha_credentials();
 
+	/* Opt-in capture of the request stream, before any requests */
+	if (nfs_rpc_capture_init() != 0)
+		LogFatal(COMPONENT_INIT, "Error while starting RPC capture");
+
 	/* RPC Initialisation - exits on failure */
 	nfs_Init_svc();
 	LogInfo(COMPONENT_INIT, "RPC resources successfully initialized");
@@ -1244,9 +1253,6 @@ static void do_malloc_trim(void *param)
  */
 void nfs_start(nfs_start_info_t *p_start_info)
 {
-	FILE *logfile = fopen("/tmp/log.lyp", "aw");
-	fprintf(logfile, "inside nfs_start\n");
-	fflush(logfile);
 	/* store the start info so it is available for all layers */
 	nfs_start_info = *p_start_info;
 
@@ -1281,8 +1287,6 @@ void nfs_start(nfs_start_info_t *p_start_info)
 	/* Initialize all layers and service threads */
 	nfs_Init(p_start_info);
 	nfs_Start_threads(); /* Spawns service threads */
-	fprintf(logfile, "finish nfs_Start_threads()\n");
-	fflush(logfile);
         LogWarn(COMPONENT_THREAD, "finish nfs_Start_threads()");
 #if defined(M_TRIM_THRESHOLD)
 	(void)delayed_submit(do_malloc_trim, 0, THIRTY_MIN);
@@ -1297,8 +1301,6 @@ void nfs_start(nfs_start_info_t *p_start_info)
 	}
 #endif /* _USE_NLM */
 
-	fprintf(logfile, "NFS SERVER INITIALIZED\n");
-	fflush(logfile);
 	LogEvent(COMPONENT_INIT,
 		 "-------------------------------------------------");
 	LogEvent(COMPONENT_INIT, "             NFS SERVER INITIALIZED");
@@ -1313,8 +1315,6 @@ void nfs_start(nfs_start_info_t *p_start_info)
 	LogDebug(COMPONENT_THREAD, "Wait for admin thread to exit");
 	pthread_join(admin_thrid, NULL);
 
-	fprintf(logfile, "joined admin thread\n");
-	fflush(logfile);
 	/* Regular exit */
 	LogEvent(COMPONENT_MAIN, "NFS EXIT: regular exit");
 
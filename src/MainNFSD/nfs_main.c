@@ -59,8 +59,6 @@
 #endif
 #endif
 
-#include "ff_api.h"
-
 /* parameters for NFSd startup and default values */
 
 static nfs_start_info_t my_nfs_start_info = { .dump_default_config = false,
@@ -175,16 +173,6 @@ static void load_lttng(void)
 
 int main(int argc, char *argv[])
 {
-	/*
-	char *ff_argv[4] = {
-		"./ganesha.nfsd",
-		"--conf=/data/f-stack/config.ini",
-		"--proc-type=primary",
-		"--proc-id=0"
-	};
-	ff_init(4, ff_argv);
-	*/
-	fprintf(stderr, "Officially start nfs...\n");
 	char *tempo_exec_name = NULL;
 	char localmachine[MAXHOSTNAMELEN + 1];
 	int c;
@@ -204,8 +192,6 @@ int main(int argc, char *argv[])
 	sigset_t signals_to_block;
 	struct config_error_type err_type;
 
-	FILE *logfile = fopen("/tmp/log.lyp", "w");
-
 	/* Set the server's boot time and epoch */
 	now(&nfs_ServerBootTime);
 	nfs_ServerEpoch = (time_t)nfs_ServerBootTime.tv_sec;
@@ -229,7 +215,6 @@ int main(int argc, char *argv[])
 	optind = 1;
 	/* now parsing options with getopt */
 	while ((c = getopt(argc, argv, options)) != EOF) {
-		fprintf(logfile, "c=%c\n", c);
 		switch (c) {
 		case 'v':
 		case '@':
@@ -248,8 +233,6 @@ int main(int argc, char *argv[])
 		case 'L':
 			/* Default Log */
 			log_path = main_strdup("log_path", optarg);
-			fprintf(logfile, "log_path=%s\n", log_path);
-			fflush(logfile);
 			break;
 #ifdef USE_LTTNG
 		case 'G':
@@ -340,9 +323,6 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	fprintf(logfile, "Finish parsing arguments\n");
-	fflush(logfile);
-
 	/* initialize memory and logging */
 	nfs_prereq_init(exec_name, nfs_host_name, debug_level, log_path,
 			dump_trace, stack_size);
@@ -357,14 +337,11 @@ int main(int argc, char *argv[])
 
 	/* initialize nfs_init */
 	nfs_init_init();
-        fprintf(logfile, "Finish nfs init init\n");
-	fflush(logfile);
 	nfs_check_malloc();
 
 	/* Start in background, if wanted */
 	if (detach_flag) {
 #ifdef HAVE_DAEMON
-		fprintf(logfile, "HAVE_DAEMON\n");
 		/* daemonize the process (fork, close xterm fds,
 		 * detach from parent process) */
 		if (daemon(0, 0))
@@ -463,9 +440,6 @@ int main(int argc, char *argv[])
 	/* multiple instances from starting, so any failure creating   */
 	/* this file is a fatal error.                                 */
 	pidfile = open(nfs_pidfile_path, O_CREAT | O_RDWR, 0644);
-	fprintf(logfile, "just opened pidfile\n");
-	fprintf(logfile, "pid = %d", getpid());
-	fflush(logfile);
 
 	if (pidfile == -1) {
 		LogFatal(
@@ -508,9 +482,6 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	fprintf(logfile, "finish pidfile\n");
-	fflush(logfile);
-
 	/* Set up for the signal handler.
 	 * Blocks the signals the signal handler will handle.
 	 */
@@ -540,9 +511,6 @@ int main(int argc, char *argv[])
 		nfs_config_struct =
 			config_ParseFile(nfs_config_path, &err_type);
 
-	fprintf(logfile, "Finish parsing nfs config\n");
-	fflush(logfile);
-
 	if (!config_error_no_error(&err_type)) {
 		char *errstr = err_type_str(&err_type);
 
@@ -668,8 +636,6 @@ int main(int argc, char *argv[])
 
 	config_Free(nfs_config_struct);
 
-	fprintf(logfile, "Just about to nfs_start\n");
-	fflush(logfile);
 	/* Everything seems to be OK! We can now start service threads */
 	nfs_start(&my_nfs_start_info);
 
@@ -169,6 +169,16 @@ static histogram_metric_handle_t compound_latency_metric[NFSSTAT4_INDEX_LAST];
 /* NFS operations per Compound procedure metric */
 static histogram_metric_handle_t compound_ops_count_metric;
 
+/* Duplicate request cache metrics */
+static histogram_metric_handle_t drc_hit_latency;
+static histogram_metric_handle_t drc_insert_latency;
+static histogram_metric_handle_t drc_retire_latency;
+static counter_metric_handle_t drc_retired_total;
+
+/* Pre-resolved dynamic request metrics, by protocol operation */
+static dynamic_op_metric_handle_t nfsv3_dynamic_ops[NFS_V3_NB_COMMAND];
+static dynamic_op_metric_handle_t nfsv4_dynamic_ops[NFS4_OP_LAST_ONE];
+
 static enum nfsstat4_index nfsstat4_to_index(nfsstat4 stat)
 {
 	switch (stat) {
@@ -301,30 +311,84 @@ void nfs_metrics__rpcs_in_flight(int64_t value)
 	monitoring__gauge_set(rpcs_inflight, value);
 }
 
+static histogram_metric_handle_t register_drc_latency(const char *op)
+{
+	const metric_label_t labels[] = { METRIC_LABEL("op", op) };
+
+	return monitoring__register_histogram(
+		"drc__latency",
+		METRIC_METADATA("Duplicate Request Cache Latency",
+				METRIC_UNIT_MICROSECOND),
+		labels, ARRAY_SIZE(labels), monitoring__buckets_exp2());
+}
+
+static void register_drc_metrics(void)
+{
+	const metric_label_t empty_labels[] = {};
+
+	drc_hit_latency = register_drc_latency("hit");
+	drc_insert_latency = register_drc_latency("insert");
+	drc_retire_latency = register_drc_latency("retire");
+	drc_retired_total = monitoring__register_counter(
+		"drc__retired_total",
+		METRIC_METADATA("Number of retired Duplicate Request Cache entries",
+				METRIC_UNIT_NONE),
+		empty_labels, ARRAY_SIZE(empty_labels));
+}
+
+void nfs_metrics__drc_hit(nsecs_elapsed_t latency)
+{
+	monitoring__histogram_observe(drc_hit_latency, latency / NS_PER_USEC);
+}
+
+void nfs_metrics__drc_insert(nsecs_elapsed_t latency)
+{
+	monitoring__histogram_observe(drc_insert_latency,
+				      latency / NS_PER_USEC);
+}
+
+void nfs_metrics__drc_retire(nsecs_elapsed_t latency, int num_retired)
+{
+	monitoring__histogram_observe(drc_retire_latency,
+				      latency / NS_PER_USEC);
+	monitoring__counter_inc(drc_retired_total, num_retired);
+}
+
+static void register_dynamic_request_metrics(void)
+{
+	for (uint32_t proc = 0; proc < NFS_V3_NB_COMMAND; proc++)
+		nfsv3_dynamic_ops[proc] = monitoring__dynamic_register_nfs_op(
+			"nfs3", nfsproc3_to_str(proc));
+
+	for (nfs_opnum4 op = 0; op < NFS4_OP_LAST_ONE; op++)
+		nfsv4_dynamic_ops[op] = monitoring__dynamic_register_nfs_op(
+			"nfs4", nfsop4_to_str(op));
+}
+
 void nfs_metrics__nfs3_request(uint32_t proc, nsecs_elapsed_t request_time,
 			       nfsstat3 nfs_status, export_id_t export_id,
-			       const char *client_ip)
+			       dynamic_client_metric_handle_t client)
 {
-	const char *const version = "nfs3";
-	const char *const operation = nfsproc3_to_str(proc);
-	const char *const statusLabel = nfsstat3_to_str(nfs_status);
+	if (proc >= NFS_V3_NB_COMMAND)
+		return;
 
-	monitoring__dynamic_observe_nfs_request(operation, request_time,
-						version, statusLabel, export_id,
-						client_ip);
+	monitoring__dynamic_observe_nfs_request(nfsv3_dynamic_ops[proc],
+						request_time, nfs_status,
+						nfsstat3_to_str(nfs_status),
+						export_id, client);
 }
 
 void nfs_metrics__nfs4_request(uint32_t op, nsecs_elapsed_t request_time,
 			       nfsstat4 status, export_id_t export_id,
-			       const char *client_ip)
+			       dynamic_client_metric_handle_t client)
 {
-	const char *const version = "nfs4";
-	const char *const operation = nfsop4_to_str(op);
-	const char *const statusLabel = nfsstat4_to_str(status);
+	if (op >= NFS4_OP_LAST_ONE)
+		return;
 
-	monitoring__dynamic_observe_nfs_request(operation, request_time,
-						version, statusLabel, export_id,
-						client_ip);
+	monitoring__dynamic_observe_nfs_request(nfsv4_dynamic_ops[op],
+						request_time, status,
+						nfsstat4_to_str(status),
+						export_id, client);
 }
 
 void nfs_metrics__init(void)
@@ -332,4 +396,6 @@ void nfs_metrics__init(void)
 	register_rpcs_metrics();
 	register_nfsv4_operations_metrics();
 	register_compound_operation_metrics();
+	register_drc_metrics();
+	register_dynamic_request_metrics();
 }
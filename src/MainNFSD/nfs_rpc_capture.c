@@ -0,0 +1,438 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs_rpc_capture.c
+ * @brief Capture of the RPC request stream to a ring file
+ *
+ * Worker threads reserve space in the ring with a compare and swap on the
+ * header's head and copy their record in, so capturing takes no lock.  The
+ * kernel writes the mapping back to the file in its own time.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "log.h"
+#include "abstract_atomic.h"
+#include "common_utils.h"
+#include "nfs_core.h"
+#include "nfs_proto_functions.h"
+#include "nfs_rpc_capture.h"
+
+bool nfs_rpc_capture_enabled;
+
+static struct {
+	int fd;
+	size_t map_size;
+	struct rpc_capture_hdr *hdr;
+	char *ring;
+	uint64_t size;
+	struct timespec start;
+	bool elide_payload;
+} capture;
+
+#define RPC_CAPTURE_ALIGN(len) (((len) + 7) & ~7UL)
+
+/**
+ * @brief Map the capture file and start capturing
+ *
+ * Does nothing unless RPC_Capture_File is set.  Any previous capture in the
+ * file is discarded.
+ *
+ * @return 0 on success, errno otherwise.
+ */
+
+int nfs_rpc_capture_init(void)
+{
+	const char *path = nfs_param.core_param.rpc_capture_file;
+	uint64_t size = nfs_param.core_param.rpc_capture_size & ~4095ULL;
+	int rc;
+
+	if (path == NULL)
+		return 0;
+
+	capture.fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+	if (capture.fd < 0) {
+		rc = errno;
+		LogCrit(COMPONENT_DISPATCH, "Could not open RPC capture %s: %s",
+			path, strerror(rc));
+		return rc;
+	}
+
+	capture.map_size = RPC_CAPTURE_HDR_SIZE + size;
+
+	if (ftruncate(capture.fd, capture.map_size) < 0) {
+		rc = errno;
+		LogCrit(COMPONENT_DISPATCH, "Could not size RPC capture %s: %s",
+			path, strerror(rc));
+		goto err_close;
+	}
+
+	capture.hdr = mmap(NULL, capture.map_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED, capture.fd, 0);
+
+	if (capture.hdr == MAP_FAILED) {
+		rc = errno;
+		LogCrit(COMPONENT_DISPATCH, "Could not map RPC capture %s: %s",
+			path, strerror(rc));
+		goto err_close;
+	}
+
+	capture.ring = (char *)capture.hdr + RPC_CAPTURE_HDR_SIZE;
+	capture.size = size;
+	capture.elide_payload = nfs_param.core_param.rpc_capture_elide_payload;
+	now(&capture.start);
+
+	capture.hdr->version = RPC_CAPTURE_VERSION;
+	capture.hdr->data_size = size;
+	capture.hdr->head = 0;
+	capture.hdr->start_sec = capture.start.tv_sec;
+	capture.hdr->start_nsec = capture.start.tv_nsec;
+	capture.hdr->flags = capture.elide_payload ? RPC_CAPTURE_FLAG_ELIDED
+						   : 0;
+	atomic_store_uint32_t(&capture.hdr->magic, RPC_CAPTURE_MAGIC);
+
+	nfs_rpc_capture_enabled = true;
+
+	LogEvent(COMPONENT_DISPATCH,
+		 "Capturing RPC requests to %s, %" PRIu64 " byte ring%s", path,
+		 size, capture.elide_payload ? ", payload elided" : "");
+
+	return 0;
+
+err_close:
+	close(capture.fd);
+	return rc;
+}
+
+/**
+ * @brief Stop capturing and flush the ring to the file
+ *
+ * Called once no more requests are being processed.
+ */
+
+void nfs_rpc_capture_shutdown(void)
+{
+	if (!nfs_rpc_capture_enabled)
+		return;
+
+	nfs_rpc_capture_enabled = false;
+
+	(void)msync(capture.hdr, capture.map_size, MS_SYNC);
+	(void)munmap(capture.hdr, capture.map_size);
+	close(capture.fd);
+}
+
+/**
+ * @brief Reserve space for a record in the ring
+ *
+ * @param[in]  len	Record length, a multiple of 8
+ * @param[out] offset	Value of head at the start of the record
+ *
+ * @return Where to write the record.
+ */
+
+static struct rpc_capture_rec *rpc_capture_reserve(uint32_t len,
+						   uint64_t *offset)
+{
+	uint64_t head = atomic_fetch_uint64_t(&capture.hdr->head);
+	uint64_t pos, skip;
+
+	do {
+		pos = head % capture.size;
+		/* Records never wrap, skip the tail of the ring instead */
+		skip = pos + len > capture.size ? capture.size - pos : 0;
+	} while (!__atomic_compare_exchange_n(&capture.hdr->head, &head,
+					      head + skip + len, false,
+					      __ATOMIC_ACQ_REL,
+					      __ATOMIC_ACQUIRE));
+
+	*offset = head + skip;
+
+	return (struct rpc_capture_rec *)(capture.ring +
+					  (*offset % capture.size));
+}
+
+/**
+ * @brief Append a NUL terminated name to a record's payload
+ *
+ * Names are positional, so once one does not fit no more are added.
+ */
+
+static void rpc_capture_name(struct rpc_capture_rec *rec, char *payload,
+			     const char *name, u_int name_len)
+{
+	if (rec->flags & RPC_CAPTURE_REC_TRUNCATED)
+		return;
+
+	if (rec->payload_len + name_len + 1 > RPC_CAPTURE_PAYLOAD_MAX) {
+		rec->flags |= RPC_CAPTURE_REC_TRUNCATED;
+		return;
+	}
+
+	if (name_len != 0)
+		memcpy(payload + rec->payload_len, name, name_len);
+	payload[rec->payload_len + name_len] = '\0';
+	rec->payload_len += name_len + 1;
+}
+
+static void rpc_capture_fh(struct rpc_capture_rec *rec, const char *fh,
+			   u_int fh_len)
+{
+	if (rec->fh_len != 0 || fh_len > RPC_CAPTURE_FH_MAX)
+		return;
+
+	memcpy(rec->fh, fh, fh_len);
+	rec->fh_len = fh_len;
+}
+
+static void rpc_capture_nfs4(struct rpc_capture_rec *rec, char *payload,
+			     nfs_request_t *reqdata)
+{
+	COMPOUND4args *args = &reqdata->arg_nfs.arg_compound4;
+	nfs_fh4 *fh;
+	bool io_seen = false;
+	u_int i;
+
+	rec->minorversion = args->minorversion;
+
+	if (reqdata->res_nfs != NULL &&
+	    reqdata->res_nfs->res_compound4_extended != NULL)
+		rec->status = reqdata->res_nfs->res_compound4_extended
+				      ->res_compound4.status;
+
+	for (i = 0; i < args->argarray.argarray_len; i++) {
+		nfs_argop4 *op = &args->argarray.argarray_val[i];
+
+		if (i < RPC_CAPTURE_MAX_OPS)
+			rec->ops[rec->nops++] = op->argop;
+
+		switch (op->argop) {
+		case NFS4_OP_PUTFH:
+			fh = &op->nfs_argop4_u.opputfh.object;
+			rpc_capture_fh(rec, fh->nfs_fh4_val, fh->nfs_fh4_len);
+			break;
+
+		case NFS4_OP_READ:
+			if (io_seen)
+				break;
+			io_seen = true;
+			rec->io_offset = op->nfs_argop4_u.opread.offset;
+			rec->io_count = op->nfs_argop4_u.opread.count;
+			break;
+
+		case NFS4_OP_WRITE:
+			if (io_seen)
+				break;
+			io_seen = true;
+			rec->io_offset = op->nfs_argop4_u.opwrite.offset;
+			rec->io_count = op->nfs_argop4_u.opwrite.data.data_len;
+			break;
+
+		default:
+			break;
+		}
+
+		if (capture.elide_payload)
+			continue;
+
+		switch (op->argop) {
+		case NFS4_OP_LOOKUP:
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.oplookup.objname.utf8string_val,
+				op->nfs_argop4_u.oplookup.objname.utf8string_len);
+			break;
+
+		case NFS4_OP_REMOVE:
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.opremove.target.utf8string_val,
+				op->nfs_argop4_u.opremove.target.utf8string_len);
+			break;
+
+		case NFS4_OP_RENAME:
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.oprename.oldname.utf8string_val,
+				op->nfs_argop4_u.oprename.oldname.utf8string_len);
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.oprename.newname.utf8string_val,
+				op->nfs_argop4_u.oprename.newname.utf8string_len);
+			break;
+
+		case NFS4_OP_LINK:
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.oplink.newname.utf8string_val,
+				op->nfs_argop4_u.oplink.newname.utf8string_len);
+			break;
+
+		case NFS4_OP_CREATE:
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.opcreate.objname.utf8string_val,
+				op->nfs_argop4_u.opcreate.objname.utf8string_len);
+			break;
+
+		case NFS4_OP_OPEN:
+			if (op->nfs_argop4_u.opopen.claim.claim != CLAIM_NULL)
+				break;
+			rpc_capture_name(rec, payload,
+					 op->nfs_argop4_u.opopen.claim
+						 .open_claim4_u.file
+						 .utf8string_val,
+					 op->nfs_argop4_u.opopen.claim
+						 .open_claim4_u.file
+						 .utf8string_len);
+			break;
+
+		case NFS4_OP_SECINFO:
+			rpc_capture_name(
+				rec, payload,
+				op->nfs_argop4_u.opsecinfo.name.utf8string_val,
+				op->nfs_argop4_u.opsecinfo.name.utf8string_len);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+#ifdef _USE_NFS3
+static void rpc_capture_nfs3(struct rpc_capture_rec *rec, char *payload,
+			     nfs_request_t *reqdata)
+{
+	nfs_arg_t *arg = &reqdata->arg_nfs;
+	nfs_fh3 *fh;
+
+	if (rec->proc == NFSPROC3_NULL)
+		return;
+
+	/* Every NFSv3 call other than NULL starts with the file handle it
+	 * operates on, and every reply with its status.
+	 */
+	fh = (nfs_fh3 *)arg;
+	rpc_capture_fh(rec, fh->data.data_val, fh->data.data_len);
+	if (reqdata->res_nfs != NULL)
+		rec->status = reqdata->res_nfs->res_getattr3.status;
+
+	switch (rec->proc) {
+	case NFSPROC3_READ:
+		rec->io_offset = arg->arg_read3.offset;
+		rec->io_count = arg->arg_read3.count;
+		break;
+
+	case NFSPROC3_WRITE:
+		rec->io_offset = arg->arg_write3.offset;
+		rec->io_count = arg->arg_write3.count;
+		break;
+
+	case NFSPROC3_LOOKUP:
+		if (!capture.elide_payload && arg->arg_lookup3.what.name)
+			rpc_capture_name(rec, payload,
+					 arg->arg_lookup3.what.name,
+					 strlen(arg->arg_lookup3.what.name));
+		break;
+
+	default:
+		break;
+	}
+}
+#endif /* _USE_NFS3 */
+
+/**
+ * @brief Capture a completed request
+ *
+ * Called with the request's op context still set up, before the arguments
+ * are freed.
+ *
+ * @param[in] reqdata	The request
+ */
+
+void nfs_rpc_capture(nfs_request_t *reqdata)
+{
+	struct rpc_capture_rec rec, *dst;
+	char payload[RPC_CAPTURE_PAYLOAD_MAX];
+	sockaddr_t *caller;
+	struct timespec done;
+	uint64_t offset;
+	uint32_t len;
+
+	if (op_ctx == NULL)
+		return;
+
+	now(&done);
+	caller = op_ctx->caller_addr;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.time_ns = timespec_diff(&capture.start, &op_ctx->start_time);
+	rec.latency_ns = timespec_diff(&op_ctx->start_time, &done);
+	rec.xid = reqdata->svc.rq_msg.rm_xid;
+	rec.prog = reqdata->svc.rq_msg.cb_prog;
+	rec.vers = reqdata->svc.rq_msg.cb_vers;
+	rec.proc = reqdata->svc.rq_msg.cb_proc;
+
+	if (caller != NULL && caller->ss_family == AF_INET) {
+		struct sockaddr_in *sin = (struct sockaddr_in *)caller;
+
+		rec.family = AF_INET;
+		rec.port = ntohs(sin->sin_port);
+		memcpy(rec.addr, &sin->sin_addr, sizeof(sin->sin_addr));
+	} else if (caller != NULL && caller->ss_family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)caller;
+
+		rec.family = AF_INET6;
+		rec.port = ntohs(sin6->sin6_port);
+		memcpy(rec.addr, &sin6->sin6_addr, sizeof(sin6->sin6_addr));
+	}
+
+	if (rec.prog == nfs_param.core_param.program[P_NFS]) {
+		if (rec.vers == NFS_V4 && rec.proc == NFSPROC4_COMPOUND)
+			rpc_capture_nfs4(&rec, payload, reqdata);
+#ifdef _USE_NFS3
+		else if (rec.vers == NFS_V3)
+			rpc_capture_nfs3(&rec, payload, reqdata);
+#endif
+	}
+
+	len = RPC_CAPTURE_ALIGN(sizeof(rec) + rec.payload_len);
+	rec.len = len;
+
+	dst = rpc_capture_reserve(len, &offset);
+	rec.offset = offset;
+
+	/* Invalidate whatever was there before filling the record in */
+	atomic_store_uint32_t(&dst->magic, 0);
+	memcpy((char *)dst + sizeof(dst->magic),
+	       (char *)&rec + sizeof(rec.magic),
+	       sizeof(rec) - sizeof(rec.magic));
+	memcpy(dst + 1, payload, rec.payload_len);
+	atomic_store_uint32_t(&dst->magic, RPC_CAPTURE_REC_MAGIC);
+}
@@ -61,6 +61,7 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "nfs_rpc_capture.h"
 
 #include "gsh_lttng/gsh_lttng.h"
 #if defined(USE_LTTNG) && !defined(LTTNG_PARSING)
@@ -734,6 +735,9 @@ void complete_request_instrumentation(nfs_request_t *reqdata)
 {
 	GSH_AUTO_TRACEPOINT(nfs_rpc, op_end, TRACE_INFO, "Op end. request: {}",
 			    reqdata);
+
+	if (unlikely(nfs_rpc_capture_enabled))
+		nfs_rpc_capture(reqdata);
 }
 
 /** @brief Completion of async RPC dispatch
@@ -79,7 +79,7 @@ int _9p_attach(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 		(u32)*msgtag, *fid, *afid, (int)*uname_len, uname_str,
 		(int)*aname_len, aname_str, *n_uname);
 
-	if (*fid >= _9P_FID_PER_CONN) {
+	if (*fid >= _9P_FID_MAX) {
 		err = ERANGE;
 		goto errout;
 	}
@@ -151,7 +151,9 @@ int _9p_attach(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	get_gsh_export_ref(pfid->fid_export);
 
 	pfid->fid = *fid;
-	req9p->pconn->fids[*fid] = pfid;
+	err = _9p_setfid(req9p->pconn, *fid, pfid);
+	if (err != 0)
+		goto errout;
 
 	/* Is user name provided as a string or as an uid ? */
 	if (*n_uname != _9P_NONUNAME) {
@@ -43,8 +43,6 @@
 #include "nfs_file_handle.h"
 #include "server_stats.h"
 
-#include "ff_api.h"
-
 /* opcode to function array */
 const struct _9p_function_desc _9pfuncdesc[] = {
 	[0] = { _9p_not_2000L, "no function" }, /* out of bounds */
@@ -106,42 +104,60 @@ int _9p_not_2000L(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	return -1;
 } /* _9p_not_2000L */
 
-static ssize_t tcp_conn_send(struct _9p_conn *conn, const void *buf, size_t len,
-			     int flags)
+/**
+ * @brief Room needed for the reply to a 9P/TCP request
+ *
+ * Rread data is sent from its own buffer, so only Rreaddir may need as much
+ * as msize.  Rversion echoes the version string of the Tversion, so it gets
+ * as much room as the request.  See _9P_REPLY_ROOM for the others.
+ *
+ * @param[in] req9p 9p request
+ *
+ * @return Size of the reply buffer to allocate.
+ */
+static u32 _9p_tcp_reply_room(struct _9p_request_data *req9p)
 {
-	ssize_t ret;
-
-	PTHREAD_MUTEX_lock(&conn->sock_lock);
-	ret = ff_send(conn->trans_data.sockfd, buf, len, flags);
-	PTHREAD_MUTEX_unlock(&conn->sock_lock);
+	u32 msglen = *(u32 *)req9p->_9pmsg;
+	u8 msgtype = *(u8 *)(req9p->_9pmsg + _9P_HDR_SIZE);
+	u32 room = _9P_REPLY_ROOM;
+	u32 count;
+
+	if (msgtype == _9P_TVERSION)
+		room = MAX(room, msglen);
+
+	/* size[4] Treaddir tag[2] fid[4] offset[8] count[4] */
+	if (msgtype == _9P_TREADDIR &&
+	    msglen >= _9P_STD_HDR_SIZE + 4 + 8 + sizeof(u32)) {
+		count = *(u32 *)(req9p->_9pmsg + _9P_STD_HDR_SIZE + 4 + 8);
+		count = MIN(count, req9p->pconn->msize);
+		room = MAX(room, count + _9P_ROOM_RREADDIR);
+	}
 
-	if (ret < 0)
-		server_stats_transport_done(conn->client, 0, 0, 0, 0, 0, 1);
-	else
-		server_stats_transport_done(conn->client, 0, 0, 0, ret, 1, 0);
-	return ret;
+	return room;
 }
 
 void _9p_tcp_process_request(struct _9p_request_data *req9p)
 {
-	u32 outdatalen = 0;
+	u32 outdatalen;
 	int rc = 0;
-	char replydata[_9P_MSG_SIZE];
 
-	rc = _9p_process_buffer(req9p, replydata, &outdatalen);
+	/* Replies are far smaller than msize but for Rreaddir, size them
+	 * from the request rather than sending each through a buffer as big
+	 * as the largest message.
+	 */
+	outdatalen = _9p_tcp_reply_room(req9p);
+	req9p->_9preply_buf = io_buf_get(outdatalen);
+	req9p->_9preply = req9p->_9preply_buf->ib_base;
+
+	rc = _9p_process_buffer(req9p, req9p->_9preply, &outdatalen);
 	if (rc != 1) {
 		LogMajor(COMPONENT_9P,
 			 "Could not process 9P buffer on socket #%lu",
 			 req9p->pconn->trans_data.sockfd);
-	} else {
-		if (tcp_conn_send(req9p->pconn, replydata, outdatalen, 0) !=
-		    outdatalen)
-			LogMajor(
-				COMPONENT_9P,
-				"Could not send 9P/TCP reply correctly on socket #%lu",
-				req9p->pconn->trans_data.sockfd);
+		outdatalen = 0;
 	}
-	_9p_DiscardFlushHook(req9p);
+	/* The dispatcher sends the reply and discards the flush hook */
+	req9p->_9preplylen = outdatalen;
 } /* _9p_process_request */
 
 int _9p_process_buffer(struct _9p_request_data *req9p, char *replydata,
@@ -170,11 +186,11 @@ int _9p_process_buffer(struct _9p_request_data *req9p, char *replydata,
 	LogFullDebug(COMPONENT_9P, "9P msg: length=%u type (%u|%s)", msglen,
 		     (u32)msgtype, _9pfuncdesc[msgtype].funcname);
 
-	/* Temporarily set outlen to maximum message size. This value will be
+	/* On entry, outlen is the room in replydata. This value will be
 	 * used inside the protocol functions for additional bound checking,
 	 * and then replaced by the actual message size, (see _9p_checkbound())
 	 */
-	*poutlen = req9p->pconn->msize;
+	*poutlen = MIN(*poutlen, req9p->pconn->msize);
 
 	/* Call the 9P service function */
 	rc = _9pfuncdesc[msgtype].service_function(req9p, poutlen, replydata);
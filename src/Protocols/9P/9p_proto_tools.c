@@ -44,6 +44,7 @@
 #include "log.h"
 #include "fsal.h"
 #include "9p.h"
+#include "abstract_atomic.h"
 #include "idmapper.h"
 #include "uid2grp.h"
 #include "export_mgr.h"
@@ -414,25 +415,177 @@ int _9p_tools_clunk(struct _9p_fid *pfid)
 	return 0;
 }
 
-void _9p_cleanup_fids(struct _9p_conn *conn)
+/* Slot of a fid in its node at a level of the fid table */
+static inline unsigned int _9p_fid_index(u32 fid, int level)
+{
+	return (fid >> (_9P_FID_NODE_SHIFT * (_9P_FID_LEVELS - 1 - level))) &
+	       (_9P_FID_NODE_SIZE - 1);
+}
+
+static void _9p_fid_node_free(struct rcu_head *head)
+{
+	gsh_free(container_of(head, struct _9p_fid_node, rcu));
+}
+
+/**
+ * @brief Look a fid up
+ *
+ * This takes no lock: nodes removed from the table by _9p_setfid() are
+ * only freed once no lookup can still be walking them.
+ *
+ * @param[in] conn The connection
+ * @param[in] fid  The fid
+ *
+ * @return The fid, NULL if it is not in use.
+ */
+struct _9p_fid *_9p_getfid(struct _9p_conn *conn, u32 fid)
+{
+	struct _9p_fid_node *node;
+	struct _9p_fid *pfid = NULL;
+	int level;
+
+	if (fid >= _9P_FID_MAX)
+		return NULL;
+
+	rcu_read_lock();
+
+	node = rcu_dereference(conn->fids);
+	for (level = 0; node != NULL && level < _9P_FID_LEVELS - 1; level++)
+		node = rcu_dereference(node->slots[_9p_fid_index(fid, level)]);
+
+	if (node != NULL)
+		pfid = rcu_dereference(
+			node->slots[_9p_fid_index(fid, _9P_FID_LEVELS - 1)]);
+
+	rcu_read_unlock();
+
+	return pfid;
+}
+
+/**
+ * @brief Set or clear a fid
+ *
+ * Setting a fid adds the nodes missing on its way, clearing the last fid
+ * of a node removes it and the parents it leaves empty.
+ *
+ * @param[in] conn The connection
+ * @param[in] fid  The fid
+ * @param[in] pfid What it now refers to, NULL to clear it
+ *
+ * @return 0, ERANGE if fid is too large or EMFILE if the connection
+ *         already has all the nodes it may use.
+ */
+int _9p_setfid(struct _9p_conn *conn, u32 fid, struct _9p_fid *pfid)
+{
+	/* Where each level's node hangs */
+	void **path[_9P_FID_LEVELS];
+	struct _9p_fid_node *node;
+	void **slot;
+	int level, rc = 0;
+
+	if (fid >= _9P_FID_MAX)
+		return ERANGE;
+
+	PTHREAD_MUTEX_lock(&conn->fid_lock);
+
+	path[0] = (void **)&conn->fids;
+	for (level = 0; level < _9P_FID_LEVELS; level++) {
+		node = *path[level];
+		if (node == NULL)
+			break;
+		if (level < _9P_FID_LEVELS - 1)
+			path[level + 1] = &node->slots[_9p_fid_index(fid, level)];
+	}
+
+	if (level < _9P_FID_LEVELS) {
+		/* Nothing to clear */
+		if (pfid == NULL)
+			goto out;
+
+		if (conn->fid_nodes + _9P_FID_LEVELS - level >
+		    _9P_FID_NODES_MAX) {
+			rc = EMFILE;
+			goto out;
+		}
+
+		for (; level < _9P_FID_LEVELS; level++) {
+			node = gsh_calloc(1, sizeof(*node));
+			conn->fid_nodes++;
+			if (level > 0)
+				((struct _9p_fid_node *)*path[level - 1])->used++;
+			rcu_set_pointer(path[level], node);
+			if (level < _9P_FID_LEVELS - 1)
+				path[level + 1] =
+					&node->slots[_9p_fid_index(fid, level)];
+		}
+	}
+
+	node = *path[_9P_FID_LEVELS - 1];
+	slot = &node->slots[_9p_fid_index(fid, _9P_FID_LEVELS - 1)];
+
+	if (*slot == NULL && pfid != NULL)
+		node->used++;
+	else if (*slot != NULL && pfid == NULL)
+		node->used--;
+
+	rcu_set_pointer(slot, pfid);
+
+	/* Drop the nodes this left empty, leaf first */
+	for (level = _9P_FID_LEVELS - 1; level >= 0; level--) {
+		node = *path[level];
+		if (node->used != 0)
+			break;
+
+		rcu_set_pointer(path[level], NULL);
+		call_rcu(&node->rcu, _9p_fid_node_free);
+		conn->fid_nodes--;
+		if (level > 0)
+			((struct _9p_fid_node *)*path[level - 1])->used--;
+	}
+
+out:
+	PTHREAD_MUTEX_unlock(&conn->fid_lock);
+
+	return rc;
+}
+
+static void _9p_cleanup_fid_node(struct _9p_fid_node *node, int level)
 {
 	int i;
+
+	for (i = 0; i < _9P_FID_NODE_SIZE; i++) {
+		if (node->slots[i] == NULL)
+			continue;
+
+		if (level < _9P_FID_LEVELS - 1) {
+			_9p_cleanup_fid_node(node->slots[i], level + 1);
+		} else {
+			_9p_init_opctx(node->slots[i], NULL);
+			_9p_tools_clunk(node->slots[i]);
+			_9p_release_opctx();
+		}
+	}
+
+	gsh_free(node);
+}
+
+void _9p_cleanup_fids(struct _9p_conn *conn)
+{
 	struct req_op_context op_context;
 
+	if (conn->fids == NULL)
+		return;
+
 	/* Initialize op context.
 	 * Note we only need it if there is a non-null fid,
 	 * might be worth optimizing for huge clusters
 	 */
 	init_op_context(&op_context, NULL, NULL, NULL, 0, 0, _9P_REQUEST);
 
-	for (i = 0; i < _9P_FID_PER_CONN; i++) {
-		if (conn->fids[i]) {
-			_9p_init_opctx(conn->fids[i], NULL);
-			_9p_tools_clunk(conn->fids[i]);
-			_9p_release_opctx();
-			conn->fids[i] = NULL; /* poison the entry */
-		}
-	}
+	/* No request uses the connection anymore, the nodes can go now */
+	_9p_cleanup_fid_node(conn->fids, 0);
+	conn->fids = NULL; /* poison the table */
+	conn->fid_nodes = 0;
 
 	release_op_context();
 }
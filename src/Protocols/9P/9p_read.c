@@ -60,6 +60,11 @@ int _9p_read(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 
 	size_t read_size = 0;
 
+	/* Over TCP, the data is sent from the buffer the FSAL read it into,
+	 * behind the reply's header.  RDMA needs it in the reply buffer.
+	 */
+	bool zerocopy = req9p->pconn->trans_type == _9P_TCP;
+
 	/* Get data */
 	_9p_getptr(cursor, msgtag, u16);
 	_9p_getptr(cursor, fid, u32);
@@ -69,10 +74,10 @@ int _9p_read(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	LogDebug(COMPONENT_9P, "TREAD: tag=%u fid=%u offset=%llu count=%u",
 		 (u32)*msgtag, *fid, (unsigned long long)*offset, *count);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= _9P_FID_MAX)
 		return _9p_rerror(req9p, msgtag, ERANGE, plenout, preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 
 	/* Make sure the requested amount of data respects negotiated msize */
 	if (*count + _9P_ROOM_RREAD > req9p->pconn->msize)
@@ -104,8 +109,25 @@ int _9p_read(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 					  preply);
 
 		read_size = MIN(*count, pfid->xattr->xattr_size - *offset);
-		memcpy(databuffer, pfid->xattr->xattr_content + *offset,
-		       read_size);
+
+		if (zerocopy && read_size != 0) {
+			/* The reply buffer only has room for the header, and
+			 * the fid may be clunked before the reply is sent */
+			struct io_buf *buf = io_buf_get(read_size);
+
+			memcpy(buf->ib_base,
+			       pfid->xattr->xattr_content + *offset,
+			       read_size);
+
+			req9p->_9preplydata.iov_base = buf->ib_base;
+			req9p->_9preplydata.iov_len = read_size;
+			req9p->_9preplydata_release = io_buf_release;
+			req9p->_9preplydata_release_data = buf;
+		} else {
+			memcpy(databuffer,
+			       pfid->xattr->xattr_content + *offset,
+			       read_size);
+		}
 
 		outcount = read_size;
 	} else {
@@ -113,15 +135,15 @@ int _9p_read(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 		struct fsal_io_arg *read_arg =
 			alloca(sizeof(*read_arg) + sizeof(struct iovec));
 
-		read_arg->info = NULL;
+		memset(read_arg, 0, sizeof(*read_arg));
 		read_arg->state = pfid->state;
 		read_arg->offset = *offset;
 		read_arg->iov_count = 1;
 		read_arg->iov = (struct iovec *)(read_arg + 1);
 		read_arg->iov[0].iov_len = *count;
-		read_arg->iov[0].iov_base = databuffer;
-		read_arg->io_amount = 0;
-		read_arg->end_of_file = false;
+		/* NULL lets the FSAL use its own buffer, or get one from the
+		 * I/O buffer pool */
+		read_arg->iov[0].iov_base = zerocopy ? NULL : databuffer;
 
 		read_data.ret.major = 0;
 		read_data.ret.minor = 0;
@@ -141,17 +163,38 @@ int _9p_read(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 					     false);
 		}
 
-		if (FSAL_IS_ERROR(read_data.ret))
+		if (FSAL_IS_ERROR(read_data.ret)) {
+			if (read_arg->iov_release != NULL)
+				read_arg->iov_release(read_arg->release_data);
 			return _9p_rerror(req9p, msgtag,
 					  _9p_tools_errno(read_data.ret),
 					  plenout, preply);
+		}
 
 		outcount = (u32)read_arg->io_amount;
+
+		if (zerocopy) {
+			req9p->_9preplydata.iov_base =
+				read_arg->iov[0].iov_base;
+			req9p->_9preplydata.iov_len = outcount;
+			req9p->_9preplydata_release = read_arg->iov_release;
+			req9p->_9preplydata_release_data =
+				read_arg->release_data;
+		}
 	}
-	_9p_setfilledbuffer(cursor, outcount);
 
-	_9p_setendptr(cursor, preply);
-	_9p_checkbound(cursor, preply, plenout);
+	if (req9p->_9preplydata.iov_base != NULL) {
+		/* Only the header goes in the reply buffer, the size covers
+		 * the data that follows it */
+		_9p_setvalue(cursor, outcount, u32);
+		_9p_checkbound(cursor, preply, plenout);
+		*((u32 *)preply) = *plenout + outcount;
+	} else {
+		_9p_setfilledbuffer(cursor, outcount);
+
+		_9p_setendptr(cursor, preply);
+		_9p_checkbound(cursor, preply, plenout);
+	}
 
 	LogDebug(COMPONENT_9P, "RREAD: tag=%u fid=%u offset=%llu count=%u",
 		 (u32)*msgtag, *fid, (unsigned long long)*offset, *count);
@@ -31,12 +31,22 @@
 
 #include "config.h"
 #include "9p.h"
+#include "9p_sock.h"
 #include "config_parsing.h"
 #include "gsh_config.h"
 
 /* 9P parameters, settable in the 9P stanza. */
 struct _9p_param _9p_param;
 
+static struct config_item_list _9p_sock_backends[] = {
+	CONFIG_LIST_TOK("kernel", _9P_SOCK_KERNEL),
+#ifdef USE_FSTACK
+	CONFIG_LIST_TOK("fstack", _9P_SOCK_FSTACK),
+#endif
+	CONFIG_LIST_TOK("loopback", _9P_SOCK_LOOPBACK),
+	CONFIG_LIST_EOL
+};
+
 static struct config_item _9p_params[] = {
 	CONF_ITEM_UI32("Nb_Worker", 1, 1024 * 128, NB_WORKER_THREAD_DEFAULT,
 		       _9p_param, nb_worker),
@@ -44,7 +54,7 @@ static struct config_item _9p_params[] = {
 		       _9p_tcp_port),
 	CONF_ITEM_UI16("_9P_RDMA_Port", 1, UINT16_MAX, _9P_RDMA_PORT, _9p_param,
 		       _9p_rdma_port),
-	CONF_ITEM_UI32("_9P_TCP_Msize", 1024, UINT32_MAX, _9P_TCP_MSIZE,
+	CONF_ITEM_UI32("_9P_TCP_Msize", 1024, _9P_TCP_MSIZE_MAX, _9P_TCP_MSIZE,
 		       _9p_param, _9p_tcp_msize),
 	CONF_ITEM_UI32("_9P_RDMA_Msize", 1024, UINT32_MAX, _9P_RDMA_MSIZE,
 		       _9p_param, _9p_rdma_msize),
@@ -54,6 +64,10 @@ static struct config_item _9p_params[] = {
 		       _9P_RDMA_INPOOL_SIZE, _9p_param, _9p_rdma_inpool_size),
 	CONF_ITEM_UI16("_9P_RDMA_Outpool_Size", 1, UINT16_MAX,
 		       _9P_RDMA_OUTPOOL_SIZE, _9p_param, _9p_rdma_outpool_size),
+	CONF_ITEM_TOKEN("_9P_Socket_Backend", _9P_SOCK_BACKEND_DEFAULT,
+			_9p_sock_backends, _9p_param, _9p_sock_backend),
+	CONF_ITEM_PATH("_9P_FStack_Config", 1, MAXPATHLEN, _9P_FSTACK_CONFIG,
+		       _9p_param, _9p_fstack_config),
 	CONFIG_EOL
 };
 
@@ -67,18 +67,20 @@ int _9p_version(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 		return _9p_rerror(req9p, msgtag, ENOENT, plenout, preply);
 	}
 
+	/* The client may ask for less than we offer, not for more */
 	if (req9p->pconn->msize < *msize)
 		*msize = req9p->pconn->msize;
-	else
-		req9p->pconn->msize = *msize;
 
 	LogDebug(COMPONENT_9P, "Negotiated msize is %u", *msize);
 
 	/* A too small msize would result in buffer overflows on calls
-	 * such as STAT. Make sure it is not ridiculously low. */
-	if (*msize < 512)
+	 * such as STAT. Make sure it is not ridiculously low, and keep the
+	 * connection's msize if it is. */
+	if (*msize < _9P_MSIZE_MIN)
 		return _9p_rerror(req9p, msgtag, ERANGE, plenout, preply);
 
+	req9p->pconn->msize = *msize;
+
 	/* Good version, build the reply */
 	_9p_setinitptr(cursor, preply, _9P_RVERSION);
 	_9p_setptr(cursor, msgtag, u16);
@@ -57,6 +57,7 @@ int _9p_walk(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	fsal_status_t fsal_status;
 	struct fsal_obj_handle *pentry = NULL;
 	char name[MAXNAMLEN + 1];
+	int rc;
 
 	u16 *nwqid;
 
@@ -72,13 +73,13 @@ int _9p_walk(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	LogDebug(COMPONENT_9P, "TWALK: tag=%u fid=%u newfid=%u nwname=%u",
 		 (u32)*msgtag, *fid, *newfid, *nwname);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= _9P_FID_MAX)
 		return _9p_rerror(req9p, msgtag, ERANGE, plenout, preply);
 
-	if (*newfid >= _9P_FID_PER_CONN)
+	if (*newfid >= _9P_FID_MAX)
 		return _9p_rerror(req9p, msgtag, ERANGE, plenout, preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
 		LogDebug(COMPONENT_9P, "request on invalid fid=%u", *fid);
@@ -206,7 +207,13 @@ int _9p_walk(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	pnewfid->state->state_refcount = 1;
 
 	/* keep info on new fid */
-	req9p->pconn->fids[*newfid] = pnewfid;
+	rc = _9p_setfid(req9p->pconn, *newfid, pnewfid);
+	if (rc != 0) {
+		free_state(pnewfid->state);
+		pnewfid->pentry->obj_ops->put_ref(pnewfid->pentry);
+		gsh_free(pnewfid);
+		return _9p_rerror(req9p, msgtag, rc, plenout, preply);
+	}
 
 	/* As much qid as requested fid */
 	nwqid = nwname;
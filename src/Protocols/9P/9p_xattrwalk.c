@@ -65,6 +65,7 @@ int _9p_xattrwalk(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	unsigned int i = 0;
 	char *xattr_cursor = NULL;
 	unsigned int tmplen = 0;
+	int rc;
 
 	struct _9p_fid *pfid = NULL;
 	struct _9p_fid *pxattrfid = NULL;
@@ -90,13 +91,13 @@ int _9p_xattrwalk(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 			"TXATTRWALK (component): tag=%u fid=%u attrfid=%u name=%.*s",
 			(u32)*msgtag, *fid, *attrfid, *name_len, name_str);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= _9P_FID_MAX)
 		return _9p_rerror(req9p, msgtag, ERANGE, plenout, preply);
 
-	if (*attrfid >= _9P_FID_PER_CONN)
+	if (*attrfid >= _9P_FID_MAX)
 		return _9p_rerror(req9p, msgtag, ERANGE, plenout, preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
 		LogDebug(COMPONENT_9P, "request on invalid fid=%u", *fid);
@@ -236,7 +237,12 @@ int _9p_xattrwalk(struct _9p_request_data *req9p, u32 *plenout, char *preply)
 	pxattrfid->xattr->xattr_size = attrsize;
 	pxattrfid->xattr->xattr_write = _9P_XATTR_READ_ONLY;
 
-	req9p->pconn->fids[*attrfid] = pxattrfid;
+	rc = _9p_setfid(req9p->pconn, *attrfid, pxattrfid);
+	if (rc != 0) {
+		gsh_free(pxattrfid->xattr);
+		gsh_free(pxattrfid);
+		return _9p_rerror(req9p, msgtag, rc, plenout, preply);
+	}
 
 	/* Increments refcount as we're manually making a new copy */
 	pxattrfid->pentry->obj_ops->get_ref(pxattrfid->pentry);
@@ -539,11 +539,11 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_COPY] = {
 		.name = "OP_COPY",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_copy,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
+		.free_res = nfs4_op_write_Free,
 		.resp_size = sizeof(COPY4res),
-		.exp_perm_flags = 0},
+		.exp_perm_flags = EXPORT_OPTION_WRITE_ACCESS},
 	[NFS4_OP_COPY_NOTIFY] = {
 		.name = "OP_COPY_NOTIFY",
 		.funct = nfs4_op_notsupp,
@@ -581,16 +581,16 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_OFFLOAD_CANCEL] = {
 		.name = "OP_OFFLOAD_CANCEL",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_offload_cancel,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
-		.resp_size = sizeof(OFFLOAD_ABORT4res),
+		.free_res = nfs4_op_write_Free,
+		.resp_size = sizeof(OFFLOAD_CANCEL4res),
 		.exp_perm_flags = 0},
 	[NFS4_OP_OFFLOAD_STATUS] = {
 		.name = "OP_OFFLOAD_STATUS",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_offload_status,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
+		.free_res = nfs4_op_offload_status_Free,
 		.resp_size = sizeof(OFFLOAD_STATUS4res),
 		.exp_perm_flags = 0},
 	[NFS4_OP_READ_PLUS] = {
@@ -616,11 +616,11 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_CLONE] = {
 		.name = "OP_CLONE",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_clone,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
-		.resp_size = sizeof(ILLEGAL4res),
-		.exp_perm_flags = 0},
+		.free_res = nfs4_op_write_Free,
+		.resp_size = sizeof(CLONE4res),
+		.exp_perm_flags = EXPORT_OPTION_WRITE_ACCESS},
 
 	/* NFSv4.3 */
 	[NFS4_OP_GETXATTR] = {
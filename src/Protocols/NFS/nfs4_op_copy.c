@@ -0,0 +1,955 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs4_op_copy.c
+ * @brief Routines used for managing the NFS4 COMPOUND functions.
+ *
+ * Routines used for managing the NFS4 COMPOUND functions COPY, CLONE,
+ * OFFLOAD_STATUS and OFFLOAD_CANCEL (RFC 7862).  Only intra-server copies
+ * are supported; the source is the saved filehandle and the destination the
+ * current filehandle, both in the same export.
+ *
+ * Short copies are done synchronously.  Larger ones, when the client allows
+ * it, are handed to a small pool of copy threads and the client is told
+ * about completion with CB_OFFLOAD.  If the callback can not be delivered
+ * the result is kept so that the client can still pick it up with
+ * OFFLOAD_STATUS, for a couple of lease periods.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "fsal.h"
+#include "nfs_core.h"
+#include "sal_functions.h"
+#include "nfs_proto_functions.h"
+#include "nfs_proto_tools.h"
+#include "nfs_convert.h"
+#include "nfs_file_handle.h"
+#include "nfs_rpc_callback.h"
+#include "export_mgr.h"
+#include "fridgethr.h"
+
+/**
+ * @brief Largest copy done synchronously
+ *
+ * Synchronous copies tie up a worker thread, so they are cut short here and
+ * the client asks for the rest.
+ */
+#define COPY_SYNC_MAX (4 * 1024 * 1024)
+
+/**
+ * @brief Unit of work for an asynchronous copy
+ *
+ * OFFLOAD_CANCEL is only noticed, and the progress OFFLOAD_STATUS reports
+ * only moves, between chunks.
+ */
+#define COPY_ASYNC_CHUNK (64 * 1024 * 1024)
+
+/**
+ * @brief An asynchronous copy
+ */
+struct nfs4_copy {
+	struct glist_head oc_list; /*< On copy_list */
+	stateid4 oc_stateid; /*< Copy stateid given to the client */
+	clientid4 oc_clientid; /*< Owning client */
+	nfs_client_id_t *oc_client; /*< Client reference while running */
+	struct gsh_export *oc_export; /*< Export reference while running */
+	struct fsal_obj_handle *oc_src; /*< Source file */
+	struct fsal_obj_handle *oc_dst; /*< Destination file */
+	state_t *oc_src_state; /*< Source state (or NULL) */
+	state_t *oc_dst_state; /*< Destination state (or NULL) */
+	struct user_cred oc_creds; /*< Credentials of the COPY request */
+	uint64_t oc_src_offset;
+	uint64_t oc_dst_offset;
+	uint64_t oc_count;
+	uint64_t oc_copied; /*< Progress, atomic */
+	uint32_t oc_cancel; /*< Set by OFFLOAD_CANCEL, atomic */
+	bool oc_running; /*< Owned by the copy thread */
+	nfsstat4 oc_status; /*< Final status */
+	time_t oc_done_time; /*< When the result was parked */
+	verifier4 oc_verf; /*< Write verifier for the result */
+};
+
+static pthread_mutex_t copy_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct glist_head copy_list = GLIST_HEAD_INIT(copy_list);
+static struct fridgethr *copy_fridge;
+
+/**
+ * @brief Start the copy thread pool
+ *
+ * @return 0 or an errno value.
+ */
+int nfs4_copy_init(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 4;
+	frp.thr_min = 0;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&copy_fridge, "copy", &frp);
+	if (rc != 0)
+		LogMajor(COMPONENT_THREAD,
+			 "Unable to initialize copy fridge, error code %d.",
+			 rc);
+
+	return rc;
+}
+
+/**
+ * @brief Drop the references a running copy holds
+ *
+ * @param[in] copy The copy
+ */
+static void copy_put_refs(struct nfs4_copy *copy)
+{
+	if (copy->oc_src_state != NULL)
+		dec_state_t_ref(copy->oc_src_state);
+	if (copy->oc_dst_state != NULL)
+		dec_state_t_ref(copy->oc_dst_state);
+	if (copy->oc_src != NULL)
+		copy->oc_src->obj_ops->put_ref(copy->oc_src);
+	if (copy->oc_dst != NULL)
+		copy->oc_dst->obj_ops->put_ref(copy->oc_dst);
+	if (copy->oc_client != NULL)
+		dec_client_id_ref(copy->oc_client);
+	if (copy->oc_export != NULL)
+		put_gsh_export(copy->oc_export);
+
+	copy->oc_src_state = NULL;
+	copy->oc_dst_state = NULL;
+	copy->oc_src = NULL;
+	copy->oc_dst = NULL;
+	copy->oc_client = NULL;
+	copy->oc_export = NULL;
+}
+
+/**
+ * @brief Free an asynchronous copy
+ *
+ * Must not be on copy_list.
+ *
+ * @param[in] copy The copy
+ */
+static void copy_free(struct nfs4_copy *copy)
+{
+	copy_put_refs(copy);
+	gsh_free(copy->oc_creds.caller_garray);
+	gsh_free(copy);
+}
+
+/**
+ * @brief Drop parked results the client never collected
+ *
+ * Called with copy_mutex held.
+ */
+static void copy_reap_locked(void)
+{
+	struct glist_head *glist, *glistn;
+	time_t expire = time(NULL) - 2 * nfs_param.nfsv4_param.lease_lifetime;
+
+	glist_for_each_safe(glist, glistn, &copy_list) {
+		struct nfs4_copy *copy =
+			glist_entry(glist, struct nfs4_copy, oc_list);
+
+		if (copy->oc_running || copy->oc_done_time > expire)
+			continue;
+
+		glist_del(&copy->oc_list);
+		copy_free(copy);
+	}
+}
+
+/**
+ * @brief Stop the copy thread pool
+ *
+ * Running copies notice between chunks and stop early.  Once no copy
+ * thread is left, the copies still queued and the parked results are
+ * dropped.
+ *
+ * @return 0 or an errno value.
+ */
+int nfs4_copy_shutdown(void)
+{
+	struct glist_head *glist, *glistn;
+	bool stopped = true;
+	int rc = fridgethr_sync_command(copy_fridge, fridgethr_comm_stop, 120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_THREAD,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(copy_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Failed shutting down copy threads: %d", rc);
+		/* Copy threads may still be running theirs */
+		stopped = false;
+	}
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+
+	glist_for_each_safe(glist, glistn, &copy_list) {
+		struct nfs4_copy *copy =
+			glist_entry(glist, struct nfs4_copy, oc_list);
+
+		if (copy->oc_running && !stopped)
+			continue;
+
+		glist_del(&copy->oc_list);
+		copy_free(copy);
+	}
+
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+	return rc;
+}
+
+/**
+ * @brief Find a copy by stateid
+ *
+ * Called with copy_mutex held.
+ *
+ * @param[in] clientid Client asking
+ * @param[in] stateid  Copy stateid
+ *
+ * @return The copy or NULL.
+ */
+static struct nfs4_copy *copy_lookup_locked(clientid4 clientid,
+					    stateid4 *stateid)
+{
+	struct glist_head *glist;
+
+	glist_for_each(glist, &copy_list) {
+		struct nfs4_copy *copy =
+			glist_entry(glist, struct nfs4_copy, oc_list);
+
+		if (copy->oc_clientid == clientid &&
+		    memcmp(copy->oc_stateid.other, stateid->other,
+			   OTHERSIZE) == 0)
+			return copy;
+	}
+
+	return NULL;
+}
+
+static void copy_cb_completion(rpc_call_t *call)
+{
+	LogFullDebug(COMPONENT_NFS_CB, "CB_OFFLOAD status %d",
+		     call->cbt.v_u.v4.res.status);
+	nfs41_release_single(call);
+}
+
+/**
+ * @brief Tell the client an asynchronous copy is finished
+ *
+ * @param[in] copy The copy
+ *
+ * @return true if the callback was sent.
+ */
+static bool copy_send_offload(struct nfs4_copy *copy)
+{
+	nfs_cb_argop4 argop;
+	CB_OFFLOAD4args *cb_args = &argop.nfs_cb_argop4_u.opcboffload;
+	offload_info4 *info = &cb_args->coa_offload_info;
+	int ret;
+
+	argop.argop = NFS4_OP_CB_OFFLOAD;
+
+	if (!nfs4_FSALToFhandle(true, &cb_args->coa_fh, copy->oc_dst,
+				copy->oc_export)) {
+		LogCrit(COMPONENT_NFS_V4, "Failed allocating handle");
+		return false;
+	}
+
+	cb_args->coa_stateid = copy->oc_stateid;
+	info->coa_status = copy->oc_status;
+
+	if (copy->oc_status == NFS4_OK) {
+		write_response4 *wr = &info->offload_info4_u.coa_resok4;
+
+		memset(wr, 0, sizeof(*wr));
+		wr->wr_count = copy->oc_copied;
+		wr->wr_committed = UNSTABLE4;
+		memcpy(wr->wr_writeverf, copy->oc_verf, NFS4_VERIFIER_SIZE);
+	} else {
+		info->offload_info4_u.coa_bytes_copied = copy->oc_copied;
+	}
+
+	ret = nfs_rpc_cb_single(copy->oc_client, &argop, NULL,
+				copy_cb_completion, NULL);
+
+	LogDebug(COMPONENT_NFS_CB, "CB_OFFLOAD nfs_rpc_cb_single returned %d",
+		 ret);
+
+	nfs4_freeFH(&cb_args->coa_fh);
+
+	return ret == 0;
+}
+
+/**
+ * @brief Run an asynchronous copy
+ *
+ * @param[in] ctx Thread context, arg is the copy
+ */
+static void copy_run(struct fridgethr_context *ctx)
+{
+	struct nfs4_copy *copy = ctx->arg;
+	struct req_op_context op_context;
+	struct gsh_buffdesc verf_desc;
+	fsal_status_t status = { 0, 0 };
+	bool sent;
+
+	get_gsh_export_ref(copy->oc_export);
+	init_op_context_simple(&op_context, copy->oc_export,
+			       copy->oc_export->fsal_export);
+	op_ctx->creds = copy->oc_creds;
+
+	while (copy->oc_copied < copy->oc_count) {
+		uint64_t chunk = MIN(copy->oc_count - copy->oc_copied,
+				     COPY_ASYNC_CHUNK);
+		uint64_t done = 0;
+
+		if (atomic_fetch_uint32_t(&copy->oc_cancel) ||
+		    fridgethr_you_should_break(ctx)) {
+			status = fsalstat(ERR_FSAL_INTERRUPT, EINTR);
+			break;
+		}
+
+		status = copy->oc_src->obj_ops->copy(
+			copy->oc_src, copy->oc_src_state,
+			copy->oc_src_offset + copy->oc_copied, copy->oc_dst,
+			copy->oc_dst_state,
+			copy->oc_dst_offset + copy->oc_copied, chunk, &done);
+
+		if (FSAL_IS_ERROR(status))
+			break;
+
+		atomic_add_uint64_t(&copy->oc_copied, done);
+
+		if (done < chunk)
+			break;
+	}
+
+	copy->oc_status = FSAL_IS_ERROR(status) ? nfs4_Errno_status(status)
+						: NFS4_OK;
+
+	verf_desc.addr = copy->oc_verf;
+	verf_desc.len = sizeof(verifier4);
+	op_ctx->fsal_export->exp_ops.get_write_verifier(op_ctx->fsal_export,
+							&verf_desc);
+
+	LogDebug(COMPONENT_NFS_V4,
+		 "Async copy finished status %s copied %" PRIu64
+		 " of %" PRIu64,
+		 nfsstat4_to_str(copy->oc_status), copy->oc_copied,
+		 copy->oc_count);
+
+	/* A cancelled copy needs no callback */
+	sent = atomic_fetch_uint32_t(&copy->oc_cancel) ||
+	       copy_send_offload(copy);
+
+	/* Our creds were only borrowed */
+	op_ctx->creds.caller_garray = NULL;
+	op_ctx->creds.caller_glen = 0;
+	release_op_context();
+
+	/* Park an undelivered result for OFFLOAD_STATUS, without pinning the
+	 * files, states or client while it waits.
+	 */
+	if (!sent)
+		copy_put_refs(copy);
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+
+	if (sent) {
+		glist_del(&copy->oc_list);
+		PTHREAD_MUTEX_unlock(&copy_mutex);
+		copy_free(copy);
+		return;
+	}
+
+	copy->oc_running = false;
+	copy->oc_done_time = time(NULL);
+
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+}
+
+/**
+ * @brief Check a COPY or CLONE stateid and get the state to do I/O with
+ *
+ * @param[in]  data    Compound request's data
+ * @param[in]  stateid Stateid from the client
+ * @param[in]  obj     File the stateid applies to
+ * @param[in]  write   Whether the file will be written
+ * @param[in]  tag     Operation name for logging
+ * @param[out] pstate  State to pass to the FSAL (or NULL), with a reference
+ *
+ * @return NFS4_OK or an error.
+ */
+static nfsstat4 copy_check_stateid(compound_data_t *data, stateid4 *stateid,
+				   struct fsal_obj_handle *obj, bool write,
+				   const char *tag, state_t **pstate)
+{
+	state_t *state = NULL;
+	state_t *state_open;
+	fsal_status_t fsal_status;
+	nfsstat4 status;
+
+	*pstate = NULL;
+
+	status = nfs4_Check_Stateid(stateid, obj, &state, data,
+				    STATEID_SPECIAL_ANY, 0, false, tag);
+
+	if (status != NFS4_OK)
+		return status;
+
+	/* NB: After this points, if state == NULL, then
+	 * the stateid is all-0 or all-1
+	 */
+	if (state != NULL) {
+		switch (state->state_type) {
+		case STATE_TYPE_SHARE:
+			break;
+		case STATE_TYPE_LOCK:
+			state_open = nfs4_State_Get_Pointer(
+				state->state_data.lock.openstate_key);
+
+			if (state_open == NULL) {
+				status = NFS4ERR_BAD_STATEID;
+				goto out;
+			}
+
+			dec_state_t_ref(state);
+			state = state_open;
+			break;
+		case STATE_TYPE_DELEG:
+			/* The delegation only orders the I/O, as with WRITE
+			 * there is no open file to use, so fall back to the
+			 * anonymous case.
+			 */
+			if (write && !(state->state_data.deleg.sd_type &
+				       OPEN_DELEGATE_WRITE)) {
+				LogDebug(COMPONENT_STATE,
+					 "%s with read delegation on destination",
+					 tag);
+				status = NFS4ERR_BAD_STATEID;
+				goto out;
+			}
+			dec_state_t_ref(state);
+			state = NULL;
+			break;
+		default:
+			status = NFS4ERR_BAD_STATEID;
+			LogDebug(COMPONENT_NFS_V4_LOCK,
+				 "%s with invalid stateid of type %d", tag,
+				 (int)state->state_type);
+			goto out;
+		}
+
+		if (state != NULL &&
+		    (state->state_data.share.share_access &
+		     (write ? OPEN4_SHARE_ACCESS_WRITE
+			    : OPEN4_SHARE_ACCESS_READ)) == 0) {
+			LogDebug(COMPONENT_NFS_V4_LOCK,
+				 "%s %s file not open for %s", tag,
+				 write ? "destination" : "source",
+				 write ? "write" : "read");
+			status = NFS4ERR_OPENMODE;
+			goto out;
+		}
+	} else if (state_deleg_conflict(obj, write)) {
+		/*
+		 * We have an anonymous stateid -- ensure that it doesn't
+		 * conflict with an outstanding delegation.
+		 */
+		status = NFS4ERR_DELAY;
+		goto out;
+	}
+
+	/* Same permissions as required for a READ or WRITE */
+	fsal_status = obj->obj_ops->test_access(
+		obj, write ? FSAL_WRITE_ACCESS : FSAL_READ_ACCESS, NULL, NULL,
+		true);
+
+	if (FSAL_IS_ERROR(fsal_status)) {
+		status = nfs4_Errno_status(fsal_status);
+		goto out;
+	}
+
+	*pstate = state;
+	return NFS4_OK;
+
+out:
+	if (state != NULL)
+		dec_state_t_ref(state);
+
+	return status;
+}
+
+/**
+ * @brief Common checks for COPY and CLONE
+ *
+ * Validates both filehandles and both stateids and works out the byte
+ * range.  A count of 0 is turned into "to the end of the source".
+ *
+ * @param[in]     data       Compound request's data
+ * @param[in]     src_sid    Source stateid
+ * @param[in]     dst_sid    Destination stateid
+ * @param[in]     src_offset Source offset
+ * @param[in]     dst_offset Destination offset
+ * @param[in,out] count      Number of bytes
+ * @param[in]     tag        Operation name for logging
+ * @param[out]    src_state  Source state, with a reference
+ * @param[out]    dst_state  Destination state, with a reference
+ *
+ * @return NFS4_OK or an error; on error no references are held.
+ */
+static nfsstat4 copy_prepare(compound_data_t *data, stateid4 *src_sid,
+			     stateid4 *dst_sid, uint64_t src_offset,
+			     uint64_t dst_offset, uint64_t *count,
+			     const char *tag, state_t **src_state,
+			     state_t **dst_state)
+{
+	struct fsal_obj_handle *src = data->saved_obj;
+	struct fsal_obj_handle *dst = data->current_obj;
+	struct fsal_attrlist attrs;
+	fsal_status_t fsal_status;
+	uint64_t MaxOffsetWrite =
+		atomic_fetch_uint64_t(&op_ctx->ctx_export->MaxOffsetWrite);
+	nfsstat4 status;
+
+	*src_state = NULL;
+	*dst_state = NULL;
+
+	status = nfs4_sanity_check_FH(data, REGULAR_FILE, false);
+	if (status != NFS4_OK)
+		return status;
+
+	status = nfs4_sanity_check_saved_FH(data, REGULAR_FILE, false);
+	if (status != NFS4_OK)
+		return status;
+
+	/* Check that both handles are in the same export. */
+	if (op_ctx->ctx_export != NULL && data->saved_export != NULL &&
+	    op_ctx->ctx_export->export_id != data->saved_export->export_id)
+		return NFS4ERR_XDEV;
+
+	fsal_prepare_attrs(&attrs, ATTR_SIZE);
+
+	fsal_status = src->obj_ops->getattrs(src, &attrs);
+	fsal_release_attrs(&attrs);
+
+	if (FSAL_IS_ERROR(fsal_status))
+		return nfs4_Errno_status(fsal_status);
+
+	if (src_offset > attrs.filesize ||
+	    (*count != 0 && *count > attrs.filesize - src_offset)) {
+		LogDebug(COMPONENT_NFS_V4,
+			 "%s range %" PRIu64 "~%" PRIu64
+			 " beyond source size %" PRIu64,
+			 tag, src_offset, *count, attrs.filesize);
+		return NFS4ERR_INVAL;
+	}
+
+	if (*count == 0)
+		*count = attrs.filesize - src_offset;
+
+	/* Overlapping ranges within the same file */
+	if (src == dst && src_offset < dst_offset + *count &&
+	    dst_offset < src_offset + *count)
+		return NFS4ERR_INVAL;
+
+	if (MaxOffsetWrite < UINT64_MAX &&
+	    (dst_offset > MaxOffsetWrite ||
+	     *count > MaxOffsetWrite - dst_offset)) {
+		LogEvent(COMPONENT_NFS_V4,
+			 "A client tried to violate max file size %" PRIu64
+			 " for exportid #%hu",
+			 MaxOffsetWrite, op_ctx->ctx_export->export_id);
+		return NFS4ERR_FBIG;
+	}
+
+	status = copy_check_stateid(data, src_sid, src, false, tag, src_state);
+	if (status != NFS4_OK)
+		return status;
+
+	status = copy_check_stateid(data, dst_sid, dst, true, tag, dst_state);
+	if (status != NFS4_OK) {
+		if (*src_state != NULL)
+			dec_state_t_ref(*src_state);
+		*src_state = NULL;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Hand a copy to the copy threads
+ *
+ * @param[in]  data      Compound request's data
+ * @param[in]  arg       COPY arguments, count already resolved
+ * @param[in]  count     Number of bytes to copy
+ * @param[in]  src_state Source state, reference is taken over
+ * @param[in]  dst_state Destination state, reference is taken over
+ * @param[out] stateid   Copy stateid for the reply
+ *
+ * @return NFS4_OK or an error; on error the state references are released.
+ */
+static nfsstat4 copy_start_async(compound_data_t *data, COPY4args *arg,
+				 uint64_t count, state_t *src_state,
+				 state_t *dst_state, stateid4 *stateid)
+{
+	nfs_client_id_t *client = data->session->clientid_record;
+	struct nfs4_copy *copy = gsh_calloc(1, sizeof(*copy));
+	int rc;
+
+	copy->oc_src = data->saved_obj;
+	copy->oc_src->obj_ops->get_ref(copy->oc_src);
+	copy->oc_dst = data->current_obj;
+	copy->oc_dst->obj_ops->get_ref(copy->oc_dst);
+	copy->oc_src_state = src_state;
+	copy->oc_dst_state = dst_state;
+	copy->oc_client = client;
+	inc_client_id_ref(client);
+	copy->oc_clientid = client->cid_clientid;
+	copy->oc_export = op_ctx->ctx_export;
+	get_gsh_export_ref(copy->oc_export);
+
+	copy->oc_creds = op_ctx->creds;
+	if (op_ctx->creds.caller_glen != 0)
+		copy->oc_creds.caller_garray = gsh_memdup(
+			op_ctx->creds.caller_garray,
+			op_ctx->creds.caller_glen * sizeof(gid_t));
+	else
+		copy->oc_creds.caller_garray = NULL;
+
+	copy->oc_src_offset = arg->ca_src_offset;
+	copy->oc_dst_offset = arg->ca_dst_offset;
+	copy->oc_count = count;
+	copy->oc_running = true;
+
+	copy->oc_stateid.seqid = 1;
+	nfs4_BuildStateId_Other(client, copy->oc_stateid.other);
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+	copy_reap_locked();
+	glist_add_tail(&copy_list, &copy->oc_list);
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+	/* The copy may finish (and be freed) before we return */
+	*stateid = copy->oc_stateid;
+
+	rc = fridgethr_submit(copy_fridge, copy_run, copy);
+
+	if (rc != 0) {
+		LogMajor(COMPONENT_NFS_V4, "Unable to start copy: %d", rc);
+		PTHREAD_MUTEX_lock(&copy_mutex);
+		glist_del(&copy->oc_list);
+		PTHREAD_MUTEX_unlock(&copy_mutex);
+		copy_free(copy);
+		return NFS4ERR_DELAY;
+	}
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief The NFS4_OP_COPY operation
+ *
+ * This functions handles the NFS4_OP_COPY operation in NFSv4.2. This
+ * function can be called only from nfs4_Compound.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_copy(struct nfs_argop4 *op, compound_data_t *data,
+				 struct nfs_resop4 *resp)
+{
+	COPY4args *const arg_COPY4 = &op->nfs_argop4_u.opcopy;
+	COPY4res *const res_COPY4 = &resp->nfs_resop4_u.opcopy;
+	COPY4resok *resok = &res_COPY4->COPY4res_u.cr_resok4;
+	state_t *src_state = NULL;
+	state_t *dst_state = NULL;
+	uint64_t count = arg_COPY4->ca_count;
+	uint64_t copied = 0;
+	fsal_status_t fsal_status;
+	struct gsh_buffdesc verf_desc;
+
+	resp->resop = NFS4_OP_COPY;
+	memset(resok, 0, sizeof(*resok));
+
+	/* Only intra-server copies */
+	if (arg_COPY4->ca_source_server.ca_source_server_len != 0) {
+		res_COPY4->cr_status = NFS4ERR_NOTSUPP;
+		goto out;
+	}
+
+	res_COPY4->cr_status = copy_prepare(
+		data, &arg_COPY4->ca_src_stateid, &arg_COPY4->ca_dst_stateid,
+		arg_COPY4->ca_src_offset, arg_COPY4->ca_dst_offset, &count,
+		"COPY", &src_state, &dst_state);
+
+	if (res_COPY4->cr_status != NFS4_OK)
+		goto out;
+
+	LogFullDebug(COMPONENT_NFS_V4,
+		     "COPY src %" PRIu64 " dst %" PRIu64 " count %" PRIu64
+		     " sync %d",
+		     arg_COPY4->ca_src_offset, arg_COPY4->ca_dst_offset, count,
+		     arg_COPY4->ca_synchronous);
+
+	resok->cr_requirements.cr_consecutive = true;
+	resok->cr_requirements.cr_synchronous = true;
+	resok->cr_response.wr_committed = UNSTABLE4;
+
+	if (!arg_COPY4->ca_synchronous && count > COPY_SYNC_MAX) {
+		res_COPY4->cr_status = copy_start_async(
+			data, arg_COPY4, count, src_state, dst_state,
+			&resok->cr_response.wr_callback_id);
+
+		/* References now belong to the copy */
+		src_state = NULL;
+		dst_state = NULL;
+
+		if (res_COPY4->cr_status != NFS4_OK)
+			goto out;
+
+		resok->cr_response.wr_ids = 1;
+		resok->cr_requirements.cr_synchronous = false;
+		goto verifier;
+	}
+
+	fsal_status = data->saved_obj->obj_ops->copy(
+		data->saved_obj, src_state, arg_COPY4->ca_src_offset,
+		data->current_obj, dst_state, arg_COPY4->ca_dst_offset,
+		MIN(count, COPY_SYNC_MAX), &copied);
+
+	if (FSAL_IS_ERROR(fsal_status)) {
+		res_COPY4->cr_status = nfs4_Errno_status(fsal_status);
+		goto out;
+	}
+
+	resok->cr_response.wr_count = copied;
+
+verifier:
+
+	verf_desc.addr = resok->cr_response.wr_writeverf;
+	verf_desc.len = sizeof(verifier4);
+	op_ctx->fsal_export->exp_ops.get_write_verifier(op_ctx->fsal_export,
+							&verf_desc);
+
+out:
+	if (src_state != NULL)
+		dec_state_t_ref(src_state);
+	if (dst_state != NULL)
+		dec_state_t_ref(dst_state);
+
+	return nfsstat4_to_nfs_req_result(res_COPY4->cr_status);
+}
+
+/**
+ * @brief The NFS4_OP_CLONE operation
+ *
+ * This functions handles the NFS4_OP_CLONE operation in NFSv4.2. This
+ * function can be called only from nfs4_Compound.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_clone(struct nfs_argop4 *op, compound_data_t *data,
+				  struct nfs_resop4 *resp)
+{
+	CLONE4args *const arg_CLONE4 = &op->nfs_argop4_u.opclone;
+	CLONE4res *const res_CLONE4 = &resp->nfs_resop4_u.opclone;
+	state_t *src_state = NULL;
+	state_t *dst_state = NULL;
+	uint64_t count = arg_CLONE4->cl_count;
+	fsal_status_t fsal_status;
+
+	resp->resop = NFS4_OP_CLONE;
+
+	res_CLONE4->cl_status = copy_prepare(
+		data, &arg_CLONE4->cl_src_stateid, &arg_CLONE4->cl_dst_stateid,
+		arg_CLONE4->cl_src_offset, arg_CLONE4->cl_dst_offset, &count,
+		"CLONE", &src_state, &dst_state);
+
+	if (res_CLONE4->cl_status != NFS4_OK)
+		goto out;
+
+	if (count == 0)
+		goto out;
+
+	/* A zero count to the FSAL means to end of file, which lets the file
+	 * system clone a final partial block.
+	 */
+	if (arg_CLONE4->cl_count == 0)
+		count = 0;
+
+	fsal_status = data->saved_obj->obj_ops->clone(
+		data->saved_obj, src_state, arg_CLONE4->cl_src_offset,
+		data->current_obj, dst_state, arg_CLONE4->cl_dst_offset, count);
+
+	if (FSAL_IS_ERROR(fsal_status))
+		res_CLONE4->cl_status = nfs4_Errno_status(fsal_status);
+
+out:
+	if (src_state != NULL)
+		dec_state_t_ref(src_state);
+	if (dst_state != NULL)
+		dec_state_t_ref(dst_state);
+
+	return nfsstat4_to_nfs_req_result(res_CLONE4->cl_status);
+}
+
+/**
+ * @brief The NFS4_OP_OFFLOAD_STATUS operation
+ *
+ * This functions handles the NFS4_OP_OFFLOAD_STATUS operation in NFSv4.2.
+ * This function can be called only from nfs4_Compound.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_offload_status(struct nfs_argop4 *op,
+					   compound_data_t *data,
+					   struct nfs_resop4 *resp)
+{
+	OFFLOAD_STATUS4args *const arg_STATUS4 =
+		&op->nfs_argop4_u.opoffload_status;
+	OFFLOAD_STATUS4res *const res_STATUS4 =
+		&resp->nfs_resop4_u.opoffload_status;
+	OFFLOAD_STATUS4resok *resok = &res_STATUS4->OFFLOAD_STATUS4res_u
+					       .osr_resok4;
+	struct nfs4_copy *copy;
+
+	resp->resop = NFS4_OP_OFFLOAD_STATUS;
+	memset(resok, 0, sizeof(*resok));
+
+	res_STATUS4->osr_status = nfs4_sanity_check_FH(data, REGULAR_FILE,
+						       false);
+	if (res_STATUS4->osr_status != NFS4_OK)
+		goto out;
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+
+	copy = copy_lookup_locked(data->session->clientid_record->cid_clientid,
+				  &arg_STATUS4->osa_stateid);
+
+	if (copy == NULL) {
+		res_STATUS4->osr_status = NFS4ERR_BAD_STATEID;
+	} else {
+		resok->osr_count = atomic_fetch_uint64_t(&copy->oc_copied);
+
+		if (!copy->oc_running) {
+			/* The result has now been delivered */
+			resok->osr_complete.osr_complete_len = 1;
+			resok->osr_complete.osr_complete_val =
+				gsh_malloc(sizeof(nfsstat4));
+			resok->osr_complete.osr_complete_val[0] =
+				copy->oc_status;
+			glist_del(&copy->oc_list);
+			copy_free(copy);
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+out:
+	return nfsstat4_to_nfs_req_result(res_STATUS4->osr_status);
+}
+
+/**
+ * @brief Free memory allocated for OFFLOAD_STATUS result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+void nfs4_op_offload_status_Free(nfs_resop4 *resp)
+{
+	OFFLOAD_STATUS4res *res_STATUS4 = &resp->nfs_resop4_u.opoffload_status;
+
+	if (res_STATUS4->osr_status == NFS4_OK)
+		gsh_free(res_STATUS4->OFFLOAD_STATUS4res_u.osr_resok4
+				 .osr_complete.osr_complete_val);
+}
+
+/**
+ * @brief The NFS4_OP_OFFLOAD_CANCEL operation
+ *
+ * This functions handles the NFS4_OP_OFFLOAD_CANCEL operation in NFSv4.2.
+ * This function can be called only from nfs4_Compound.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_offload_cancel(struct nfs_argop4 *op,
+					   compound_data_t *data,
+					   struct nfs_resop4 *resp)
+{
+	OFFLOAD_CANCEL4args *const arg_CANCEL4 =
+		&op->nfs_argop4_u.opoffload_cancel;
+	OFFLOAD_CANCEL4res *const res_CANCEL4 =
+		&resp->nfs_resop4_u.opoffload_cancel;
+	struct nfs4_copy *copy;
+
+	resp->resop = NFS4_OP_OFFLOAD_CANCEL;
+
+	res_CANCEL4->ocr_status = nfs4_sanity_check_FH(data, REGULAR_FILE,
+						       false);
+	if (res_CANCEL4->ocr_status != NFS4_OK)
+		goto out;
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+
+	copy = copy_lookup_locked(data->session->clientid_record->cid_clientid,
+				  &arg_CANCEL4->oca_stateid);
+
+	if (copy == NULL) {
+		res_CANCEL4->ocr_status = NFS4ERR_BAD_STATEID;
+	} else if (copy->oc_running) {
+		/* The copy thread stops at the next chunk and cleans up */
+		atomic_store_uint32_t(&copy->oc_cancel, 1);
+	} else {
+		glist_del(&copy->oc_list);
+		copy_free(copy);
+	}
+
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+out:
+	return nfsstat4_to_nfs_req_result(res_CANCEL4->ocr_status);
+}
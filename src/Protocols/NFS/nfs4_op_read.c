@@ -49,6 +49,7 @@
 #include "server_stats.h"
 #include "export_mgr.h"
 #include "gsh_rpc.h"
+#include "io_buf_pool.h"
 
 #include "gsh_lttng/gsh_lttng.h"
 #if defined(USE_LTTNG) && !defined(LTTNG_PARSING)
@@ -177,17 +178,62 @@ static enum nfs_req_result nfs4_complete_read(struct nfs4_read_data *data)
 	return nfsstat4_to_nfs_req_result(data->res_READ4->status);
 }
 
+static void read4_io_data_release(void *release_data);
+
+/**
+ * @brief Turn a completed READ result into a READ_PLUS result
+ *
+ * The READ_PLUS result overlays the READ result, so the read buffer and
+ * its release function must be taken out of the READ result first.  A
+ * data segment is returned from the read buffer, whatever offset the
+ * FSAL put in its io_info.  READ_PLUS results are released with
+ * nfs4_op_read_plus_Free(), which can only gsh_free() the data, so data
+ * in a buffer with its own release function is copied out.
+ *
+ * @param[in,out] resp       The READ_PLUS result, holding a READ result
+ * @param[in]     info       io_info filled in by the FSAL
+ * @param[in]     read_data  The read, NULL if read2 was not called
+ */
 static void nfs4_complete_read_plus(struct nfs_resop4 *resp,
-				    struct io_info *info)
+				    struct io_info *info,
+				    struct nfs4_read_data *read_data)
 {
 	READ4res *const res_READ4 = &resp->nfs_resop4_u.opread;
 	READ_PLUS4res *const res_RPLUS = &resp->nfs_resop4_u.opread_plus;
 	contents *contentp = &res_RPLUS->rpr_resok4.rpr_contents;
+	io_data io = res_READ4->READ4res_u.resok4.data;
+	bool eof = res_READ4->READ4res_u.resok4.eof;
+	bool release;
+	char *buf = NULL;
+
+	/* Does the READ result own the buffer? */
+	release = io.release != NULL && io.release != read4_io_data_release;
+
+	if (read_data != NULL && info->io_content.what == NFS4_CONTENT_DATA &&
+	    io.data_len != 0) {
+		if (release) {
+			size_t off = 0;
+			u_int i;
+
+			buf = gsh_malloc(io.data_len);
+
+			for (i = 0; i < io.iovcnt && off < io.data_len; i++) {
+				size_t len = MIN(io.iov[i].iov_len,
+						 io.data_len - off);
+
+				memcpy(buf + off, io.iov[i].iov_base, len);
+				off += len;
+			}
+		} else {
+			buf = io.iov[0].iov_base;
+		}
+	}
 
-	/* Fixup the eof status from the res_READ4 that res_RPLUS overlays. */
-	res_RPLUS->rpr_resok4.rpr_eof = res_READ4->READ4res_u.resok4.eof;
+	if (release)
+		io.release(io.release_data);
 
-	/* Now fill in the rest of res_RPLUS */
+	/* Now fill in res_RPLUS */
+	res_RPLUS->rpr_resok4.rpr_eof = eof;
 	contentp->what = info->io_content.what;
 	res_RPLUS->rpr_resok4.rpr_contents_count = 1;
 
@@ -197,11 +243,11 @@ static void nfs4_complete_read_plus(struct nfs_resop4 *resp,
 	}
 
 	if (info->io_content.what == NFS4_CONTENT_DATA) {
-		contentp->data.d_offset = info->io_content.data.d_offset;
-		contentp->data.d_data.data_len =
-			info->io_content.data.d_data.data_len;
-		contentp->data.d_data.data_val =
-			info->io_content.data.d_data.data_val;
+		contentp->data.d_offset = read_data != NULL ?
+						  read_data->read_arg.offset :
+						  0;
+		contentp->data.d_data.data_len = buf != NULL ? io.data_len : 0;
+		contentp->data.d_data.data_val = buf;
 	}
 }
 
@@ -327,7 +373,7 @@ enum nfs_req_result nfs4_op_read_plus_resume(struct nfs_argop4 *op,
 	rc = nfs4_complete_read(read_data);
 
 	if (rc == NFS_REQ_OK) {
-		nfs4_complete_read_plus(resp, &read_data->info);
+		nfs4_complete_read_plus(resp, &read_data->info, read_data);
 	}
 
 	if (rc != NFS_REQ_ASYNC_WAIT) {
@@ -366,7 +412,7 @@ op_dsread(struct nfs_argop4 *op, compound_data_t *data, struct nfs_resop4 *resp)
 	/* NFSv4 return code */
 	nfsstat4 nfs_status = 0;
 	/* Buffer into which data is to be read */
-	void *buffer = NULL;
+	struct io_buf *buffer;
 	/* End of file flag */
 	bool eof = false;
 	READ4resok *resok = &res_READ4->READ4res_u.resok4;
@@ -387,13 +433,15 @@ op_dsread(struct nfs_argop4 *op, compound_data_t *data, struct nfs_resop4 *resp)
 	/* Construct the FSAL file handle */
 
 	/* Must allocate buffer as a multiple of BYTES_PER_XDR_UNIT */
-	buffer = gsh_malloc_aligned(4096, RNDUP(arg_READ4->count));
+	buffer = io_buf_get(RNDUP(arg_READ4->count));
 
-	resok->iov0.iov_base = buffer;
+	resok->iov0.iov_base = buffer->ib_base;
 	resok->iov0.iov_len = arg_READ4->count;
 	resok->data.data_len = arg_READ4->count;
 	resok->data.iovcnt = 1;
 	resok->data.iov = &resok->iov0;
+	resok->data.release = io_buf_release;
+	resok->data.release_data = buffer;
 
 	nfs_status = op_ctx->ctx_pnfs_ds->s_ops.dsh_read(
 		data->current_ds, &arg_READ4->stateid, arg_READ4->offset,
@@ -401,7 +449,9 @@ op_dsread(struct nfs_argop4 *op, compound_data_t *data, struct nfs_resop4 *resp)
 		&eof);
 
 	if (nfs_status != NFS4_OK) {
-		gsh_free(buffer);
+		io_buf_release(buffer);
+		resok->data.release = NULL;
+		resok->data.release_data = NULL;
 		resok->data.data_len = 0;
 		resok->iov0.iov_len = 0;
 		resok->iov0.iov_base = NULL;
@@ -776,7 +826,7 @@ static enum nfs_req_result nfs4_read(struct nfs_argop4 *op,
 	read_data = gsh_calloc(1, sizeof(*read_data));
 	LogFullDebug(COMPONENT_NFS_V4, "Allocated read_data %p", read_data);
 	read_arg = &read_data->read_arg;
-	read_arg->info = info;
+	read_arg->info = NULL;
 	read_arg->state = state_found;
 	read_arg->offset = offset;
 	read_arg->iov_count = resok->data.iovcnt;
@@ -793,8 +843,11 @@ static enum nfs_req_result nfs4_read(struct nfs_argop4 *op,
 	data->op_data = read_data;
 
 	if (info != NULL) {
-		/* We will be using the io_info that is part of read_data */
+		/* We will be using the io_info that is part of read_data,
+		 * it outlives this call if the read goes async.
+		 */
 		read_data->info.io_advise = info->io_advise;
+		read_arg->info = &read_data->info;
 	}
 
 again:
@@ -975,7 +1028,8 @@ enum nfs_req_result nfs4_op_read_plus(struct nfs_argop4 *op,
 		struct nfs4_read_data *read_data = data->op_data;
 
 		nfs4_complete_read_plus(
-			resp, read_data != NULL ? &read_data->info : &info);
+			resp, read_data != NULL ? &read_data->info : &info,
+			read_data);
 	}
 
 	if (req_result != NFS_REQ_ASYNC_WAIT && data->op_data != NULL) {
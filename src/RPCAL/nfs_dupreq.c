@@ -49,10 +49,16 @@
 #include "city.h"
 #include "abstract_mem.h"
 #include "gsh_intrinsic.h"
+#include "nfs_metrics.h"
 
 #define DUPREQ_NOCACHE ((void *)0x02)
 #define DUPREQ_NOCACHE_NORES ((void *)0x03)
-#define DUPREQ_MAX_RETRIES 5
+#define DUPREQ_RETIRE_BATCH 8
+
+/* Slab of preallocated dupreq entries, see alloc_dupreq() */
+#define DUPREQ_SLAB_SHARDS 16
+#define DUPREQ_SLAB_REFILL 32 /* entries preallocated at once */
+#define DUPREQ_SLAB_MAX 512 /* idle entries kept per shard */
 
 #define NFS_pcp nfs_param.core_param
 #define NFS_program NFS_pcp.program
@@ -139,6 +145,20 @@ struct drc_st {
 
 static struct drc_st *drc_st;
 
+/* Each shard is a free list of entries whose dre_mtx is still
+ * initialized.  Threads are spread over the shards round robin.
+ */
+struct dupreq_slab {
+	pthread_mutex_t mtx;
+	TAILQ_HEAD(dupreq_slab_q, dupreq_entry) free_q;
+	uint32_t count;
+	GSH_CACHE_PAD(0);
+};
+
+static struct dupreq_slab dupreq_slab[DUPREQ_SLAB_SHARDS];
+static uint32_t dupreq_slab_next;
+static __thread int32_t dupreq_slab_shard = -1;
+
 /**
  * @brief Comparison function for duplicate request entries.
  *
@@ -265,6 +285,41 @@ static inline int drc_recycle_cmpf(const struct opr_rbtree_node *lhs,
 	return sockaddr_cmpf(&lk->d_u.tcp.addr, &rk->d_u.tcp.addr, false);
 }
 
+/**
+ * @brief Set up the per-partition retirement FIFOs of a DRC
+ *
+ * The size bounds are split evenly between the partitions, since each
+ * partition retires its own entries.
+ *
+ * @param[in] drc The DRC, with npart, maxsize and hiwat set
+ */
+static void init_drc_parts(drc_t *drc)
+{
+	int ix;
+
+	drc->size = 0;
+	drc->part = gsh_calloc(drc->npart, sizeof(struct drc_part));
+	for (ix = 0; ix < drc->npart; ++ix)
+		TAILQ_INIT(&drc->part[ix].dupreq_q);
+
+	drc->part_maxsize = MAX(drc->maxsize / drc->npart, 1);
+	drc->part_hiwat = MAX(drc->hiwat / drc->npart, 1);
+}
+
+/**
+ * @brief Return the retirement FIFO of a DRC partition
+ *
+ * @param[in] drc The DRC
+ * @param[in] t   One of drc->xt.tree[]
+ *
+ * @return The matching drc_part.
+ */
+static inline struct drc_part *drc_part_of(drc_t *drc,
+					   struct rbtree_x_part *t)
+{
+	return &drc->part[t - drc->xt.tree];
+}
+
 /**
  * @brief Initialize a shared duplicate request cache
  */
@@ -290,7 +345,7 @@ static inline void init_shared_drc(void)
 	assert(!code);
 
 	/* completed requests */
-	TAILQ_INIT(&drc->dupreq_q);
+	init_drc_parts(drc);
 
 	/* init closed-form "cache" partition */
 	for (ix = 0; ix < drc->npart; ++ix) {
@@ -305,6 +360,11 @@ static inline void init_shared_drc(void)
 /* Cleanup on shutdown */
 void dupreq2_cleanup(void)
 {
+	int ix;
+
+	for (ix = 0; ix < DUPREQ_SLAB_SHARDS; ix++)
+		PTHREAD_MUTEX_destroy(&dupreq_slab[ix].mtx);
+
 	PTHREAD_MUTEX_destroy(&drc_st->drc_st_mtx);
 }
 
@@ -317,7 +377,7 @@ struct cleanup_list_element dupreq2_cleanup_element = {
  */
 void dupreq2_pkginit(void)
 {
-	int code __attribute__((unused)) = 0;
+	int ix, code __attribute__((unused)) = 0;
 
 	dupreq_pool = pool_basic_init("Duplicate Request Pool",
 				      sizeof(dupreq_entry_t));
@@ -328,6 +388,11 @@ void dupreq2_pkginit(void)
 
 	drc_st = gsh_calloc(1, sizeof(struct drc_st));
 
+	for (ix = 0; ix < DUPREQ_SLAB_SHARDS; ix++) {
+		PTHREAD_MUTEX_init(&dupreq_slab[ix].mtx, NULL);
+		TAILQ_INIT(&dupreq_slab[ix].free_q);
+	}
+
 	/* init shared statics */
 	PTHREAD_MUTEX_init(&drc_st->drc_st_mtx, NULL);
 
@@ -421,7 +486,7 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
 	assert(!code);
 
 	/* completed requests */
-	TAILQ_INIT(&drc->dupreq_q);
+	init_drc_parts(drc);
 
 	/* recycling DRC */
 	TAILQ_INIT_ENTRY(drc, d_u.tcp.recycle_q);
@@ -454,6 +519,7 @@ static inline void free_tcp_drc(drc_t *drc)
 			gsh_free(drc->xt.tree[ix].cache);
 	}
 	rbtx_cleanup(&drc->xt);
+	gsh_free(drc->part);
 	PTHREAD_MUTEX_destroy(&drc->drc_mtx);
 	LogFullDebug(COMPONENT_DUPREQ, "free TCP drc %p", drc);
 	pool_free(tcp_drc_pool, drc);
@@ -468,7 +534,7 @@ static inline void free_tcp_drc(drc_t *drc)
  */
 static inline uint32_t nfs_dupreq_ref_drc(drc_t *drc)
 {
-	return ++(drc->refcnt); /* locked */
+	return atomic_inc_uint32_t(&drc->refcnt);
 }
 
 /**
@@ -480,7 +546,7 @@ static inline uint32_t nfs_dupreq_ref_drc(drc_t *drc)
  */
 static inline uint32_t nfs_dupreq_unref_drc(drc_t *drc)
 {
-	return --(drc->refcnt); /* locked */
+	return atomic_dec_uint32_t(&drc->refcnt);
 }
 
 #define DRC_ST_LOCK() PTHREAD_MUTEX_lock(&drc_st->drc_st_mtx)
@@ -502,6 +568,7 @@ static inline void drc_free_expired(void)
 	struct opr_rbtree_node *odrc = NULL;
 	struct dupreq_entry *dv;
 	struct dupreq_entry *tdv;
+	int ix;
 
 	DRC_ST_LOCK();
 
@@ -539,16 +606,20 @@ static inline void drc_free_expired(void)
 
 			/* Free any dupreqs in this drc. No need to
 			 * remove dupreqs from the hash table or
-			 * drc->dupreq_q list individually as the drc is
+			 * partition lists individually as the drc is
 			 * going to be freed anyway.  There shouldn't be
 			 * any active requests, so all these dupreqs
 			 * will have refcnt of 1 for being in the hash
 			 * table.
 			 */
-			TAILQ_FOREACH_SAFE(dv, &drc->dupreq_q, fifo_q, tdv)
-			{
-				assert(dv->refcnt == 1);
-				dupreq_entry_put(dv);
+			for (ix = 0; ix < drc->npart; ++ix) {
+				TAILQ_FOREACH_SAFE(dv,
+						   &drc->part[ix].dupreq_q,
+						   fifo_q, tdv)
+				{
+					assert(dv->refcnt == 1);
+					dupreq_entry_put(dv);
+				}
 			}
 			free_tcp_drc(drc);
 		} else {
@@ -596,10 +667,14 @@ retry:
 		 */
 		drc = (drc_t *)req->rq_xprt->xp_u2;
 		if (drc) {
-			/* found, no danger of removal */
+			/* found, no danger of removal.  The xprt holds a
+			 * ref, so the call path ref can't raise refcnt
+			 * from zero and needs no lock.
+			 */
 			LogFullDebug(COMPONENT_DUPREQ, "ref DRC=%p for xprt=%p",
 				     drc, req->rq_xprt);
-			PTHREAD_MUTEX_lock(&drc->drc_mtx); /* LOCKED */
+			(void)nfs_dupreq_ref_drc(drc);
+			goto out;
 		} else {
 			drc_t drc_k;
 			struct rbtree_x_part *t = NULL;
@@ -730,40 +805,36 @@ out:
  */
 void nfs_dupreq_put_drc(drc_t *drc)
 {
-	PTHREAD_MUTEX_lock(&drc->drc_mtx);
+	uint32_t refcnt;
 
 	/* refcnt is not used on shared UDP DRC, so nothing to do */
 	if (drc->type == DRC_UDP_V234)
-		goto unlock;
+		return;
 
 	assert(drc->type == DRC_TCP_V3 || drc->type == DRC_TCP_V4);
 
-	if (drc->refcnt == 0) {
-		LogCrit(COMPONENT_DUPREQ,
-			"drc %p refcnt will underrun refcnt=%u", drc,
-			drc->refcnt);
-	}
+	refcnt = nfs_dupreq_unref_drc(drc);
 
-	nfs_dupreq_unref_drc(drc);
+	if (refcnt == UINT32_MAX) {
+		LogCrit(COMPONENT_DUPREQ, "drc %p refcnt underrun", drc);
+	}
 
-	LogFullDebug(COMPONENT_DUPREQ, "drc %p refcnt==%u", drc, drc->refcnt);
+	LogFullDebug(COMPONENT_DUPREQ, "drc %p refcnt==%u", drc, refcnt);
 
-	if (drc->refcnt != 0) /* quick path */
-		goto unlock;
+	if (refcnt != 0) /* quick path */
+		return;
 
-	/* note t's lock order wrt drc->drc_mtx is the opposite of
-	 * drc->xt[*].lock. Drop and reacquire locks in correct
-	 * order.
+	/* The recycle queue is protected by DRC_ST_LOCK, which is taken
+	 * before drc->drc_mtx.
 	 */
-	PTHREAD_MUTEX_unlock(&drc->drc_mtx);
 	DRC_ST_LOCK();
 	PTHREAD_MUTEX_lock(&drc->drc_mtx);
 
-	/* Since we dropped and reacquired the drc lock for the
-	 * correct lock order, we need to recheck the drc fields
-	 * again!
+	/* The DRC may have been picked up again by a reconnection
+	 * before we got the locks, so recheck the drc fields!
 	 */
-	if (drc->refcnt == 0 && !(drc->flags & DRC_FLAG_RECYCLE)) {
+	if (atomic_fetch_uint32_t(&drc->refcnt) == 0 &&
+	    !(drc->flags & DRC_FLAG_RECYCLE)) {
 		drc->d_u.tcp.recycle_time = time(NULL);
 		drc->flags |= DRC_FLAG_RECYCLE;
 		TAILQ_INSERT_TAIL(&drc_st->tcp_drc_recycle_q, drc,
@@ -773,8 +844,6 @@ void nfs_dupreq_put_drc(drc_t *drc)
 			     drc);
 	}
 	DRC_ST_UNLOCK();
-
-unlock:
 	PTHREAD_MUTEX_unlock(&drc->drc_mtx);
 }
 
@@ -859,21 +928,58 @@ static inline const nfs_function_desc_t *nfs_dupreq_func(dupreq_entry_t *dv)
 	return func;
 }
 
+/**
+ * @brief Return this thread's dupreq slab shard
+ */
+static inline struct dupreq_slab *dupreq_slab_get(void)
+{
+	if (unlikely(dupreq_slab_shard < 0))
+		dupreq_slab_shard = atomic_postinc_uint32_t(&dupreq_slab_next) %
+				    DUPREQ_SLAB_SHARDS;
+
+	return &dupreq_slab[dupreq_slab_shard];
+}
+
 /**
  * @brief Construct a duplicate request cache entry.
  *
- * Entries are allocated from the dupreq_pool.  Since dupre_entry_t
- * presently contains an expanded nfs_arg_t, zeroing of at least corresponding
- * value pointers is required for XDR allocation.
+ * Entries come from a sharded slab of preallocated entries whose
+ * dre_mtx stays initialized while they are idle.  An empty shard is
+ * refilled from the dupreq_pool DUPREQ_SLAB_REFILL entries at a time.
  *
- * @return The newly allocated dupreq entry or NULL.
+ * @return The newly allocated dupreq entry.
  */
 static inline dupreq_entry_t *alloc_dupreq(void)
 {
+	struct dupreq_slab *slab = dupreq_slab_get();
 	dupreq_entry_t *dv;
+	int i;
+
+	PTHREAD_MUTEX_lock(&slab->mtx);
+
+	if (TAILQ_EMPTY(&slab->free_q)) {
+		for (i = 0; i < DUPREQ_SLAB_REFILL; i++) {
+			dv = pool_alloc(dupreq_pool);
+			PTHREAD_MUTEX_init(&dv->dre_mtx, NULL);
+			TAILQ_INSERT_TAIL(&slab->free_q, dv, fifo_q);
+		}
+		slab->count += DUPREQ_SLAB_REFILL;
+	}
+
+	dv = TAILQ_FIRST(&slab->free_q);
+	TAILQ_REMOVE(&slab->free_q, dv, fifo_q);
+	slab->count--;
 
-	dv = pool_alloc(dupreq_pool);
-	PTHREAD_MUTEX_init(&dv->dre_mtx, NULL);
+	PTHREAD_MUTEX_unlock(&slab->mtx);
+
+	memset(&dv->rbt_k, 0, sizeof(dv->rbt_k));
+	memset(&dv->hin, 0, sizeof(dv->hin));
+	dv->hk = 0;
+	dv->complete = false;
+	dv->refcnt = 0;
+	dv->res = NULL;
+	dv->rc = NFS_REQ_OK;
+	dv->dupe_cnt = 0;
 	TAILQ_INIT_ENTRY(dv, fifo_q);
 	TAILQ_INIT(&dv->dupes);
 
@@ -885,11 +991,12 @@ static inline dupreq_entry_t *alloc_dupreq(void)
  *
  * If the entry has processed request data, the corresponding free
  * function is called on the result.  The cache entry is then returned
- * to the dupreq_pool.
+ * to the slab, or to the dupreq_pool if the slab shard is full.
  */
 static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
 {
 	const nfs_function_desc_t *func;
+	struct dupreq_slab *slab;
 
 	assert(dv->refcnt == 0);
 
@@ -903,8 +1010,23 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
 		func->free_function(dv->res);
 		free_nfs_res(dv->res);
 	}
-	PTHREAD_MUTEX_destroy(&dv->dre_mtx);
-	pool_free(dupreq_pool, dv);
+
+	slab = dupreq_slab_get();
+
+	PTHREAD_MUTEX_lock(&slab->mtx);
+
+	if (slab->count < DUPREQ_SLAB_MAX) {
+		TAILQ_INSERT_HEAD(&slab->free_q, dv, fifo_q);
+		slab->count++;
+		dv = NULL;
+	}
+
+	PTHREAD_MUTEX_unlock(&slab->mtx);
+
+	if (dv != NULL) {
+		PTHREAD_MUTEX_destroy(&dv->dre_mtx);
+		pool_free(dupreq_pool, dv);
+	}
 }
 
 /**
@@ -953,54 +1075,58 @@ static inline void dupreq_entry_put(dupreq_entry_t *dv)
 /**
  * @brief advance retwnd.
  *
- * If (drc)->retwnd is 0, advance its value to RETWND_START_BIAS, else
- * increase its value by 2 (corrects to 1) iff !full.
+ * If drc->retwnd is 0, advance its value to RETWND_START_BIAS, else
+ * increase its value by 2 (corrects to 1) iff !full.  The window is a
+ * heuristic, so racing updates are tolerated rather than locked out.
  *
  * @param[in] drc The duplicate request cache
  */
-#define drc_inc_retwnd(drc)                                \
-	do {                                               \
-		if ((drc)->retwnd == 0)                    \
-			(drc)->retwnd = RETWND_START_BIAS; \
-		else if ((drc)->retwnd < (drc)->maxsize)   \
-			(drc)->retwnd += 2;                \
-	} while (0)
+static inline void drc_inc_retwnd(drc_t *drc)
+{
+	uint32_t retwnd = atomic_fetch_uint32_t(&drc->retwnd);
+
+	if (retwnd == 0)
+		atomic_store_uint32_t(&drc->retwnd, RETWND_START_BIAS);
+	else if (retwnd < drc->maxsize)
+		atomic_add_uint32_t(&drc->retwnd, 2);
+}
 
 /**
  * @brief conditionally decrement retwnd.
  *
- * If (drc)->retwnd > 0, decrease its value by 1.
+ * If drc->retwnd > 0, decrease its value by 1.
  *
  * @param[in] drc The duplicate request cache
  */
-#define drc_dec_retwnd(drc)                \
-	do {                               \
-		if ((drc)->retwnd > 0)     \
-			--((drc)->retwnd); \
-	} while (0)
+static inline void drc_dec_retwnd(drc_t *drc)
+{
+	(void)atomic_add_unless_uint32_t(&drc->retwnd, UINT32_MAX, 0);
+}
 
 /**
  * @brief retire request predicate.
  *
- * Calculate whether a request may be retired from the provided duplicate
- * request cache.
+ * Calculate whether a request may be retired from the provided
+ * partition of a duplicate request cache.  The partition lock must be
+ * held.
  *
  * @param[in] drc The duplicate request cache
+ * @param[in] dp  The partition
  *
  * @return true if a request may be retired, else false.
  */
-static inline bool drc_should_retire(drc_t *drc)
+static inline bool drc_should_retire(drc_t *drc, struct drc_part *dp)
 {
 	/* do not exceed the hard bound on cache size */
-	if (unlikely(drc->size > drc->maxsize))
+	if (unlikely(dp->size > drc->part_maxsize))
 		return true;
 
 	/* otherwise, are we permitted to retire requests */
-	if (unlikely(drc->retwnd > 0))
+	if (unlikely(atomic_fetch_uint32_t(&drc->retwnd) > 0))
 		return false;
 
-	/* finally, retire if drc->size is above intended high water mark */
-	if (unlikely(drc->size > drc->hiwat))
+	/* finally, retire if size is above intended high water mark */
+	if (unlikely(dp->size > drc->part_hiwat))
 		return true;
 
 	return false;
@@ -1040,6 +1166,7 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs)
 	dupreq_entry_t *dv = NULL, *dk = NULL;
 	drc_t *drc;
 	dupreq_status_t status = DUPREQ_SUCCESS;
+	struct timespec s_time, e_time;
 
 	if (!(reqnfs->funcdesc->dispatch_behaviour & CAN_BE_DUP))
 		goto no_cache;
@@ -1085,6 +1212,9 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs)
 		struct opr_rbtree_node *nv;
 		struct rbtree_x_part *t =
 			rbtx_partition_of_scalar(&drc->xt, dk->hk);
+		struct drc_part *dp = drc_part_of(drc, t);
+
+		now(&s_time);
 		PTHREAD_MUTEX_lock(&t->mtx); /* partition lock */
 		nv = rbtree_x_cached_lookup(&drc->xt, t, &dk->rbt_k, dk->hk);
 		if (nv) {
@@ -1140,10 +1270,8 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs)
 
 			PTHREAD_MUTEX_unlock(&dv->dre_mtx);
 
-			PTHREAD_MUTEX_lock(&drc->drc_mtx);
 			/* Extend window */
 			drc_inc_retwnd(drc);
-			PTHREAD_MUTEX_unlock(&drc->drc_mtx);
 		} else {
 			/* new request */
 			reqnfs->svc.rq_u1 = dk;
@@ -1159,11 +1287,10 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs)
 			 */
 			dk->refcnt = 2;
 
-			/* add to q tail */
-			PTHREAD_MUTEX_lock(&drc->drc_mtx);
-			TAILQ_INSERT_TAIL(&drc->dupreq_q, dk, fifo_q);
-			++(drc->size);
-			PTHREAD_MUTEX_unlock(&drc->drc_mtx);
+			/* add to partition q tail */
+			TAILQ_INSERT_TAIL(&dp->dupreq_q, dk, fifo_q);
+			++(dp->size);
+			(void)atomic_inc_uint32_t(&drc->size);
 
 			LogFullDebug(
 				COMPONENT_DUPREQ,
@@ -1175,6 +1302,12 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs)
 				drc->size);
 		}
 		PTHREAD_MUTEX_unlock(&t->mtx);
+
+		now(&e_time);
+		if (status == DUPREQ_SUCCESS)
+			nfs_metrics__drc_insert(timespec_diff(&s_time, &e_time));
+		else
+			nfs_metrics__drc_hit(timespec_diff(&s_time, &e_time));
 	}
 
 	return status;
@@ -1194,8 +1327,9 @@ no_cache:
  *
  * In contrast with the prior DRC implementation, completing a request
  * in the current implementation may under normal conditions cause one
- * or more cached requests to be retired.  Requests are retired in the
- * order they were inserted.  The primary retire algorithm is a high
+ * or more cached requests to be retired.  Requests are retired, up to
+ * DUPREQ_RETIRE_BATCH at a time, in the order they were inserted into
+ * the partition of the completed request.  The primary retire algorithm is a high
  * water mark, and a windowing heuristic.  One or more requests will be
  * retired if the water mark/timeout is exceeded, and if a no duplicate
  * requests have been found in the cache in a configurable window of
@@ -1212,9 +1346,12 @@ no_cache:
 void nfs_dupreq_finish(nfs_request_t *reqnfs, enum nfs_req_result rc)
 {
 	dupreq_entry_t *ov = NULL, *dv = reqnfs->svc.rq_u1;
+	dupreq_entry_t *retired[DUPREQ_RETIRE_BATCH];
 	struct rbtree_x_part *t;
+	struct drc_part *dp;
 	drc_t *drc = NULL;
-	int16_t cnt = 0;
+	struct timespec s_time, e_time;
+	int cnt = 0, ix;
 
 	/* do nothing if req is marked no-cache */
 	if (dv == DUPREQ_NOCACHE || dv == DUPREQ_NOCACHE_NORES)
@@ -1243,7 +1380,6 @@ void nfs_dupreq_finish(nfs_request_t *reqnfs, enum nfs_req_result rc)
 	PTHREAD_MUTEX_unlock(&dv->dre_mtx);
 
 	drc = reqnfs->svc.rq_xprt->xp_u2; /* req holds a ref on drc */
-	PTHREAD_MUTEX_lock(&drc->drc_mtx);
 
 	LogFullDebug(COMPONENT_DUPREQ,
 		     "completing dv=%p xid=%" PRIu32
@@ -1254,67 +1390,60 @@ void nfs_dupreq_finish(nfs_request_t *reqnfs, enum nfs_req_result rc)
 	/* (all) finished requests count against retwnd */
 	drc_dec_retwnd(drc);
 
-	/* conditionally retire entries */
-dq_again:
-	if (drc_should_retire(drc)) {
-		ov = TAILQ_FIRST(&drc->dupreq_q);
-		if (likely(ov)) {
-			/* remove dict entry */
-			t = rbtx_partition_of_scalar(&drc->xt, ov->hk);
-			uint64_t ov_hk = ov->hk;
-
-			/* Need to acquire partition lock, but the lock
-			 * order is partition lock followed by drc lock.
-			 * Drop drc lock and reacquire it!
-			 */
-			PTHREAD_MUTEX_unlock(&drc->drc_mtx);
-			PTHREAD_MUTEX_lock(&t->mtx); /* partition lock */
-			PTHREAD_MUTEX_lock(&drc->drc_mtx);
+	/* conditionally retire entries, from the partition of this request
+	 * since partitions fill evenly and each one is retired under its
+	 * own lock.
+	 */
+	t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
+	dp = drc_part_of(drc, t);
 
-			/* Since we dropped drc lock and reacquired it,
-			 * the drc dupreq list may have changed. Get the
-			 * dupreq entry from the list again.
-			 */
-			ov = TAILQ_FIRST(&drc->dupreq_q);
+	/* Unlocked peek, most completions have nothing to retire */
+	if (!drc_should_retire(drc, dp))
+		return;
 
-			/* Make sure that we are removing the entry we
-			 * expected (imperfect, but harmless).
-			 */
-			if (ov == NULL || ov->hk != ov_hk) {
-				PTHREAD_MUTEX_unlock(&t->mtx);
-				goto unlock;
-			}
+	now(&s_time);
+	PTHREAD_MUTEX_lock(&t->mtx); /* partition lock */
 
-			/* remove q entry */
-			TAILQ_REMOVE(&drc->dupreq_q, ov, fifo_q);
-			TAILQ_INIT_ENTRY(ov, fifo_q);
-			--(drc->size);
-			PTHREAD_MUTEX_unlock(&drc->drc_mtx);
+	while (cnt < DUPREQ_RETIRE_BATCH && drc_should_retire(drc, dp)) {
+		ov = TAILQ_FIRST(&dp->dupreq_q);
+		if (unlikely(!ov))
+			break;
 
-			rbtree_x_cached_remove(&drc->xt, t, &ov->rbt_k, ov->hk);
+		/* remove q entry */
+		TAILQ_REMOVE(&dp->dupreq_q, ov, fifo_q);
+		TAILQ_INIT_ENTRY(ov, fifo_q);
+		--(dp->size);
 
-			PTHREAD_MUTEX_unlock(&t->mtx);
+		/* remove dict entry */
+		rbtree_x_cached_remove(&drc->xt, t, &ov->rbt_k, ov->hk);
 
-			LogDebug(COMPONENT_DUPREQ,
-				 "retiring ov=%p xid=%" PRIu32
-				 " on DRC=%p state=%s, refcnt=%d",
-				 ov, ov->hin.tcp.rq_xid, drc,
-				 dupreq_state_table[ov->complete], ov->refcnt);
-
-			/* release hashtable ref count */
-			dupreq_entry_put(ov);
-
-			/* conditionally retire another */
-			if (cnt++ < DUPREQ_MAX_RETRIES) {
-				PTHREAD_MUTEX_lock(&drc->drc_mtx);
-				goto dq_again; /* calls drc_should_retire() */
-			}
-			return;
-		}
+		retired[cnt++] = ov;
 	}
 
-unlock:
-	PTHREAD_MUTEX_unlock(&drc->drc_mtx);
+	PTHREAD_MUTEX_unlock(&t->mtx);
+
+	if (cnt == 0)
+		return;
+
+	(void)atomic_sub_uint32_t(&drc->size, cnt);
+
+	/* Release the hashtable refs outside the partition lock, freeing
+	 * the cached responses may take a while.
+	 */
+	for (ix = 0; ix < cnt; ix++) {
+		ov = retired[ix];
+
+		LogDebug(COMPONENT_DUPREQ,
+			 "retiring ov=%p xid=%" PRIu32
+			 " on DRC=%p state=%s, refcnt=%d",
+			 ov, ov->hin.tcp.rq_xid, drc,
+			 dupreq_state_table[ov->complete], ov->refcnt);
+
+		dupreq_entry_put(ov);
+	}
+
+	now(&e_time);
+	nfs_metrics__drc_retire(timespec_diff(&s_time, &e_time), cnt);
 }
 
 /**
@@ -1336,6 +1465,7 @@ void nfs_dupreq_delete(nfs_request_t *reqnfs, enum nfs_req_result rc)
 {
 	dupreq_entry_t *dv = reqnfs->svc.rq_u1;
 	struct rbtree_x_part *t;
+	struct drc_part *dp;
 	drc_t *drc;
 
 	/* do nothing if req is marked no-cache */
@@ -1384,22 +1514,22 @@ void nfs_dupreq_delete(nfs_request_t *reqnfs, enum nfs_req_result rc)
 	 * req holds a ref on drc, so it should be valid here.
 	 * assert(drc == (drc_t *)reqnfs->svc.rq_xprt->xp_u2);
 	 */
-	PTHREAD_MUTEX_lock(&drc->drc_mtx);
+	t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
+	dp = drc_part_of(drc, t);
+
+	PTHREAD_MUTEX_lock(&t->mtx);
 	if (!TAILQ_IS_ENQUEUED(dv, fifo_q)) {
-		PTHREAD_MUTEX_unlock(&drc->drc_mtx);
+		PTHREAD_MUTEX_unlock(&t->mtx);
 		return; /* no more in the hash table/list, nothing todo */
 	}
-	TAILQ_REMOVE(&drc->dupreq_q, dv, fifo_q);
+	TAILQ_REMOVE(&dp->dupreq_q, dv, fifo_q);
 	TAILQ_INIT_ENTRY(dv, fifo_q);
-	--(drc->size);
-	PTHREAD_MUTEX_unlock(&drc->drc_mtx);
-
-	t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
-
-	PTHREAD_MUTEX_lock(&t->mtx);
+	--(dp->size);
 	rbtree_x_cached_remove(&drc->xt, t, &dv->rbt_k, dv->hk);
 	PTHREAD_MUTEX_unlock(&t->mtx);
 
+	(void)atomic_dec_uint32_t(&drc->size);
+
 	/* we removed the dupreq from hashtable, release a ref */
 	dupreq_entry_put(dv);
 }
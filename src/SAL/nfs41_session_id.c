@@ -220,7 +220,7 @@ static hash_parameter_t session_id_param = {
 	.compare_key = compare_session_id,
 	.display_key = display_session_id_key,
 	.display_val = display_session_id_val,
-	.flags = HT_FLAG_CACHE,
+	.flags = HT_FLAG_CACHE | HT_FLAG_LOCKLESS_READ,
 };
 
 /**
@@ -271,6 +271,31 @@ int32_t _inc_session_ref(nfs41_session_t *session, const char *func, int line)
 	return refcnt;
 }
 
+static void free_session_rcu(struct rcu_head *head)
+{
+	pool_free(nfs41_session_pool,
+		  container_of(head, nfs41_session_t, session_rcu));
+}
+
+/**
+ * @brief Take a reference on a session found in ht_session_id
+ *
+ * @param[in] val Buffer descriptor for the session
+ *
+ * @retval true if the reference was taken.
+ * @retval false if the session is being freed.
+ */
+static bool session_id_tryref(struct gsh_buffdesc *val)
+{
+	nfs41_session_t *session = val->addr;
+	int32_t refcnt = atomic_inc_unless_0_int32_t(&session->refcount);
+
+	GSH_AUTO_TRACEPOINT(nfs4, incref, TRACE_INFO,
+			    "Session incref. Session: {}, refcount: {}",
+			    session, refcnt);
+	return refcnt != 0;
+}
+
 int32_t _dec_session_ref(nfs41_session_t *session, const char *func, int line)
 {
 	int i;
@@ -334,8 +359,10 @@ int32_t _dec_session_ref(nfs41_session_t *session, const char *func, int line)
 		gsh_free(session->fc_slots);
 		gsh_free(session->bc_slots);
 
-		/* Free the memory for the session */
-		pool_free(nfs41_session_pool, session);
+		/* Free the memory for the session once lockless lookups
+		 * of ht_session_id can no longer be looking at it.
+		 */
+		call_rcu(&session->session_rcu, free_session_rcu);
 	}
 
 	return refcnt;
@@ -400,7 +427,6 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 {
 	struct gsh_buffdesc key;
 	struct gsh_buffdesc val;
-	struct hash_latch latch;
 	char str[LOG_BUFF_LEN] = "\0";
 	struct display_buffer dspbuf = { sizeof(str), str, str };
 	bool str_valid = false;
@@ -415,9 +441,8 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 	key.addr = sessionid;
 	key.len = NFS4_SESSIONID_SIZE;
 
-	code = hashtable_getlatch(ht_session_id, &key, &val, false, &latch);
+	code = hashtable_tryref(ht_session_id, &key, &val, session_id_tryref);
 	if (code != HASHTABLE_SUCCESS) {
-		hashtable_releaselatched(ht_session_id, &latch);
 		if (str_valid)
 			LogFullDebug(COMPONENT_SESSIONS, "Session %s Not Found",
 				     str);
@@ -425,9 +450,6 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 	}
 
 	*session_data = val.addr;
-	inc_session_ref(*session_data); /* XXX more locks? */
-
-	hashtable_releaselatched(ht_session_id, &latch);
 
 	if (str_valid)
 		LogFullDebug(COMPONENT_SESSIONS, "Session %s Found", str);
@@ -311,7 +311,7 @@ static hash_parameter_t state_id_param = {
 	.compare_key = compare_state_id,
 	.display_key = display_state_id_key,
 	.display_val = display_state_id_val,
-	.flags = HT_FLAG_CACHE,
+	.flags = HT_FLAG_CACHE | HT_FLAG_LOCKLESS_READ,
 	.ht_log_component = COMPONENT_STATE,
 	.ht_name = "State ID Table"
 };
@@ -479,6 +479,11 @@ void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
 	       sizeof(my_stateid));
 }
 
+static void free_state_rcu(struct rcu_head *head)
+{
+	free_state(container_of(head, struct state_t, state_rcu));
+}
+
 /**
  * @brief Relinquish a reference on a state_t
  *
@@ -511,7 +516,10 @@ void dec_nfs4_state_ref(struct state_t *state)
 
 	PTHREAD_MUTEX_destroy(&state->state_mutex);
 
-	free_state(state);
+	/* ht_state_id is searched without a lock, so a lookup may still be
+	 * looking at this state.
+	 */
+	call_rcu(&state->state_rcu, free_state_rcu);
 
 	if (str_valid)
 		LogFullDebug(COMPONENT_STATE, "Deleted %s", str);
@@ -606,6 +614,21 @@ state_status_t nfs4_State_Set(state_t *state)
 	}
 }
 
+/**
+ * @brief Take a reference on a state found in ht_state_id
+ *
+ * @param[in] val Buffer descriptor for the state
+ *
+ * @retval true if the reference was taken.
+ * @retval false if the state is being freed.
+ */
+static bool state_id_tryref(struct gsh_buffdesc *val)
+{
+	struct state_t *state = val->addr;
+
+	return atomic_inc_unless_0_int32_t(&state->state_refcount) != 0;
+}
+
 /**
  * @brief Get the state from the stateid
  *
@@ -618,43 +641,25 @@ struct state_t *nfs4_State_Get_Pointer(char *other)
 	struct gsh_buffdesc buffkey;
 	struct gsh_buffdesc buffval;
 	hash_error_t rc;
-	struct hash_latch latch;
 	struct state_t *state;
 
 	buffkey.addr = other;
 	buffkey.len = OTHERSIZE;
 
-	/* Acquire hashtable latch with may_write == false, as we are not
-	 * updating hashtable data structures but rather we are atomically
-	 * incrementing state_t refcount below. This allows concurrent reads
-	 * from this data structure without contending on hashtable writer
-	 * lock and since the state_t refcount itself is atomic, we are
-	 * thread safe. Furthermore, all writes to the ht_state_id hashtable
-	 * are private to this implementation file and are done under may_write
-	 * lock, so that calls to decrement the state reference count would
-	 * be done under exclusive writer lock.
+	/* ht_state_id is searched without taking any lock, so the reference
+	 * must be taken with state_id_tryref, which refuses a state whose
+	 * last reference is already gone.
 	 */
-	rc = hashtable_getlatch(ht_state_id, &buffkey, &buffval,
-				false /* may_write */, &latch);
+	rc = hashtable_tryref(ht_state_id, &buffkey, &buffval,
+			      state_id_tryref);
 
 	if (rc != HASHTABLE_SUCCESS) {
-		if (rc == HASHTABLE_ERROR_NO_SUCH_KEY)
-			hashtable_releaselatched(ht_state_id, &latch);
 		LogDebug(COMPONENT_STATE, "HashTable_Get returned %d", rc);
 		return NULL;
 	}
 
 	state = buffval.addr;
 
-	/* Take an atomic reference under latch. Hashtable is currently read
-	 * locked, so this state can't be invalidated while this atomic
-	 * increment is occurring.
-	 */
-	inc_state_t_ref(state);
-
-	/* Release latch, which releases hashtable read lock */
-	hashtable_releaselatched(ht_state_id, &latch);
-
 	return state;
 }
 
@@ -97,6 +97,100 @@ struct glist_head state_blocked_locks = GLIST_HEAD_INIT(state_blocked_locks);
  */
 pthread_mutex_t blocked_locks_mutex;
 
+/* It looks like when we report OPEN4_RESULT_MAY_NOTIFY_LOCK, the client polls
+ * exactly every lease time. This creates a race where the poll request arrives
+ * after we cancel the lock. For this reason, we add a small time buffer.
+ */
+#define POLL_TIME_CANCEL_BUFFER_SEC (5)
+
+/**
+ * @brief Blocked lock timer wheel
+ *
+ * Blocked locks that need looking at later, NFSv4 locks to re-test or
+ * expire and NLM locks that have to be polled, hang off the slot for the
+ * second they are next due.  The poller then only visits the locks that
+ * are due instead of every blocked lock.  Protected by blocked_locks_mutex.
+ */
+#define BLOCKED_LOCK_WHEEL_SLOTS 1024
+
+static struct glist_head blocked_lock_wheel[BLOCKED_LOCK_WHEEL_SLOTS];
+
+/** Last second the poller went through */
+static time_t blocked_lock_wheel_time;
+
+/**
+ * @brief Work out when a blocked lock next needs attention
+ *
+ * @param[in] pblock Block data of the lock
+ * @param[in] now    Current time
+ *
+ * @return the time, or 0 if the lock does not need polling.
+ */
+static time_t blocked_lock_next_due(state_block_data_t *pblock, time_t now)
+{
+	state_lock_entry_t *lock_entry = pblock->sbd_lock_entry;
+	int64_t interval = nfs_param.core_param.blocked_lock_poller_interval;
+	time_t lease = nfs_param.nfsv4_param.lease_lifetime;
+	time_t when;
+
+	if (lock_entry == NULL)
+		return 0;
+
+	if (interval < 1)
+		interval = 1;
+
+	if (lock_entry->sle_protocol != LOCK_NFSv4) {
+		/* Only polled NLM locks need us, others wait for an event */
+		if (pblock->sbd_block_type != STATE_BLOCK_POLL)
+			return 0;
+
+		return now + interval;
+	}
+
+	if (lock_entry->sle_blocked == STATE_AVAILABLE)
+		when = pblock->sbd_prot.sbd_v4.snbd_notified_eligible_time +
+		       lease + POLL_TIME_CANCEL_BUFFER_SEC;
+	else
+		when = pblock->sbd_prot.sbd_v4.snbd_last_poll_time + 2 * lease;
+
+	/* Once past due, look again every poll interval as long as the
+	 * lock sticks around.
+	 */
+	return when > now ? when : now + interval;
+}
+
+/**
+ * @brief Put a blocked lock on the timer wheel
+ *
+ * Must hold blocked_locks_mutex.
+ *
+ * @param[in,out] pblock Block data of the lock
+ * @param[in]     due    When it is due, 0 to take it off the wheel
+ */
+static void blocked_lock_arm(state_block_data_t *pblock, time_t due)
+{
+	glist_del(&pblock->sbd_timer);
+	pblock->sbd_due = due;
+
+	if (due != 0)
+		glist_add_tail(&blocked_lock_wheel[due %
+						   BLOCKED_LOCK_WHEEL_SLOTS],
+			       &pblock->sbd_timer);
+}
+
+/**
+ * @brief Take a lock off the blocked lock list and timer wheel
+ *
+ * Must hold blocked_locks_mutex.
+ *
+ * @param[in,out] pblock Block data of the lock
+ */
+static inline void blocked_lock_unlist(state_block_data_t *pblock)
+{
+	glist_del(&pblock->sbd_list);
+	glist_del(&pblock->sbd_timer);
+}
+
 /**
  * @brief Owner of state with no defined owner
  */
@@ -652,7 +746,7 @@ void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 				return;
 			}
 
-			glist_del(&lock_entry->sle_block_data->sbd_list);
+			blocked_lock_unlist(lock_entry->sle_block_data);
 			PTHREAD_MUTEX_unlock(&blocked_locks_mutex);
 
 			gsh_free(lock_entry->sle_block_data);
@@ -682,6 +776,308 @@ void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 	}
 }
 
+/******************************************************************************
+ *
+ * Byte-range lock interval tree
+ *
+ * Every entry on a file's lock_list is also in the file's lock_tree, an
+ * AVL tree ordered by (lock start, entry address) where each node also
+ * carries the largest lock end of its subtree.  Finding the locks that
+ * overlap a range is then O(log n + k) rather than a walk of the whole
+ * list.  The list is kept for the callers that do want every lock.
+ *
+ * The lock range of an entry is the tree key, so it may only be changed
+ * while the entry is out of the tree.
+ *
+ ******************************************************************************/
+
+static inline int32_t lock_tree_height(state_lock_entry_t *node)
+{
+	return node != NULL ? node->sle_tree.height : 0;
+}
+
+static inline bool lock_tree_before(state_lock_entry_t *a,
+				    state_lock_entry_t *b)
+{
+	if (a->sle_lock.lock_start != b->sle_lock.lock_start)
+		return a->sle_lock.lock_start < b->sle_lock.lock_start;
+
+	return (uintptr_t)a < (uintptr_t)b;
+}
+
+static void lock_tree_update(state_lock_entry_t *node)
+{
+	state_lock_entry_t *left = node->sle_tree.left;
+	state_lock_entry_t *right = node->sle_tree.right;
+	int32_t hl = lock_tree_height(left), hr = lock_tree_height(right);
+	uint64_t max_end = lock_end(&node->sle_lock);
+
+	if (left != NULL && left->sle_tree.max_end > max_end)
+		max_end = left->sle_tree.max_end;
+
+	if (right != NULL && right->sle_tree.max_end > max_end)
+		max_end = right->sle_tree.max_end;
+
+	node->sle_tree.height = (hl > hr ? hl : hr) + 1;
+	node->sle_tree.max_end = max_end;
+}
+
+static state_lock_entry_t *lock_tree_rotate_right(state_lock_entry_t *node)
+{
+	state_lock_entry_t *left = node->sle_tree.left;
+
+	node->sle_tree.left = left->sle_tree.right;
+	left->sle_tree.right = node;
+	lock_tree_update(node);
+	lock_tree_update(left);
+
+	return left;
+}
+
+static state_lock_entry_t *lock_tree_rotate_left(state_lock_entry_t *node)
+{
+	state_lock_entry_t *right = node->sle_tree.right;
+
+	node->sle_tree.right = right->sle_tree.left;
+	right->sle_tree.left = node;
+	lock_tree_update(node);
+	lock_tree_update(right);
+
+	return right;
+}
+
+static state_lock_entry_t *lock_tree_balance(state_lock_entry_t *node)
+{
+	state_lock_entry_t *left = node->sle_tree.left;
+	state_lock_entry_t *right = node->sle_tree.right;
+	int32_t balance = lock_tree_height(left) - lock_tree_height(right);
+
+	if (balance > 1) {
+		if (lock_tree_height(left->sle_tree.left) <
+		    lock_tree_height(left->sle_tree.right))
+			node->sle_tree.left = lock_tree_rotate_left(left);
+
+		return lock_tree_rotate_right(node);
+	}
+
+	if (balance < -1) {
+		if (lock_tree_height(right->sle_tree.right) <
+		    lock_tree_height(right->sle_tree.left))
+			node->sle_tree.right = lock_tree_rotate_right(right);
+
+		return lock_tree_rotate_left(node);
+	}
+
+	lock_tree_update(node);
+	return node;
+}
+
+static state_lock_entry_t *lock_tree_insert_at(state_lock_entry_t *root,
+					       state_lock_entry_t *entry)
+{
+	if (root == NULL) {
+		entry->sle_tree.left = NULL;
+		entry->sle_tree.right = NULL;
+		lock_tree_update(entry);
+		return entry;
+	}
+
+	if (lock_tree_before(entry, root))
+		root->sle_tree.left =
+			lock_tree_insert_at(root->sle_tree.left, entry);
+	else
+		root->sle_tree.right =
+			lock_tree_insert_at(root->sle_tree.right, entry);
+
+	return lock_tree_balance(root);
+}
+
+static state_lock_entry_t *lock_tree_remove_min(state_lock_entry_t *root,
+						state_lock_entry_t **min)
+{
+	if (root->sle_tree.left == NULL) {
+		*min = root;
+		return root->sle_tree.right;
+	}
+
+	root->sle_tree.left = lock_tree_remove_min(root->sle_tree.left, min);
+
+	return lock_tree_balance(root);
+}
+
+static state_lock_entry_t *lock_tree_remove_at(state_lock_entry_t *root,
+					       state_lock_entry_t *entry)
+{
+	state_lock_entry_t *left, *right, *min;
+
+	if (root == entry) {
+		left = root->sle_tree.left;
+		right = root->sle_tree.right;
+
+		if (right == NULL)
+			return left;
+
+		right = lock_tree_remove_min(right, &min);
+		min->sle_tree.left = left;
+		min->sle_tree.right = right;
+
+		return lock_tree_balance(min);
+	}
+
+	if (lock_tree_before(entry, root))
+		root->sle_tree.left =
+			lock_tree_remove_at(root->sle_tree.left, entry);
+	else
+		root->sle_tree.right =
+			lock_tree_remove_at(root->sle_tree.right, entry);
+
+	return lock_tree_balance(root);
+}
+
+/**
+ * @brief Add a lock entry to a file's lock tree
+ *
+ * @note The st_lock MUST be held
+ *
+ * @param[in,out] ostate File state
+ * @param[in,out] entry  Entry to add, must not be in the tree
+ */
+static void lock_tree_insert(struct state_hdl *ostate,
+			     state_lock_entry_t *entry)
+{
+	ostate->file.lock_tree =
+		lock_tree_insert_at(ostate->file.lock_tree, entry);
+
+	if (ostate->file.lock_count++ == 0)
+		ostate->file.lock_export = entry->sle_export;
+
+	if (entry->sle_export == ostate->file.lock_export)
+		ostate->file.lock_export_count++;
+}
+
+/**
+ * @brief Take a lock entry out of a file's lock tree
+ *
+ * @note The st_lock MUST be held
+ *
+ * @param[in,out] ostate File state
+ * @param[in,out] entry  Entry to remove
+ *
+ * @return true if the entry was in the tree.
+ */
+static bool lock_tree_remove(struct state_hdl *ostate,
+			     state_lock_entry_t *entry)
+{
+	if (entry->sle_tree.height == 0)
+		return false;
+
+	ostate->file.lock_tree =
+		lock_tree_remove_at(ostate->file.lock_tree, entry);
+	entry->sle_tree.left = NULL;
+	entry->sle_tree.right = NULL;
+	entry->sle_tree.height = 0;
+
+	ostate->file.lock_count--;
+
+	/* Forget the export once its last lock is gone, so that another
+	 * export allocated at the same address can not be mistaken for it.
+	 */
+	if (entry->sle_export == ostate->file.lock_export &&
+	    --ostate->file.lock_export_count == 0)
+		ostate->file.lock_export = NULL;
+
+	return true;
+}
+
+/**
+ * @brief Add a lock entry to a file's lock list
+ *
+ * @note The st_lock MUST be held
+ *
+ * @param[in,out] ostate File state
+ * @param[in,out] entry  Entry to add
+ */
+static void lock_list_add(struct state_hdl *ostate, state_lock_entry_t *entry)
+{
+	glist_add_tail(&ostate->file.lock_list, &entry->sle_list);
+	lock_tree_insert(ostate, entry);
+}
+
+#define LOCK_TREE_VEC_INLINE 16
+
+/**
+ * @brief Lock entries gathered from a lock tree
+ *
+ * The entries stay valid as long as the st_lock is held and nothing
+ * else removes them, which lets the caller change the tree while
+ * working through them.
+ */
+struct lock_tree_vec {
+	state_lock_entry_t **entries;
+	size_t count;
+	size_t size;
+	state_lock_entry_t *inline_entries[LOCK_TREE_VEC_INLINE];
+};
+
+static inline void lock_tree_vec_init(struct lock_tree_vec *vec)
+{
+	vec->entries = vec->inline_entries;
+	vec->count = 0;
+	vec->size = LOCK_TREE_VEC_INLINE;
+}
+
+static inline void lock_tree_vec_free(struct lock_tree_vec *vec)
+{
+	if (vec->entries != vec->inline_entries)
+		gsh_free(vec->entries);
+
+	lock_tree_vec_init(vec);
+}
+
+static void lock_tree_vec_push(struct lock_tree_vec *vec,
+			       state_lock_entry_t *entry)
+{
+	if (vec->count == vec->size) {
+		state_lock_entry_t **entries;
+
+		entries = gsh_malloc(2 * vec->size * sizeof(*entries));
+		memcpy(entries, vec->entries, vec->count * sizeof(*entries));
+
+		if (vec->entries != vec->inline_entries)
+			gsh_free(vec->entries);
+
+		vec->entries = entries;
+		vec->size *= 2;
+	}
+
+	vec->entries[vec->count++] = entry;
+}
+
+/**
+ * @brief Gather the locks overlapping a range, in start order
+ *
+ * @param[in]     root  Tree to search
+ * @param[in]     start First byte of the range
+ * @param[in]     end   Last byte of the range
+ * @param[in,out] vec   Entries found are appended here
+ */
+static void lock_tree_collect(state_lock_entry_t *root, uint64_t start,
+			      uint64_t end, struct lock_tree_vec *vec)
+{
+	while (root != NULL && root->sle_tree.max_end >= start) {
+		lock_tree_collect(root->sle_tree.left, start, end, vec);
+
+		/* Everything further right starts after this one */
+		if (root->sle_lock.lock_start > end)
+			return;
+
+		if (lock_end(&root->sle_lock) >= start)
+			lock_tree_vec_push(vec, root);
+
+		root = root->sle_tree.right;
+	}
+}
+
 /**
  * @brief Remove an entry from the lock lists
  *
@@ -741,6 +1137,7 @@ static void remove_from_locklist(state_lock_entry_t *lock_entry)
 		lock_entry->sle_blocked = STATE_CANCELED;
 	}
 
+	lock_tree_remove(lock_entry->sle_obj->state_hdl, lock_entry);
 	glist_del(&lock_entry->sle_list);
 	lock_entry_dec_ref(lock_entry);
 }
@@ -760,15 +1157,18 @@ static state_lock_entry_t *get_overlapping_entry(struct state_hdl *ostate,
 						 state_owner_t *owner,
 						 fsal_lock_param_t *lock)
 {
-	struct glist_head *glist;
-	struct glist_head *glist_n;
 	state_lock_entry_t *found_entry = NULL;
-	uint64_t found_entry_end, range_end = lock_end(lock);
+	struct lock_tree_vec overlaps;
+	size_t i;
+
+	lock_tree_vec_init(&overlaps);
 
 recheck_for_conflicting_entries:
-	glist_for_each_safe(glist, glist_n, &ostate->file.lock_list)
-	{
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	lock_tree_collect(ostate->file.lock_tree, lock->lock_start,
+			  lock_end(lock), &overlaps);
+
+	for (i = 0; i < overlaps.count; i++) {
+		found_entry = overlaps.entries[i];
 
 		LogEntry("Checking", found_entry);
 
@@ -777,55 +1177,52 @@ recheck_for_conflicting_entries:
 		    found_entry->sle_blocked == STATE_CANCELED)
 			continue;
 
-		found_entry_end = lock_end(&found_entry->sle_lock);
-
-		if ((found_entry_end >= lock->lock_start) &&
-		    (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
-			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W ||
-			     lock->lock_type == FSAL_LOCK_W) &&
-			    different_owners(found_entry->sle_owner, owner)) {
-				/* Recheck for expiry */
-				state_owner_t *cf_own = found_entry->sle_owner;
-				nfs_client_id_t *client_id =
-					cf_own->so_owner.so_nfs4_owner
-						.so_clientrec;
-
-				if ((atomic_fetch_uint32_t(
-					    &num_of_curr_expired_clients)) &&
-				    (cf_own->so_type >=
-				     STATE_OPEN_OWNER_NFSV4) &&
-				    client_id->marked_for_delayed_cleanup) {
-					/* Release the state lock, to clean */
-					ostate->no_cleanup = false;
-					PTHREAD_MUTEX_unlock(&ostate->st_lock);
-
-					reap_expired_client_list(client_id);
-					/* Acquire back the state lock */
-					PTHREAD_MUTEX_lock(&ostate->st_lock);
-					ostate->no_cleanup = true;
-
-					/* Continue to recheck for conflicts */
-					goto recheck_for_conflicting_entries;
-				}
-				/* found a conflicting lock, return it */
-				return found_entry;
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
+		if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W ||
+		     lock->lock_type == FSAL_LOCK_W) &&
+		    different_owners(found_entry->sle_owner, owner)) {
+			/* Recheck for expiry */
+			state_owner_t *cf_own = found_entry->sle_owner;
+			nfs_client_id_t *client_id =
+				cf_own->so_owner.so_nfs4_owner.so_clientrec;
+
+			if ((atomic_fetch_uint32_t(
+				    &num_of_curr_expired_clients)) &&
+			    (cf_own->so_type >= STATE_OPEN_OWNER_NFSV4) &&
+			    client_id->marked_for_delayed_cleanup) {
+				/* Release the state lock, to clean */
+				ostate->no_cleanup = false;
+				PTHREAD_MUTEX_unlock(&ostate->st_lock);
+
+				reap_expired_client_list(client_id);
+				/* Acquire back the state lock */
+				PTHREAD_MUTEX_lock(&ostate->st_lock);
+				ostate->no_cleanup = true;
+
+				/* Continue to recheck for conflicts */
+				overlaps.count = 0;
+				goto recheck_for_conflicting_entries;
 			}
+			/* found a conflicting lock, return it */
+			lock_tree_vec_free(&overlaps);
+			return found_entry;
 		}
 	}
 
+	lock_tree_vec_free(&overlaps);
 	return NULL;
 }
 
 /**
  * @brief Add a lock, potentially merging with existing locks
  *
- * We need to iterate over the full lock list and remove
- * any mapping entry. And l_offset = 0 and sle_lock.lock_length = 0 lock_entry
- * implies remove all entries
+ * Go over the locks of the same owner that overlap or touch the lock and
+ * merge them into it, or split and shrink them if they are of a different
+ * type.  Since lock_entry can grow while merging, repeat until it stops
+ * changing.
  *
  * @note The st_lock MUST be held
  *
@@ -839,18 +1236,30 @@ static void merge_lock_entry(struct state_hdl *ostate,
 	state_lock_entry_t *check_entry_right;
 	uint64_t check_entry_end;
 	uint64_t lock_entry_end;
-	struct glist_head *glist;
-	struct glist_head *glistn;
+	uint64_t pass_start, pass_end;
+	struct lock_tree_vec near;
+	bool in_tree;
+	size_t i;
 
 	/* lock_entry might be STATE_NON_BLOCKING */
 
-	glist_for_each_safe(glist, glistn, &ostate->file.lock_list)
-	{
-		check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	/* lock_entry may be on the list already, its range is going to
+	 * change so keep it out of the tree until done.
+	 */
+	in_tree = lock_tree_remove(ostate, lock_entry);
+	lock_tree_vec_init(&near);
 
-		/* Skip entry being merged - it could be in the list */
-		if (check_entry == lock_entry)
-			continue;
+again:
+	pass_start = lock_entry->sle_lock.lock_start;
+	pass_end = lock_end(&lock_entry->sle_lock);
+
+	lock_tree_collect(ostate->file.lock_tree,
+			  pass_start > 0 ? pass_start - 1 : 0,
+			  pass_end < UINT64_MAX ? pass_end + 1 : UINT64_MAX,
+			  &near);
+
+	for (i = 0; i < near.count; i++) {
+		check_entry = near.entries[i];
 
 		if (different_owners(check_entry->sle_owner,
 				     lock_entry->sle_owner))
@@ -881,14 +1290,15 @@ static void merge_lock_entry(struct state_hdl *ostate,
 		    ((lock_entry_end < check_entry_end) ||
 		     (check_entry->sle_lock.lock_start <
 		      lock_entry->sle_lock.lock_start))) {
+			/* The old lock's range changes */
+			lock_tree_remove(ostate, check_entry);
+
 			if (lock_entry_end < check_entry_end &&
 			    check_entry->sle_lock.lock_start <
 				    lock_entry->sle_lock.lock_start) {
 				/* Need to split old lock */
 				check_entry_right =
 					state_lock_entry_t_dup(check_entry);
-				glist_add_tail(&ostate->file.lock_list,
-					       &(check_entry_right->sle_list));
 			} else {
 				/* No split, just shrink, make the logic below
 				 * work on original lock
@@ -919,6 +1329,12 @@ static void merge_lock_entry(struct state_hdl *ostate,
 					check_entry->sle_lock.lock_start;
 				LogEntry("Merge shrunk left", check_entry);
 			}
+
+			lock_tree_insert(ostate, check_entry);
+
+			if (check_entry_right != check_entry)
+				lock_list_add(ostate, check_entry_right);
+
 			/* Done splitting/shrinking old lock */
 			continue;
 		}
@@ -945,6 +1361,18 @@ static void merge_lock_entry(struct state_hdl *ostate,
 		LogEntry("Merging removing", check_entry);
 		remove_from_locklist(check_entry);
 	}
+
+	if (lock_entry->sle_lock.lock_start != pass_start ||
+	    lock_end(&lock_entry->sle_lock) != pass_end) {
+		/* lock_entry grew, look at its new neighbours */
+		near.count = 0;
+		goto again;
+	}
+
+	lock_tree_vec_free(&near);
+
+	if (in_tree)
+		lock_tree_insert(ostate, lock_entry);
 }
 
 /**
@@ -1052,15 +1480,17 @@ complete_remove:
 }
 
 /**
- * @brief Subtract a lock from a list of locks
+ * @brief Subtract a lock from a file's locks
  *
  * This function possibly splits entries in the list.
  *
+ * @note The st_lock MUST be held
+ *
  * @param[in]     owner   Lock owner
  * @param[in]     state   Associated lock state
  * @param[in]     lock    Lock to remove
  * @param[out]    removed True if an entry was removed
- * @param[in,out] list    List of locks to modify
+ * @param[in,out] ostate  File state to modify
  *
  * @return State status.
  */
@@ -1068,22 +1498,27 @@ static state_status_t subtract_lock_from_list(state_owner_t *owner,
 					      bool state_applies, int32_t state,
 					      fsal_lock_param_t *lock,
 					      bool *removed,
-					      struct glist_head *list)
+					      struct state_hdl *ostate)
 {
 	state_lock_entry_t *found_entry;
 	struct glist_head split_lock_list, remove_list;
 	struct glist_head *glist, *glistn;
+	struct lock_tree_vec overlaps;
 	state_status_t status = STATE_SUCCESS;
 	bool removed_one = false;
+	size_t i;
 
 	*removed = false;
 
 	glist_init(&split_lock_list);
 	glist_init(&remove_list);
+	lock_tree_vec_init(&overlaps);
 
-	glist_for_each_safe(glist, glistn, list)
-	{
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	lock_tree_collect(ostate->file.lock_tree, lock->lock_start,
+			  lock_end(lock), &overlaps);
+
+	for (i = 0; i < overlaps.count; i++) {
+		found_entry = overlaps.entries[i];
 
 		if (owner != NULL &&
 		    different_owners(found_entry->sle_owner, owner))
@@ -1108,6 +1543,9 @@ static state_status_t subtract_lock_from_list(state_owner_t *owner,
 		status = subtract_lock_from_entry(found_entry, lock,
 						  &split_lock_list,
 						  &remove_list, &removed_one);
+		if (removed_one)
+			lock_tree_remove(ostate, found_entry);
+
 		*removed |= removed_one;
 
 		if (status != STATE_SUCCESS) {
@@ -1118,6 +1556,8 @@ static state_status_t subtract_lock_from_list(state_owner_t *owner,
 		}
 	}
 
+	lock_tree_vec_free(&overlaps);
+
 	if (status != STATE_SUCCESS) {
 		/* We ran out of memory while splitting. split_lock_list
 		 * has been freed. For each entry on the remove_list, put
@@ -1128,19 +1568,26 @@ static state_status_t subtract_lock_from_list(state_owner_t *owner,
 		{
 			found_entry = glist_entry(glist, state_lock_entry_t,
 						  sle_list);
-			glist_move_tail(list, &(found_entry->sle_list));
+			glist_del(&found_entry->sle_list);
+			lock_list_add(ostate, found_entry);
 		}
 	} else {
 		/* free the enttries on the remove_list */
 		free_list(&remove_list);
 
 		/* now add the split lock list */
-		glist_add_list_tail(list, &split_lock_list);
+		glist_for_each_safe(glist, glistn, &split_lock_list)
+		{
+			found_entry = glist_entry(glist, state_lock_entry_t,
+						  sle_list);
+			glist_del(&found_entry->sle_list);
+			lock_list_add(ostate, found_entry);
+		}
 	}
 
 	LogFullDebug(COMPONENT_STATE,
-		     "List of all locks for list=%p returning %d", list,
-		     status);
+		     "List of all locks for list=%p returning %d",
+		     &ostate->file.lock_list, status);
 
 	return status;
 }
@@ -1151,7 +1598,7 @@ static state_status_t subtract_lock_from_list(state_owner_t *owner,
  *
  ******************************************************************************/
 
-static void grant_blocked_locks(struct state_hdl *);
+static void grant_blocked_locks(struct state_hdl *, fsal_lock_param_t *);
 
 static inline int display_lock_cookie(struct display_buffer *dspbuf,
 				      struct gsh_buffdesc *buff)
@@ -1685,7 +2132,7 @@ void grant_blocked_lock_immediate(struct state_hdl *ostate,
 	LogEntry("Immediate Granted entry", lock_entry);
 
 	/* A lock downgrade could unblock blocked locks */
-	grant_blocked_locks(ostate);
+	grant_blocked_locks(ostate, &lock_entry->sle_lock);
 }
 
 static void grant_nfsv4_blocking_lock(struct fsal_obj_handle *obj,
@@ -1702,7 +2149,7 @@ static void grant_nfsv4_blocking_lock(struct fsal_obj_handle *obj,
 	}
 
 	PTHREAD_MUTEX_lock(&blocked_locks_mutex);
-	glist_del(&lock_entry->sle_block_data->sbd_list);
+	blocked_lock_unlist(lock_entry->sle_block_data);
 	PTHREAD_MUTEX_unlock(&blocked_locks_mutex);
 
 	grant_blocked_lock_immediate(obj->state_hdl, lock_entry);
@@ -1745,7 +2192,7 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 		LogEntry("Granted entry", lock_entry);
 
 		/* A lock downgrade could unblock blocked locks */
-		grant_blocked_locks(obj->state_hdl);
+		grant_blocked_locks(obj->state_hdl, &lock_entry->sle_lock);
 	}
 
 	/* Free cookie and unblock lock.
@@ -1829,7 +2276,19 @@ void try_to_grant_lock(state_lock_entry_t *lock_entry)
 		if (lock_entry->sle_protocol == LOCK_NLM) {
 			PTHREAD_MUTEX_lock(&blocked_locks_mutex);
 
-			glist_del(&lock_entry->sle_block_data->sbd_list);
+			blocked_lock_unlist(lock_entry->sle_block_data);
+
+			PTHREAD_MUTEX_unlock(&blocked_locks_mutex);
+		} else if (status == STATE_SUCCESS) {
+			/* The grant notification starts the expiry clock */
+			state_block_data_t *pblock = lock_entry->sle_block_data;
+
+			PTHREAD_MUTEX_lock(&blocked_locks_mutex);
+
+			if (!glist_null(&pblock->sbd_list))
+				blocked_lock_arm(pblock,
+						 blocked_lock_next_due(
+							 pblock, time(NULL)));
 
 			PTHREAD_MUTEX_unlock(&blocked_locks_mutex);
 		}
@@ -1874,16 +2333,23 @@ out_upcall:
 }
 
 /**
- * @brief Attempt to grant all blocked locks on a file
+ * @brief Attempt to grant blocked locks on a file
+ *
+ * Only the blocked locks overlapping the released or cancelled range can
+ * have become grantable, so only those are looked at.
  *
  * @param[in] ostate File state
+ * @param[in] lock   Range that changed, NULL for the whole file
  */
 
-static void grant_blocked_locks(struct state_hdl *ostate)
+static void grant_blocked_locks(struct state_hdl *ostate,
+				fsal_lock_param_t *lock)
 {
 	state_lock_entry_t *found_entry;
-	struct glist_head *glist, *glistn;
 	struct fsal_export *export = op_ctx->ctx_export->fsal_export;
+	struct lock_tree_vec overlaps;
+	uint64_t start = 0, end = UINT64_MAX;
+	size_t i;
 
 	if (!ostate)
 		return;
@@ -1894,23 +2360,47 @@ static void grant_blocked_locks(struct state_hdl *ostate)
 	if (export->exp_ops.fs_supports(export, fso_lock_support_async_block))
 		return;
 
-	glist_for_each_safe(glist, glistn, &ostate->file.lock_list)
-	{
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	if (lock != NULL) {
+		start = lock->lock_start;
+		end = lock_end(lock);
+	}
 
-		if (found_entry->sle_blocked != STATE_BLOCKING)
+	/* Collect the waiters first and hold a reference, granting a lock
+	 * changes the tree under us.
+	 */
+	lock_tree_vec_init(&overlaps);
+	lock_tree_collect(ostate->file.lock_tree, start, end, &overlaps);
+
+	for (i = 0; i < overlaps.count; i++) {
+		found_entry = overlaps.entries[i];
+
+		if (found_entry->sle_blocked == STATE_BLOCKING)
+			lock_entry_inc_ref(found_entry);
+		else
+			overlaps.entries[i] = NULL;
+	}
+
+	for (i = 0; i < overlaps.count; i++) {
+		found_entry = overlaps.entries[i];
+
+		if (found_entry == NULL)
 			continue;
 
 		/* Found a blocked entry for this file,
 		 * see if we can place the lock.
 		 */
-		if (get_overlapping_entry(ostate, found_entry->sle_owner,
-					  &found_entry->sle_lock) != NULL)
-			continue;
+		if (found_entry->sle_blocked == STATE_BLOCKING &&
+		    !glist_null(&found_entry->sle_list) &&
+		    get_overlapping_entry(ostate, found_entry->sle_owner,
+					  &found_entry->sle_lock) == NULL) {
+			/* Found an entry that might work, try to grant it. */
+			try_to_grant_lock(found_entry);
+		}
 
-		/* Found an entry that might work, try to grant it. */
-		try_to_grant_lock(found_entry);
+		lock_entry_dec_ref(found_entry);
 	}
+
+	lock_tree_vec_free(&overlaps);
 }
 
 /**
@@ -2044,13 +2534,16 @@ void cancel_blocked_locks_range(struct state_hdl *ostate, state_owner_t *owner,
 				bool state_applies, int32_t state,
 				fsal_lock_param_t *lock)
 {
-	struct glist_head *glist, *glistn;
 	state_lock_entry_t *found_entry = NULL;
-	uint64_t found_entry_end, range_end = lock_end(lock);
+	struct lock_tree_vec overlaps;
+	size_t i;
 
-	glist_for_each_safe(glist, glistn, &ostate->file.lock_list)
-	{
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	lock_tree_vec_init(&overlaps);
+	lock_tree_collect(ostate->file.lock_tree, lock->lock_start,
+			  lock_end(lock), &overlaps);
+
+	for (i = 0; i < overlaps.count; i++) {
+		found_entry = overlaps.entries[i];
 
 		/* Skip locks not owned by owner */
 		if (owner != NULL &&
@@ -2071,14 +2564,11 @@ void cancel_blocked_locks_range(struct state_hdl *ostate, state_owner_t *owner,
 
 		LogEntry("Checking", found_entry);
 
-		found_entry_end = lock_end(&found_entry->sle_lock);
-
-		if ((found_entry_end >= lock->lock_start) &&
-		    (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps, cancel it. */
-			cancel_blocked_lock(ostate->file.obj, found_entry);
-		}
+		/* lock overlaps, cancel it. */
+		cancel_blocked_lock(ostate->file.obj, found_entry);
 	}
+
+	lock_tree_vec_free(&overlaps);
 }
 
 /**
@@ -2093,12 +2583,16 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	state_lock_entry_t *lock_entry;
 	struct fsal_obj_handle *obj;
 	state_status_t status = STATE_SUCCESS;
+	fsal_lock_param_t released;
 
 	lock_entry = cookie_entry->sce_lock_entry;
 	obj = cookie_entry->sce_obj;
 
 	STATELOCK_lock(obj);
 
+	/* free_cookie() may free the lock entry, remember its range */
+	released = lock_entry->sle_lock;
+
 	/* We need to make sure lock is only "granted" once...
 	 * It's (remotely) possible that due to latency, we might end up
 	 * processing two GRANTED_RSP calls at the same time.
@@ -2136,7 +2630,7 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	free_cookie(cookie_entry, true);
 
 	/* Check to see if we can grant any blocked locks. */
-	grant_blocked_locks(obj->state_hdl);
+	grant_blocked_locks(obj->state_hdl, &released);
 
 	STATELOCK_unlock(obj);
 
@@ -2484,12 +2978,67 @@ static void state_cancel_internal(struct fsal_obj_handle *obj,
 		cancel_blocked_lock(obj, found_entry);
 
 		/* Check to see if we can grant any blocked locks. */
-		grant_blocked_locks(obj->state_hdl);
+		grant_blocked_locks(obj->state_hdl, lock);
 
 		break;
 	}
 }
 
+/**
+ * @brief Check a lock owner is not using another export for this file
+ *
+ * A lock owner may not hold locks on a file through more than one export.
+ *
+ * @note The st_lock MUST be held
+ *
+ * @param[in] obj    File to lock
+ * @param[in] owner  Lock owner
+ *
+ * @retval STATE_SUCCESS if the owner has no lock through another export.
+ * @retval STATE_INVALID_ARGUMENT otherwise.
+ */
+static state_status_t check_lock_owner_export(struct fsal_obj_handle *obj,
+					      state_owner_t *owner)
+{
+	struct state_hdl *ostate = obj->state_hdl;
+	struct tmp_export_paths tmp = { NULL, NULL };
+	struct glist_head *glist;
+	state_lock_entry_t *found_entry;
+
+	/* Nothing to look for if every lock came through this export */
+	if (ostate->file.lock_export == op_ctx->ctx_export &&
+	    ostate->file.lock_export_count == ostate->file.lock_count)
+		return STATE_SUCCESS;
+
+	glist_for_each(glist, &ostate->file.lock_list)
+	{
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+
+		if (found_entry->sle_export == op_ctx->ctx_export ||
+		    different_owners(found_entry->sle_owner, owner))
+			continue;
+
+		tmp_get_exp_paths(&tmp, found_entry->sle_export);
+
+		LogEvent(
+			COMPONENT_STATE,
+			"Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
+			found_entry->sle_export->export_id,
+			op_ctx_tmp_export_path(op_ctx, &tmp),
+			op_ctx->ctx_export->export_id,
+			op_ctx_export_path(op_ctx));
+
+		LogEntry("Found lock entry belonging to another export",
+			 found_entry);
+
+		tmp_put_exp_paths(&tmp);
+
+		return STATE_INVALID_ARGUMENT;
+	}
+
+	return STATE_SUCCESS;
+}
+
 /**
  * @brief handle the case where requested lock is either contained or overlaps
  * an existing lock
@@ -2570,7 +3119,7 @@ static void handle_contained_range_if_present(
 		cancel_blocked_lock(obj, found_entry);
 
 		/* Check to see if we can grant any blocked locks. */
-		grant_blocked_locks(obj->state_hdl);
+		grant_blocked_locks(obj->state_hdl, lock);
 		*lock_cancel = true;
 		return;
 	} else if (found_entry->sle_blocked != STATE_NON_BLOCKING) {
@@ -2628,10 +3177,10 @@ state_status_t state_lock(struct fsal_obj_handle *obj, state_owner_t *owner,
 			  fsal_lock_param_t *conflict)
 {
 	bool allow = true, overlap = false;
-	struct glist_head *glist;
-	struct glist_head *glist_n;
 	state_lock_entry_t *found_entry;
 	state_lock_entry_t *new_entry;
+	struct lock_tree_vec overlaps;
+	size_t i;
 	uint64_t found_entry_end;
 	uint64_t range_end = lock_end(lock);
 	struct fsal_export *fsal_export = op_ctx->fsal_export;
@@ -2644,47 +3193,28 @@ state_status_t state_lock(struct fsal_obj_handle *obj, state_owner_t *owner,
 
 	LOCK__REQUEST_AUTO_TRACEPOINT(lock, obj, lock_request_start, TRACE_INFO,
 				      "lock request started");
+	status = check_lock_owner_export(obj, owner);
+
+	if (status != STATE_SUCCESS)
+		return status;
+
+	lock_tree_vec_init(&overlaps);
+
 	if (blocking != STATE_NON_BLOCKING) {
 		/* First search for a blocked request. Client can ignore the
 		 * blocked request and keep sending us new lock request again
 		 * and again. So if we have a mapping blocked request return
 		 * that
 		 */
-		glist_for_each(glist, &obj->state_hdl->file.lock_list)
-		{
-			found_entry = glist_entry(glist, state_lock_entry_t,
-						  sle_list);
+		lock_tree_collect(obj->state_hdl->file.lock_tree,
+				  lock->lock_start, range_end, &overlaps);
+
+		for (i = 0; i < overlaps.count; i++) {
+			found_entry = overlaps.entries[i];
 
 			if (different_owners(found_entry->sle_owner, owner))
 				continue;
 
-			/* Need to reject lock request if this lock owner
-			 * already has a lock on this file via a different
-			 * export.
-			 */
-			if (found_entry->sle_export != op_ctx->ctx_export) {
-				struct tmp_export_paths tmp = { NULL, NULL };
-
-				tmp_get_exp_paths(&tmp,
-						  found_entry->sle_export);
-
-				LogEvent(
-					COMPONENT_STATE,
-					"Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-					found_entry->sle_export->export_id,
-					op_ctx_tmp_export_path(op_ctx, &tmp),
-					op_ctx->ctx_export->export_id,
-					op_ctx_export_path(op_ctx));
-				LogEntry(
-					"Found lock entry belonging to another export",
-					found_entry);
-
-				tmp_put_exp_paths(&tmp);
-
-				status = STATE_INVALID_ARGUMENT;
-				return status;
-			}
-
 			if (found_entry->sle_blocked != blocking)
 				continue;
 
@@ -2698,47 +3228,24 @@ state_status_t state_lock(struct fsal_obj_handle *obj, state_owner_t *owner,
 			LogEntry("Found blocked", found_entry);
 			LOCK_AUTO_TRACEPOINT(found_entry, found_blocked,
 					     TRACE_INFO, "Found blocked");
+			lock_tree_vec_free(&overlaps);
 			status = STATE_LOCK_BLOCKED;
 			return status;
 		}
 	}
 
 recheck_for_conflicting_entries:
-	glist_for_each_safe(glist, glist_n, &obj->state_hdl->file.lock_list)
-	{
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
-		/* Need to reject lock request if this lock owner already has
-		 * a lock on this file via a different export.
-		 */
-		if (found_entry->sle_export != op_ctx->ctx_export &&
-		    !different_owners(found_entry->sle_owner, owner)) {
-			struct tmp_export_paths tmp = { NULL, NULL };
-
-			tmp_get_exp_paths(&tmp, found_entry->sle_export);
-
-			LogEvent(
-				COMPONENT_STATE,
-				"Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-				found_entry->sle_export->export_id,
-				op_ctx_tmp_export_path(op_ctx, &tmp),
-				op_ctx->ctx_export->export_id,
-				op_ctx_export_path(op_ctx));
-
-			LogEntry("Found lock entry belonging to another export",
-				 found_entry);
+	overlaps.count = 0;
+	lock_tree_collect(obj->state_hdl->file.lock_tree, lock->lock_start,
+			  range_end, &overlaps);
 
-			tmp_put_exp_paths(&tmp);
-
-			status = STATE_INVALID_ARGUMENT;
-			return status;
-		}
+	for (i = 0; i < overlaps.count; i++) {
+		found_entry = overlaps.entries[i];
 
 		/* Don't skip blocked locks for fairness */
 		found_entry_end = lock_end(&found_entry->sle_lock);
 
-		if (!(lock->lock_reclaim) &&
-		    (found_entry_end >= lock->lock_start) &&
-		    (found_entry->sle_lock.lock_start <= range_end) && allow) {
+		if (!(lock->lock_reclaim) && allow) {
 			/* lock overlaps see if we can allow:
 			 * allow if neither lock is exclusive or
 			 * the owner is the same
@@ -2795,15 +3302,19 @@ recheck_for_conflicting_entries:
 						  &lock_cancel);
 
 		if (lock_granted) {
+			lock_tree_vec_free(&overlaps);
 			status = STATE_SUCCESS;
 			return status;
 		}
 		if (lock_cancel) {
+			lock_tree_vec_free(&overlaps);
 			status = STATE_LOCK_BLOCKED;
 			return status;
 		}
 	}
 
+	lock_tree_vec_free(&overlaps);
+
 	/* Decide how to proceed */
 	if (blocking == STATE_BLOCKING) {
 		/* do_lock_op will handle FSAL_OP_LOCKB for those FSALs that
@@ -2908,11 +3419,10 @@ recheck_for_conflicting_entries:
 		/* Insert entry into lock list */
 		LogEntry("New lock", new_entry);
 
-		glist_add_tail(&obj->state_hdl->file.lock_list,
-			       &new_entry->sle_list);
+		lock_list_add(obj->state_hdl, new_entry);
 
 		/* A lock downgrade could unblock blocked locks */
-		grant_blocked_locks(obj->state_hdl);
+		grant_blocked_locks(obj->state_hdl, &new_entry->sle_lock);
 	} else if (status == STATE_LOCK_CONFLICT) {
 		LogEntry("Conflict in FSAL for", new_entry);
 
@@ -2949,12 +3459,13 @@ recheck_for_conflicting_entries:
 		/* Insert entry into lock list */
 		LogEntry("FSAL block for", new_entry);
 
-		glist_add_tail(&obj->state_hdl->file.lock_list,
-			       &new_entry->sle_list);
+		lock_list_add(obj->state_hdl, new_entry);
 
 		PTHREAD_MUTEX_lock(&blocked_locks_mutex);
 
 		glist_add_tail(&state_blocked_locks, &block_data->sbd_list);
+		blocked_lock_arm(block_data,
+				 blocked_lock_next_due(block_data, time(NULL)));
 
 		PTHREAD_MUTEX_unlock(&blocked_locks_mutex);
 	} else {
@@ -3019,8 +3530,7 @@ state_unlock_internal(struct fsal_obj_handle *obj, state_t *state,
 
 	/* Release the lock from lock list for entry */
 	status = subtract_lock_from_list(owner, state_applies, nsm_state, lock,
-					 &removed,
-					 &obj->state_hdl->file.lock_list);
+					 &removed, obj->state_hdl);
 
 	if (status != STATE_SUCCESS) {
 		/* The unlock has not taken affect (other than canceling any
@@ -3060,7 +3570,7 @@ state_unlock_internal(struct fsal_obj_handle *obj, state_t *state,
 		empty = LogList("Lock List", obj,
 				&obj->state_hdl->file.lock_list);
 
-	grant_blocked_locks(obj->state_hdl);
+	grant_blocked_locks(obj->state_hdl, lock);
 
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS) &&
 	    lock->lock_start == 0 && lock->lock_length == 0 && empty)
@@ -3768,12 +4278,6 @@ static void handle_nlm_lock(state_block_data_t *pblock,
 	LogEntry("Blocked Lock found", found_entry);
 }
 
-/* It looks like when we report OPEN4_RESULT_MAY_NOTIFY_LOCK, the client polls
- * exactly every lease time. This creates a race where the poll request arrives
- * after we cancel the lock. For this reason, we add a small time buffer.
- */
-#define POLL_TIME_CANCEL_BUFFER_SEC (5)
-
 /**
  * @brief handle nfsv4 lock polling logic
  *
@@ -3849,7 +4353,7 @@ static void handle_nfsv4_lock(state_block_data_t *pblock,
 }
 
 /**
- * @brief Poll any blocked locks of type STATE_BLOCK_POLL
+ * @brief Poll the blocked locks that are due on the timer wheel
  *
  * @param[in] ctx Fridge Thread Context
  *
@@ -3858,19 +4362,52 @@ static void handle_nfsv4_lock(state_block_data_t *pblock,
 void blocked_lock_polling(struct fridgethr_context *ctx)
 {
 	state_lock_entry_t *found_entry;
-	struct glist_head *glist;
+	struct glist_head *glist, *glistn;
 	state_block_data_t *pblock;
+	struct glist_head due;
+	time_t check_time, second;
 
 	SetNameFunction("lk_poll");
+	glist_init(&due);
 	PTHREAD_MUTEX_lock(&blocked_locks_mutex);
-	time_t check_time = time(NULL);
+	check_time = time(NULL);
 
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS))
 		LogBlockedList("Blocked Lock List", NULL, &state_blocked_locks);
 
-	glist_for_each(glist, &state_blocked_locks)
+	/* Pull everything that came due since the last pass off the wheel.
+	 * Going around the wheel once is enough since each slot is checked
+	 * against the actual due time.
+	 */
+	second = blocked_lock_wheel_time;
+	if (check_time - second > BLOCKED_LOCK_WHEEL_SLOTS)
+		second = check_time - BLOCKED_LOCK_WHEEL_SLOTS;
+
+	while (second < check_time) {
+		second++;
+		glist_for_each_safe(glist, glistn,
+				    &blocked_lock_wheel[second %
+							BLOCKED_LOCK_WHEEL_SLOTS])
+		{
+			pblock = glist_entry(glist, state_block_data_t,
+					     sbd_timer);
+
+			if (pblock->sbd_due > check_time)
+				continue;
+
+			glist_del(&pblock->sbd_timer);
+			glist_add_tail(&due, &pblock->sbd_timer);
+		}
+	}
+
+	if (check_time > blocked_lock_wheel_time)
+		blocked_lock_wheel_time = check_time;
+
+	glist_for_each_safe(glist, glistn, &due)
 	{
-		pblock = glist_entry(glist, state_block_data_t, sbd_list);
+		pblock = glist_entry(glist, state_block_data_t, sbd_timer);
+
+		glist_del(&pblock->sbd_timer);
 
 		found_entry = pblock->sbd_lock_entry;
 
@@ -3884,7 +4421,10 @@ void blocked_lock_polling(struct fridgethr_context *ctx)
 		else
 			handle_nlm_lock(pblock, found_entry);
 
-	} /* glist_for_each_safe */
+		/* Still blocked, look at it again when next due */
+		blocked_lock_arm(pblock,
+				 blocked_lock_next_due(pblock, check_time));
+	}
 
 	PTHREAD_MUTEX_unlock(&blocked_locks_mutex);
 }
@@ -4049,7 +4589,7 @@ void cancel_all_nlm_blocked(void)
 		found_entry = pblock->sbd_lock_entry;
 
 		/* Remove lock from blocked list */
-		glist_del(&pblock->sbd_list);
+		blocked_lock_unlist(pblock);
 
 		lock_entry_inc_ref(found_entry);
 
@@ -4120,6 +4660,7 @@ struct cleanup_list_element state_cleanup_element = {
 state_status_t state_lock_init(void)
 {
 	state_status_t status = STATE_SUCCESS;
+	int i;
 
 	ht_lock_cookies = hashtable_init(&cookie_param);
 	if (ht_lock_cookies == NULL) {
@@ -4133,6 +4674,9 @@ state_status_t state_lock_init(void)
 	PTHREAD_MUTEX_init(&all_locks_mutex, NULL);
 #endif
 	PTHREAD_MUTEX_init(&blocked_locks_mutex, NULL);
+	for (i = 0; i < BLOCKED_LOCK_WHEEL_SLOTS; i++)
+		glist_init(&blocked_lock_wheel[i]);
+	blocked_lock_wheel_time = time(NULL);
 	PTHREAD_MUTEX_init(&cached_open_owners_lock, NULL);
 #ifdef _USE_NLM
 	PTHREAD_MUTEX_init(&granted_mutex, NULL);
@@ -0,0 +1,619 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Multi-threaded FSAL throughput benchmark.
+ *
+ * The *_latency tests time a single thread and print an average.  This drives
+ * each FSAL operation from several threads at once over a working set of
+ * files, with most operations going to a small hot set, and records every
+ * operation in a log-linear histogram so that the tail is visible.  Every
+ * operation is run both through MDCACHE and directly against the sub-FSAL.
+ *
+ * Typical use:
+ *
+ *   test_fsal_bench --config ganesha.conf --threads 1,4,16 --files 10000 \
+ *       --json bench.json
+ */
+
+#include <sys/types.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <boost/program_options.hpp>
+
+#include "gtest.hh"
+#include "gtest_histogram.hh"
+
+extern "C" {
+/* Manually forward this, as 9P is not C++ safe */
+void admin_halt(void);
+/* Ganesha headers */
+#include "export_mgr.h"
+#include "nfs_exports.h"
+#include "sal_data.h"
+#include "fsal.h"
+#include "common_utils.h"
+/* For MDCACHE bypass.  Use with care */
+#include "../FSAL/Stackable_FSALs/FSAL_MDCACHE/mdcache_debug.h"
+}
+
+#define TEST_ROOT "fsal_bench"
+
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+  char* json_out = nullptr;
+
+  std::vector<unsigned int> thread_counts = { 4 };
+  unsigned int file_count = 1000;
+  unsigned int hot_count = 0;
+  unsigned int hot_pct = 90;
+  unsigned int duration = 5;
+  unsigned int io_size = 4096;
+
+  struct bench_result {
+    std::string op;
+    bool bypass;
+    unsigned int threads;
+    uint64_t errors;
+    double seconds;
+    gtest::LatencyHistogram hist;
+  };
+
+  std::vector<bench_result> results;
+
+  enum bench_op {
+    BENCH_LOOKUP,
+    BENCH_GETATTRS,
+    BENCH_READ2,
+    BENCH_WRITE2,
+    BENCH_READDIR,
+    BENCH_OPEN2,
+  };
+
+  struct bench_worker {
+    std::thread thread;
+    gtest::LatencyHistogram hist;
+    uint64_t errors = 0;
+    std::mt19937_64 rng;
+    char *buf = nullptr;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+  };
+
+  static enum fsal_dir_result
+  bench_dirent(const char *name, struct fsal_obj_handle *obj,
+               struct fsal_attrlist *attrs, void *dir_state,
+               fsal_cookie_t cookie)
+  {
+    obj->obj_ops->put_ref(obj);
+    return DIR_CONTINUE;
+  }
+
+  class FSALBenchTest : public gtest::GaneshaFSALBaseTest {
+  protected:
+
+    virtual void SetUp() {
+      struct fsal_io_arg write_arg;
+      struct iovec iov;
+      struct async_process_data io_data;
+      pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+      pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+      char *buf;
+
+      gtest::GaneshaFSALBaseTest::SetUp();
+
+      objs.resize(file_count);
+      sub_objs.resize(file_count);
+
+      create_and_prime_many(file_count, objs.data());
+
+      sub_root = mdcdb_get_sub_handle(test_root);
+      ASSERT_NE(sub_root, nullptr);
+
+      /* Give every file some data, so read2 has something to return */
+      buf = (char *) malloc(io_size);
+      memset(buf, 'a', io_size);
+
+      for (unsigned int i = 0; i < file_count; ++i) {
+        sub_objs[i] = mdcdb_get_sub_handle(objs[i]);
+        ASSERT_NE(sub_objs[i], nullptr);
+
+        memset(&write_arg, 0, sizeof(write_arg));
+        iov.iov_base = buf;
+        iov.iov_len = io_size;
+        write_arg.iov = &iov;
+        write_arg.iov_count = 1;
+        write_arg.io_request = io_size;
+
+        io_data.ret.major = ERR_FSAL_NO_ERROR;
+        io_data.ret.minor = 0;
+        io_data.done = false;
+        io_data.fsa_cond = &cond;
+        io_data.fsa_mutex = &mutex;
+
+        fsal_write(objs[i], true, &write_arg, &io_data);
+        ASSERT_EQ(io_data.ret.major, 0);
+      }
+
+      free(buf);
+    }
+
+    virtual void TearDown() {
+      remove_many(file_count, objs.data());
+
+      gtest::GaneshaFSALBaseTest::TearDown();
+    }
+
+    /* Pick a file, sending hot_pct percent of the picks to the hot set */
+    unsigned int pick(struct bench_worker *w) {
+      unsigned int hot = hot_count ? hot_count : file_count / 10;
+
+      if (hot == 0 || hot >= file_count)
+        return w->rng() % file_count;
+
+      if (w->rng() % 100 < hot_pct)
+        return w->rng() % hot;
+
+      return hot + w->rng() % (file_count - hot);
+    }
+
+    fsal_status_t do_io(struct bench_worker *w, struct fsal_obj_handle *obj,
+                        bool write) {
+      struct fsal_io_arg arg;
+      struct iovec iov;
+      struct async_process_data io_data;
+
+      memset(&arg, 0, sizeof(arg));
+      iov.iov_base = w->buf;
+      iov.iov_len = io_size;
+      arg.iov = &iov;
+      arg.iov_count = 1;
+      arg.io_request = io_size;
+
+      io_data.ret.major = ERR_FSAL_NO_ERROR;
+      io_data.ret.minor = 0;
+      io_data.done = false;
+      io_data.fsa_cond = &w->cond;
+      io_data.fsa_mutex = &w->mutex;
+
+      if (write)
+        fsal_write(obj, true, &arg, &io_data);
+      else
+        fsal_read(obj, true, &arg, &io_data);
+
+      return io_data.ret;
+    }
+
+    fsal_status_t do_op(struct bench_worker *w, enum bench_op op, bool bypass,
+                        unsigned int idx) {
+      struct fsal_obj_handle *dir = bypass ? sub_root : test_root;
+      struct fsal_obj_handle *obj = bypass ? sub_objs[idx] : objs[idx];
+      struct fsal_export *saveexp = op_ctx->fsal_export;
+      struct fsal_obj_handle *out = nullptr;
+      struct fsal_attrlist attrs_out;
+      struct state_t *state;
+      fsal_status_t status;
+      char fname[NAMELEN];
+      bool caller_perm_check = false;
+      uint64_t whence = 0;
+      bool eod = false;
+
+      if (bypass)
+        op_ctx->fsal_export = saveexp->sub_export;
+
+      sprintf(fname, "f-%08x", idx);
+
+      switch (op) {
+      case BENCH_LOOKUP:
+        status = dir->obj_ops->lookup(dir, fname, &out, NULL);
+        if (!FSAL_IS_ERROR(status))
+          out->obj_ops->put_ref(out);
+        break;
+
+      case BENCH_GETATTRS:
+        fsal_prepare_attrs(&attrs_out, ATTRS_POSIX);
+        status = obj->obj_ops->getattrs(obj, &attrs_out);
+        fsal_release_attrs(&attrs_out);
+        break;
+
+      case BENCH_READ2:
+        status = do_io(w, obj, false);
+        break;
+
+      case BENCH_WRITE2:
+        status = do_io(w, obj, true);
+        break;
+
+      case BENCH_READDIR:
+        /* Lists the whole working set, the pick is ignored */
+        status = dir->obj_ops->readdir(dir, &whence, NULL, bench_dirent, 0,
+                                       &eod);
+        break;
+
+      case BENCH_OPEN2:
+        state = op_ctx->fsal_export->exp_ops.alloc_state(op_ctx->fsal_export,
+                                                         STATE_TYPE_SHARE,
+                                                         NULL);
+        status = dir->obj_ops->open2(dir, state, FSAL_O_READ, FSAL_NO_CREATE,
+                                     fname, NULL, NULL, &out, NULL,
+                                     &caller_perm_check, nullptr, nullptr);
+        if (!FSAL_IS_ERROR(status)) {
+          status = out->obj_ops->close2(out, state);
+          out->obj_ops->put_ref(out);
+        }
+        free_state(state);
+        break;
+
+      default:
+        status = fsalstat(ERR_FSAL_NOTSUPP, 0);
+        break;
+      }
+
+      op_ctx->fsal_export = saveexp;
+
+      return status;
+    }
+
+    void worker(struct bench_worker *w, enum bench_op op, bool bypass) {
+      struct req_op_context op_context;
+      struct timespec s_time, e_time;
+      fsal_status_t status;
+
+      /* Each thread needs its own op context, which owns an export ref */
+      get_gsh_export_ref(a_export);
+      init_op_context_simple(&op_context, a_export, a_export->fsal_export);
+
+      while (!start.load())
+        std::this_thread::yield();
+
+      while (!stop.load()) {
+        unsigned int idx = pick(w);
+
+        now_mono(&s_time);
+        status = do_op(w, op, bypass, idx);
+        now_mono(&e_time);
+
+        w->hist.record(timespec_diff(&s_time, &e_time));
+        if (FSAL_IS_ERROR(status))
+          w->errors++;
+      }
+
+      release_op_context();
+    }
+
+    void run(const char *name, enum bench_op op, bool bypass) {
+      for (unsigned int nthreads : thread_counts) {
+        std::vector<struct bench_worker> workers(nthreads);
+        struct timespec s_time, e_time;
+        struct bench_result result;
+
+        start.store(false);
+        stop.store(false);
+
+        for (unsigned int i = 0; i < nthreads; ++i) {
+          struct bench_worker *w = &workers[i];
+
+          w->rng.seed(i + 1);
+          w->buf = (char *) malloc(io_size);
+          memset(w->buf, 'b', io_size);
+          PTHREAD_MUTEX_init(&w->mutex, NULL);
+          PTHREAD_COND_init(&w->cond, NULL);
+          w->thread = std::thread(&FSALBenchTest::worker, this, w, op,
+                                  bypass);
+        }
+
+        now_mono(&s_time);
+        start.store(true);
+
+        std::this_thread::sleep_for(std::chrono::seconds(duration));
+
+        stop.store(true);
+        for (auto &w : workers)
+          w.thread.join();
+        now_mono(&e_time);
+
+        result.op = name;
+        result.bypass = bypass;
+        result.threads = nthreads;
+        result.errors = 0;
+        result.seconds = timespec_diff(&s_time, &e_time) / 1e9;
+
+        for (auto &w : workers) {
+          result.hist.merge(w.hist);
+          result.errors += w.errors;
+          PTHREAD_MUTEX_destroy(&w.mutex);
+          PTHREAD_COND_destroy(&w.cond);
+          free(w.buf);
+        }
+
+        fprintf(stderr,
+                "%-8s %-7s threads %3u: %10.0f ops/s  p50 %" PRIu64
+                " ns  p99 %" PRIu64 " ns  p999 %" PRIu64 " ns  max %"
+                PRIu64 " ns  errors %" PRIu64 "\n",
+                name, bypass ? "bypass" : "mdcache", nthreads,
+                result.hist.count() / result.seconds,
+                result.hist.percentile(50.0), result.hist.percentile(99.0),
+                result.hist.percentile(99.9), result.hist.max(),
+                result.errors);
+
+        EXPECT_EQ(result.errors, 0);
+
+        results.push_back(result);
+      }
+    }
+
+    std::vector<struct fsal_obj_handle *> objs;
+    std::vector<struct fsal_obj_handle *> sub_objs;
+    struct fsal_obj_handle *sub_root = nullptr;
+    std::atomic<bool> start;
+    std::atomic<bool> stop;
+  };
+
+  void write_json(std::ostream &out) {
+    out << "{\n"
+        << "  \"files\": " << file_count << ",\n"
+        << "  \"hot_files\": "
+        << (hot_count ? hot_count : file_count / 10) << ",\n"
+        << "  \"hot_pct\": " << hot_pct << ",\n"
+        << "  \"io_size\": " << io_size << ",\n"
+        << "  \"duration\": " << duration << ",\n"
+        << "  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+      const bench_result &r = results[i];
+
+      out << (i ? "," : "") << "\n    {"
+          << "\"op\": \"" << r.op << "\", "
+          << "\"path\": \"" << (r.bypass ? "bypass" : "mdcache") << "\", "
+          << "\"threads\": " << r.threads << ", "
+          << "\"ops\": " << r.hist.count() << ", "
+          << "\"errors\": " << r.errors << ", "
+          << "\"seconds\": " << r.seconds << ", "
+          << "\"ops_per_sec\": " << (uint64_t) (r.hist.count() / r.seconds)
+          << ", "
+          << "\"latency_ns\": {"
+          << "\"min\": " << r.hist.min() << ", "
+          << "\"mean\": " << r.hist.mean() << ", "
+          << "\"p50\": " << r.hist.percentile(50.0) << ", "
+          << "\"p99\": " << r.hist.percentile(99.0) << ", "
+          << "\"p999\": " << r.hist.percentile(99.9) << ", "
+          << "\"max\": " << r.hist.max() << "}}";
+    }
+
+    out << "\n  ]\n}\n";
+  }
+
+} /* namespace */
+
+TEST_F(FSALBenchTest, LOOKUP)
+{
+  run("lookup", BENCH_LOOKUP, false);
+}
+
+TEST_F(FSALBenchTest, LOOKUP_BYPASS)
+{
+  run("lookup", BENCH_LOOKUP, true);
+}
+
+TEST_F(FSALBenchTest, GETATTRS)
+{
+  run("getattrs", BENCH_GETATTRS, false);
+}
+
+TEST_F(FSALBenchTest, GETATTRS_BYPASS)
+{
+  run("getattrs", BENCH_GETATTRS, true);
+}
+
+TEST_F(FSALBenchTest, READ2)
+{
+  run("read2", BENCH_READ2, false);
+}
+
+TEST_F(FSALBenchTest, READ2_BYPASS)
+{
+  run("read2", BENCH_READ2, true);
+}
+
+TEST_F(FSALBenchTest, WRITE2)
+{
+  run("write2", BENCH_WRITE2, false);
+}
+
+TEST_F(FSALBenchTest, WRITE2_BYPASS)
+{
+  run("write2", BENCH_WRITE2, true);
+}
+
+TEST_F(FSALBenchTest, READDIR)
+{
+  run("readdir", BENCH_READDIR, false);
+}
+
+TEST_F(FSALBenchTest, READDIR_BYPASS)
+{
+  run("readdir", BENCH_READDIR, true);
+}
+
+TEST_F(FSALBenchTest, OPEN2_CLOSE2)
+{
+  run("open2", BENCH_OPEN2, false);
+}
+
+TEST_F(FSALBenchTest, OPEN2_CLOSE2_BYPASS)
+{
+  run("open2", BENCH_OPEN2, true);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+       "path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+       "log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+       "id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+       "ganesha debug level")
+
+      ("threads", po::value<string>(),
+       "comma separated thread counts to run each test with (default 4)")
+
+      ("files", po::value<unsigned int>(),
+       "number of files in the working set (default 1000)")
+
+      ("hot-files", po::value<unsigned int>(),
+       "number of files in the hot set (default files / 10)")
+
+      ("hot-pct", po::value<unsigned int>(),
+       "percentage of operations going to the hot set (default 90)")
+
+      ("duration", po::value<unsigned int>(),
+       "seconds to run each test for (default 5)")
+
+      ("io-size", po::value<unsigned int>(),
+       "size of each read2/write2 in bytes (default 4096)")
+
+      ("json", po::value<string>(),
+       "write results as JSON to the given file, - for stdout")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::command_line_parser parser{argc, argv};
+    parser.options(opts).allow_unregistered();
+    po::store(parser.run(), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("threads");
+    if (vm_iter != vm.end()) {
+      stringstream list(vm_iter->second.as<std::string>());
+      string item;
+
+      thread_counts.clear();
+      while (getline(list, item, ',')) {
+        unsigned int n = stoul(item);
+
+        if (n > 0)
+          thread_counts.push_back(n);
+      }
+      if (thread_counts.empty())
+        thread_counts.push_back(1);
+    }
+    vm_iter = vm.find("files");
+    if (vm_iter != vm.end()) {
+      file_count = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("hot-files");
+    if (vm_iter != vm.end()) {
+      hot_count = vm_iter->second.as<unsigned int>();
+    }
+    vm_iter = vm.find("hot-pct");
+    if (vm_iter != vm.end()) {
+      hot_pct = std::min(vm_iter->second.as<unsigned int>(), 100U);
+    }
+    vm_iter = vm.find("duration");
+    if (vm_iter != vm.end()) {
+      duration = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("io-size");
+    if (vm_iter != vm.end()) {
+      io_size = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("json");
+    if (vm_iter != vm.end()) {
+      json_out = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    gtest::env = new gtest::Environment(ganesha_conf, lpath, dlevel,
+					NULL, TEST_ROOT, export_id);
+    ::testing::AddGlobalTestEnvironment(gtest::env);
+
+    code  = RUN_ALL_TESTS();
+
+    if (json_out != nullptr) {
+      if (strcmp(json_out, "-") == 0) {
+        write_json(cout);
+      } else {
+        ofstream out(json_out);
+
+        write_json(out);
+      }
+    }
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+#ifndef GTEST_GTEST_HISTOGRAM_HH
+#define GTEST_GTEST_HISTOGRAM_HH
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+/* Histogram precision: 2^HIST_SUB_BITS sub-buckets per power of two, so a
+ * recorded value is off by less than 1% (HDR histogram with 2 significant
+ * digits). */
+#define HIST_SUB_BITS 8
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT / 2)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_HALF_COUNT)
+
+namespace gtest {
+
+  class LatencyHistogram {
+  public:
+    LatencyHistogram() : counts(HIST_BUCKETS, 0), total(0), sum(0),
+                         min_ns(UINT64_MAX), max_ns(0) {}
+
+    void record(uint64_t ns) {
+      counts[index(ns)]++;
+      total++;
+      sum += ns;
+      if (ns < min_ns)
+        min_ns = ns;
+      if (ns > max_ns)
+        max_ns = ns;
+    }
+
+    void merge(const LatencyHistogram &other) {
+      for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] += other.counts[i];
+      total += other.total;
+      sum += other.sum;
+      if (other.min_ns < min_ns)
+        min_ns = other.min_ns;
+      if (other.max_ns > max_ns)
+        max_ns = other.max_ns;
+    }
+
+    /* Smallest recorded value such that pct percent of the samples are at
+     * or below it, reported as the top of its bucket like HDR does. */
+    uint64_t percentile(double pct) const {
+      uint64_t target, seen = 0;
+
+      if (total == 0)
+        return 0;
+
+      target = (uint64_t) ceil(pct / 100.0 * total);
+      if (target == 0)
+        target = 1;
+
+      for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= target)
+          return std::min(highest_equivalent(i), max_ns);
+      }
+
+      return max_ns;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? min_ns : 0; }
+    uint64_t max() const { return max_ns; }
+    uint64_t mean() const { return total ? sum / total : 0; }
+
+  private:
+    static size_t index(uint64_t v) {
+      int shift;
+
+      if (v < HIST_SUB_COUNT)
+        return v;
+
+      /* Keep the top HIST_SUB_BITS bits of the value */
+      shift = 63 - __builtin_clzll(v) - (HIST_SUB_BITS - 1);
+
+      return shift * HIST_HALF_COUNT + (v >> shift);
+    }
+
+    static uint64_t highest_equivalent(size_t idx) {
+      int shift;
+      uint64_t sub;
+
+      if (idx < HIST_SUB_COUNT)
+        return idx;
+
+      shift = idx / HIST_HALF_COUNT - 1;
+      sub = idx - shift * HIST_HALF_COUNT;
+
+      return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min_ns;
+    uint64_t max_ns;
+  };
+} // namespace gtest
+
+#endif /* GTEST_GTEST_HISTOGRAM_HH */
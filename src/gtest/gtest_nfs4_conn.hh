@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "gtest_nfs4.hh"
+
+extern "C" {
+/* Ganesha headers */
+#include "client_mgr.h"
+#include "nfs_creds.h"
+#include "xprt_handler.h"
+}
+
+#ifndef GTEST_GTEST_NFS4_CONN_HH
+#define GTEST_GTEST_NFS4_CONN_HH
+
+/* Most ops a compound built with NFS4Conn::build() can have */
+#define NFS4_CONN_MAX_OPS 40
+
+/* Callback program number handed to CREATE_SESSION, never called back */
+#define NFS4_CONN_CB_PROGRAM 0x40000000
+
+#include <vector>
+
+namespace gtest {
+
+  inline void set_bitmap(struct bitmap4 *bits, const std::vector<int> &attrs) {
+    memset(bits, 0, sizeof(*bits));
+
+    for (int attr : attrs) {
+      bits->map[attr / 32] |= 1U << (attr % 32);
+      if (bits->bitmap4_len < (u_int) (attr / 32 + 1))
+        bits->bitmap4_len = attr / 32 + 1;
+    }
+  }
+
+  /* A client ID with a one slot session */
+  struct NFS4Session {
+    clientid4 clientid;
+    sessionid4 sessionid;
+    sequenceid4 seqid;
+  };
+
+  /*
+   * A connection from a synthetic client, for running whole COMPOUNDs
+   * through nfs4_Compound() in process.
+   *
+   * The transport never carries anything, but SAL binds sessions to it like
+   * a real one.  Every connection has its own caller address, 127.1.x.y, so
+   * the export must grant access to 127.1.0.0/16.  FSALs that complete I/O
+   * asynchronously are not supported: a compound that would be resumed on
+   * another thread aborts.
+   */
+  class NFS4Conn {
+  public:
+    NFS4Conn(unsigned int id) : id(id) {
+      struct sockaddr_in *remote, *local;
+      struct authunix_parms aup;
+
+      xprt = (SVCXPRT *) gsh_calloc(1, sizeof(*xprt));
+      remote = (struct sockaddr_in *) &xprt->xp_remote.ss;
+      local = (struct sockaddr_in *) &xprt->xp_local.ss;
+
+      xprt->xp_fd = -1;
+      /* Our own reference, so sessions releasing theirs never try to
+       * destroy it. */
+      xprt->xp_refcnt = 1;
+
+      remote->sin_family = AF_INET;
+      remote->sin_addr.s_addr = htonl(0x7f010000 | ((id + 1) & 0xffff));
+      remote->sin_port = htons(700 + id % 300);
+
+      local->sin_family = AF_INET;
+      local->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      local->sin_port = htons(NFS_PORT);
+
+      init_custom_data_for_xprt(xprt);
+
+      req = (nfs_request_t *) gsh_calloc(1, sizeof(*req));
+
+      static_assert(sizeof(aup) <= sizeof(req->svc.rq_msg.rq_cred_body),
+                    "authunix_parms does not fit in rq_cred_body");
+
+      req->svc.rq_xprt = xprt;
+      req->svc.rq_msg.cb_prog = nfs_param.core_param.program[P_NFS];
+      req->svc.rq_msg.cb_vers = NFS_V4;
+      req->svc.rq_msg.cb_proc = NFSPROC4_COMPOUND;
+      req->svc.rq_msg.cb_cred.oa_flavor = AUTH_UNIX;
+
+      memset(&aup, 0, sizeof(aup));
+      aup.aup_time = time(NULL);
+      aup.aup_machname = (char *) "ganesha-gtest";
+      memcpy(req->svc.rq_msg.rq_cred_body, &aup, sizeof(aup));
+    }
+
+    NFS4Conn(const NFS4Conn &) = delete;
+    NFS4Conn &operator=(const NFS4Conn &) = delete;
+
+    ~NFS4Conn() {
+      gsh_free(req);
+
+      dissociate_custom_data_from_xprt(xprt);
+      xprt->xp_flags |= SVC_XPRT_FLAG_DESTROYED;
+      destroy_custom_data_for_destroyed_xprt(xprt);
+
+      /* A session still holding the transport would be left pointing at
+       * freed memory, leak it instead. */
+      EXPECT_EQ(xprt->xp_refcnt, 1);
+      if (xprt->xp_refcnt == 1)
+        gsh_free(xprt);
+    }
+
+    /* Run one COMPOUND the way the worker threads do.  The caller must
+     * release the result with nfs4_Compound_Free(). */
+    nfsstat4 compound(nfs_arg_t *arg, nfs_res_t *res) {
+      int rc;
+
+      req->svc.rq_msg.rm_xid++;
+      req->proc_data = NULL;
+      memset(res, 0, sizeof(*res));
+
+      init_op_context(&req->op_context, NULL, NULL,
+                      (sockaddr_t *) svc_getrpccaller(xprt), NFS_V4, 0,
+                      NFS_REQUEST);
+      export_check_access();
+      now(&op_ctx->start_time);
+      init_credentials();
+      op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
+
+      rc = nfs4_Compound(arg, &req->svc, res);
+
+      if (rc == NFS_REQ_ASYNC_WAIT)
+        LogFatal(COMPONENT_NFS_V4,
+                 "COMPOUND xid %" PRIu32
+                 " went asynchronous, not supported in process",
+                 req->svc.rq_msg.rm_xid);
+
+      if (op_ctx->client != NULL) {
+        put_gsh_client(op_ctx->client);
+        op_ctx->client = NULL;
+      }
+      clean_credentials();
+      release_op_context();
+
+      return res->res_compound4_extended->res_compound4.status;
+    }
+
+    /* Start a minor version 1 compound of count ops, using ops[] */
+    nfs_arg_t *build(unsigned int count) {
+      memset(ops, 0, count * sizeof(ops[0]));
+      memset(&arg, 0, sizeof(arg));
+      arg.arg_compound4.minorversion = 1;
+      arg.arg_compound4.argarray.argarray_len = count;
+      arg.arg_compound4.argarray.argarray_val = ops;
+
+      return &arg;
+    }
+
+    void set_sequence(struct nfs_argop4 *op, NFS4Session *s) {
+      SEQUENCE4args *args = &op->nfs_argop4_u.opsequence;
+
+      op->argop = NFS4_OP_SEQUENCE;
+      memcpy(args->sa_sessionid, s->sessionid, NFS4_SESSIONID_SIZE);
+      args->sa_sequenceid = s->seqid++;
+      args->sa_slotid = 0;
+      args->sa_highest_slotid = 0;
+      args->sa_cachethis = false;
+    }
+
+    /* EXCHANGE_ID, CREATE_SESSION and RECLAIM_COMPLETE for a new client */
+    bool create_session(NFS4Session *s, const char *owner) {
+      EXCHANGE_ID4args *eia;
+      CREATE_SESSION4args *csa;
+      callback_sec_parms4 sec_parms;
+      channel_attrs4 *fore, *back;
+      nfs_res_t res;
+      nfs_resop4 *resop;
+      sequenceid4 csa_sequence = 0;
+      nfsstat4 status;
+
+      build(1);
+      ops[0].argop = NFS4_OP_EXCHANGE_ID;
+      eia = &ops[0].nfs_argop4_u.opexchange_id;
+      memcpy(eia->eia_clientowner.co_verifier, &id, sizeof(id));
+      eia->eia_clientowner.co_ownerid.co_ownerid_len = strlen(owner);
+      eia->eia_clientowner.co_ownerid.co_ownerid_val = (char *) owner;
+      eia->eia_flags = EXCHGID4_FLAG_USE_NON_PNFS;
+      eia->eia_state_protect.spa_how = SP4_NONE;
+
+      status = compound(&arg, &res);
+      if (status == NFS4_OK) {
+        resop = &res.res_compound4_extended->res_compound4.resarray
+                                                         .resarray_val[0];
+        s->clientid = resop->nfs_resop4_u.opexchange_id.EXCHANGE_ID4res_u
+                                                  .eir_resok4.eir_clientid;
+        csa_sequence = resop->nfs_resop4_u.opexchange_id.EXCHANGE_ID4res_u
+                                                  .eir_resok4.eir_sequenceid;
+      }
+      nfs4_Compound_Free(&res);
+      EXPECT_EQ(status, NFS4_OK) << "EXCHANGE_ID";
+      if (status != NFS4_OK)
+        return false;
+
+      build(1);
+      ops[0].argop = NFS4_OP_CREATE_SESSION;
+      csa = &ops[0].nfs_argop4_u.opcreate_session;
+      csa->csa_clientid = s->clientid;
+      csa->csa_sequence = csa_sequence;
+      csa->csa_flags = 0;
+      csa->csa_cb_program = NFS4_CONN_CB_PROGRAM;
+
+      fore = &csa->csa_fore_chan_attrs;
+      fore->ca_maxrequestsize = 1024 * 1024 + 4096;
+      fore->ca_maxresponsesize = 1024 * 1024 + 4096;
+      fore->ca_maxresponsesize_cached = 4096;
+      fore->ca_maxoperations = NFS4_CONN_MAX_OPS;
+      fore->ca_maxrequests = 1;
+
+      back = &csa->csa_back_chan_attrs;
+      back->ca_maxrequestsize = NFS41_MIN_REQUEST_SIZE;
+      back->ca_maxresponsesize = NFS41_MIN_RESPONSE_SIZE;
+      back->ca_maxoperations = NFS41_MIN_OPERATIONS;
+      back->ca_maxrequests = 1;
+
+      memset(&sec_parms, 0, sizeof(sec_parms));
+      sec_parms.cb_secflavor = AUTH_NONE;
+      csa->csa_sec_parms.csa_sec_parms_len = 1;
+      csa->csa_sec_parms.csa_sec_parms_val = &sec_parms;
+
+      status = compound(&arg, &res);
+      if (status == NFS4_OK) {
+        resop = &res.res_compound4_extended->res_compound4.resarray
+                                                         .resarray_val[0];
+        memcpy(s->sessionid,
+               resop->nfs_resop4_u.opcreate_session.CREATE_SESSION4res_u
+                                                   .csr_resok4.csr_sessionid,
+               NFS4_SESSIONID_SIZE);
+        s->seqid = 1;
+      }
+      nfs4_Compound_Free(&res);
+      EXPECT_EQ(status, NFS4_OK) << "CREATE_SESSION";
+      if (status != NFS4_OK)
+        return false;
+
+      build(2);
+      set_sequence(&ops[0], s);
+      ops[1].argop = NFS4_OP_RECLAIM_COMPLETE;
+      ops[1].nfs_argop4_u.opreclaim_complete.rca_one_fs = false;
+
+      status = compound(&arg, &res);
+      nfs4_Compound_Free(&res);
+      EXPECT_EQ(status, NFS4_OK) << "RECLAIM_COMPLETE";
+
+      return status == NFS4_OK;
+    }
+
+    /* DESTROY_SESSION and DESTROY_CLIENTID */
+    void destroy_session(NFS4Session *s) {
+      nfs_res_t res;
+      nfsstat4 status;
+
+      build(1);
+      ops[0].argop = NFS4_OP_DESTROY_SESSION;
+      memcpy(ops[0].nfs_argop4_u.opdestroy_session.dsa_sessionid,
+             s->sessionid, NFS4_SESSIONID_SIZE);
+
+      status = compound(&arg, &res);
+      nfs4_Compound_Free(&res);
+      EXPECT_EQ(status, NFS4_OK) << "DESTROY_SESSION";
+
+      build(1);
+      ops[0].argop = NFS4_OP_DESTROY_CLIENTID;
+      ops[0].nfs_argop4_u.opdestroy_clientid.dca_clientid = s->clientid;
+
+      status = compound(&arg, &res);
+      nfs4_Compound_Free(&res);
+      EXPECT_EQ(status, NFS4_OK) << "DESTROY_CLIENTID";
+    }
+
+    struct nfs_argop4 ops[NFS4_CONN_MAX_OPS];
+
+  private:
+    unsigned int id;
+    SVCXPRT *xprt;
+    nfs_request_t *req;
+    nfs_arg_t arg;
+  };
+} // namespace gtest
+
+#endif /* GTEST_GTEST_NFS4_CONN_HH */
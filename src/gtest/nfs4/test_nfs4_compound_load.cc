@@ -0,0 +1,756 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * In-process NFSv4.1 COMPOUND load generator.
+ *
+ * The *_latency tests call a single op handler with a hand built
+ * compound_data_t.  This instead drives whole COMPOUNDs through
+ * nfs4_Compound() from many threads, with the same op context setup the
+ * worker threads do, so SAL (client IDs, sessions, slots), MDCACHE and the
+ * stats code all see something close to real traffic without a network.
+ *
+ * Every thread gets a fake transport with its own client address, and
+ * establishes --clients-per-thread client IDs, each with a one slot session.
+ * Requests are SEQUENCE + PUTFH + one of READ, WRITE, GETATTR, LOOKUP or
+ * READDIR, picked according to --mix.  READ and WRITE use the anonymous
+ * stateid.
+ *
+ * --compounds replays pre-encoded COMPOUND4args instead (or as well, with
+ * replay=N in --mix).  The file is a sequence of records, each a 4 byte big
+ * endian length followed by the XDR encoded arguments.  Every record must be
+ * a minor version 1 or 2 compound starting with SEQUENCE, whose session and
+ * slot are rewritten to the replaying client's.  File handles and stateids
+ * are used as is, so they must be valid for the running configuration.
+ *
+ * The export must grant access to 127.1.0.0/16, NFSv4.1 must be enabled and
+ * the server must not be in grace (Graceless = true).  FSALs that complete
+ * I/O asynchronously are not supported: a compound that would be resumed
+ * later on another thread aborts the run.
+ *
+ * Typical use:
+ *
+ *   test_nfs4_compound_load --config ganesha.conf --threads 1,8,32 \
+ *       --clients-per-thread 4 --mix read=50,getattr=50 --json load.json
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <memory>
+#include <boost/program_options.hpp>
+
+#include "gtest_nfs4_conn.hh"
+#include "gtest_histogram.hh"
+
+extern "C" {
+/* Manually forward this, as 9P is not C++ safe */
+void admin_halt(void);
+}
+
+#define TEST_ROOT "nfs4_compound_load"
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+  char* json_out = nullptr;
+  char* compounds_path = nullptr;
+
+  std::vector<unsigned int> thread_counts = { 4 };
+  unsigned int clients_per_thread = 4;
+  unsigned int file_count = 1000;
+  unsigned int duration = 5;
+  unsigned int io_size = 4096;
+
+  enum load_op {
+    LOAD_READ,
+    LOAD_WRITE,
+    LOAD_GETATTR,
+    LOAD_LOOKUP,
+    LOAD_READDIR,
+    LOAD_REPLAY,
+    LOAD_OP_COUNT
+  };
+
+  const char *load_op_names[LOAD_OP_COUNT] = {
+    "read", "write", "getattr", "lookup", "readdir", "replay"
+  };
+
+  unsigned int mix[LOAD_OP_COUNT] = { 40, 20, 20, 10, 10, 0 };
+
+  /* Raw records from --compounds, decoded separately by every thread */
+  std::vector<std::string> records;
+
+  struct load_result {
+    std::string op;
+    unsigned int threads;
+    uint64_t errors;
+    double seconds;
+    gtest::LatencyHistogram hist;
+  };
+
+  std::vector<load_result> results;
+
+  struct load_worker {
+    std::thread thread;
+    unsigned int id;
+    std::unique_ptr<gtest::NFS4Conn> conn;
+    std::vector<gtest::NFS4Session> clients;
+    unsigned int next_client = 0;
+    std::vector<nfs_arg_t> replay;
+    size_t next_replay = 0;
+    gtest::LatencyHistogram hist[LOAD_OP_COUNT];
+    uint64_t errors[LOAD_OP_COUNT] = {};
+    std::mt19937_64 rng;
+    char *buf = nullptr;
+    struct iovec iov;
+    char name[NAMELEN];
+    bool ready = false;
+  };
+
+  bool decode_record(const std::string &rec, nfs_arg_t *arg) {
+    XDR xdrs;
+    bool ok;
+
+    memset(arg, 0, sizeof(*arg));
+    xdrmem_create(&xdrs, (char *) rec.data(), rec.size(), XDR_DECODE);
+    ok = xdr_COMPOUND4args(&xdrs, &arg->arg_compound4);
+    xdr_destroy(&xdrs);
+
+    if (!ok) {
+      xdr_free((xdrproc_t) xdr_COMPOUND4args, &arg->arg_compound4);
+      return false;
+    }
+
+    if (arg->arg_compound4.minorversion < 1 ||
+        arg->arg_compound4.argarray.argarray_len == 0 ||
+        arg->arg_compound4.argarray.argarray_val[0].argop !=
+                                                        NFS4_OP_SEQUENCE) {
+      xdr_free((xdrproc_t) xdr_COMPOUND4args, &arg->arg_compound4);
+      return false;
+    }
+
+    return true;
+  }
+
+  bool load_records(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    unsigned char hdr[4];
+
+    if (!in)
+      return false;
+
+    while (in.read((char *) hdr, sizeof(hdr))) {
+      uint32_t len = ((uint32_t) hdr[0] << 24) | (hdr[1] << 16) |
+                     (hdr[2] << 8) | hdr[3];
+      std::string rec(len, '\0');
+      nfs_arg_t arg;
+
+      if (!in.read(&rec[0], len)) {
+        std::cerr << path << ": truncated record " << records.size()
+                  << std::endl;
+        return false;
+      }
+
+      if (!decode_record(rec, &arg)) {
+        std::cerr << path << ": record " << records.size()
+                  << " is not an NFSv4.1 compound starting with SEQUENCE"
+                  << std::endl;
+        return false;
+      }
+
+      xdr_free((xdrproc_t) xdr_COMPOUND4args, &arg.arg_compound4);
+      records.push_back(rec);
+    }
+
+    return !records.empty();
+  }
+
+  class NFS4LoadTest : public gtest::GaneshaFSALBaseTest {
+  protected:
+
+    virtual void SetUp() {
+      struct fsal_io_arg write_arg;
+      struct iovec iov;
+      struct async_process_data io_data;
+      pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+      pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+      char *buf;
+      bool fhres;
+
+      gtest::GaneshaFSALBaseTest::SetUp();
+
+      objs.resize(file_count);
+      fhs.resize(file_count);
+      memset(fhs.data(), 0, file_count * sizeof(nfs_fh4));
+      memset(&dir_fh, 0, sizeof(dir_fh));
+
+      create_and_prime_many(file_count, objs.data());
+
+      fhres = nfs4_FSALToFhandle(true, &dir_fh, test_root,
+                                 op_ctx->ctx_export);
+      ASSERT_EQ(fhres, true);
+
+      /* Give every file some data, so READ has something to return */
+      buf = (char *) malloc(io_size);
+      memset(buf, 'a', io_size);
+
+      for (unsigned int i = 0; i < file_count; ++i) {
+        fhres = nfs4_FSALToFhandle(true, &fhs[i], objs[i],
+                                   op_ctx->ctx_export);
+        ASSERT_EQ(fhres, true);
+
+        memset(&write_arg, 0, sizeof(write_arg));
+        iov.iov_base = buf;
+        iov.iov_len = io_size;
+        write_arg.iov = &iov;
+        write_arg.iov_count = 1;
+        write_arg.io_request = io_size;
+
+        io_data.ret.major = ERR_FSAL_NO_ERROR;
+        io_data.ret.minor = 0;
+        io_data.done = false;
+        io_data.fsa_cond = &cond;
+        io_data.fsa_mutex = &mutex;
+
+        fsal_write(objs[i], true, &write_arg, &io_data);
+        ASSERT_EQ(io_data.ret.major, 0);
+      }
+
+      free(buf);
+    }
+
+    virtual void TearDown() {
+      for (auto &fh : fhs)
+        gsh_free(fh.nfs_fh4_val);
+      gsh_free(dir_fh.nfs_fh4_val);
+
+      remove_many(file_count, objs.data());
+
+      gtest::GaneshaFSALBaseTest::TearDown();
+    }
+
+    enum load_op pick_op(struct load_worker *w) {
+      unsigned int total = 0, r;
+      int op;
+
+      for (op = 0; op < LOAD_OP_COUNT; ++op)
+        total += mix[op];
+
+      r = w->rng() % total;
+
+      for (op = 0; op < LOAD_OP_COUNT - 1; ++op) {
+        if (r < mix[op])
+          break;
+        r -= mix[op];
+      }
+
+      return (enum load_op) op;
+    }
+
+    /* Fill in a synthetic SEQUENCE + PUTFH + op compound */
+    nfs_arg_t *build_op(struct load_worker *w, gtest::NFS4Session *c,
+                        enum load_op op) {
+      unsigned int idx = w->rng() % file_count;
+      nfs_arg_t *arg = w->conn->build(3);
+      struct nfs_argop4 *putfh = &w->conn->ops[1];
+      struct nfs_argop4 *nop = &w->conn->ops[2];
+
+      w->conn->set_sequence(&w->conn->ops[0], c);
+
+      putfh->argop = NFS4_OP_PUTFH;
+      putfh->nfs_argop4_u.opputfh.object =
+                          (op == LOAD_LOOKUP || op == LOAD_READDIR) ? dir_fh
+                                                                    : fhs[idx];
+
+      switch (op) {
+      case LOAD_READ:
+        /* All zero stateid4 is the anonymous stateid */
+        nop->argop = NFS4_OP_READ;
+        nop->nfs_argop4_u.opread.offset = 0;
+        nop->nfs_argop4_u.opread.count = io_size;
+        break;
+
+      case LOAD_WRITE:
+        w->iov.iov_base = w->buf;
+        w->iov.iov_len = io_size;
+        nop->argop = NFS4_OP_WRITE;
+        nop->nfs_argop4_u.opwrite.offset = 0;
+        nop->nfs_argop4_u.opwrite.stable = UNSTABLE4;
+        nop->nfs_argop4_u.opwrite.data.data_len = io_size;
+        nop->nfs_argop4_u.opwrite.data.iovcnt = 1;
+        nop->nfs_argop4_u.opwrite.data.iov = &w->iov;
+        break;
+
+      case LOAD_GETATTR:
+        nop->argop = NFS4_OP_GETATTR;
+        gtest::set_bitmap(&nop->nfs_argop4_u.opgetattr.attr_request,
+                          { FATTR4_TYPE, FATTR4_CHANGE, FATTR4_SIZE,
+                            FATTR4_FILEID, FATTR4_MODE });
+        break;
+
+      case LOAD_LOOKUP:
+        snprintf(w->name, sizeof(w->name), "f-%08x", idx);
+        nop->argop = NFS4_OP_LOOKUP;
+        nop->nfs_argop4_u.oplookup.objname.utf8string_len = strlen(w->name);
+        nop->nfs_argop4_u.oplookup.objname.utf8string_val = w->name;
+        break;
+
+      case LOAD_READDIR:
+        nop->argop = NFS4_OP_READDIR;
+        nop->nfs_argop4_u.opreaddir.cookie = 0;
+        nop->nfs_argop4_u.opreaddir.dircount = 8192;
+        nop->nfs_argop4_u.opreaddir.maxcount = 32768;
+        gtest::set_bitmap(&nop->nfs_argop4_u.opreaddir.attr_request,
+                          { FATTR4_TYPE, FATTR4_FILEID });
+        break;
+
+      default:
+        break;
+      }
+
+      return arg;
+    }
+
+    /* Point the next recorded compound at one of our sessions */
+    nfs_arg_t *next_replay(struct load_worker *w, gtest::NFS4Session *c) {
+      nfs_arg_t *arg = &w->replay[w->next_replay];
+
+      w->next_replay = (w->next_replay + 1) % w->replay.size();
+
+      w->conn->set_sequence(&arg->arg_compound4.argarray.argarray_val[0], c);
+
+      return arg;
+    }
+
+    bool worker_setup(struct load_worker *w) {
+      char owner[64];
+
+      w->conn.reset(new gtest::NFS4Conn(w->id));
+
+      if (mix[LOAD_REPLAY] != 0) {
+        w->replay.resize(records.size());
+        for (size_t i = 0; i < records.size(); ++i)
+          if (!decode_record(records[i], &w->replay[i]))
+            return false;
+      }
+
+      w->clients.resize(clients_per_thread);
+      for (unsigned int i = 0; i < clients_per_thread; ++i) {
+        snprintf(owner, sizeof(owner), "ganesha-load-%d-%u-%u", getpid(),
+                 w->id, i);
+        if (!w->conn->create_session(&w->clients[i], owner)) {
+          w->clients.resize(i);
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    void worker_teardown(struct load_worker *w) {
+      for (auto &c : w->clients)
+        w->conn->destroy_session(&c);
+
+      for (auto &arg : w->replay)
+        xdr_free((xdrproc_t) xdr_COMPOUND4args, &arg.arg_compound4);
+
+      w->conn.reset();
+    }
+
+    void worker(struct load_worker *w) {
+      struct timespec s_time, e_time;
+      nfs_res_t res;
+      nfs_arg_t *arg;
+      nfsstat4 status;
+
+      w->ready = worker_setup(w);
+      ready.fetch_add(1);
+
+      while (!start.load())
+        std::this_thread::yield();
+
+      while (w->ready && !stop.load()) {
+        gtest::NFS4Session *c = &w->clients[w->next_client];
+        enum load_op op = pick_op(w);
+
+        w->next_client = (w->next_client + 1) % w->clients.size();
+
+        arg = op == LOAD_REPLAY ? next_replay(w, c) : build_op(w, c, op);
+
+        now_mono(&s_time);
+        status = w->conn->compound(arg, &res);
+        nfs4_Compound_Free(&res);
+        now_mono(&e_time);
+
+        w->hist[op].record(timespec_diff(&s_time, &e_time));
+        if (status != NFS4_OK)
+          w->errors[op]++;
+      }
+
+      worker_teardown(w);
+    }
+
+    void run() {
+      for (unsigned int nthreads : thread_counts) {
+        std::vector<struct load_worker> workers(nthreads);
+        struct timespec s_time, e_time;
+        struct load_result total;
+        double seconds;
+
+        start.store(false);
+        stop.store(false);
+        ready.store(0);
+
+        for (unsigned int i = 0; i < nthreads; ++i) {
+          struct load_worker *w = &workers[i];
+
+          w->id = i;
+          w->rng.seed(i + 1);
+          w->buf = (char *) malloc(io_size);
+          memset(w->buf, 'b', io_size);
+          w->thread = std::thread(&NFS4LoadTest::worker, this, w);
+        }
+
+        /* Client and session setup is not part of the measurement */
+        while (ready.load() < nthreads)
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        now_mono(&s_time);
+        start.store(true);
+
+        std::this_thread::sleep_for(std::chrono::seconds(duration));
+
+        stop.store(true);
+        for (auto &w : workers)
+          w.thread.join();
+        now_mono(&e_time);
+
+        seconds = timespec_diff(&s_time, &e_time) / 1e9;
+
+        total.op = "all";
+        total.threads = nthreads;
+        total.errors = 0;
+        total.seconds = seconds;
+
+        for (int op = 0; op < LOAD_OP_COUNT; ++op) {
+          struct load_result result;
+
+          result.op = load_op_names[op];
+          result.threads = nthreads;
+          result.errors = 0;
+          result.seconds = seconds;
+
+          for (auto &w : workers) {
+            result.hist.merge(w.hist[op]);
+            result.errors += w.errors[op];
+          }
+
+          if (result.hist.count() == 0)
+            continue;
+
+          total.hist.merge(result.hist);
+          total.errors += result.errors;
+          report(result);
+        }
+
+        report(total);
+
+        for (auto &w : workers) {
+          EXPECT_TRUE(w.ready) << "thread " << w.id << " setup failed";
+          free(w.buf);
+        }
+
+        EXPECT_EQ(total.errors, 0);
+      }
+    }
+
+    void report(const struct load_result &result) {
+      fprintf(stderr,
+              "%-8s threads %3u clients %4u: %10.0f ops/s  p50 %" PRIu64
+              " ns  p99 %" PRIu64 " ns  p999 %" PRIu64 " ns  max %" PRIu64
+              " ns  errors %" PRIu64 "\n",
+              result.op.c_str(), result.threads,
+              result.threads * clients_per_thread,
+              result.hist.count() / result.seconds,
+              result.hist.percentile(50.0), result.hist.percentile(99.0),
+              result.hist.percentile(99.9), result.hist.max(),
+              result.errors);
+
+      results.push_back(result);
+    }
+
+    std::vector<struct fsal_obj_handle *> objs;
+    std::vector<nfs_fh4> fhs;
+    nfs_fh4 dir_fh;
+    std::atomic<bool> start;
+    std::atomic<bool> stop;
+    std::atomic<unsigned int> ready;
+  };
+
+  void write_json(std::ostream &out) {
+    out << "{\n"
+        << "  \"files\": " << file_count << ",\n"
+        << "  \"clients_per_thread\": " << clients_per_thread << ",\n"
+        << "  \"io_size\": " << io_size << ",\n"
+        << "  \"duration\": " << duration << ",\n"
+        << "  \"mix\": {";
+
+    for (int op = 0; op < LOAD_OP_COUNT; ++op)
+      out << (op ? ", " : "") << "\"" << load_op_names[op] << "\": "
+          << mix[op];
+
+    out << "},\n"
+        << "  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+      const load_result &r = results[i];
+
+      out << (i ? "," : "") << "\n    {"
+          << "\"op\": \"" << r.op << "\", "
+          << "\"threads\": " << r.threads << ", "
+          << "\"ops\": " << r.hist.count() << ", "
+          << "\"errors\": " << r.errors << ", "
+          << "\"seconds\": " << r.seconds << ", "
+          << "\"ops_per_sec\": " << (uint64_t) (r.hist.count() / r.seconds)
+          << ", "
+          << "\"latency_ns\": {"
+          << "\"min\": " << r.hist.min() << ", "
+          << "\"mean\": " << r.hist.mean() << ", "
+          << "\"p50\": " << r.hist.percentile(50.0) << ", "
+          << "\"p99\": " << r.hist.percentile(99.0) << ", "
+          << "\"p999\": " << r.hist.percentile(99.9) << ", "
+          << "\"max\": " << r.hist.max() << "}}";
+    }
+
+    out << "\n  ]\n}\n";
+  }
+
+  /* Parse "read=40,write=20,..."; ops that are not named get no weight */
+  bool parse_mix(const std::string &spec) {
+    std::stringstream list(spec);
+    std::string item;
+    unsigned int total = 0;
+
+    for (int op = 0; op < LOAD_OP_COUNT; ++op)
+      mix[op] = 0;
+
+    while (getline(list, item, ',')) {
+      size_t eq = item.find('=');
+      int op;
+
+      if (eq == std::string::npos)
+        return false;
+
+      for (op = 0; op < LOAD_OP_COUNT; ++op)
+        if (item.compare(0, eq, load_op_names[op]) == 0)
+          break;
+
+      if (op == LOAD_OP_COUNT)
+        return false;
+
+      mix[op] = std::stoul(item.substr(eq + 1));
+      total += mix[op];
+    }
+
+    return total != 0;
+  }
+
+} /* namespace */
+
+TEST_F(NFS4LoadTest, COMPOUND)
+{
+  run();
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+       "path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+       "log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+       "id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+       "ganesha debug level")
+
+      ("threads", po::value<string>(),
+       "comma separated thread counts to run with (default 4)")
+
+      ("clients-per-thread", po::value<unsigned int>(),
+       "client IDs, each with its own session, per thread (default 4)")
+
+      ("files", po::value<unsigned int>(),
+       "number of files in the working set (default 1000)")
+
+      ("duration", po::value<unsigned int>(),
+       "seconds to run for (default 5)")
+
+      ("io-size", po::value<unsigned int>(),
+       "size of each READ/WRITE in bytes (default 4096)")
+
+      ("mix", po::value<string>(),
+       "weighted op mix, e.g. read=40,write=20,getattr=20,lookup=10,"
+       "readdir=10,replay=0")
+
+      ("compounds", po::value<string>(),
+       "file of length prefixed XDR COMPOUND4args to replay")
+
+      ("json", po::value<string>(),
+       "write results as JSON to the given file, - for stdout")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::command_line_parser parser{argc, argv};
+    parser.options(opts).allow_unregistered();
+    po::store(parser.run(), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("threads");
+    if (vm_iter != vm.end()) {
+      stringstream list(vm_iter->second.as<std::string>());
+      string item;
+
+      thread_counts.clear();
+      while (getline(list, item, ',')) {
+        unsigned int n = stoul(item);
+
+        if (n > 0)
+          thread_counts.push_back(n);
+      }
+      if (thread_counts.empty())
+        thread_counts.push_back(1);
+    }
+    vm_iter = vm.find("clients-per-thread");
+    if (vm_iter != vm.end()) {
+      clients_per_thread = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("files");
+    if (vm_iter != vm.end()) {
+      file_count = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("duration");
+    if (vm_iter != vm.end()) {
+      duration = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("io-size");
+    if (vm_iter != vm.end()) {
+      io_size = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("compounds");
+    if (vm_iter != vm.end()) {
+      compounds_path = (char*) vm_iter->second.as<std::string>().c_str();
+      if (!load_records(compounds_path)) {
+        cerr << "No usable compounds in " << compounds_path << endl;
+        return 1;
+      }
+      /* Replay only, unless --mix says otherwise */
+      parse_mix("replay=1");
+    }
+    vm_iter = vm.find("mix");
+    if (vm_iter != vm.end()) {
+      if (!parse_mix(vm_iter->second.as<std::string>())) {
+        cerr << "Bad --mix " << vm_iter->second.as<std::string>() << endl;
+        return 1;
+      }
+    }
+    if (mix[LOAD_REPLAY] != 0 && records.empty()) {
+      cerr << "replay in --mix needs --compounds" << endl;
+      return 1;
+    }
+    vm_iter = vm.find("json");
+    if (vm_iter != vm.end()) {
+      json_out = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    gtest::env = new gtest::Environment(ganesha_conf, lpath, dlevel,
+					NULL, TEST_ROOT, export_id);
+    ::testing::AddGlobalTestEnvironment(gtest::env);
+
+    code  = RUN_ALL_TESTS();
+
+    if (json_out != nullptr) {
+      if (strcmp(json_out, "-") == 0) {
+        write_json(cout);
+      } else {
+        ofstream out(json_out);
+
+        write_json(out);
+      }
+    }
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * READ_PLUS hole and data segments.  The export must be backed by an FSAL
+ * that reports holes from read2, such as FSAL_MEM.
+ */
+
+#include <sys/types.h>
+#include <iostream>
+#include <boost/program_options.hpp>
+
+#include "gtest_nfs4.hh"
+
+extern "C" {
+/* Manually forward this, as 9P is not C++ safe */
+void admin_halt(void);
+/* Ganesha headers */
+#include "sal_data.h"
+}
+
+#define TEST_ROOT "nfs4_read_plus"
+#define TEST_FILE "test_file"
+#define DATA_OFFSET (1024 * 1024)
+#define DATA_SIZE 4096
+
+namespace {
+
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+  class ReadPlusTest : public gtest::GaeshaNFS4BaseTest {
+  protected:
+
+    virtual void SetUp() {
+      fsal_status_t status;
+      bool caller_perm_check = false;
+      struct fsal_io_arg *write_arg;
+      struct async_process_data io_data;
+      struct state_t *state;
+
+      GaeshaNFS4BaseTest::SetUp();
+
+      state = op_ctx->fsal_export->exp_ops.alloc_state(op_ctx->fsal_export,
+                                                       STATE_TYPE_SHARE,
+                                                       NULL);
+      ASSERT_NE(state, nullptr);
+
+      status = test_root->obj_ops->open2(test_root, state, FSAL_O_RDWR,
+                                         FSAL_UNCHECKED, TEST_FILE, NULL,
+                                         NULL, &test_file, NULL,
+                                         &caller_perm_check, nullptr,
+                                         nullptr);
+      ASSERT_EQ(status.major, 0);
+
+      /* Leave a hole in front of the data */
+      memset(databuffer, 'a', DATA_SIZE);
+
+      write_arg = (struct fsal_io_arg *)alloca(sizeof(struct fsal_io_arg) +
+                                               sizeof(struct iovec));
+      memset(write_arg, 0, sizeof(*write_arg));
+      write_arg->state = state;
+      write_arg->offset = DATA_OFFSET;
+      write_arg->io_request = DATA_SIZE;
+      write_arg->iov_count = 1;
+      write_arg->iov[0].iov_len = DATA_SIZE;
+      write_arg->iov[0].iov_base = databuffer;
+      write_arg->fsal_stable = true;
+
+      io_data.ret.major = ERR_FSAL_NO_ERROR;
+      io_data.ret.minor = 0;
+      io_data.done = false;
+      io_data.fsa_cond = &cond;
+      io_data.fsa_mutex = &mutex;
+
+      fsal_write(test_file, false, write_arg, &io_data);
+      ASSERT_EQ(io_data.ret.major, 0);
+      ASSERT_EQ(write_arg->io_amount, (size_t)DATA_SIZE);
+
+      status = test_file->obj_ops->close2(test_file, state);
+      EXPECT_EQ(status.major, 0);
+      free_state(state);
+
+      data->minorversion = 2;
+      setCurrentFH(test_file);
+    }
+
+    virtual void TearDown() {
+      fsal_status_t status;
+
+      set_current_entry(data, nullptr);
+
+      status = fsal_remove(test_root, TEST_FILE, NULL, NULL);
+      EXPECT_EQ(status.major, 0);
+      test_file->obj_ops->put_ref(test_file);
+      test_file = NULL;
+
+      GaeshaNFS4BaseTest::TearDown();
+    }
+
+    /* READ_PLUS with the anonymous stateid */
+    READ_PLUS4res *read_plus(offset4 offset, count4 count) {
+      enum nfs_req_result rc;
+
+      nfs4_Compound_FreeOne(&resp);
+      memset(&resp, 0, sizeof(resp));
+
+      ops[0].argop = NFS4_OP_READ_PLUS;
+      memset(&ops[0].nfs_argop4_u.opread_plus, 0,
+             sizeof(ops[0].nfs_argop4_u.opread_plus));
+      ops[0].nfs_argop4_u.opread_plus.rpa_offset = offset;
+      ops[0].nfs_argop4_u.opread_plus.rpa_count = count;
+
+      rc = nfs4_op_read_plus(&ops[0], data, &resp);
+      EXPECT_EQ(rc, NFS_REQ_OK);
+
+      return &resp.nfs_resop4_u.opread_plus;
+    }
+
+    struct fsal_obj_handle *test_file = nullptr;
+    char databuffer[DATA_SIZE];
+  };
+
+} /* namespace */
+
+TEST_F(ReadPlusTest, HOLE)
+{
+  READ_PLUS4res *res = read_plus(0, 8192);
+  contents *c = &res->rpr_resok4.rpr_contents;
+
+  ASSERT_EQ(res->rpr_status, NFS4_OK);
+  EXPECT_EQ(res->rpr_resok4.rpr_contents_count, 1U);
+  EXPECT_FALSE(res->rpr_resok4.rpr_eof);
+  ASSERT_EQ(c->what, NFS4_CONTENT_HOLE);
+  EXPECT_EQ(c->hole.di_offset, 0U);
+  EXPECT_EQ(c->hole.di_length, 8192U);
+}
+
+TEST_F(ReadPlusTest, DATA)
+{
+  READ_PLUS4res *res = read_plus(DATA_OFFSET, DATA_SIZE);
+  contents *c = &res->rpr_resok4.rpr_contents;
+
+  ASSERT_EQ(res->rpr_status, NFS4_OK);
+  EXPECT_EQ(res->rpr_resok4.rpr_contents_count, 1U);
+  EXPECT_TRUE(res->rpr_resok4.rpr_eof);
+  ASSERT_EQ(c->what, NFS4_CONTENT_DATA);
+  EXPECT_EQ(c->data.d_offset, (offset4)DATA_OFFSET);
+  ASSERT_EQ(c->data.d_data.data_len, (u_int)DATA_SIZE);
+  ASSERT_NE(c->data.d_data.data_val, nullptr);
+  EXPECT_EQ(memcmp(c->data.d_data.data_val, databuffer, DATA_SIZE), 0);
+}
+
+TEST_F(ReadPlusTest, HOLE_THEN_DATA)
+{
+  /* A single segment is returned, the hole up to the data */
+  READ_PLUS4res *res = read_plus(DATA_OFFSET - 1024, 2048);
+  contents *c = &res->rpr_resok4.rpr_contents;
+
+  ASSERT_EQ(res->rpr_status, NFS4_OK);
+  ASSERT_EQ(c->what, NFS4_CONTENT_HOLE);
+  EXPECT_EQ(c->hole.di_offset, (offset4)(DATA_OFFSET - 1024));
+  EXPECT_EQ(c->hole.di_length, 1024U);
+
+  /* Then the data after it */
+  res = read_plus(DATA_OFFSET, 2048);
+  c = &res->rpr_resok4.rpr_contents;
+
+  ASSERT_EQ(res->rpr_status, NFS4_OK);
+  ASSERT_EQ(c->what, NFS4_CONTENT_DATA);
+  EXPECT_EQ(c->data.d_offset, (offset4)DATA_OFFSET);
+  ASSERT_EQ(c->data.d_data.data_len, 2048U);
+  EXPECT_EQ(memcmp(c->data.d_data.data_val, databuffer, 2048), 0);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+  char* session_name = NULL;
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+       "path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+       "log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+       "id of an FSAL_MEM export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+       "ganesha debug level")
+
+      ("session", po::value<string>(),
+       "LTTng session name")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::command_line_parser parser{argc, argv};
+    parser.options(opts).allow_unregistered();
+    po::store(parser.run(), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+         (char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("session");
+    if (vm_iter != vm.end()) {
+      session_name = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    gtest::env = new gtest::Environment(ganesha_conf, lpath, dlevel,
+                                        session_name, TEST_ROOT, export_id);
+    ::testing::AddGlobalTestEnvironment(gtest::env);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
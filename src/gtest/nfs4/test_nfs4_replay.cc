@@ -0,0 +1,768 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Replay of an RPC capture (RPC_Capture_File) against an in-process server.
+ *
+ * Every NFSv4 COMPOUND in the capture that can be rebuilt from its record is
+ * run through nfs4_Compound() at the time it originally arrived, divided by
+ * --speed, and its latency is compared with the captured one per op class
+ * (the first op after SEQUENCE and PUTFH).
+ *
+ * Only stateless ops are replayed: compounds containing OPEN, CLOSE, LOCK,
+ * SETATTR, CREATE, REMOVE and the like, or client ID and session management,
+ * are skipped and counted.  READ uses the anonymous stateid, WRITE writes a
+ * pattern since data is never captured, and LOOKUP needs the names from the
+ * capture payload.  File handles are used as captured, so the replaying
+ * configuration must export the same file systems with the same FSALs.
+ *
+ * Each client address in the capture gets a session of its own, and all of
+ * a client's requests are replayed in order by one thread, --threads of
+ * which share the clients.  NFSv4.0 compounds are replayed without a
+ * client ID, which is enough for the ops replayed.
+ *
+ * The export must grant access to 127.1.0.0/16, NFSv4.1 must be enabled and
+ * the server must not be in grace (Graceless = true).
+ *
+ * Typical use:
+ *
+ *   test_nfs4_replay --config ganesha.conf --trace /var/tmp/rpc.capture \
+ *       --speed 4 --threads 8 --json replay.json
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <string>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <boost/program_options.hpp>
+
+#include "gtest_nfs4_conn.hh"
+#include "gtest_histogram.hh"
+
+extern "C" {
+/* Manually forward this, as 9P is not C++ safe */
+void admin_halt(void);
+/* Ganesha headers */
+#include "nfs_convert.h"
+#include "nfs_rpc_capture.h"
+}
+
+#define TEST_ROOT "nfs4_replay"
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+  char* json_out = nullptr;
+  char* trace_path = nullptr;
+
+  double speed = 1.0;
+  unsigned int thread_count = 4;
+
+  enum replay_skip {
+    SKIP_NOT_NFS4,
+    SKIP_SESSION,
+    SKIP_STATEFUL,
+    SKIP_FH,
+    SKIP_NAMES,
+    SKIP_OPS,
+    SKIP_COUNT
+  };
+
+  const char *skip_names[SKIP_COUNT] = {
+    "not an NFSv4 COMPOUND",
+    "client ID or session management",
+    "stateful or unsupported op",
+    "file handle not captured",
+    "names elided or truncated",
+    "op list truncated"
+  };
+
+  struct replay_rec {
+    struct rpc_capture_rec rec;
+    std::string payload;
+    unsigned int client;
+  };
+
+  struct replay_client {
+    std::string key;
+    bool v41 = false;
+  };
+
+  struct capture_info {
+    uint64_t start_sec;
+    uint64_t flags;
+    uint64_t records;
+    uint64_t skipped[SKIP_COUNT];
+  } info;
+
+  /* Replayable records, in arrival order */
+  std::vector<replay_rec> records;
+  std::vector<replay_client> clients;
+
+  struct replay_class {
+    gtest::LatencyHistogram captured;
+    gtest::LatencyHistogram replayed;
+    uint64_t mismatches = 0;
+  };
+
+  std::map<int, replay_class> classes;
+  double replay_seconds;
+
+  struct replay_worker {
+    std::thread thread;
+    unsigned int id;
+    std::unique_ptr<gtest::NFS4Conn> conn;
+    /* Sessions of our clients, by client index */
+    std::map<unsigned int, gtest::NFS4Session> sessions;
+    std::vector<const replay_rec *> recs;
+    std::map<int, replay_class> classes;
+    std::vector<char> buf;
+    struct iovec iov;
+    bool ready = false;
+  };
+
+  /* The op a compound is about, past SEQUENCE and the PUTFH */
+  int op_class(const struct rpc_capture_rec *rec) {
+    for (unsigned int i = 0; i < rec->nops; ++i) {
+      switch (rec->ops[i]) {
+      case NFS4_OP_SEQUENCE:
+      case NFS4_OP_PUTFH:
+      case NFS4_OP_PUTROOTFH:
+      case NFS4_OP_PUTPUBFH:
+        continue;
+      default:
+        return rec->ops[i];
+      }
+    }
+
+    return rec->nops ? rec->ops[rec->nops - 1] : 0;
+  }
+
+  /* Count the NUL terminated names in a payload */
+  unsigned int payload_names(const std::string &payload) {
+    return std::count(payload.begin(), payload.end(), '\0');
+  }
+
+  int classify(const struct replay_rec &r) {
+    const struct rpc_capture_rec *rec = &r.rec;
+    unsigned int putfh = 0, names = 0;
+
+    if (rec->prog != nfs_param.core_param.program[P_NFS] ||
+        rec->vers != NFS_V4 || rec->proc != NFSPROC4_COMPOUND ||
+        rec->nops == 0)
+      return SKIP_NOT_NFS4;
+
+    /* We can not tell whether there were more ops than recorded */
+    if (rec->nops >= RPC_CAPTURE_MAX_OPS)
+      return SKIP_OPS;
+
+    if (rec->minorversion >= 1 && rec->ops[0] != NFS4_OP_SEQUENCE)
+      return SKIP_SESSION;
+
+    for (unsigned int i = 0; i < rec->nops; ++i) {
+      switch (rec->ops[i]) {
+      case NFS4_OP_SEQUENCE:
+        if (i != 0 || rec->minorversion == 0)
+          return SKIP_STATEFUL;
+        break;
+
+      case NFS4_OP_PUTFH:
+        putfh++;
+        break;
+
+      case NFS4_OP_LOOKUP:
+      case NFS4_OP_SECINFO:
+        names++;
+        break;
+
+      case NFS4_OP_PUTROOTFH:
+      case NFS4_OP_PUTPUBFH:
+      case NFS4_OP_GETFH:
+      case NFS4_OP_SAVEFH:
+      case NFS4_OP_RESTOREFH:
+      case NFS4_OP_LOOKUPP:
+      case NFS4_OP_GETATTR:
+      case NFS4_OP_ACCESS:
+      case NFS4_OP_READ:
+      case NFS4_OP_WRITE:
+      case NFS4_OP_COMMIT:
+      case NFS4_OP_READDIR:
+      case NFS4_OP_READLINK:
+      case NFS4_OP_SECINFO_NO_NAME:
+        break;
+
+      default:
+        return SKIP_STATEFUL;
+      }
+    }
+
+    /* Only the first handle is captured */
+    if (putfh > 1 || (putfh == 1 && rec->fh_len == 0))
+      return SKIP_FH;
+
+    if (names != 0 && ((info.flags & RPC_CAPTURE_FLAG_ELIDED) ||
+                       (rec->flags & RPC_CAPTURE_REC_TRUNCATED) ||
+                       payload_names(r.payload) < names))
+      return SKIP_NAMES;
+
+    return -1;
+  }
+
+  /*
+   * Collect the records still intact in the ring.  The oldest ones may have
+   * been partly overwritten, and the tail of each lap may be a leftover from
+   * the previous one, so anything whose offset does not match where it sits
+   * is skipped 8 bytes at a time.
+   */
+  bool load_trace(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> data;
+    const struct rpc_capture_hdr *hdr;
+    std::map<std::string, unsigned int> client_index;
+    const char *ring;
+    uint64_t size, head, abs;
+
+    if (!in)
+      return false;
+
+    data.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+
+    hdr = (const struct rpc_capture_hdr *) data.data();
+    if (data.size() < RPC_CAPTURE_HDR_SIZE ||
+        hdr->magic != RPC_CAPTURE_MAGIC ||
+        hdr->version != RPC_CAPTURE_VERSION ||
+        data.size() < RPC_CAPTURE_HDR_SIZE + hdr->data_size) {
+      std::cerr << path << ": not an RPC capture" << std::endl;
+      return false;
+    }
+
+    ring = data.data() + RPC_CAPTURE_HDR_SIZE;
+    size = hdr->data_size;
+    head = hdr->head;
+    info.start_sec = hdr->start_sec;
+    info.flags = hdr->flags;
+
+    abs = head > size ? head - size : 0;
+
+    while (abs < head) {
+      uint64_t pos = abs % size;
+      const struct rpc_capture_rec *rec =
+                              (const struct rpc_capture_rec *) (ring + pos);
+      struct replay_rec r;
+      std::string key;
+      int skip;
+
+      if (pos + sizeof(*rec) > size || rec->magic != RPC_CAPTURE_REC_MAGIC ||
+          rec->offset != abs || rec->len < sizeof(*rec) + rec->payload_len ||
+          rec->len % 8 != 0 || pos + rec->len > size) {
+        abs += 8;
+        continue;
+      }
+
+      abs += rec->len;
+      info.records++;
+
+      r.rec = *rec;
+      r.payload.assign((const char *) (rec + 1), rec->payload_len);
+
+      skip = classify(r);
+      if (skip >= 0) {
+        info.skipped[skip]++;
+        continue;
+      }
+
+      key.assign((const char *) &rec->family, sizeof(rec->family));
+      key.append((const char *) rec->addr, sizeof(rec->addr));
+
+      auto it = client_index.find(key);
+
+      if (it == client_index.end()) {
+        it = client_index.emplace(key, clients.size()).first;
+        clients.emplace_back();
+        clients.back().key = key;
+      }
+
+      r.client = it->second;
+      if (rec->minorversion >= 1)
+        clients[r.client].v41 = true;
+
+      records.push_back(r);
+    }
+
+    /* Records are in the ring in completion order */
+    std::stable_sort(records.begin(), records.end(),
+                     [](const replay_rec &a, const replay_rec &b) {
+                       return a.rec.time_ns < b.rec.time_ns;
+                     });
+
+    return true;
+  }
+
+  class NFS4ReplayTest : public gtest::GaneshaBaseTest {
+  protected:
+
+    /* Rebuild a compound from its record */
+    nfs_arg_t *build_record(struct replay_worker *w, const replay_rec *r) {
+      const struct rpc_capture_rec *rec = &r->rec;
+      nfs_arg_t *arg = w->conn->build(rec->nops);
+      const char *name = r->payload.data();
+
+      arg->arg_compound4.minorversion = rec->minorversion;
+
+      for (unsigned int i = 0; i < rec->nops; ++i) {
+        struct nfs_argop4 *op = &w->conn->ops[i];
+        utf8string *objname = nullptr;
+
+        op->argop = (nfs_opnum4) rec->ops[i];
+
+        switch (op->argop) {
+        case NFS4_OP_SEQUENCE:
+          w->conn->set_sequence(op, &w->sessions[r->client]);
+          break;
+
+        case NFS4_OP_PUTFH:
+          op->nfs_argop4_u.opputfh.object.nfs_fh4_len = rec->fh_len;
+          op->nfs_argop4_u.opputfh.object.nfs_fh4_val = (char *) rec->fh;
+          break;
+
+        case NFS4_OP_READ:
+          /* All zero stateid4 is the anonymous stateid */
+          op->nfs_argop4_u.opread.offset = rec->io_offset;
+          op->nfs_argop4_u.opread.count = rec->io_count;
+          break;
+
+        case NFS4_OP_WRITE:
+          w->iov.iov_base = w->buf.data();
+          w->iov.iov_len = rec->io_count;
+          op->nfs_argop4_u.opwrite.offset = rec->io_offset;
+          op->nfs_argop4_u.opwrite.stable = UNSTABLE4;
+          op->nfs_argop4_u.opwrite.data.data_len = rec->io_count;
+          op->nfs_argop4_u.opwrite.data.iovcnt = 1;
+          op->nfs_argop4_u.opwrite.data.iov = &w->iov;
+          break;
+
+        case NFS4_OP_GETATTR:
+          gtest::set_bitmap(&op->nfs_argop4_u.opgetattr.attr_request,
+                            { FATTR4_TYPE, FATTR4_CHANGE, FATTR4_SIZE,
+                              FATTR4_FILEID, FATTR4_MODE, FATTR4_NUMLINKS,
+                              FATTR4_OWNER, FATTR4_OWNER_GROUP,
+                              FATTR4_TIME_MODIFY });
+          break;
+
+        case NFS4_OP_ACCESS:
+          op->nfs_argop4_u.opaccess.access =
+                ACCESS4_READ | ACCESS4_LOOKUP | ACCESS4_MODIFY |
+                ACCESS4_EXTEND | ACCESS4_DELETE | ACCESS4_EXECUTE;
+          break;
+
+        case NFS4_OP_READDIR:
+          op->nfs_argop4_u.opreaddir.cookie = 0;
+          op->nfs_argop4_u.opreaddir.dircount = 8192;
+          op->nfs_argop4_u.opreaddir.maxcount = 32768;
+          gtest::set_bitmap(&op->nfs_argop4_u.opreaddir.attr_request,
+                            { FATTR4_TYPE, FATTR4_FILEID });
+          break;
+
+        case NFS4_OP_SECINFO_NO_NAME:
+          op->nfs_argop4_u.opsecinfo_no_name = SECINFO_STYLE4_CURRENT_FH;
+          break;
+
+        case NFS4_OP_LOOKUP:
+          objname = &op->nfs_argop4_u.oplookup.objname;
+          break;
+
+        case NFS4_OP_SECINFO:
+          objname = &op->nfs_argop4_u.opsecinfo.name;
+          break;
+
+        default:
+          /* COMMIT of the whole file, and ops without arguments */
+          break;
+        }
+
+        if (objname != nullptr) {
+          objname->utf8string_len = strlen(name);
+          objname->utf8string_val = (char *) name;
+          name += objname->utf8string_len + 1;
+        }
+      }
+
+      return arg;
+    }
+
+    bool worker_setup(struct replay_worker *w) {
+      char owner[64];
+      uint32_t io_max = 0;
+
+      w->conn.reset(new gtest::NFS4Conn(w->id));
+
+      for (const replay_rec *r : w->recs)
+        io_max = std::max(io_max, r->rec.io_count);
+
+      w->buf.assign(io_max, 'r');
+
+      for (const replay_rec *r : w->recs) {
+        if (!clients[r->client].v41 || w->sessions.count(r->client))
+          continue;
+
+        snprintf(owner, sizeof(owner), "ganesha-replay-%d-%u", getpid(),
+                 r->client);
+        if (!w->conn->create_session(&w->sessions[r->client], owner)) {
+          w->sessions.erase(r->client);
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    void worker_teardown(struct replay_worker *w) {
+      for (auto &s : w->sessions)
+        w->conn->destroy_session(&s.second);
+
+      w->conn.reset();
+    }
+
+    void worker(struct replay_worker *w) {
+      struct timespec s_time, e_time;
+      nfs_res_t res;
+      nfs_arg_t *arg;
+      nfsstat4 status;
+
+      w->ready = worker_setup(w);
+      ready.fetch_add(1);
+
+      while (!start.load())
+        std::this_thread::yield();
+
+      for (const replay_rec *r : w->recs) {
+        replay_class *c = &w->classes[op_class(&r->rec)];
+
+        if (!w->ready)
+          break;
+
+        if (speed > 0)
+          std::this_thread::sleep_until(
+                        t0 + std::chrono::nanoseconds((uint64_t) (
+                                (r->rec.time_ns - first_ns) / speed)));
+
+        arg = build_record(w, r);
+
+        now_mono(&s_time);
+        status = w->conn->compound(arg, &res);
+        nfs4_Compound_Free(&res);
+        now_mono(&e_time);
+
+        c->replayed.record(timespec_diff(&s_time, &e_time));
+        if (status != r->rec.status)
+          c->mismatches++;
+      }
+
+      worker_teardown(w);
+    }
+
+    void run() {
+      std::vector<struct replay_worker> workers(thread_count);
+      struct timespec s_time, e_time;
+
+      ASSERT_FALSE(records.empty()) << "nothing to replay";
+
+      for (auto &r : records)
+        classes[op_class(&r.rec)].captured.record(r.rec.latency_ns);
+
+      /* Clients are spread over the threads, each keeping its order */
+      for (auto &r : records)
+        workers[r.client % thread_count].recs.push_back(&r);
+
+      first_ns = records.front().rec.time_ns;
+      start.store(false);
+      ready.store(0);
+
+      for (unsigned int i = 0; i < thread_count; ++i) {
+        workers[i].id = i;
+        workers[i].thread = std::thread(&NFS4ReplayTest::worker, this,
+                                        &workers[i]);
+      }
+
+      /* Session setup is not part of the replay */
+      while (ready.load() < thread_count)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+      now_mono(&s_time);
+      t0 = std::chrono::steady_clock::now();
+      start.store(true);
+
+      for (auto &w : workers)
+        w.thread.join();
+      now_mono(&e_time);
+
+      replay_seconds = timespec_diff(&s_time, &e_time) / 1e9;
+
+      for (auto &w : workers) {
+        EXPECT_TRUE(w.ready) << "thread " << w.id << " setup failed";
+
+        for (auto &wc : w.classes) {
+          replay_class *c = &classes[wc.first];
+
+          c->replayed.merge(wc.second.replayed);
+          c->mismatches += wc.second.mismatches;
+        }
+      }
+
+      report();
+    }
+
+    void report() {
+      replay_class total;
+      uint64_t skipped = 0;
+
+      for (int i = 0; i < SKIP_COUNT; ++i) {
+        skipped += info.skipped[i];
+        if (info.skipped[i] != 0)
+          fprintf(stderr, "skipped %10" PRIu64 ": %s\n", info.skipped[i],
+                  skip_names[i]);
+      }
+
+      fprintf(stderr,
+              "replayed %" PRIu64 " of %" PRIu64 " records from %zu "
+              "clients in %.3f s, trace spans %.3f s\n",
+              info.records - skipped, info.records, clients.size(),
+              replay_seconds,
+              (records.back().rec.time_ns - first_ns) / 1e9);
+
+      for (auto &c : classes) {
+        report_class(nfsop4_to_str(c.first), c.second);
+        total.captured.merge(c.second.captured);
+        total.replayed.merge(c.second.replayed);
+        total.mismatches += c.second.mismatches;
+      }
+
+      report_class("all", total);
+    }
+
+    void report_class(const char *name, const replay_class &c) {
+      const gtest::LatencyHistogram &a = c.captured, &b = c.replayed;
+
+      fprintf(stderr,
+              "%-16s ops %8" PRIu64 "  captured p50 %" PRIu64 " p99 %" PRIu64
+              " p999 %" PRIu64 " ns  replayed p50 %" PRIu64 " p99 %" PRIu64
+              " p999 %" PRIu64 " ns  ratio p50 %.2f p99 %.2f"
+              "  status mismatches %" PRIu64 "\n",
+              name, b.count(), a.percentile(50.0), a.percentile(99.0),
+              a.percentile(99.9), b.percentile(50.0), b.percentile(99.0),
+              b.percentile(99.9),
+              (double) b.percentile(50.0) /
+                std::max(a.percentile(50.0), (uint64_t) 1),
+              (double) b.percentile(99.0) /
+                std::max(a.percentile(99.0), (uint64_t) 1),
+              c.mismatches);
+    }
+
+    std::atomic<bool> start;
+    std::atomic<unsigned int> ready;
+    std::chrono::steady_clock::time_point t0;
+    uint64_t first_ns;
+  };
+
+  void write_hist(std::ostream &out, const gtest::LatencyHistogram &h) {
+    out << "{"
+        << "\"count\": " << h.count() << ", "
+        << "\"mean\": " << h.mean() << ", "
+        << "\"p50\": " << h.percentile(50.0) << ", "
+        << "\"p99\": " << h.percentile(99.0) << ", "
+        << "\"p999\": " << h.percentile(99.9) << ", "
+        << "\"max\": " << h.max() << "}";
+  }
+
+  void write_json(std::ostream &out) {
+    bool first = true;
+
+    out << "{\n"
+        << "  \"trace\": \"" << trace_path << "\",\n"
+        << "  \"start_sec\": " << info.start_sec << ",\n"
+        << "  \"speed\": " << speed << ",\n"
+        << "  \"threads\": " << thread_count << ",\n"
+        << "  \"clients\": " << clients.size() << ",\n"
+        << "  \"records\": " << info.records << ",\n"
+        << "  \"seconds\": " << replay_seconds << ",\n"
+        << "  \"skipped\": {";
+
+    for (int i = 0; i < SKIP_COUNT; ++i)
+      out << (i ? ", " : "") << "\"" << skip_names[i] << "\": "
+          << info.skipped[i];
+
+    out << "},\n"
+        << "  \"classes\": [";
+
+    for (auto &c : classes) {
+      out << (first ? "" : ",") << "\n    {"
+          << "\"op\": \"" << nfsop4_to_str(c.first) << "\", "
+          << "\"status_mismatches\": " << c.second.mismatches << ", "
+          << "\"captured_ns\": ";
+      write_hist(out, c.second.captured);
+      out << ", \"replayed_ns\": ";
+      write_hist(out, c.second.replayed);
+      out << "}";
+      first = false;
+    }
+
+    out << "\n  ]\n}\n";
+  }
+
+} /* namespace */
+
+TEST_F(NFS4ReplayTest, REPLAY)
+{
+  run();
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+       "path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+       "log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+       "id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+       "ganesha debug level")
+
+      ("trace", po::value<string>(),
+       "RPC capture file to replay (required)")
+
+      ("speed", po::value<double>(),
+       "replay rate relative to the capture, 0 for as fast as possible "
+       "(default 1)")
+
+      ("threads", po::value<unsigned int>(),
+       "threads to replay with (default 4)")
+
+      ("json", po::value<string>(),
+       "write results as JSON to the given file, - for stdout")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::command_line_parser parser{argc, argv};
+    parser.options(opts).allow_unregistered();
+    po::store(parser.run(), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("trace");
+    if (vm_iter != vm.end()) {
+      trace_path = (char*) vm_iter->second.as<std::string>().c_str();
+    } else {
+      cerr << "--trace is required" << endl;
+      return 1;
+    }
+    vm_iter = vm.find("speed");
+    if (vm_iter != vm.end()) {
+      speed = std::max(vm_iter->second.as<double>(), 0.0);
+    }
+    vm_iter = vm.find("threads");
+    if (vm_iter != vm.end()) {
+      thread_count = std::max(vm_iter->second.as<unsigned int>(), 1U);
+    }
+    vm_iter = vm.find("json");
+    if (vm_iter != vm.end()) {
+      json_out = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    gtest::env = new gtest::Environment(ganesha_conf, lpath, dlevel,
+					NULL, TEST_ROOT, export_id);
+    ::testing::AddGlobalTestEnvironment(gtest::env);
+
+    /* Needs the configuration loaded to know the NFS program number */
+    if (!load_trace(trace_path)) {
+      cerr << "Could not read " << trace_path << endl;
+      return 1;
+    }
+
+    code  = RUN_ALL_TESTS();
+
+    if (json_out != nullptr) {
+      if (strcmp(json_out, "-") == 0) {
+        write_json(cout);
+      } else {
+        ofstream out(json_out);
+
+        write_json(out);
+      }
+    }
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
@@ -0,0 +1,510 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * 9P/TCP through the loopback socket backend.
+ *
+ * Opens in-process connections to the 9P dispatcher and drives Tversion,
+ * Tattach, Twalk, Tlopen and Tread through them, so the dispatcher, the
+ * workers and the interpreter run as they do for a network client.  The
+ * configuration must enable 9P, serve it with
+ *
+ *   _9P { _9P_Socket_Backend = loopback; }
+ *
+ * and allow 9P on the export, for 127.0.0.1.
+ */
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "gtest.hh"
+
+extern "C" {
+/* Manually forward this, as 9P is not C++ safe */
+void admin_halt(void);
+/* Ganesha headers */
+#include "gsh_config.h"
+#include "9p_sock.h"
+}
+
+#define TEST_ROOT "9p_loopback"
+#define TEST_FILE "test_file"
+#define DATA_SIZE 4096
+#define LOOP_COUNT 100000
+
+/* From 9p.h, which is not C++ safe */
+#define P9_RLERROR 7
+#define P9_TLOPEN 12
+#define P9_RLOPEN 13
+#define P9_TVERSION 100
+#define P9_RVERSION 101
+#define P9_TATTACH 104
+#define P9_RATTACH 105
+#define P9_TWALK 110
+#define P9_RWALK 111
+#define P9_TREAD 116
+#define P9_RREAD 117
+#define P9_TCLUNK 120
+#define P9_RCLUNK 121
+#define P9_NOTAG ((uint16_t)~0)
+#define P9_NOFID ((uint32_t)~0)
+#define P9_QID_SIZE 13
+
+namespace {
+
+  char* event_list = nullptr;
+  uint32_t msize = 65536;
+
+  /* A 9P message, built or parsed in wire (little endian) order */
+  class Msg {
+  public:
+    std::vector<uint8_t> buf;
+    size_t pos = 0;
+
+    Msg() {}
+
+    Msg(uint8_t type, uint16_t tag) {
+      put32(0);
+      put8(type);
+      put16(tag);
+    }
+
+    void put8(uint8_t v) {
+      buf.push_back(v);
+    }
+
+    void put16(uint16_t v) {
+      put8(v);
+      put8(v >> 8);
+    }
+
+    void put32(uint32_t v) {
+      put16(v);
+      put16(v >> 16);
+    }
+
+    void put64(uint64_t v) {
+      put32(v);
+      put32(v >> 32);
+    }
+
+    void putstr(const char *s) {
+      size_t len = strlen(s);
+
+      put16(len);
+      buf.insert(buf.end(), s, s + len);
+    }
+
+    /* Fill in size[4] once the body is complete */
+    void seal() {
+      uint32_t len = buf.size();
+
+      for (int i = 0; i < 4; ++i)
+        buf[i] = len >> (8 * i);
+    }
+
+    uint8_t get8() {
+      return buf.at(pos++);
+    }
+
+    uint16_t get16() {
+      uint16_t v = get8();
+
+      return v | get8() << 8;
+    }
+
+    uint32_t get32() {
+      uint32_t v = get16();
+
+      return v | (uint32_t) get16() << 16;
+    }
+
+    uint64_t get64() {
+      uint64_t v = get32();
+
+      return v | (uint64_t) get32() << 32;
+    }
+
+    std::string getstr() {
+      uint16_t len = get16();
+      std::string s((const char *) &buf.at(pos), len);
+
+      pos += len;
+      return s;
+    }
+  };
+
+  class Loopback9PTest : public gtest::GaneshaFSALBaseTest {
+  protected:
+
+    virtual void SetUp() {
+      struct fsal_attrlist attrs_out;
+      struct fsal_io_arg write_arg;
+      struct iovec iov;
+      struct async_process_data io_data;
+      pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+      pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+      fsal_status_t status;
+
+      gtest::GaneshaFSALBaseTest::SetUp();
+
+      fsal_prepare_attrs(&attrs_out, 0);
+      status = fsal_create(test_root, TEST_FILE, REGULAR_FILE, &attrs, NULL,
+                           &test_file, &attrs_out, nullptr, nullptr);
+      ASSERT_EQ(status.major, 0);
+      fsal_release_attrs(&attrs_out);
+
+      for (int i = 0; i < DATA_SIZE; ++i)
+        databuffer[i] = 'a' + i % 26;
+
+      memset(&write_arg, 0, sizeof(write_arg));
+      iov.iov_base = databuffer;
+      iov.iov_len = DATA_SIZE;
+      write_arg.iov = &iov;
+      write_arg.iov_count = 1;
+      write_arg.io_request = DATA_SIZE;
+
+      io_data.ret.major = ERR_FSAL_NO_ERROR;
+      io_data.ret.minor = 0;
+      io_data.done = false;
+      io_data.fsa_cond = &cond;
+      io_data.fsa_mutex = &mutex;
+
+      fsal_write(test_file, true, &write_arg, &io_data);
+      ASSERT_EQ(io_data.ret.major, 0);
+
+      conn = _9p_loopback_connect();
+      ASSERT_NE(conn, nullptr)
+        << "_9P_Socket_Backend must be loopback and 9P enabled";
+    }
+
+    virtual void TearDown() {
+      fsal_status_t status;
+
+      if (conn != nullptr)
+        _9p_loopback_close(conn);
+      conn = nullptr;
+
+      test_file->obj_ops->put_ref(test_file);
+      test_file = nullptr;
+      status = fsal_remove(test_root, TEST_FILE, NULL, NULL);
+      EXPECT_EQ(status.major, 0);
+
+      gtest::GaneshaFSALBaseTest::TearDown();
+    }
+
+    /* Send a request and wait for its reply */
+    void rpc(Msg &req, Msg &rep) {
+      size_t have = 0;
+      ssize_t n;
+      uint32_t len = 4;
+
+      req.seal();
+      ASSERT_EQ(_9p_loopback_write(conn, req.buf.data(), req.buf.size()),
+                (ssize_t) req.buf.size());
+
+      rep.buf.resize(len);
+      rep.pos = 0;
+
+      while (have < len) {
+        n = _9p_loopback_read(conn, rep.buf.data() + have, len - have);
+        ASSERT_GT(n, 0) << "connection closed by the dispatcher";
+        have += n;
+
+        if (have == 4 && len == 4) {
+          len = rep.get32();
+          ASSERT_GE(len, 7U);
+          rep.buf.resize(len);
+        }
+      }
+
+      rep.pos = 4;
+    }
+
+    /* Check the reply type and tag, and skip past them */
+    void expect_reply(Msg &rep, uint8_t type, uint16_t tag) {
+      uint8_t rtype = rep.get8();
+      uint16_t rtag = rep.get16();
+
+      if (rtype == P9_RLERROR)
+        FAIL() << "Rlerror " << rep.get32() << " instead of type "
+               << (int) type;
+      ASSERT_EQ(rtype, type);
+      ASSERT_EQ(rtag, tag);
+    }
+
+    void version() {
+      Msg req(P9_TVERSION, P9_NOTAG), rep;
+
+      req.put32(msize);
+      req.putstr("9P2000.L");
+      rpc(req, rep);
+      expect_reply(rep, P9_RVERSION, P9_NOTAG);
+
+      msize = rep.get32();
+      EXPECT_EQ(rep.getstr(), "9P2000.L");
+    }
+
+    void attach(uint32_t fid) {
+      Msg req(P9_TATTACH, 1), rep;
+
+      req.put32(fid);
+      req.put32(P9_NOFID);
+      req.putstr("root");
+      req.putstr(ctx_export_path(op_ctx));
+      req.put32(0);
+      rpc(req, rep);
+      expect_reply(rep, P9_RATTACH, 1);
+    }
+
+    /* Walk fid down names to newfid, returns the qids walked */
+    unsigned int walk(uint32_t fid, uint32_t newfid,
+                      const std::vector<const char *> &names) {
+      Msg req(P9_TWALK, 2), rep;
+      unsigned int nwqid;
+
+      req.put32(fid);
+      req.put32(newfid);
+      req.put16(names.size());
+      for (const char *name : names)
+        req.putstr(name);
+      rpc(req, rep);
+      expect_reply(rep, P9_RWALK, 2);
+
+      nwqid = rep.get16();
+      EXPECT_EQ(rep.buf.size(), rep.pos + nwqid * P9_QID_SIZE);
+
+      return nwqid;
+    }
+
+    void lopen(uint32_t fid, uint32_t flags) {
+      Msg req(P9_TLOPEN, 3), rep;
+
+      req.put32(fid);
+      req.put32(flags);
+      rpc(req, rep);
+      expect_reply(rep, P9_RLOPEN, 3);
+    }
+
+    /* Read count bytes at offset into rep, returns the count read */
+    uint32_t read(uint32_t fid, uint64_t offset, uint32_t count, Msg &rep) {
+      Msg req(P9_TREAD, 4);
+
+      req.put32(fid);
+      req.put64(offset);
+      req.put32(count);
+      rpc(req, rep);
+      expect_reply(rep, P9_RREAD, 4);
+
+      return rep.get32();
+    }
+
+    void clunk(uint32_t fid) {
+      Msg req(P9_TCLUNK, 5), rep;
+
+      req.put32(fid);
+      rpc(req, rep);
+      expect_reply(rep, P9_RCLUNK, 5);
+    }
+
+    /* Version, attach as fid 0 and open the test file as fid 1 */
+    void open_test_file() {
+      version();
+      attach(0);
+      ASSERT_EQ(walk(0, 1, { TEST_ROOT, TEST_FILE }), 2U);
+      lopen(1, O_RDONLY);
+    }
+
+    struct _9p_loopback_conn *conn = nullptr;
+    struct fsal_obj_handle *test_file = nullptr;
+    char databuffer[DATA_SIZE];
+  };
+
+} /* namespace */
+
+TEST_F(Loopback9PTest, READ)
+{
+  Msg rep;
+  uint32_t count;
+
+  open_test_file();
+
+  count = read(1, 0, DATA_SIZE, rep);
+  ASSERT_EQ(count, (uint32_t) DATA_SIZE);
+  ASSERT_EQ(rep.buf.size(), rep.pos + count);
+  EXPECT_EQ(memcmp(&rep.buf[rep.pos], databuffer, DATA_SIZE), 0);
+
+  /* Short read at the end of the file */
+  count = read(1, DATA_SIZE - 100, DATA_SIZE, rep);
+  ASSERT_EQ(count, 100U);
+  EXPECT_EQ(memcmp(&rep.buf[rep.pos], databuffer + DATA_SIZE - 100, 100), 0);
+
+  clunk(1);
+  clunk(0);
+}
+
+TEST_F(Loopback9PTest, WALK_MISSING)
+{
+  Msg req(P9_TWALK, 2), rep;
+
+  version();
+  attach(0);
+
+  req.put32(0);
+  req.put32(1);
+  req.put16(2);
+  req.putstr(TEST_ROOT);
+  req.putstr("missing");
+  rpc(req, rep);
+
+  ASSERT_EQ(rep.get8(), P9_RLERROR);
+  EXPECT_EQ(rep.get16(), 2);
+  EXPECT_EQ(rep.get32(), (uint32_t) ENOENT);
+
+  clunk(0);
+}
+
+TEST_F(Loopback9PTest, LOOP)
+{
+  struct timespec s_time, e_time;
+  Msg rep;
+
+  open_test_file();
+
+  enableEvents(event_list);
+
+  now(&s_time);
+
+  for (int i = 0; i < LOOP_COUNT; ++i) {
+    ASSERT_EQ(read(1, 0, DATA_SIZE, rep), (uint32_t) DATA_SIZE);
+  }
+
+  now(&e_time);
+
+  disableEvents(event_list);
+
+  fprintf(stderr, "Average time per Tread: %" PRIu64 " ns\n",
+          timespec_diff(&s_time, &e_time) / LOOP_COUNT);
+
+  clunk(1);
+  clunk(0);
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+  char* session_name = NULL;
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+       "path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+       "log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+       "id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+       "ganesha debug level")
+
+      ("session", po::value<string>(),
+       "LTTng session name")
+
+      ("event-list", po::value<string>(),
+       "LTTng event list, comma separated")
+
+      ("msize", po::value<uint32_t>(),
+       "msize to ask for in Tversion")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::command_line_parser parser{argc, argv};
+    parser.options(opts).allow_unregistered();
+    po::store(parser.run(), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+         (char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("session");
+    if (vm_iter != vm.end()) {
+      session_name = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("event-list");
+    if (vm_iter != vm.end()) {
+      event_list = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("msize");
+    if (vm_iter != vm.end()) {
+      msize = vm_iter->second.as<uint32_t>();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    gtest::env = new gtest::Environment(ganesha_conf, lpath, dlevel,
+                                        session_name, TEST_ROOT, export_id);
+    ::testing::AddGlobalTestEnvironment(gtest::env);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
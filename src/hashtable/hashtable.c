@@ -40,6 +40,13 @@
  * determines which of the partitions (each containing a tree and each
  * separately locked), and a hash which acts as the key within an
  * individual Red-Black Tree.
+ *
+ * Tables created with HT_FLAG_LOCKLESS_READ additionally keep, for
+ * each partition, an open addressing index of the stored pairs that
+ * is published with RCU.  Unlatched lookups (HashTable_Get and
+ * hashtable_tryref) search that index without taking the partition
+ * lock.  Writers still serialize on the partition lock and maintain
+ * both structures.
  */
 
 #include "config.h"
@@ -51,7 +58,9 @@
 #include "log.h"
 #include "abstract_atomic.h"
 #include "common_utils.h"
+#include "gsh_list.h"
 #include <assert.h>
+#include <urcu-bp.h>
 
 /**
  * @brief Total size of the cache page configured for a table
@@ -263,6 +272,268 @@ static inline hash_error_t compute(struct hash_table *ht,
 	return HASHTABLE_SUCCESS;
 }
 
+/**
+ * @brief A stored pair in a table with HT_FLAG_LOCKLESS_READ
+ *
+ * The pair is wrapped so that the lockless index can filter on the
+ * hash without touching the key, and so that it can be freed after an
+ * RCU grace period.  Once published an entry is never modified; an
+ * overwrite publishes a new entry instead.
+ */
+struct hash_lf_entry {
+	struct hash_data data; /*< Key and value, RBT_OPAQ points here */
+	uint64_t rbt_hash; /*< Red-black tree hash of the key */
+	struct rcu_head rcu; /*< For deferred free */
+};
+
+/**
+ * @brief Open addressing index of a partition
+ *
+ * Replaced as a whole when it has to grow or be purged of tombstones.
+ */
+struct hash_lf_slots {
+	struct rcu_head rcu; /*< For deferred free after a resize */
+	uint32_t mask; /*< Number of slots minus one */
+	uint32_t used; /*< Slots holding an entry or a tombstone */
+	struct hash_lf_entry *slot[]; /*< Linearly probed slots */
+};
+
+/* Marks a slot whose entry was removed, probing continues past it */
+static struct hash_lf_entry lf_tombstone;
+
+static inline bool lf_enabled(const struct hash_table *ht)
+{
+	return ht->parameter.flags & HT_FLAG_LOCKLESS_READ;
+}
+
+static struct hash_lf_slots *lf_slots_alloc(uint32_t nslots)
+{
+	struct hash_lf_slots *slots;
+
+	slots = gsh_calloc(1, sizeof(struct hash_lf_slots) +
+				      nslots * sizeof(struct hash_lf_entry *));
+	slots->mask = nslots - 1;
+
+	return slots;
+}
+
+static void lf_free_slots(struct rcu_head *head)
+{
+	gsh_free(container_of(head, struct hash_lf_slots, rcu));
+}
+
+static void lf_free_entry(struct rcu_head *head)
+{
+	gsh_free(container_of(head, struct hash_lf_entry, rcu));
+}
+
+/**
+ * @brief Allocate the buffer pair for a new entry
+ *
+ * @param[in] ht      The hash table
+ * @param[in] rbthash Hash of the key to be stored
+ *
+ * @return The buffer pair.
+ */
+static struct hash_data *hash_data_alloc(struct hash_table *ht,
+					 uint64_t rbthash)
+{
+	struct hash_lf_entry *entry;
+
+	if (!lf_enabled(ht))
+		return pool_alloc(ht->data_pool);
+
+	entry = gsh_calloc(1, sizeof(struct hash_lf_entry));
+	entry->rbt_hash = rbthash;
+
+	return &entry->data;
+}
+
+/**
+ * @brief Release the buffer pair of a removed entry
+ *
+ * Lockless readers may still be looking at the pair, so in that mode
+ * the free is deferred past a grace period.
+ *
+ * @param[in] ht   The hash table
+ * @param[in] data The buffer pair
+ */
+static void hash_data_release(struct hash_table *ht, struct hash_data *data)
+{
+	if (lf_enabled(ht))
+		call_rcu(&container_of(data, struct hash_lf_entry, data)->rcu,
+			 lf_free_entry);
+	else
+		pool_free(ht->data_pool, data);
+}
+
+/**
+ * @brief Place an entry in the first free slot of its probe sequence
+ *
+ * The caller holds the partition write lock and has checked that the
+ * key is not already present, so the first tombstone may be reused.
+ *
+ * @param[in,out] slots The index
+ * @param[in]     entry The entry to publish
+ */
+static void lf_slots_insert(struct hash_lf_slots *slots,
+			    struct hash_lf_entry *entry)
+{
+	uint32_t i = entry->rbt_hash & slots->mask;
+	struct hash_lf_entry *cur;
+
+	while ((cur = slots->slot[i]) != NULL && cur != &lf_tombstone)
+		i = (i + 1) & slots->mask;
+
+	if (cur == NULL)
+		slots->used++;
+
+	rcu_set_pointer(&slots->slot[i], entry);
+}
+
+/**
+ * @brief Find the slot holding an entry
+ *
+ * Must be called with the partition write lock held.
+ *
+ * @param[in] slots The index
+ * @param[in] entry The entry to look for
+ *
+ * @return Pointer to the slot.
+ */
+static struct hash_lf_entry **lf_slots_find(struct hash_lf_slots *slots,
+					    struct hash_lf_entry *entry)
+{
+	uint32_t i = entry->rbt_hash & slots->mask;
+
+	while (slots->slot[i] != entry) {
+		assert(slots->slot[i] != NULL);
+		i = (i + 1) & slots->mask;
+	}
+
+	return &slots->slot[i];
+}
+
+/**
+ * @brief Add an entry to the lockless index of a partition
+ *
+ * The index is rebuilt, sized for the live entries, once live entries
+ * and tombstones fill three quarters of it.  The old index is freed
+ * after a grace period.
+ *
+ * @param[in]     ht        The hash table
+ * @param[in,out] partition The partition, write locked
+ * @param[in]     data      The buffer pair being inserted
+ */
+static void lf_publish(struct hash_table *ht, struct hash_partition *partition,
+		       struct hash_data *data)
+{
+	struct hash_lf_slots *slots = partition->lf_slots;
+	struct hash_lf_slots *grown;
+	uint32_t nslots = ht->parameter.lockless_slots;
+	uint32_t i;
+
+	if ((slots->used + 1) * 4 > (slots->mask + 1) * 3) {
+		while (nslots < partition->count * 2)
+			nslots <<= 1;
+
+		grown = lf_slots_alloc(nslots);
+
+		for (i = 0; i <= slots->mask; i++) {
+			if (slots->slot[i] != NULL &&
+			    slots->slot[i] != &lf_tombstone)
+				lf_slots_insert(grown, slots->slot[i]);
+		}
+
+		rcu_assign_pointer(partition->lf_slots, grown);
+		call_rcu(&slots->rcu, lf_free_slots);
+		slots = grown;
+	}
+
+	lf_slots_insert(slots, container_of(data, struct hash_lf_entry, data));
+}
+
+/**
+ * @brief Remove an entry from the lockless index of a partition
+ *
+ * @param[in,out] partition The partition, write locked
+ * @param[in]     data      The buffer pair being removed
+ */
+static void lf_unpublish(struct hash_partition *partition,
+			 struct hash_data *data)
+{
+	rcu_set_pointer(lf_slots_find(partition->lf_slots,
+				      container_of(data, struct hash_lf_entry,
+						   data)),
+			&lf_tombstone);
+}
+
+/**
+ * @brief Look up a key without taking the partition lock
+ *
+ * The value is only guaranteed to be stable while the read side
+ * critical section is held, so the optional reference is taken before
+ * leaving it.  A failed reference means the value is going away and
+ * is reported as a missing key.
+ *
+ * @param[in]  ht      The hash table
+ * @param[in]  key     The key to look up
+ * @param[in]  index   Partition index of the key
+ * @param[in]  rbthash Hash of the key
+ * @param[out] val     The value found, may be NULL
+ * @param[in]  try_ref Function to take a reference, may be NULL
+ *
+ * @retval HASHTABLE_SUCCESS if found (and referenced).
+ * @retval HASHTABLE_ERROR_NO_SUCH_KEY otherwise.
+ */
+static hash_error_t lf_get(struct hash_table *ht,
+			   const struct gsh_buffdesc *key, uint32_t index,
+			   uint64_t rbthash, struct gsh_buffdesc *val,
+			   bool (*try_ref)(struct gsh_buffdesc *))
+{
+	struct hash_lf_slots *slots;
+	struct hash_lf_entry *entry;
+	struct gsh_buffdesc found;
+	hash_error_t rc = HASHTABLE_ERROR_NO_SUCH_KEY;
+	uint32_t i, probes;
+
+	rcu_read_lock();
+
+	slots = rcu_dereference(ht->partitions[index].lf_slots);
+
+	for (i = rbthash & slots->mask, probes = 0; probes <= slots->mask;
+	     i = (i + 1) & slots->mask, probes++) {
+		entry = rcu_dereference(slots->slot[i]);
+
+		if (entry == NULL)
+			break;
+
+		if (entry == &lf_tombstone || entry->rbt_hash != rbthash ||
+		    ht->parameter.compare_key((struct gsh_buffdesc *)key,
+					      &entry->data.key) != 0)
+			continue;
+
+		found = entry->data.val;
+
+		if (try_ref == NULL || try_ref(&found)) {
+			if (val)
+				*val = found;
+			rc = HASHTABLE_SUCCESS;
+		}
+		break;
+	}
+
+	rcu_read_unlock();
+
+	if (isDebug(COMPONENT_HASHTABLE) &&
+	    isFullDebug(ht->parameter.ht_log_component))
+		LogFullDebug(ht->parameter.ht_log_component,
+			     "Lockless get %s returning %s",
+			     ht->parameter.ht_name, hash_table_err_to_str(rc));
+
+	return rc;
+}
+
 /* The following are the hash table primitives implementing the
    actual functionality. */
 
@@ -300,6 +571,16 @@ struct hash_table *hashtable_init(struct hash_param *hparam)
 			hparam->cache_entry_count = 32767;
 	}
 
+	if (hparam->flags & HT_FLAG_LOCKLESS_READ) {
+		uint32_t nslots = 16;
+
+		/* Round up to a power of 2 for masked probing */
+		while (nslots < hparam->lockless_slots)
+			nslots <<= 1;
+
+		hparam->lockless_slots = nslots;
+	}
+
 	/* We need to save copy of the parameters in the table. */
 	ht->parameter = *hparam;
 	for (index = 0; index < hparam->index_size; ++index) {
@@ -312,6 +593,10 @@ struct hash_table *hashtable_init(struct hash_param *hparam)
 		if (hparam->flags & HT_FLAG_CACHE)
 			partition->cache = gsh_calloc(1, cache_page_size(ht));
 
+		if (hparam->flags & HT_FLAG_LOCKLESS_READ)
+			partition->lf_slots =
+				lf_slots_alloc(hparam->lockless_slots);
+
 		completed++;
 	}
 
@@ -346,12 +631,18 @@ hash_error_t hashtable_destroy(struct hash_table *ht,
 	if (hrc != HASHTABLE_SUCCESS)
 		goto out;
 
+	/* Wait for deferred frees of entries and replaced indexes */
+	if (lf_enabled(ht))
+		rcu_barrier();
+
 	for (index = 0; index < ht->parameter.index_size; ++index) {
 		if (ht->partitions[index].cache) {
 			gsh_free(ht->partitions[index].cache);
 			ht->partitions[index].cache = NULL;
 		}
 
+		gsh_free(ht->partitions[index].lf_slots);
+
 		PTHREAD_RWLOCK_destroy(&(ht->partitions[index].ht_lock));
 	}
 	pool_destroy(ht->node_pool);
@@ -440,6 +731,10 @@ hash_error_t hashtable_getlatch(struct hash_table *ht,
 	if (rc != HASHTABLE_SUCCESS)
 		return rc;
 
+	/* A plain lookup leaves nothing latched, so it may skip the lock */
+	if (!may_write && latch == NULL && lf_enabled(ht))
+		return lf_get(ht, key, index, rbt_hash, val, NULL);
+
 	/* Acquire mutex */
 	if (may_write)
 		PTHREAD_RWLOCK_wrlock(&(ht->partitions[index].ht_lock));
@@ -629,8 +924,28 @@ hash_error_t hashtable_setlatched(struct hash_table *ht,
 		if (stored_val)
 			*stored_val = descriptors->val;
 
-		descriptors->key = *key;
-		descriptors->val = *val;
+		if (lf_enabled(ht)) {
+			/* Published entries are immutable, swap in a copy */
+			struct hash_data *old = descriptors;
+			struct hash_lf_entry **slot;
+
+			descriptors = hash_data_alloc(ht, latch->rbt_hash);
+			descriptors->key = *key;
+			descriptors->val = *val;
+			RBT_OPAQ(latch->locator) = descriptors;
+
+			slot = lf_slots_find(
+				ht->partitions[latch->index].lf_slots,
+				container_of(old, struct hash_lf_entry, data));
+			rcu_set_pointer(slot,
+					container_of(descriptors,
+						     struct hash_lf_entry,
+						     data));
+			hash_data_release(ht, old);
+		} else {
+			descriptors->key = *key;
+			descriptors->val = *val;
+		}
 		rc = HASHTABLE_OVERWRITTEN;
 		goto out;
 	}
@@ -642,11 +957,7 @@ hash_error_t hashtable_setlatched(struct hash_table *ht,
 
 	mutator = pool_alloc(ht->node_pool);
 
-	descriptors = pool_alloc(ht->data_pool);
-
-	RBT_OPAQ(mutator) = descriptors;
-	RBT_VALUE(mutator) = latch->rbt_hash;
-	RBT_INSERT(&ht->partitions[latch->index].rbt, mutator, locator);
+	descriptors = hash_data_alloc(ht, latch->rbt_hash);
 
 	descriptors->key.addr = key->addr;
 	descriptors->key.len = key->len;
@@ -654,9 +965,16 @@ hash_error_t hashtable_setlatched(struct hash_table *ht,
 	descriptors->val.addr = val->addr;
 	descriptors->val.len = val->len;
 
+	RBT_OPAQ(mutator) = descriptors;
+	RBT_VALUE(mutator) = latch->rbt_hash;
+	RBT_INSERT(&ht->partitions[latch->index].rbt, mutator, locator);
+
 	/* Only in the non-overwrite case */
 	++ht->partitions[latch->index].count;
 
+	if (lf_enabled(ht))
+		lf_publish(ht, &ht->partitions[latch->index], descriptors);
+
 	rc = HASHTABLE_SUCCESS;
 
 out:
@@ -764,7 +1082,9 @@ void hashtable_deletelatched(struct hash_table *ht,
 
 	/* Now remove the entry */
 	RBT_UNLINK(&partition->rbt, latch->locator);
-	pool_free(ht->data_pool, data);
+	if (lf_enabled(ht))
+		lf_unpublish(partition, data);
+	hash_data_release(ht, data);
 	pool_free(ht->node_pool, latch->locator);
 	--ht->partitions[latch->index].count;
 
@@ -825,7 +1145,9 @@ hash_error_t hashtable_delall(struct hash_table *ht,
 			key = data->key;
 			val = data->val;
 
-			pool_free(ht->data_pool, data);
+			if (lf_enabled(ht))
+				lf_unpublish(&ht->partitions[index], data);
+			hash_data_release(ht, data);
 			pool_free(ht->node_pool, holder);
 			--ht->partitions[index].count;
 			rc = free_func(key, val);
@@ -1022,6 +1344,62 @@ hash_error_t hashtable_getref(hash_table_t *ht, struct gsh_buffdesc *key,
 	return rc;
 }
 
+/**
+ * @brief Look up a value and try to take a reference
+ *
+ * This function is like hashtable_getref, except that the reference
+ * may be refused, typically because the value's refcount already
+ * dropped to zero.  On tables with HT_FLAG_LOCKLESS_READ no lock is
+ * taken; the reference is taken within an RCU read side critical
+ * section instead, which is why it must be allowed to fail.
+ *
+ * @param[in]  ht      The hash store to be searched
+ * @param[in]  key     A buffer descriptor locating the key to find
+ * @param[out] val     A buffer descriptor locating the value found
+ * @param[in]  try_ref A function to try to take a reference on the
+ *                     supplied value, returning false on failure
+ *
+ * @retval HASHTABLE_SUCCESS if found and referenced
+ * @retval HASHTABLE_ERROR_NO_SUCH_KEY if absent or the reference failed
+ * @return Other errors on failure
+ */
+hash_error_t hashtable_tryref(hash_table_t *ht, struct gsh_buffdesc *key,
+			      struct gsh_buffdesc *val,
+			      bool (*try_ref)(struct gsh_buffdesc *))
+{
+	/* structure to hold retained state */
+	struct hash_latch latch;
+	/* Stored return code */
+	hash_error_t rc = 0;
+	uint32_t index;
+	uint64_t rbt_hash;
+
+	if (lf_enabled(ht)) {
+		rc = compute(ht, key, &index, &rbt_hash);
+		if (rc != HASHTABLE_SUCCESS)
+			return rc;
+
+		return lf_get(ht, key, index, rbt_hash, val, try_ref);
+	}
+
+	rc = hashtable_getlatch(ht, key, val, false, &latch);
+
+	switch (rc) {
+	case HASHTABLE_SUCCESS:
+		if (!try_ref(val))
+			rc = HASHTABLE_ERROR_NO_SUCH_KEY;
+		/* FALLTHROUGH */
+	case HASHTABLE_ERROR_NO_SUCH_KEY:
+		hashtable_releaselatched(ht, &latch);
+		break;
+
+	default:
+		break;
+	}
+
+	return rc;
+}
+
 void hashtable_for_each(hash_table_t *ht, ht_for_each_cb_t callback, void *arg)
 {
 	uint32_t i;
@@ -41,6 +41,8 @@
 #include "9p_types.h"
 #include "fsal_types.h"
 #include "sal_data.h"
+#include "io_buf_pool.h"
+#include <urcu-bp.h>
 
 #ifdef _USE_9P_RDMA
 #include <mooshika.h>
@@ -52,10 +54,20 @@
 
 #define _9P_LOCK_CLIENT_LEN 64
 
-#define _9P_FID_PER_CONN 1024
+/* Each connection's fids are kept in a radix tree of _9P_FID_LEVELS levels
+ * of nodes with _9P_FID_NODE_SIZE slots, allocated as fids get used and
+ * freed once they no longer hold any. */
+#define _9P_FID_NODE_SHIFT 8
+#define _9P_FID_NODE_SIZE (1 << _9P_FID_NODE_SHIFT)
+#define _9P_FID_LEVELS 3
 
-/* _9P_MSG_SIZE: maximum message size for 9P/TCP */
-#define _9P_MSG_SIZE 70000
+/* Fids from 0 to _9P_FID_MAX - 1 may be used */
+#define _9P_FID_MAX (1U << (_9P_FID_NODE_SHIFT * _9P_FID_LEVELS))
+
+/* Nodes a connection's fid table may use, 2 MiB worth: room for a quarter
+ * million fids if the client numbers them densely, as Linux does, while
+ * scattered fids run out long before they pin much memory. */
+#define _9P_FID_NODES_MAX 1024
 
 #define _9P_HDR_SIZE 4
 #define _9P_TYPE_SIZE 1
@@ -360,6 +372,12 @@ struct _9p_flush_bucket {
 
 #define FLUSH_BUCKETS 32
 
+struct _9p_fid_node {
+	void *slots[_9P_FID_NODE_SIZE]; /* Nodes, or fids at the last level */
+	unsigned int used; /* Slots in use */
+	struct rcu_head rcu; /* For deferred free */
+};
+
 struct _9p_conn {
 	union trans_data {
 		long sockfd;
@@ -372,10 +390,11 @@ struct _9p_conn {
 	struct gsh_client *client;
 	struct timeval birth; /* This is useful if same sockfd is
 				   reused on socket's close/open */
-	struct _9p_fid *fids[_9P_FID_PER_CONN];
+	struct _9p_fid_node *fids; /* see _9p_getfid() */
+	pthread_mutex_t fid_lock; /* Serializes changes to fids */
+	unsigned int fid_nodes; /* Nodes in fids */
 	struct _9p_flush_bucket flush_buckets[FLUSH_BUCKETS];
 	unsigned long sequence;
-	pthread_mutex_t sock_lock;
 	sockaddr_t addrpeer;
 	unsigned int msize;
 };
@@ -403,8 +422,18 @@ struct _9p_rdma_priv {
 #endif
 
 struct _9p_request_data {
-	struct glist_head req_q; /* chaining of pending requests */
+	struct glist_head req_q; /* chaining of pending requests, then of
+				    replies waiting to be sent */
 	char *_9pmsg;
+	struct io_buf *_9pmsg_buf; /* 9P/TCP: pool buffer holding _9pmsg */
+	char *_9preply; /* 9P/TCP reply, sent by the dispatcher */
+	struct io_buf *_9preply_buf; /* 9P/TCP: pool buffer holding _9preply */
+	u32 _9preplylen;
+	/* Payload sent right after _9preply without being copied into it,
+	 * and how to release it once sent */
+	struct iovec _9preplydata;
+	void (*_9preplydata_release)(void *release_data);
+	void *_9preplydata_release_data;
 	struct _9p_conn *pconn;
 #ifdef _USE_9P_RDMA
 	msk_data_t *data;
@@ -602,7 +631,41 @@ extern const struct _9p_function_desc _9pfuncdesc[];
 /**
  * @brief Default value for _9p_tcp_msize
  */
-#define _9P_TCP_MSIZE 65536
+#define _9P_TCP_MSIZE 1048576
+
+/**
+ * @brief Largest _9p_tcp_msize
+ */
+#define _9P_TCP_MSIZE_MAX (16 * 1024 * 1024)
+
+/**
+ * @brief Smallest msize a client may negotiate
+ *
+ * Below this, replies such as Rgetattr would not fit.
+ */
+#define _9P_MSIZE_MIN 512
+
+/**
+ * @brief Room for any 9P/TCP reply with no payload
+ *
+ * Only Rread and Rreaddir carry as much as msize; every other reply is
+ * at most a path name or, for Rversion, as long as its request.
+ */
+#define _9P_REPLY_ROOM 8192
+
+/**
+ * @brief Default value for _9p_sock_backend
+ */
+#ifdef USE_FSTACK
+#define _9P_SOCK_BACKEND_DEFAULT _9P_SOCK_FSTACK
+#else
+#define _9P_SOCK_BACKEND_DEFAULT _9P_SOCK_KERNEL
+#endif
+
+/**
+ * @brief Default value for _9p_fstack_config
+ */
+#define _9P_FSTACK_CONFIG "/data/f-stack/config.ini"
 
 /**
  * @brief Default value for _9p_rdma_msize
@@ -659,6 +722,13 @@ struct _9p_param {
 	    Defaults to _9P_RDMA_OUTPOOL_SIZE,
 	    settable by _9P_RDMA_OutPool_Size */
 	uint16_t _9p_rdma_outpool_size;
+	/** Sockets 9p/tcp is served on, an enum _9p_sock_backend.
+	    Defaults to _9P_SOCK_BACKEND_DEFAULT, settable by
+	    _9P_Socket_Backend */
+	uint32_t _9p_sock_backend;
+	/** F-Stack configuration file.  Defaults to _9P_FSTACK_CONFIG,
+	    settable by _9P_FStack_Config */
+	char *_9p_fstack_config;
 };
 
 /** @} */
@@ -724,6 +794,8 @@ int _9p_tools_get_req_context_by_name(int uname_len, char *uname_str,
 int _9p_tools_errno(fsal_status_t fsal_status);
 void _9p_openflags2FSAL(u32 *inflags, fsal_openflags_t *outflags);
 int _9p_tools_clunk(struct _9p_fid *pfid);
+struct _9p_fid *_9p_getfid(struct _9p_conn *conn, u32 fid);
+int _9p_setfid(struct _9p_conn *conn, u32 fid, struct _9p_fid *pfid);
 void _9p_cleanup_fids(struct _9p_conn *conn);
 
 static inline unsigned int _9p_openflags_to_share_access(u32 *inflags)
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file 9p_sock.h
+ * @brief Socket backends for the 9P/TCP dispatcher
+ *
+ * The dispatcher's event loop only talks to its sockets through one of
+ * these, chosen by _9P_Socket_Backend.  Every call but wake() is made from
+ * the dispatcher thread, and every socket is non-blocking: calls that
+ * would block fail with EAGAIN.
+ */
+
+#ifndef _9P_SOCK_H
+#define _9P_SOCK_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Values of _9P_Socket_Backend
+ */
+enum _9p_sock_backend {
+	_9P_SOCK_KERNEL, /*< Kernel sockets */
+	_9P_SOCK_FSTACK, /*< F-Stack, the DPDK userspace TCP stack */
+	_9P_SOCK_LOOPBACK, /*< In-process, see _9p_loopback_connect() */
+};
+
+struct _9p_sock_ops {
+	const char *name;
+
+	/** Set the stack up, on the dispatcher thread.  May be NULL. */
+	int (*init)(void);
+
+	/** Call pass() over and over, never returns.  NULL to have the
+	 *  dispatcher do it. */
+	void (*run)(int (*pass)(void *arg), void *arg);
+
+	/** Create the listening socket */
+	int (*listen)(void);
+
+	/** Accept a connection and fill in its peer's address */
+	int (*accept)(int listen_fd, struct sockaddr_storage *peer);
+
+	/** epoll_create(), epoll_ctl() and epoll_wait() alike */
+	int (*poll_create)(void);
+	int (*poll_ctl)(int epfd, int op, int fd, struct epoll_event *event);
+	int (*poll)(int epfd, struct epoll_event *events, int maxevents,
+		    int timeout);
+
+	/** Interrupt a poll() blocked in another thread.  NULL if poll() is
+	 *  always called with a 0 timeout, because run() is polling. */
+	void (*wake)(void);
+
+	ssize_t (*recv)(int fd, void *buf, size_t len);
+	/** Gathers replies and the payloads they point to, as writev() */
+	ssize_t (*send)(int fd, const struct iovec *iov, int iovcnt);
+	int (*close)(int fd);
+};
+
+extern const struct _9p_sock_ops _9p_sock_kernel;
+#ifdef USE_FSTACK
+extern const struct _9p_sock_ops _9p_sock_fstack;
+#endif
+extern const struct _9p_sock_ops _9p_sock_loopback;
+
+/**
+ * @brief Client side of an in-process 9P connection
+ *
+ * Lets a benchmark in the same process drive the 9P interpreter through
+ * the dispatcher without a network stack.  The calls block.
+ */
+struct _9p_loopback_conn;
+
+struct _9p_loopback_conn *_9p_loopback_connect(void);
+ssize_t _9p_loopback_write(struct _9p_loopback_conn *conn, const void *buf,
+			   size_t len);
+ssize_t _9p_loopback_read(struct _9p_loopback_conn *conn, void *buf,
+			  size_t len);
+void _9p_loopback_close(struct _9p_loopback_conn *conn);
+
+#endif /* _9P_SOCK_H */
@@ -49,6 +49,7 @@
 #include "cidr.h"
 #include "sal_shared.h"
 #include "connection_manager.h"
+#include "monitoring.h"
 
 struct gsh_client {
 	struct avltree_node node_k;
@@ -59,6 +60,7 @@ struct gsh_client {
 	sockaddr_t cl_addrbuf;
 	uint64_t state_stats[STATE_TYPE_MAX]; /* state stats for this client */
 	connection_manager__client_t connection_manager;
+	dynamic_client_metric_handle_t monitoring; /* per client metrics */
 };
 
 static inline int64_t inc_gsh_client_refcount(struct gsh_client *client)
@@ -134,6 +136,18 @@ struct base_client_entry *client_match(enum log_components component,
 				       const char *str, sockaddr_t *hostaddr,
 				       struct glist_head *clients);
 
+struct client_list_index;
+
+struct client_list_index *client_list_index_build(struct glist_head *clients);
+void client_list_index_free(struct client_list_index *cidx);
+void client_list_index_purge_names(void);
+
+struct base_client_entry *client_match_index(enum log_components component,
+					     const char *str,
+					     sockaddr_t *clientaddr,
+					     struct glist_head *clients,
+					     struct client_list_index **indexp);
+
 typedef void *(client_list_entry_allocator_t)(void);
 
 typedef void(client_list_entry_filler_t)(struct base_client_entry *client,
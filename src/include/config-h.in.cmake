@@ -61,6 +61,7 @@
 #cmakedefine PROXYV4_HANDLE_MAPPING 1
 #cmakedefine _USE_9P 1
 #cmakedefine _USE_9P_RDMA 1
+#cmakedefine USE_FSTACK 1
 #cmakedefine _USE_NFS_RDMA 1
 #cmakedefine _USE_NFS3 1
 #cmakedefine _USE_NLM 1
@@ -89,6 +90,7 @@
 #cmakedefine ENABLE_VFS_DEBUG_ACL 1
 #cmakedefine ENABLE_RFC_ACL 1
 #cmakedefine ENABLE_VFS_ACL 1
+#cmakedefine USE_FSAL_VFS_IO_URING 1
 #cmakedefine CEPHFS_POSIX_ACL 1
 #cmakedefine USE_GLUSTER_XREADDIRPLUS 1
 #cmakedefine USE_GLUSTER_UPCALL_REGISTER 1
@@ -118,6 +120,7 @@
 #cmakedefine USE_LLAPI 1
 #cmakedefine USE_GLUSTER_STAT_FETCH_API 1
 #cmakedefine HAVE_URCU_REF_GET_UNLESS_ZERO 1
+#cmakedefine HAVE_COPY_FILE_RANGE 1
 #cmakedefine USE_BTRFSUTIL 1
 #cmakedefine USE_MONITORING 1
 #define NFS_GANESHA 1
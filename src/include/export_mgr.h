@@ -156,6 +156,8 @@ struct gsh_export {
 	uint64_t config_gen;
 	/** CFG Allowed clients - update protected by lock */
 	struct glist_head clients;
+	/** Compiled form of clients, built on first use.  Protected by lock */
+	struct client_list_index *clients_index;
 	/** Entry for the junction of this export.  Protected by lock */
 	struct fsal_obj_handle *exp_junction_obj;
 	/** The export this export sits on. Protected by lock */
@@ -354,7 +354,7 @@ extern struct gsh_refstr *no_export;
  * rules), increment the minor version
  */
 
-#define FSAL_MINOR_VERSION 0
+#define FSAL_MINOR_VERSION 1
 
 /* Forward references for object methods */
 
@@ -2792,6 +2792,69 @@ struct fsal_obj_ops {
 
 	/**@{*/
 
+	/**
+ * Server side copy
+ */
+
+	/**
+ * @brief Copy a range of bytes from one file to another
+ *
+ * This function copies count bytes starting at src_offset in src_hdl to
+ * dst_offset in dst_hdl without passing the data through the protocol
+ * layer.  Both handles belong to the same export.  The copy may be short;
+ * the number of bytes actually copied is returned in copied and the caller
+ * is expected to continue from there.  A short copy with no error means
+ * the end of the source was reached.
+ *
+ * The default implementation loops over read2 and write2 so every FSAL
+ * gets a working copy; FSALs with a native facility should override it.
+ * Data is written unstable.
+ *
+ * @param[in]  src_hdl    File to copy from
+ * @param[in]  src_state  Open or lock state for src_hdl (or NULL)
+ * @param[in]  src_offset Offset in src_hdl at which to start
+ * @param[in]  dst_hdl    File to copy to
+ * @param[in]  dst_state  Open or lock state for dst_hdl (or NULL)
+ * @param[in]  dst_offset Offset in dst_hdl at which to start
+ * @param[in]  count      Number of bytes to copy
+ * @param[out] copied     Number of bytes actually copied
+ *
+ * @return FSAL status.
+ */
+	fsal_status_t (*copy)(struct fsal_obj_handle *src_hdl,
+			      struct state_t *src_state, uint64_t src_offset,
+			      struct fsal_obj_handle *dst_hdl,
+			      struct state_t *dst_state, uint64_t dst_offset,
+			      uint64_t count, uint64_t *copied);
+
+	/**
+ * @brief Share a range of blocks between two files
+ *
+ * Make the range [dst_offset, dst_offset + count) of dst_hdl share storage
+ * with the range starting at src_offset in src_hdl.  Unlike copy, this is
+ * all or nothing.  A count of zero means to the end of the source file.
+ *
+ * @param[in] src_hdl    File to clone from
+ * @param[in] src_state  Open or lock state for src_hdl (or NULL)
+ * @param[in] src_offset Offset in src_hdl at which to start
+ * @param[in] dst_hdl    File to clone into
+ * @param[in] dst_state  Open or lock state for dst_hdl (or NULL)
+ * @param[in] dst_offset Offset in dst_hdl at which to start
+ * @param[in] count      Number of bytes to clone
+ *
+ * @return FSAL status, ERR_FSAL_NOTSUPP if the file system can not share
+ *         blocks.
+ */
+	fsal_status_t (*clone)(struct fsal_obj_handle *src_hdl,
+			       struct state_t *src_state, uint64_t src_offset,
+			       struct fsal_obj_handle *dst_hdl,
+			       struct state_t *dst_state, uint64_t dst_offset,
+			       uint64_t count);
+
+	/**@}*/
+
+	/**@{*/
+
 	/**
  * ASYNC API functions.
  *
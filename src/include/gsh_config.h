@@ -112,7 +112,7 @@ typedef enum protos {
 /**
  * @brief Default value for core_param.drc.tcp.npart
  */
-#define DRC_TCP_NPART 1
+#define DRC_TCP_NPART 7
 
 /**
  * @brief Default value for core_param.drc.tcp.size
@@ -551,6 +551,13 @@ typedef struct nfs_core_param {
 	 * For more info, see:
 	 * https://git.kernel.org/torvalds/p/8d19f1c8e1937baf74e1962aae9f90fa3aeab463 */
 	bool allow_set_io_flusher_fail;
+	/** File to capture the RPC request stream to, capture is off if
+	    NULL.  See nfs_rpc_capture.h */
+	char *rpc_capture_file;
+	/** Size of the capture ring in bytes */
+	uint64_t rpc_capture_size;
+	/** Leave the component names out of captured records */
+	bool rpc_capture_elide_payload;
 } nfs_core_parameter_t;
 
 /** @} */
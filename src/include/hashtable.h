@@ -80,6 +80,12 @@ typedef int (*hash_display_function_t)(struct display_buffer *dspbuf,
 #define HT_FLAG_CACHE \
 	0x0001 /*< Indicates that caching should be
 				   enabled */
+#define HT_FLAG_LOCKLESS_READ \
+	0x0002 /*< Maintain an RCU protected open
+				   addressing index so that lookups
+				   without a latch take no lock.  Keys
+				   and values must stay readable for an
+				   RCU grace period after removal. */
 
 /**
  * @brief Hash parameters
@@ -91,6 +97,9 @@ typedef int (*hash_display_function_t)(struct display_buffer *dspbuf,
 struct hash_param {
 	uint32_t flags; /*< Create flags */
 	uint32_t cache_entry_count; /*< 2^10 <= Power of 2 <= 2^15 */
+	uint32_t lockless_slots; /*< Initial number of open addressing
+				     slots per partition (power of 2)
+				     for HT_FLAG_LOCKLESS_READ */
 	uint32_t index_size; /*< Number of partition trees, this MUST
 				   be a prime number. */
 	index_function_t hash_func_key; /*< Partition function,
@@ -150,6 +159,8 @@ struct hash_partition {
 	struct rbt_head rbt; /*< The red-black tree */
 	pthread_rwlock_t ht_lock; /*< Lock for this partition */
 	struct rbt_node **cache; /*< Expected entry cache */
+	struct hash_lf_slots *lf_slots; /*< RCU protected lookup index,
+					    only with HT_FLAG_LOCKLESS_READ */
 };
 
 /**
@@ -238,7 +249,8 @@ void hashtable_log(log_components_t, struct hash_table *);
  *
  * This function attempts to locate a key in the hash store and return
  * the associated value.  It is implemented as a wrapper around
- * the hashtable_getlatched function.
+ * the hashtable_getlatched function.  On tables created with
+ * HT_FLAG_LOCKLESS_READ no lock is taken.
  *
  * @param[in]  ht  The hash store to be searched
  * @param[in]  key A buffer descriptor locating the key to find
@@ -339,6 +351,9 @@ hash_error_t hashtable_test_and_set(struct hash_table *, struct gsh_buffdesc *,
 hash_error_t hashtable_getref(struct hash_table *, struct gsh_buffdesc *,
 			      struct gsh_buffdesc *,
 			      void (*)(struct gsh_buffdesc *));
+hash_error_t hashtable_tryref(struct hash_table *, struct gsh_buffdesc *,
+			      struct gsh_buffdesc *,
+			      bool (*)(struct gsh_buffdesc *));
 
 typedef void (*ht_for_each_cb_t)(struct rbt_node *pn, void *arg);
 void hashtable_for_each(struct hash_table *ht, ht_for_each_cb_t callback,
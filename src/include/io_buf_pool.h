@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file io_buf_pool.h
+ * @brief Pool of page aligned I/O payload buffers
+ *
+ * READ replies need a buffer of up to rsize bytes for every request.
+ * Rather than allocating and freeing one each time, buffers are kept in
+ * power of 2 size classes, cached per thread with a shared depot behind
+ * the thread caches.  A buffer may be released by a different thread
+ * than the one that got it, as happens when the reply is sent
+ * asynchronously.
+ */
+
+#ifndef IO_BUF_POOL_H
+#define IO_BUF_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief An I/O buffer from the pool
+ */
+struct io_buf {
+	void *ib_base; /*< Page aligned buffer */
+	size_t ib_size; /*< Usable size of the buffer */
+	struct io_buf *ib_next; /*< Next buffer in a cache */
+	int ib_class; /*< Size class, or IO_BUF_NO_CLASS */
+};
+
+/** Class of buffers too big for the pool, they are freed on release */
+#define IO_BUF_NO_CLASS (-1)
+
+struct io_buf *io_buf_get(size_t size);
+void io_buf_release(void *release_data);
+
+#endif /* IO_BUF_POOL_H */
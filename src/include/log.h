@@ -149,6 +149,7 @@ int enable_log_facility(const char *name);
 int disable_log_facility(const char *name);
 int set_log_destination(const char *name, char *dest);
 int set_log_level(const char *name, log_levels_t max_level);
+void log_reopen_files(void);
 void set_const_log_str(void);
 
 struct log_component_info {
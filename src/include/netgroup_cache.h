@@ -24,6 +24,10 @@
 
 #ifndef NETGROUP_CACHE_H
 #define NETGROUP_CACHE_H
+
+/* Seconds a netgroup cache entry is valid, hardcoded for now */
+#define NG_CACHE_EXPIRATION (30 * 60)
+
 void ng_cache_init(void);
 void ng_clear_cache(void);
 bool ng_innetgr(const char *group, const char *host);
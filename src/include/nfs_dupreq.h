@@ -50,20 +50,31 @@ enum drc_type {
 
 #define DRC_FLAG_RECYCLE 0x1
 
+/* Retirement state of one partition of a DRC.  It is indexed like
+ * drc->xt.tree[] and protected by that partition's mutex, so inserting,
+ * retiring and deleting entries never serialize on drc_mtx.
+ */
+struct drc_part {
+	/* Entries of this partition, oldest first */
+	TAILQ_HEAD(drc_tailq, dupreq_entry) dupreq_q;
+	uint32_t size;
+};
+
 typedef struct drc {
 	enum drc_type type;
 	struct rbtree_x xt;
-	/* Define the tail queue */
-	TAILQ_HEAD(drc_tailq, dupreq_entry) dupreq_q;
-	pthread_mutex_t drc_mtx;
+	struct drc_part *part; /* npart retirement FIFOs */
+	pthread_mutex_t drc_mtx; /* protects recycling */
 	uint32_t npart;
 	uint32_t cachesz;
-	uint32_t size;
+	uint32_t size; /* atomic, sum of part[].size */
 	uint32_t maxsize;
 	uint32_t hiwat;
+	uint32_t part_maxsize; /* maxsize share of each partition */
+	uint32_t part_hiwat; /* hiwat share of each partition */
 	uint32_t flags;
-	uint32_t refcnt; /* call path refs */
-	uint32_t retwnd;
+	uint32_t refcnt; /* call path refs, atomic */
+	uint32_t retwnd; /* atomic */
 	union {
 		struct {
 			sockaddr_t addr;
@@ -65,6 +65,8 @@ struct global_export_perms {
 	struct export_perms def;
 	struct export_perms conf;
 	struct glist_head clients;
+	/** Compiled clients, protected by export_opt_lock */
+	struct client_list_index *clients_index;
 };
 
 extern pthread_rwlock_t export_opt_lock;
@@ -48,6 +48,9 @@ typedef struct nfs_ip_name__ {
 	char hostname[];
 } nfs_ip_name_t;
 
+/* Seconds an IP/name cache entry is valid */
+extern unsigned int expiration_time;
+
 int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname, size_t size);
 int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname, size_t size);
 int nfs_ip_name_remove(sockaddr_t *ipaddr);
@@ -41,6 +41,9 @@ void nfs_metrics__nfs4_compound_completed(nfsstat4, nsecs_elapsed_t,
 void nfs_metrics__rpc_received(void);
 void nfs_metrics__rpc_completed(void);
 void nfs_metrics__rpcs_in_flight(int64_t value);
+void nfs_metrics__drc_hit(nsecs_elapsed_t latency);
+void nfs_metrics__drc_insert(nsecs_elapsed_t latency);
+void nfs_metrics__drc_retire(nsecs_elapsed_t latency, int num_retired);
 void nfs_metrics__init(void);
 
 /*
@@ -60,12 +63,12 @@ void nfs_metrics__nfs3_request(const uint32_t proc,
 			       const nsecs_elapsed_t request_time,
 			       const nfsstat3 status,
 			       const export_id_t export_id,
-			       const char *client_ip);
+			       dynamic_client_metric_handle_t client);
 
 void nfs_metrics__nfs4_request(const uint32_t op,
 			       const nsecs_elapsed_t request_time,
 			       const nfsstat4 status,
 			       const export_id_t export_id,
-			       const char *client_ip);
+			       dynamic_client_metric_handle_t client);
 
 #endif /* !NFS_METRICS_H */
@@ -429,6 +429,25 @@ enum nfs_req_result nfs4_op_layoutstats(struct nfs_argop4 *, compound_data_t *,
 
 void nfs4_op_layoutstats_Free(nfs_resop4 *resp);
 
+enum nfs_req_result nfs4_op_copy(struct nfs_argop4 *, compound_data_t *,
+				 struct nfs_resop4 *);
+
+enum nfs_req_result nfs4_op_clone(struct nfs_argop4 *, compound_data_t *,
+				  struct nfs_resop4 *);
+
+enum nfs_req_result nfs4_op_offload_status(struct nfs_argop4 *,
+					   compound_data_t *,
+					   struct nfs_resop4 *);
+
+void nfs4_op_offload_status_Free(nfs_resop4 *resp);
+
+enum nfs_req_result nfs4_op_offload_cancel(struct nfs_argop4 *,
+					   compound_data_t *,
+					   struct nfs_resop4 *);
+
+int nfs4_copy_init(void);
+int nfs4_copy_shutdown(void);
+
 /* NFSv4.3 */
 enum nfs_req_result nfs4_op_getxattr(struct nfs_argop4 *, compound_data_t *,
 				     struct nfs_resop4 *);
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs_rpc_capture.h
+ * @brief Capture of the RPC request stream to a ring file
+ *
+ * When RPC_Capture_File is set, every completed request is summarised in a
+ * record appended to a memory mapped file used as a ring.  The file starts
+ * with a struct rpc_capture_hdr padded to RPC_CAPTURE_HDR_SIZE, followed by
+ * data_size bytes of ring.
+ *
+ * Records are 8 byte aligned and never wrap; a record that does not fit
+ * before the end of the ring starts over at the beginning, leaving the tail
+ * unused.  head counts every byte ever reserved, so a record lives at
+ * ring offset (offset % data_size), and only records with offset at least
+ * (head - data_size) are still intact.  A record's magic is written last,
+ * so a reader must also check that offset matches where it found it.
+ *
+ * The payload, unless elided, is the component names the request carried
+ * (LOOKUP, REMOVE, RENAME, LINK, CREATE, OPEN by name and SECINFO for
+ * NFSv4, LOOKUP for NFSv3), each NUL terminated, in op order.  WRITE data
+ * is never captured.
+ *
+ * All fields are in host byte order.
+ */
+
+#ifndef NFS_RPC_CAPTURE_H
+#define NFS_RPC_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nfs_proto_data.h"
+
+#define RPC_CAPTURE_MAGIC 0x47534843 /* "GSHC" */
+#define RPC_CAPTURE_VERSION 1
+#define RPC_CAPTURE_REC_MAGIC 0x52435043 /* "RCPC" */
+
+#define RPC_CAPTURE_HDR_SIZE 4096
+#define RPC_CAPTURE_MAX_OPS 32
+#define RPC_CAPTURE_FH_MAX 128
+#define RPC_CAPTURE_PAYLOAD_MAX 1024
+
+/** Payloads were elided for the whole capture */
+#define RPC_CAPTURE_FLAG_ELIDED 0x1
+
+/** Names did not fit in the payload, it holds only the first ones */
+#define RPC_CAPTURE_REC_TRUNCATED 0x1
+
+struct rpc_capture_hdr {
+	uint32_t magic; /*< RPC_CAPTURE_MAGIC */
+	uint32_t version; /*< RPC_CAPTURE_VERSION */
+	uint64_t data_size; /*< Bytes of ring after the header */
+	uint64_t head; /*< Bytes ever reserved in the ring */
+	uint64_t start_sec; /*< CLOCK_REALTIME at capture start */
+	uint64_t start_nsec;
+	uint64_t flags; /*< RPC_CAPTURE_FLAG_* */
+};
+
+struct rpc_capture_rec {
+	uint32_t magic; /*< RPC_CAPTURE_REC_MAGIC, written last */
+	uint32_t len; /*< Whole record including payload and padding */
+	uint64_t offset; /*< Value of head where this record starts */
+	uint64_t time_ns; /*< Arrival, relative to capture start */
+	uint64_t latency_ns; /*< Arrival to completion */
+	uint64_t io_offset; /*< Offset of the first READ or WRITE */
+	uint32_t xid;
+	uint32_t prog;
+	uint32_t status; /*< COMPOUND status, or NFSv3 status */
+	uint32_t io_count; /*< Byte count of the first READ or WRITE */
+	uint16_t vers;
+	uint16_t proc;
+	uint16_t minorversion;
+	uint16_t family; /*< Client address family, AF_INET or AF_INET6 */
+	uint16_t port; /*< Client port */
+	uint16_t payload_len;
+	uint8_t nops; /*< Ops in ops[], may be fewer than in the COMPOUND */
+	uint8_t fh_len; /*< First PUTFH, or the NFSv3 file handle */
+	uint8_t flags; /*< RPC_CAPTURE_REC_* */
+	uint8_t pad;
+	uint8_t addr[16]; /*< Client address */
+	uint16_t ops[RPC_CAPTURE_MAX_OPS]; /*< NFSv4 opcodes */
+	uint8_t fh[RPC_CAPTURE_FH_MAX];
+	/* payload_len bytes of payload follow */
+};
+
+extern bool nfs_rpc_capture_enabled;
+
+int nfs_rpc_capture_init(void);
+void nfs_rpc_capture_shutdown(void);
+void nfs_rpc_capture(nfs_request_t *reqdata);
+
+#endif /* NFS_RPC_CAPTURE_H */
@@ -2667,11 +2667,23 @@ typedef struct {
 } seek_res4;
 
 typedef struct OFFLOAD_STATUS4resok {
-	length4 osr_bytes_copied;
-	count4 osr_count_complete;
-	nfsstat4 osr_complete;
+	length4 osr_count;
+	struct {
+		u_int osr_complete_len;
+		nfsstat4 *osr_complete_val;
+	} osr_complete;
 } OFFLOAD_STATUS4resok;
 
+struct netloc4 {
+	netloc_type4 nl_type;
+	union {
+		utf8str_cis nl_name;
+		utf8str_cis nl_url;
+		netaddr4 nl_addr;
+	} netloc4_u;
+};
+typedef struct netloc4 netloc4;
+
 struct COPY_NOTIFY4args {
 	stateid4 cna_stateid;
 	netloc_type4 cna_type;
@@ -2715,33 +2727,45 @@ struct COPY4args {
 	offset4 ca_src_offset;
 	offset4 ca_dst_offset;
 	length4 ca_count;
-	netloc_type4 ca_type;
-	union {
-		utf8str_cis ca_name;
-		utf8str_cis ca_url;
-		netaddr4 ca_addr;
-	};
+	bool_t ca_consecutive;
+	bool_t ca_synchronous;
+	struct {
+		u_int ca_source_server_len;
+		netloc4 *ca_source_server_val;
+	} ca_source_server;
 };
 typedef struct COPY4args COPY4args;
 
+struct copy_requirements4 {
+	bool_t cr_consecutive;
+	bool_t cr_synchronous;
+};
+typedef struct copy_requirements4 copy_requirements4;
+
+struct COPY4resok {
+	write_response4 cr_response;
+	copy_requirements4 cr_requirements;
+};
+typedef struct COPY4resok COPY4resok;
+
 struct COPY4res {
 	nfsstat4 cr_status;
 	union {
-		write_response4 cr_resok4;
-		length4 cr_bytes_copied;
+		COPY4resok cr_resok4;
+		copy_requirements4 cr_requirements;
 	} COPY4res_u;
 };
 typedef struct COPY4res COPY4res;
 
-struct OFFLOAD_ABORT4args {
-	stateid4 oaa_stateid;
+struct OFFLOAD_CANCEL4args {
+	stateid4 oca_stateid;
 };
-typedef struct OFFLOAD_ABORT4args OFFLOAD_ABORT4args;
+typedef struct OFFLOAD_CANCEL4args OFFLOAD_CANCEL4args;
 
-struct OFFLOAD_ABORT4res {
-	stateid4 oar_stateid;
+struct OFFLOAD_CANCEL4res {
+	nfsstat4 ocr_status;
 };
-typedef struct OFFLOAD_ABORT4res OFFLOAD_ABORT4res;
+typedef struct OFFLOAD_CANCEL4res OFFLOAD_CANCEL4res;
 
 struct OFFLOAD_STATUS4args {
 	stateid4 osa_stateid;
@@ -2756,6 +2780,20 @@ struct OFFLOAD_STATUS4res {
 };
 typedef struct OFFLOAD_STATUS4res OFFLOAD_STATUS4res;
 
+struct CLONE4args {
+	stateid4 cl_src_stateid;
+	stateid4 cl_dst_stateid;
+	offset4 cl_src_offset;
+	offset4 cl_dst_offset;
+	length4 cl_count;
+};
+typedef struct CLONE4args CLONE4args;
+
+struct CLONE4res {
+	nfsstat4 cl_status;
+};
+typedef struct CLONE4res CLONE4res;
+
 struct WRITE_SAME4args {
 	stateid4 wp_stateid;
 	stable_how4 wp_stable;
@@ -3278,8 +3316,9 @@ struct nfs_argop4 {
 		COPY_NOTIFY4args opoffload_notify;
 		OFFLOAD_REVOKE4args opcopy_revoke;
 		COPY4args opcopy;
-		OFFLOAD_ABORT4args opoffload_abort;
+		OFFLOAD_CANCEL4args opoffload_cancel;
 		OFFLOAD_STATUS4args opoffload_status;
+		CLONE4args opclone;
 		WRITE_SAME4args opwrite_same;
 		ALLOCATE4args opallocate;
 		DEALLOCATE4args opdeallocate;
@@ -3363,8 +3402,9 @@ struct nfs_resop4 {
 		COPY_NOTIFY4res opoffload_notify;
 		OFFLOAD_REVOKE4res opcopy_revoke;
 		COPY4res opcopy;
-		OFFLOAD_ABORT4res opoffload_abort;
+		OFFLOAD_CANCEL4res opoffload_cancel;
 		OFFLOAD_STATUS4res opoffload_status;
+		CLONE4res opclone;
 		WRITE_SAME4res opwrite_same;
 		ALLOCATE4res opallocate;
 		DEALLOCATE4res opdeallocate;
@@ -3719,6 +3759,27 @@ struct CB_NOTIFY_DEVICEID4res {
 };
 typedef struct CB_NOTIFY_DEVICEID4res CB_NOTIFY_DEVICEID4res;
 
+struct offload_info4 {
+	nfsstat4 coa_status;
+	union {
+		write_response4 coa_resok4;
+		length4 coa_bytes_copied;
+	} offload_info4_u;
+};
+typedef struct offload_info4 offload_info4;
+
+struct CB_OFFLOAD4args {
+	nfs_fh4 coa_fh;
+	stateid4 coa_stateid;
+	offload_info4 coa_offload_info;
+};
+typedef struct CB_OFFLOAD4args CB_OFFLOAD4args;
+
+struct CB_OFFLOAD4res {
+	nfsstat4 cor_status;
+};
+typedef struct CB_OFFLOAD4res CB_OFFLOAD4res;
+
 /* Callback operations new to NFSv4.1 */
 
 enum nfs_cb_opnum4 {
@@ -3734,6 +3795,7 @@ enum nfs_cb_opnum4 {
 	NFS4_OP_CB_WANTS_CANCELLED = 12,
 	NFS4_OP_CB_NOTIFY_LOCK = 13,
 	NFS4_OP_CB_NOTIFY_DEVICEID = 14,
+	NFS4_OP_CB_OFFLOAD = 15,
 	NFS4_OP_CB_ILLEGAL = 10044,
 };
 typedef enum nfs_cb_opnum4 nfs_cb_opnum4;
@@ -3753,6 +3815,7 @@ struct nfs_cb_argop4 {
 		CB_WANTS_CANCELLED4args opcbwants_cancelled;
 		CB_NOTIFY_LOCK4args opcbnotify_lock;
 		CB_NOTIFY_DEVICEID4args opcbnotify_deviceid;
+		CB_OFFLOAD4args opcboffload;
 	} nfs_cb_argop4_u;
 };
 typedef struct nfs_cb_argop4 nfs_cb_argop4;
@@ -3772,6 +3835,7 @@ struct nfs_cb_resop4 {
 		CB_WANTS_CANCELLED4res opcbwants_cancelled;
 		CB_NOTIFY_LOCK4res opcbnotify_lock;
 		CB_NOTIFY_DEVICEID4res opcbnotify_deviceid;
+		CB_OFFLOAD4res opcboffload;
 		CB_ILLEGAL4res opcbillegal;
 	} nfs_cb_resop4_u;
 };
@@ -8121,6 +8185,152 @@ static inline bool xdr_LAYOUTSTATS4res(XDR *xdrs, LAYOUTSTATS4res *objp)
 	return true;
 }
 
+static inline bool xdr_netloc4(XDR *xdrs, netloc4 *objp)
+{
+	if (!inline_xdr_enum(xdrs, (enum_t *)&objp->nl_type))
+		return false;
+	switch (objp->nl_type) {
+	case NL4_NAME:
+		if (!xdr_utf8str_cis(xdrs, &objp->netloc4_u.nl_name))
+			return false;
+		break;
+	case NL4_URL:
+		if (!xdr_utf8str_cis(xdrs, &objp->netloc4_u.nl_url))
+			return false;
+		break;
+	case NL4_NETADDR:
+		if (!xdr_netaddr4(xdrs, &objp->netloc4_u.nl_addr))
+			return false;
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+static inline bool xdr_COPY4args(XDR *xdrs, COPY4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->ca_src_stateid))
+		return false;
+	if (!xdr_stateid4(xdrs, &objp->ca_dst_stateid))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->ca_src_offset))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->ca_dst_offset))
+		return false;
+	if (!xdr_length4(xdrs, &objp->ca_count))
+		return false;
+	if (!inline_xdr_bool(xdrs, &objp->ca_consecutive))
+		return false;
+	if (!inline_xdr_bool(xdrs, &objp->ca_synchronous))
+		return false;
+	if (!xdr_array(xdrs,
+		       (char **)&objp->ca_source_server.ca_source_server_val,
+		       &objp->ca_source_server.ca_source_server_len,
+		       XDR_ARRAY_MAXLEN, sizeof(netloc4),
+		       (xdrproc_t)xdr_netloc4))
+		return false;
+	return true;
+}
+
+static inline bool xdr_copy_requirements4(XDR *xdrs, copy_requirements4 *objp)
+{
+	if (!inline_xdr_bool(xdrs, &objp->cr_consecutive))
+		return false;
+	if (!inline_xdr_bool(xdrs, &objp->cr_synchronous))
+		return false;
+	return true;
+}
+
+static inline bool xdr_COPY4res(XDR *xdrs, COPY4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->cr_status))
+		return false;
+	switch (objp->cr_status) {
+	case NFS4_OK:
+		if (!xdr_WRITE_SAME4resok(
+			    xdrs, &objp->COPY4res_u.cr_resok4.cr_response))
+			return false;
+		if (!xdr_copy_requirements4(
+			    xdrs, &objp->COPY4res_u.cr_resok4.cr_requirements))
+			return false;
+		break;
+	case NFS4ERR_OFFLOAD_NO_REQS:
+		if (!xdr_copy_requirements4(
+			    xdrs, &objp->COPY4res_u.cr_requirements))
+			return false;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_CANCEL4args(XDR *xdrs, OFFLOAD_CANCEL4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->oca_stateid))
+		return false;
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_CANCEL4res(XDR *xdrs, OFFLOAD_CANCEL4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->ocr_status))
+		return false;
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_STATUS4args(XDR *xdrs, OFFLOAD_STATUS4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->osa_stateid))
+		return false;
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_STATUS4res(XDR *xdrs, OFFLOAD_STATUS4res *objp)
+{
+	OFFLOAD_STATUS4resok *resok = &objp->OFFLOAD_STATUS4res_u.osr_resok4;
+
+	if (!xdr_nfsstat4(xdrs, &objp->osr_status))
+		return false;
+	switch (objp->osr_status) {
+	case NFS4_OK:
+		if (!xdr_length4(xdrs, &resok->osr_count))
+			return false;
+		if (!xdr_array(xdrs,
+			       (char **)&resok->osr_complete.osr_complete_val,
+			       &resok->osr_complete.osr_complete_len, 1,
+			       sizeof(nfsstat4), (xdrproc_t)xdr_nfsstat4))
+			return false;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static inline bool xdr_CLONE4args(XDR *xdrs, CLONE4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->cl_src_stateid))
+		return false;
+	if (!xdr_stateid4(xdrs, &objp->cl_dst_stateid))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->cl_src_offset))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->cl_dst_offset))
+		return false;
+	if (!xdr_length4(xdrs, &objp->cl_count))
+		return false;
+	return true;
+}
+
+static inline bool xdr_CLONE4res(XDR *xdrs, CLONE4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->cl_status))
+		return false;
+	return true;
+}
+
 /* new operations for NFSv4.1 */
 
 static inline bool xdr_nfs_opnum4(XDR *xdrs, nfs_opnum4 *objp)
@@ -8444,10 +8654,25 @@ static inline bool xdr_nfs_argop4(XDR *xdrs, nfs_argop4 *objp)
 		break;
 
 	case NFS4_OP_COPY:
-	case NFS4_OP_COPY_NOTIFY:
+		if (!xdr_COPY4args(xdrs, &objp->nfs_argop4_u.opcopy))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_CANCEL:
+		if (!xdr_OFFLOAD_CANCEL4args(
+			    xdrs, &objp->nfs_argop4_u.opoffload_cancel))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_STATUS:
+		if (!xdr_OFFLOAD_STATUS4args(
+			    xdrs, &objp->nfs_argop4_u.opoffload_status))
+			return false;
+		break;
 	case NFS4_OP_CLONE:
+		if (!xdr_CLONE4args(xdrs, &objp->nfs_argop4_u.opclone))
+			return false;
+		break;
+
+	case NFS4_OP_COPY_NOTIFY:
 		break;
 
 	/* NFSv4.3 */
@@ -8770,10 +8995,29 @@ static inline bool xdr_nfs_resop4(XDR *xdrs, nfs_resop4 *objp)
 		break;
 
 	case NFS4_OP_COPY:
-	case NFS4_OP_COPY_NOTIFY:
+		if (!xdr_COPY4res(xdrs, &objp->nfs_resop4_u.opcopy))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_CANCEL:
+		if (!xdr_OFFLOAD_CANCEL4res(
+			    xdrs, &objp->nfs_resop4_u.opoffload_cancel))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_STATUS:
+		if (!xdr_OFFLOAD_STATUS4res(
+			    xdrs, &objp->nfs_resop4_u.opoffload_status))
+			return false;
+		break;
 	case NFS4_OP_CLONE:
+		if (!xdr_CLONE4res(xdrs, &objp->nfs_resop4_u.opclone))
+			return false;
+		break;
+
+	case NFS4_OP_COPY_NOTIFY:
+		/* Not supported, only the status is encoded */
+		if (!xdr_ILLEGAL4res(xdrs, &objp->nfs_resop4_u.opillegal))
+			return false;
+		break;
 
 	/* NFSv4.3 */
 	case NFS4_OP_GETXATTR:
@@ -9542,6 +9786,43 @@ static inline bool xdr_CB_NOTIFY_DEVICEID4res(XDR *xdrs,
 	return true;
 }
 
+static inline bool xdr_offload_info4(XDR *xdrs, offload_info4 *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->coa_status))
+		return false;
+	switch (objp->coa_status) {
+	case NFS4_OK:
+		if (!xdr_WRITE_SAME4resok(xdrs,
+					  &objp->offload_info4_u.coa_resok4))
+			return false;
+		break;
+	default:
+		if (!xdr_length4(xdrs,
+				 &objp->offload_info4_u.coa_bytes_copied))
+			return false;
+		break;
+	}
+	return true;
+}
+
+static inline bool xdr_CB_OFFLOAD4args(XDR *xdrs, CB_OFFLOAD4args *objp)
+{
+	if (!xdr_nfs_fh4(xdrs, &objp->coa_fh))
+		return false;
+	if (!xdr_stateid4(xdrs, &objp->coa_stateid))
+		return false;
+	if (!xdr_offload_info4(xdrs, &objp->coa_offload_info))
+		return false;
+	return true;
+}
+
+static inline bool xdr_CB_OFFLOAD4res(XDR *xdrs, CB_OFFLOAD4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->cor_status))
+		return false;
+	return true;
+}
+
 /* Callback operations new to NFSv4.1 */
 
 static inline bool xdr_nfs_cb_opnum4(XDR *xdrs, nfs_cb_opnum4 *objp)
@@ -9617,6 +9898,11 @@ static inline bool xdr_nfs_cb_argop4(XDR *xdrs, nfs_cb_argop4 *objp)
 			    xdrs, &objp->nfs_cb_argop4_u.opcbnotify_deviceid))
 			return false;
 		break;
+	case NFS4_OP_CB_OFFLOAD:
+		if (!xdr_CB_OFFLOAD4args(xdrs,
+					 &objp->nfs_cb_argop4_u.opcboffload))
+			return false;
+		break;
 	case NFS4_OP_CB_ILLEGAL:
 		break;
 	default:
@@ -9689,6 +9975,11 @@ static inline bool xdr_nfs_cb_resop4(XDR *xdrs, nfs_cb_resop4 *objp)
 			    xdrs, &objp->nfs_cb_resop4_u.opcbnotify_deviceid))
 			return false;
 		break;
+	case NFS4_OP_CB_OFFLOAD:
+		if (!xdr_CB_OFFLOAD4res(xdrs,
+					&objp->nfs_cb_resop4_u.opcboffload))
+			return false;
+		break;
 	case NFS4_OP_CB_ILLEGAL:
 		if (!xdr_CB_ILLEGAL4res(xdrs,
 					&objp->nfs_cb_resop4_u.opcbillegal))
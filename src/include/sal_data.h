@@ -44,6 +44,7 @@
 #include <time.h>
 #include <pthread.h>
 #include <dirent.h> /* For having MAXNAMLEN */
+#include <urcu-bp.h>
 
 #include "abstract_atomic.h"
 #include "abstract_mem.h"
@@ -242,6 +243,8 @@ struct nfs41_session {
 	uint32_t nb_slots; /**< Number of slots in this session */
 	nfs41_session_slot_t *fc_slots; /**< Forechannel slot table*/
 	nfs41_cb_session_slot_t *bc_slots; /**< Backchannel slot table */
+	struct rcu_head session_rcu; /**< Deferred free, lockless lookups
+					  may still hold the session */
 };
 
 /**
@@ -452,6 +455,8 @@ struct state_t {
 	struct state_refer state_refer; /**< For NFSv4.1, track the
 					   call that created a
 					   state. */
+	struct rcu_head state_rcu; /**< Deferred free, lockless lookups
+				       may still hold the state */
 };
 
 static inline void free_state(struct state_t *state)
@@ -938,6 +943,8 @@ typedef enum state_block_type_t {
  */
 struct state_block_data_t {
 	struct glist_head sbd_list; /*< Lost of blocking locks */
+	struct glist_head sbd_timer; /*< Link in the blocked lock timer wheel */
+	time_t sbd_due; /*< When the timer wheel next looks at this lock */
 	state_grant_type_t sbd_grant_type; /*< Type of grant */
 	state_block_type_t sbd_block_type; /*< Type of block */
 	granted_callback_t sbd_granted_callback; /*< Callback for grant */
@@ -949,8 +956,22 @@ struct state_block_data_t {
 	} sbd_prot;
 };
 
+/**
+ * @brief Node of a file's byte-range lock interval tree
+ *
+ * The tree is an AVL tree ordered by lock start, each node also tracking
+ * the largest lock end in its subtree.
+ */
+struct state_lock_tree_node {
+	state_lock_entry_t *left; /*< Locks starting before this one */
+	state_lock_entry_t *right; /*< Locks starting after this one */
+	uint64_t max_end; /*< Last byte locked in this subtree */
+	int32_t height; /*< Subtree height, 0 when not in a tree */
+};
+
 struct state_lock_entry_t {
 	struct glist_head sle_list; /*< Locks on this file */
+	struct state_lock_tree_node sle_tree; /*< Node in file's lock tree */
 	struct glist_head sle_owner_locks; /*< Link on the owner lock list */
 	struct glist_head sle_client_locks; /*< Locks on this client */
 	struct glist_head sle_state_locks; /*< Locks on this state */
@@ -1023,6 +1044,16 @@ struct state_file {
 	struct glist_head layoutrecall_list;
 	/** Pointers for lock list. Protected by st_lock */
 	struct glist_head lock_list;
+	/** Interval tree of the locks on lock_list. Protected by st_lock */
+	state_lock_entry_t *lock_tree;
+	/** Number of locks in lock_tree. Protected by st_lock */
+	uint32_t lock_count;
+	/** Number of locks in lock_tree taken through lock_export.
+	 *  Protected by st_lock */
+	uint32_t lock_export_count;
+	/** Export of the first lock, NULL once all its locks are gone.
+	 *  Only compared, never dereferenced. Protected by st_lock */
+	struct gsh_export *lock_export;
 	/** Pointers for NLM share list. Protected by st_lock */
 	struct glist_head nlm_share_list;
 	/** true iff write delegated. Protected by st_lock */
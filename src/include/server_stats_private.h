@@ -128,15 +128,28 @@ struct server_stats {
 	struct gsh_client client; /* must be last element! */
 };
 
+/**
+ * @brief Number of per worker thread stats shards
+ *
+ * Global and per export stats are recorded into one of these shards,
+ * picked once per thread, and folded into the shared stats when read.
+ */
+
+#define SERVER_STATS_SHARDS 32
+
 /**
  * @brief Server by export id statistics
  *
  * Top level structure only shared between export_mgr.c and
  * server_stats.c
+ *
+ * Workers record into shards[], st only holds what has been folded
+ * by server_stats_fold_export().
  */
 
 struct export_stats {
 	struct gsh_stats st;
+	struct gsh_stats shards[SERVER_STATS_SHARDS];
 	struct gsh_export export;
 };
 
@@ -497,6 +510,8 @@ extern struct glist_head fsal_list;
 #endif /* USE_DBUS */
 
 void server_stats_free(struct gsh_stats *statsp);
+void server_stats_fold_export(struct export_stats *export_st);
+void server_stats_fold_global(void);
 void server_stats_allops_free(struct gsh_clnt_allops_stats *statsp);
 
 void server_stats_init(void);
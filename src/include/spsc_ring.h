@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file spsc_ring.h
+ * @brief Bounded single producer, single consumer ring of pointers
+ *
+ * One thread pushes and one other thread pops, without locks.  Each side
+ * only writes its own index, and the indexes live on their own cache
+ * lines so the two threads do not bounce a line on every operation.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "abstract_mem.h"
+#include "gsh_intrinsic.h"
+
+struct spsc_ring {
+	void **slots;
+	uint32_t mask; /*< Number of slots - 1 */
+
+	GSH_CACHE_PAD(0);
+
+	uint32_t head; /*< Next slot to pop, written by the consumer */
+
+	GSH_CACHE_PAD(1);
+
+	uint32_t tail; /*< Next slot to push, written by the producer */
+
+	GSH_CACHE_PAD(2);
+};
+
+/**
+ * @brief Initialize a ring
+ *
+ * @param[in] ring	The ring
+ * @param[in] size	Number of slots, a power of 2
+ */
+
+static inline void spsc_ring_init(struct spsc_ring *ring, uint32_t size)
+{
+	ring->slots = gsh_calloc(size, sizeof(void *));
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+static inline void spsc_ring_destroy(struct spsc_ring *ring)
+{
+	gsh_free(ring->slots);
+	ring->slots = NULL;
+}
+
+/**
+ * @brief Push an entry, producer side
+ *
+ * @return false if the ring is full.
+ */
+
+static inline bool spsc_ring_push(struct spsc_ring *ring, void *entry)
+{
+	uint32_t tail = ring->tail;
+
+	if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask)
+		return false;
+
+	ring->slots[tail & ring->mask] = entry;
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * @brief Pop an entry, consumer side
+ *
+ * @return The oldest entry, or NULL if the ring is empty.
+ */
+
+static inline void *spsc_ring_pop(struct spsc_ring *ring)
+{
+	uint32_t head = ring->head;
+	void *entry;
+
+	if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	entry = ring->slots[head & ring->mask];
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return entry;
+}
+
+/**
+ * @brief Check whether there is anything to pop, consumer side
+ */
+
+static inline bool spsc_ring_empty(struct spsc_ring *ring)
+{
+	return ring->head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif /* SPSC_RING_H */
@@ -44,6 +44,8 @@
 #include <sys/resource.h>
 #include <execinfo.h>
 #include <assert.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 #ifdef USE_UNWIND
 #define UNW_LOCAL_ONLY
@@ -55,6 +57,7 @@
 #include "gsh_rpc.h"
 #include "common_utils.h"
 #include "abstract_mem.h"
+#include "abstract_atomic.h"
 
 #ifdef USE_DBUS
 #include "gsh_dbus.h"
@@ -224,6 +227,18 @@ static int log_to_stream(log_header_t headers, void *private,
 			 log_levels_t level, struct display_buffer *buffer,
 			 char *compstr, char *message);
 
+static int log_to_file_async(log_header_t headers, void *private,
+			     log_levels_t level, struct display_buffer *buffer,
+			     char *compstr, char *message);
+
+static struct log_async_file *log_async_file_create(const char *path);
+static void log_async_file_release(struct log_async_file *file);
+static void log_async_file_set_path(struct log_async_file *file,
+				    const char *path);
+static const char *log_facility_path(struct log_facility *facility);
+static void log_async_flush(void);
+static void log_async_shutdown(void);
+
 static struct glist_head facility_list;
 static struct glist_head active_facility_list;
 
@@ -342,6 +357,8 @@ void Cleanup(void)
 		c = c->next;
 	}
 
+	log_async_shutdown();
+
 	PTHREAD_RWLOCK_destroy(&log_rwlock);
 #ifdef _DONT_HAVE_LOCALTIME_R
 	PTHREAD_MUTEX_destroy(&mutex_localtime);
@@ -350,6 +367,8 @@ void Cleanup(void)
 
 void Fatal(void)
 {
+	/* Get whatever is still queued, including the fatal message, out */
+	log_async_flush();
 	gsh_backtrace();
 	_exit(2);
 }
@@ -656,7 +675,8 @@ int create_log_facility(const char *name, lf_function_t *log_func,
 		return -EINVAL;
 	if (max_level < NIV_NULL || max_level >= NB_LOG_LEVEL)
 		return -EINVAL;
-	if (log_func == log_to_file && private != NULL) {
+	if ((log_func == log_to_file || log_func == log_to_file_async) &&
+	    private != NULL) {
 		char *dir;
 		int rc;
 
@@ -697,6 +717,8 @@ int create_log_facility(const char *name, lf_function_t *log_func,
 
 	if (log_func == log_to_file && private != NULL)
 		facility->lf_private = gsh_strdup(private);
+	else if (log_func == log_to_file_async && private != NULL)
+		facility->lf_private = log_async_file_create(private);
 	else
 		facility->lf_private = private;
 
@@ -748,6 +770,9 @@ void release_log_facility(const char *name)
 	PTHREAD_RWLOCK_unlock(&log_rwlock);
 	if (facility->lf_func == log_to_file && facility->lf_private != NULL)
 		gsh_free(facility->lf_private);
+	else if (facility->lf_func == log_to_file_async &&
+		 facility->lf_private != NULL)
+		log_async_file_release(facility->lf_private);
 	gsh_free(facility->lf_name);
 	gsh_free(facility);
 }
@@ -923,7 +948,8 @@ int set_log_destination(const char *name, char *dest)
 		LogCrit(COMPONENT_LOG, "No such log facility (%s)", name);
 		return -ENOENT;
 	}
-	if (facility->lf_func == log_to_file) {
+	if (facility->lf_func == log_to_file ||
+	    facility->lf_func == log_to_file_async) {
 		char *logfile, *dir;
 
 		dir = gsh_strdupa(dest);
@@ -936,9 +962,13 @@ int set_log_destination(const char *name, char *dest)
 				dest, strerror(errno));
 			return -errno;
 		}
-		logfile = gsh_strdup(dest);
-		gsh_free(facility->lf_private);
-		facility->lf_private = logfile;
+		if (facility->lf_func == log_to_file_async) {
+			log_async_file_set_path(facility->lf_private, dest);
+		} else {
+			logfile = gsh_strdup(dest);
+			gsh_free(facility->lf_private);
+			facility->lf_private = logfile;
+		}
 	} else if (facility->lf_func == log_to_stream) {
 		FILE *out;
 
@@ -1211,6 +1241,631 @@ static int log_to_stream(log_header_t headers, void *private,
 		return 0;
 }
 
+/**
+ * @page AsyncLog Asynchronous file logging
+ *
+ * log_to_file() opens, writes and closes the log file for every message
+ * on the thread that logs it.  A facility configured with Async = true
+ * uses log_to_file_async() instead, which only copies the formatted
+ * message into a ring buffer owned by the logging thread.
+ *
+ * Each thread gets its own single producer, single consumer ring the
+ * first time it logs, so producers never contend with each other.  One
+ * writer thread drains all the rings, keeps the log files open and
+ * hands runs of messages for the same file to writev().  If a ring is
+ * full the message is dropped and counted against its file; the writer
+ * reports the count in the file once it catches up.
+ *
+ * Log files are reopened after log_reopen_files(), which the SIGHUP
+ * handler calls so logrotate can move the files out from under us.
+ *
+ * The rings, the list of async files and the writer's open descriptors
+ * are protected by log_async_mutex.  The writer holds it while it drains,
+ * so anyone else needing the rings empty (releasing a facility, Fatal())
+ * just drains them itself with the mutex held.
+ */
+
+/** Size of each thread's ring, must be a power of 2 */
+#define LOG_ASYNC_RING_SIZE (64 * 1024)
+#define LOG_ASYNC_RING_MASK (LOG_ASYNC_RING_SIZE - 1)
+
+/** Records are aligned so a header never wraps around the ring */
+#define LOG_ASYNC_ALIGN 16
+
+/** How many iovecs the writer hands to a single writev */
+#define LOG_ASYNC_IOV 64
+
+struct log_async_file {
+	struct glist_head laf_list; /*< List of async log files */
+	char *laf_path; /*< Path of the log file */
+	int laf_fd; /*< Open descriptor, -1 if not (yet) open */
+	uint64_t laf_dropped; /*< Messages dropped since last report */
+};
+
+struct log_async_rec {
+	struct log_async_file *lar_file; /*< File the message goes to */
+	uint32_t lar_len; /*< Length of the message that follows */
+	uint32_t lar_pad;
+};
+
+struct log_async_ring {
+	struct glist_head lr_list; /*< List of all rings */
+	uint64_t lr_head; /*< Written by the owning thread */
+	uint64_t lr_tail; /*< Written by whoever drains the ring */
+	uint32_t lr_orphaned; /*< Owning thread has exited */
+	char lr_buf[LOG_ASYNC_RING_SIZE];
+};
+
+static pthread_mutex_t log_async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_async_cond = PTHREAD_COND_INITIALIZER;
+static struct glist_head log_async_rings = GLIST_HEAD_INIT(log_async_rings);
+static struct glist_head log_async_files = GLIST_HEAD_INIT(log_async_files);
+static pthread_t log_async_thread;
+static bool log_async_running;
+static bool log_async_stop;
+static uint32_t log_async_idle;
+static uint32_t log_async_reopen;
+static pthread_key_t log_async_key;
+static pthread_once_t log_async_once = PTHREAD_ONCE_INIT;
+static __thread struct log_async_ring *log_async_my_ring;
+
+static inline uint64_t log_async_rec_size(uint32_t len)
+{
+	return (sizeof(struct log_async_rec) + len + LOG_ASYNC_ALIGN - 1) &
+	       ~((uint64_t)LOG_ASYNC_ALIGN - 1);
+}
+
+/**
+ * @brief Mark a thread's ring as orphaned when the thread exits
+ *
+ * The writer frees the ring once it has drained it.
+ *
+ * @param[in] arg The ring
+ */
+static void log_async_ring_orphan(void *arg)
+{
+	struct log_async_ring *ring = arg;
+
+	log_async_my_ring = NULL;
+	atomic_store_uint32_t(&ring->lr_orphaned, 1);
+}
+
+static void log_async_key_init(void)
+{
+	(void)pthread_key_create(&log_async_key, log_async_ring_orphan);
+}
+
+/**
+ * @brief Get the calling thread's ring, creating it on first use
+ *
+ * @return the ring.
+ */
+static struct log_async_ring *log_async_ring_get(void)
+{
+	struct log_async_ring *ring = log_async_my_ring;
+
+	if (likely(ring != NULL))
+		return ring;
+
+	ring = gsh_calloc(1, sizeof(*ring));
+
+	pthread_mutex_lock(&log_async_mutex);
+	glist_add_tail(&log_async_rings, &ring->lr_list);
+	pthread_mutex_unlock(&log_async_mutex);
+
+	(void)pthread_setspecific(log_async_key, ring);
+	log_async_my_ring = ring;
+
+	return ring;
+}
+
+/**
+ * @brief Open a log file if it is not open
+ *
+ * Must hold log_async_mutex.
+ *
+ * @param[in] file The file
+ *
+ * @return true if the file is open.
+ */
+static bool log_async_open(struct log_async_file *file)
+{
+	int err;
+
+	if (file->laf_fd >= 0)
+		return true;
+
+	file->laf_fd = open(file->laf_path, O_WRONLY | O_APPEND | O_CREAT,
+			    log_mask);
+
+	if (file->laf_fd >= 0)
+		return true;
+
+	err = errno;
+	fprintf(stderr,
+		"Error: couldn't open the log file %s status=%d (%s)\n",
+		file->laf_path, err, strerror(err));
+	return false;
+}
+
+/**
+ * @brief Write out a batch of messages for one file
+ *
+ * Must hold log_async_mutex.
+ *
+ * @param[in] file   The file
+ * @param[in] iov    Messages
+ * @param[in] iovcnt Number of iovecs
+ */
+static void log_async_writev(struct log_async_file *file, struct iovec *iov,
+			     int iovcnt)
+{
+	ssize_t rc;
+	int err;
+
+	if (iovcnt == 0 || !log_async_open(file))
+		return;
+
+	while (iovcnt > 0) {
+		rc = writev(file->laf_fd, iov, iovcnt);
+
+		if (rc < 0) {
+			err = errno;
+
+			if (err == EINTR)
+				continue;
+
+			fprintf(stderr,
+				"Error: couldn't complete write to the log file %s status=%d (%s)\n",
+				file->laf_path, err, strerror(err));
+			return;
+		}
+
+		/* Skip whatever made it out and retry the rest */
+		while (iovcnt > 0 && (size_t)rc >= iov->iov_len) {
+			rc -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
+	}
+}
+
+/**
+ * @brief Drain one ring
+ *
+ * Must hold log_async_mutex.
+ *
+ * @param[in] ring The ring
+ *
+ * @return true if anything was written.
+ */
+static bool log_async_drain_ring(struct log_async_ring *ring)
+{
+	struct iovec iov[LOG_ASYNC_IOV];
+	struct log_async_file *cur = NULL;
+	struct log_async_rec *rec;
+	uint64_t tail = ring->lr_tail;
+	uint64_t head = atomic_fetch_uint64_t(&ring->lr_head);
+	uint64_t pos, first;
+	int iovcnt = 0;
+
+	if (tail == head)
+		return false;
+
+	while (tail != head) {
+		rec = (struct log_async_rec *)(ring->lr_buf +
+					       (tail & LOG_ASYNC_RING_MASK));
+
+		if (rec->lar_file != cur || iovcnt > LOG_ASYNC_IOV - 2) {
+			if (cur != NULL)
+				log_async_writev(cur, iov, iovcnt);
+			cur = rec->lar_file;
+			iovcnt = 0;
+		}
+
+		/* The message may wrap around the end of the ring */
+		pos = (tail + sizeof(*rec)) & LOG_ASYNC_RING_MASK;
+		first = LOG_ASYNC_RING_SIZE - pos;
+
+		if (first > rec->lar_len)
+			first = rec->lar_len;
+
+		iov[iovcnt].iov_base = ring->lr_buf + pos;
+		iov[iovcnt++].iov_len = first;
+
+		if (first < rec->lar_len) {
+			iov[iovcnt].iov_base = ring->lr_buf;
+			iov[iovcnt++].iov_len = rec->lar_len - first;
+		}
+
+		tail += log_async_rec_size(rec->lar_len);
+	}
+
+	log_async_writev(cur, iov, iovcnt);
+
+	/* Only now can the owner reuse the space */
+	atomic_store_uint64_t(&ring->lr_tail, tail);
+
+	return true;
+}
+
+/**
+ * @brief Drain all rings and report dropped messages
+ *
+ * Must hold log_async_mutex.
+ *
+ * @return true if anything was written.
+ */
+static bool log_async_drain(void)
+{
+	struct glist_head *glist, *glistn;
+	struct log_async_ring *ring;
+	struct log_async_file *file;
+	bool wrote = false;
+	char buf[128];
+	uint64_t dropped;
+	struct iovec iov;
+
+	glist_for_each_safe(glist, glistn, &log_async_rings) {
+		ring = glist_entry(glist, struct log_async_ring, lr_list);
+
+		/* Check orphaned first, the owner may log on its way out */
+		if (atomic_fetch_uint32_t(&ring->lr_orphaned) &&
+		    !log_async_drain_ring(ring)) {
+			glist_del(&ring->lr_list);
+			gsh_free(ring);
+			continue;
+		}
+
+		if (log_async_drain_ring(ring))
+			wrote = true;
+	}
+
+	glist_for_each(glist, &log_async_files) {
+		file = glist_entry(glist, struct log_async_file, laf_list);
+		dropped = __atomic_exchange_n(&file->laf_dropped, 0,
+					      __ATOMIC_SEQ_CST);
+
+		if (dropped == 0)
+			continue;
+
+		iov.iov_base = buf;
+		iov.iov_len = snprintf(buf, sizeof(buf),
+				       "%s: dropped %" PRIu64
+				       " log messages, logging fell behind\n",
+				       program_name, dropped);
+		log_async_writev(file, &iov, 1);
+		wrote = true;
+	}
+
+	return wrote;
+}
+
+/**
+ * @brief Check if any ring has something in it
+ *
+ * Must hold log_async_mutex.
+ */
+static bool log_async_pending(void)
+{
+	struct glist_head *glist;
+	struct log_async_ring *ring;
+
+	glist_for_each(glist, &log_async_rings) {
+		ring = glist_entry(glist, struct log_async_ring, lr_list);
+
+		if (atomic_fetch_uint64_t(&ring->lr_head) != ring->lr_tail)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Close the open log files so they get reopened
+ *
+ * Must hold log_async_mutex.
+ */
+static void log_async_close_files(void)
+{
+	struct glist_head *glist;
+	struct log_async_file *file;
+
+	glist_for_each(glist, &log_async_files) {
+		file = glist_entry(glist, struct log_async_file, laf_list);
+
+		if (file->laf_fd >= 0) {
+			(void)close(file->laf_fd);
+			file->laf_fd = -1;
+		}
+	}
+}
+
+/**
+ * @brief The log writer thread
+ *
+ * This thread must not log through LogXXX, it would only be writing
+ * messages to itself.
+ */
+static void *log_async_writer(void *arg)
+{
+	struct timespec timeout;
+
+	SetNameFunction("log_wr");
+
+	pthread_mutex_lock(&log_async_mutex);
+
+	while (!log_async_stop) {
+		if (__atomic_exchange_n(&log_async_reopen, 0,
+					__ATOMIC_SEQ_CST)) {
+			/* Drain first so messages logged before the SIGHUP
+			 * still go to the old file.
+			 */
+			(void)log_async_drain();
+			log_async_close_files();
+		}
+
+		if (log_async_drain())
+			continue;
+
+		/* Tell producers to wake us, then look once more so a
+		 * message that raced with us is not left waiting.
+		 */
+		atomic_store_uint32_t(&log_async_idle, 1);
+
+		if (!log_async_pending() && !log_async_stop &&
+		    !atomic_fetch_uint32_t(&log_async_reopen)) {
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_sec += 1;
+			(void)pthread_cond_timedwait(&log_async_cond,
+						     &log_async_mutex,
+						     &timeout);
+		}
+
+		atomic_store_uint32_t(&log_async_idle, 0);
+	}
+
+	(void)log_async_drain();
+
+	pthread_mutex_unlock(&log_async_mutex);
+
+	return NULL;
+}
+
+/**
+ * @brief Wake the writer thread if it is waiting
+ */
+static void log_async_wake(void)
+{
+	if (!atomic_fetch_uint32_t(&log_async_idle))
+		return;
+
+	pthread_mutex_lock(&log_async_mutex);
+	pthread_cond_signal(&log_async_cond);
+	pthread_mutex_unlock(&log_async_mutex);
+}
+
+/**
+ * @brief Create an async log file, starting the writer if needed
+ *
+ * Called with log_rwlock held for write.
+ *
+ * @param[in] path Path of the log file
+ *
+ * @return the new file.
+ */
+static struct log_async_file *log_async_file_create(const char *path)
+{
+	struct log_async_file *file = gsh_calloc(1, sizeof(*file));
+	int rc;
+
+	file->laf_path = gsh_strdup(path);
+	file->laf_fd = -1;
+
+	(void)pthread_once(&log_async_once, log_async_key_init);
+
+	pthread_mutex_lock(&log_async_mutex);
+
+	glist_add_tail(&log_async_files, &file->laf_list);
+
+	if (!log_async_running) {
+		log_async_stop = false;
+		rc = pthread_create(&log_async_thread, NULL, log_async_writer,
+				    NULL);
+		if (rc != 0)
+			fprintf(stderr,
+				"Error: couldn't start the log writer thread status=%d (%s)\n",
+				rc, strerror(rc));
+		else
+			log_async_running = true;
+	}
+
+	pthread_mutex_unlock(&log_async_mutex);
+
+	return file;
+}
+
+/**
+ * @brief Release an async log file
+ *
+ * The facility is already off the lists, so nothing new can be queued
+ * for it.  Write out what is queued before it goes away.
+ *
+ * @param[in] file The file
+ */
+static void log_async_file_release(struct log_async_file *file)
+{
+	pthread_mutex_lock(&log_async_mutex);
+
+	(void)log_async_drain();
+	glist_del(&file->laf_list);
+
+	pthread_mutex_unlock(&log_async_mutex);
+
+	if (file->laf_fd >= 0)
+		(void)close(file->laf_fd);
+
+	gsh_free(file->laf_path);
+	gsh_free(file);
+}
+
+/**
+ * @brief Point an async log file at a new path
+ *
+ * @param[in] file The file
+ * @param[in] path New path
+ */
+static void log_async_file_set_path(struct log_async_file *file,
+				    const char *path)
+{
+	char *old;
+
+	pthread_mutex_lock(&log_async_mutex);
+
+	/* What was logged so far goes to the old file */
+	(void)log_async_drain();
+
+	old = file->laf_path;
+	file->laf_path = gsh_strdup(path);
+
+	if (file->laf_fd >= 0) {
+		(void)close(file->laf_fd);
+		file->laf_fd = -1;
+	}
+
+	pthread_mutex_unlock(&log_async_mutex);
+
+	gsh_free(old);
+}
+
+/**
+ * @brief Get the file path a facility logs to
+ *
+ * @param[in] facility The facility
+ *
+ * @return the path or NULL if the facility does not log to a file.
+ */
+static const char *log_facility_path(struct log_facility *facility)
+{
+	if (facility->lf_func == log_to_file)
+		return facility->lf_private;
+
+	if (facility->lf_func == log_to_file_async)
+		return ((struct log_async_file *)facility->lf_private)
+			->laf_path;
+
+	return NULL;
+}
+
+/**
+ * @brief Write out everything queued
+ *
+ * Used when the process is about to go away.
+ */
+static void log_async_flush(void)
+{
+	if (!log_async_running)
+		return;
+
+	pthread_mutex_lock(&log_async_mutex);
+	(void)log_async_drain();
+	pthread_mutex_unlock(&log_async_mutex);
+}
+
+/**
+ * @brief Stop the writer thread after it writes out what is queued
+ */
+static void log_async_shutdown(void)
+{
+	pthread_mutex_lock(&log_async_mutex);
+
+	if (!log_async_running) {
+		pthread_mutex_unlock(&log_async_mutex);
+		return;
+	}
+
+	log_async_stop = true;
+	pthread_cond_signal(&log_async_cond);
+
+	pthread_mutex_unlock(&log_async_mutex);
+
+	(void)pthread_join(log_async_thread, NULL);
+
+	pthread_mutex_lock(&log_async_mutex);
+	log_async_running = false;
+	log_async_close_files();
+	pthread_mutex_unlock(&log_async_mutex);
+}
+
+/**
+ * @brief Have the log writer reopen its files
+ *
+ * Called on SIGHUP so rotated log files are let go of.
+ */
+void log_reopen_files(void)
+{
+	atomic_store_uint32_t(&log_async_reopen, 1);
+
+	pthread_mutex_lock(&log_async_mutex);
+	pthread_cond_signal(&log_async_cond);
+	pthread_mutex_unlock(&log_async_mutex);
+}
+
+static int log_to_file_async(log_header_t headers, void *private,
+			     log_levels_t level, struct display_buffer *buffer,
+			     char *compstr, char *message)
+{
+	struct log_async_file *file = private;
+	struct log_async_ring *ring = log_async_ring_get();
+	struct log_async_rec *rec;
+	uint32_t len = display_buffer_len(buffer) + 1;
+	uint64_t head = ring->lr_head;
+	uint64_t need = log_async_rec_size(len);
+	uint64_t pos, first;
+
+	if (need > LOG_ASYNC_RING_SIZE -
+			   (head - atomic_fetch_uint64_t(&ring->lr_tail))) {
+		/* The writer is behind, count it and move on */
+		(void)atomic_inc_uint64_t(&file->laf_dropped);
+		log_async_wake();
+		return -1;
+	}
+
+	/* Add newline to end of buffer, this is why LOG_BUF_EXTRA is 1 */
+	buffer->b_start[len - 1] = '\n';
+
+	rec = (struct log_async_rec *)(ring->lr_buf +
+				       (head & LOG_ASYNC_RING_MASK));
+	rec->lar_file = file;
+	rec->lar_len = len;
+
+	pos = (head + sizeof(*rec)) & LOG_ASYNC_RING_MASK;
+	first = LOG_ASYNC_RING_SIZE - pos;
+
+	if (first > len)
+		first = len;
+
+	memcpy(ring->lr_buf + pos, buffer->b_start, first);
+
+	if (first < len)
+		memcpy(ring->lr_buf, buffer->b_start + first, len - first);
+
+	/* Remove newline from buffer */
+	buffer->b_start[len - 1] = '\0';
+
+	/* Publish the record to the writer */
+	atomic_store_uint64_t(&ring->lr_head, head + need);
+
+	log_async_wake();
+
+	return 0;
+}
+
 int display_timeval(struct display_buffer *dspbuf, struct timeval *tv)
 {
 	char *fmt = date_time_fmt;
@@ -1804,6 +2459,7 @@ struct facility_config {
 	struct glist_head fac_list;
 	char *facility_name;
 	char *dest;
+	bool async;
 	enum facility_state state;
 	lf_function_t *func;
 	log_header_t headers;
@@ -2140,6 +2796,7 @@ static struct config_item facility_params[] = {
 			headers),
 	CONF_ITEM_TOKEN("enable", FAC_IDLE, enable_options, facility_config,
 			state),
+	CONF_ITEM_BOOL("async", false, facility_config, async),
 	CONFIG_EOL
 };
 
@@ -2221,7 +2878,8 @@ static int facility_commit(void *node, void *link_mem, void *self_struct,
 			if (conf->headers == NB_LH_TYPES)
 				conf->headers = LH_COMPONENT;
 		} else {
-			conf->func = log_to_file;
+			conf->func = conf->async ? log_to_file_async :
+						   log_to_file;
 			conf->lf_private = conf->dest;
 			if (conf->headers == NB_LH_TYPES)
 				conf->headers = LH_ALL;
@@ -2553,8 +3211,8 @@ void gsh_libunwind(void)
 	glist_for_each(glist, &active_facility_list)
 	{
 		facility = glist_entry(glist, struct log_facility, lf_active);
-		if (facility->lf_func == log_to_file) {
-			fd = open((char *)facility->lf_private,
+		if (log_facility_path(facility) != NULL) {
+			fd = open(log_facility_path(facility),
 				  O_WRONLY | O_APPEND | O_CREAT, log_mask);
 			break;
 		}
@@ -2638,8 +3296,8 @@ void gsh_backtrace(void)
 	glist_for_each(glist, &active_facility_list)
 	{
 		facility = glist_entry(glist, struct log_facility, lf_active);
-		if (facility->lf_func == log_to_file) {
-			fd = open((char *)facility->lf_private,
+		if (log_facility_path(facility) != NULL) {
+			fd = open(log_facility_path(facility),
 				  O_WRONLY | O_APPEND | O_CREAT, log_mask);
 			break;
 		}
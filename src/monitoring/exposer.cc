@@ -209,6 +209,14 @@ void Exposer::start(uint16_t port)
 	thread_id_ = std::thread{ server_thread, this };
 }
 
+void Exposer::set_collect_hook(std::function<void(void)> hook)
+{
+	const std::lock_guard<std::mutex> lock(mutex_);
+	if (running_)
+		PFATAL("Already running");
+	collect_hook_ = hook;
+}
+
 void Exposer::stop()
 {
 	const std::lock_guard<std::mutex> lock(mutex_);
@@ -255,6 +263,8 @@ void *Exposer::server_thread(void *arg)
 		const uint64_t start_time = now_mono_ns();
 		recv(client_fd, buffer, sizeof(buffer), 0);
 
+		if (exposer->collect_hook_)
+			exposer->collect_hook_();
 		auto families = exposer->registry_.Collect();
 		for (auto &family : families) {
 			compact_family(family);
@@ -28,6 +28,7 @@
  * @author Yoni Couriel <yonic@google.com>
  * @brief Prometheus client that exposes HTTP interface for metrics scraping.
  */
+#include <functional>
 #include <thread>
 
 #include "prometheus/registry.h"
@@ -45,6 +46,10 @@ class Exposer {
 	void start(uint16_t port);
 	void stop(void);
 
+	// Called before each scrape, used to fold sharded metrics into the
+	// registry. Must be set before start().
+	void set_collect_hook(std::function<void(void)> hook);
+
     private:
 	prometheus::Registry &registry_;
 	HistogramInt::Family &scrapingLatencies_;
@@ -55,6 +60,7 @@ class Exposer {
 	bool running_ = false;
 	std::thread thread_id_;
 	std::mutex mutex_;
+	std::function<void(void)> collect_hook_;
 
 	// Delete copy/move constructor/assignment
 	Exposer(const Exposer &) = delete;
@@ -117,6 +117,16 @@ typedef struct histogram_metric_handle {
 	void *metric;
 } histogram_metric_handle_t;
 
+/* C wrapper for the pre-resolved dynamic metrics of an NFS operation */
+typedef struct dynamic_op_metric_handle {
+	void *metric;
+} dynamic_op_metric_handle_t;
+
+/* C wrapper for the pre-resolved dynamic metrics of a client */
+typedef struct dynamic_client_metric_handle {
+	void *metric;
+} dynamic_client_metric_handle_t;
+
 #ifdef USE_MONITORING
 
 /* Registers and initializes a new static counter metric. */
@@ -166,6 +176,22 @@ void monitoring_register_export_label(export_id_t export_id, const char *label);
 /* Inits monitoring module and exposes a Prometheus-format HTTP endpoint. */
 void monitoring__init(uint16_t port, bool enable_dynamic_metrics);
 
+/* Resolves the dynamic request metrics of a {version, operation} once, so
+ * that observing a request does not build labels or take locks.
+ * Returns an empty handle if dynamic metrics are disabled. */
+dynamic_op_metric_handle_t
+monitoring__dynamic_register_nfs_op(const char *version, const char *operation);
+
+/* Resolves the per client metrics of a client once, the handle is kept with
+ * the client and released when the client goes away.
+ * Returns an empty handle if dynamic metrics are disabled or the address is
+ * empty. */
+dynamic_client_metric_handle_t
+monitoring__dynamic_register_client(const char *client_ip);
+
+void monitoring__dynamic_unregister_client(
+	dynamic_client_metric_handle_t handle);
+
 /*
  * The following two functions generate the following metrics,
  * exported both as total and per export.
@@ -179,17 +205,15 @@ void monitoring__init(uint16_t port, bool enable_dynamic_metrics);
  * - Latency in ms as histogram.
  */
 
-void monitoring__dynamic_observe_nfs_request(const char *operation,
-					     nsecs_elapsed_t request_time,
-					     const char *version,
-					     const char *status_label,
-					     export_id_t export_id,
-					     const char *client_ip);
+void monitoring__dynamic_observe_nfs_request(
+	dynamic_op_metric_handle_t handle, nsecs_elapsed_t request_time,
+	int32_t status, const char *status_label, export_id_t export_id,
+	dynamic_client_metric_handle_t client);
 
 void monitoring__dynamic_observe_nfs_io(size_t bytes_requested,
 					size_t bytes_transferred, bool success,
 					bool is_write, export_id_t export_id,
-					const char *client_ip);
+					dynamic_client_metric_handle_t client);
 
 /* MDCache hit rates. */
 void monitoring__dynamic_mdcache_cache_hit(const char *operation,
@@ -264,26 +288,39 @@ void monitoring__dynamic_mdcache_cache_miss(const char *operation,
 		UNUSED_EXPR(export_id);                    \
 		UNUSED_EXPR(label);                        \
 	})
-#define monitoring__dynamic_observe_nfs_request(                              \
-	operation, request_time, version, status_label, export_id, client_ip) \
+#define monitoring__dynamic_register_nfs_op(version, operation) \
+	({                                                      \
+		UNUSED_EXPR(version);                           \
+		UNUSED_EXPR(operation);                         \
+		(dynamic_op_metric_handle_t){ 0 };              \
+	})
+#define monitoring__dynamic_register_client(client_ip) \
+	({                                             \
+		UNUSED_EXPR(client_ip);                \
+		(dynamic_client_metric_handle_t){ 0 }; \
+	})
+#define monitoring__dynamic_unregister_client(handle) ({ UNUSED_EXPR(handle); })
+#define monitoring__dynamic_observe_nfs_request(handle, request_time, status, \
+						status_label, export_id,      \
+						client)                       \
 	({                                                                    \
-		UNUSED_EXPR(operation);                                       \
+		UNUSED_EXPR(handle);                                          \
 		UNUSED_EXPR(request_time);                                    \
-		UNUSED_EXPR(version);                                         \
+		UNUSED_EXPR(status);                                          \
 		UNUSED_EXPR(status_label);                                    \
 		UNUSED_EXPR(export_id);                                       \
-		UNUSED_EXPR(client_ip);                                       \
+		UNUSED_EXPR(client);                                          \
 	})
 #define monitoring__dynamic_observe_nfs_io(bytes_requested, bytes_transferred, \
 					   success, is_write, export_id,       \
-					   client_ip)                          \
+					   client)                             \
 	({                                                                     \
 		UNUSED_EXPR(bytes_requested);                                  \
 		UNUSED_EXPR(bytes_transferred);                                \
 		UNUSED_EXPR(success);                                          \
 		UNUSED_EXPR(is_write);                                         \
 		UNUSED_EXPR(export_id);                                        \
-		UNUSED_EXPR(client_ip);                                        \
+		UNUSED_EXPR(client);                                           \
 	})
 #define monitoring__dynamic_mdcache_cache_hit(operation, export_id) \
 	({                                                          \
@@ -22,12 +22,17 @@
 
 #include <unistd.h>
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <sstream>
 #include <string>
 #include <algorithm>
 #include <shared_mutex>
+#include <functional>
 
 #include "prometheus/counter.h"
 #include "prometheus/gauge.h"
@@ -311,6 +316,605 @@ static void toLowerCase(std::string &s)
 	std::transform(s.begin(), s.end(), s.begin(), ::tolower);
 }
 
+/*
+ * Pre-resolved dynamic request metrics.
+ *
+ * Resolving a metric through Family::Add() builds a label map and takes the
+ * family mutex, which is too expensive for every RPC. Instead, each
+ * {version, operation} pair is registered once at init time and the hot path
+ * only performs relaxed atomic adds into a per-thread shard. Status and export
+ * dimensions are resolved lazily and published with a CAS, so observing never
+ * takes a lock. The Exposer folds the shards into the Prometheus registry
+ * right before collecting.
+ */
+
+static constexpr size_t kShards = 16;
+static constexpr size_t kCacheLine = 64;
+static constexpr size_t kStatusSlots = 64;
+static constexpr size_t kExportChunkBits = 8;
+static constexpr size_t kExportChunkSize = 1 << kExportChunkBits;
+static constexpr size_t kExportChunks =
+	(UINT16_MAX + 1) / kExportChunkSize;
+
+static size_t get_shard(void)
+{
+	static std::atomic<size_t> next_shard{ 0 };
+	thread_local const size_t shard =
+		next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+	return shard;
+}
+
+// Publishes a lazily allocated object into an empty slot, or returns the
+// object that won the race.
+template <typename T, typename F>
+static T *publish(std::atomic<T *> &slot, F create)
+{
+	T *current = slot.load(std::memory_order_acquire);
+	if (current != nullptr)
+		return current;
+	T *const created = create();
+	if (slot.compare_exchange_strong(current, created,
+					 std::memory_order_acq_rel))
+		return created;
+	delete created;
+	return current;
+}
+
+// Counter accumulated in per-thread shards, folded at scrape time.
+class ShardedCounter {
+    public:
+	ShardedCounter(CounterInt::Family &family, const LabelsMap &labels)
+		: family_(family)
+		, labels_(labels)
+	{
+	}
+
+	void Increment(int64_t value = 1)
+	{
+		shards_[get_shard()].value.fetch_add(value,
+						     std::memory_order_relaxed);
+	}
+
+	// Only called from the scraping thread.
+	void Fold()
+	{
+		int64_t total = 0;
+		for (auto &shard : shards_)
+			total += shard.value.exchange(
+				0, std::memory_order_relaxed);
+		if (total == 0)
+			return;
+		if (counter_ == nullptr)
+			counter_ = &family_.Add(labels_);
+		counter_->Increment(total);
+	}
+
+	// Folds into the series of other labels from now on.
+	// Only called from the scraping thread.
+	void Relabel(const LabelsMap &labels)
+	{
+		labels_ = labels;
+		counter_ = nullptr;
+	}
+
+    private:
+	struct alignas(kCacheLine) Shard {
+		std::atomic<int64_t> value{ 0 };
+	};
+
+	CounterInt::Family &family_;
+	LabelsMap labels_;
+	CounterInt *counter_ = nullptr;
+	std::array<Shard, kShards> shards_;
+};
+
+// Histogram accumulated in per-thread shards, folded at scrape time.
+// The sum and the bucket counts of a shard are not folded atomically, so a
+// scrape may observe a sample in one and not the other until the next scrape.
+template <typename V> class ShardedHistogram {
+    public:
+	using Histogram = prometheus::Histogram<V>;
+
+	ShardedHistogram(typename Histogram::Family &family,
+			 const LabelsMap &labels,
+			 const typename Histogram::BucketBoundaries &buckets)
+		: family_(family)
+		, labels_(labels)
+		, buckets_(buckets)
+	{
+	}
+
+	void Observe(int64_t value)
+	{
+		const size_t bucket =
+			std::lower_bound(buckets_.begin(), buckets_.end(),
+					 value) -
+			buckets_.begin();
+		Shard &shard = shards_[get_shard()];
+
+		shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		shard.sum.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	// Only called from the scraping thread.
+	void Fold()
+	{
+		std::vector<V> increments(buckets_.size() + 1, 0);
+		int64_t count = 0;
+		int64_t sum = 0;
+
+		for (auto &shard : shards_) {
+			for (size_t i = 0; i < increments.size(); i++) {
+				const int64_t value = shard.buckets[i].exchange(
+					0, std::memory_order_relaxed);
+				increments[i] += value;
+				count += value;
+			}
+			sum += shard.sum.exchange(0, std::memory_order_relaxed);
+		}
+		if (count == 0)
+			return;
+		if (histogram_ == nullptr)
+			histogram_ = &family_.Add(labels_, buckets_);
+		histogram_->ObserveMultiple(increments, sum);
+	}
+
+	// Only called from the scraping thread.
+	void Relabel(const LabelsMap &labels)
+	{
+		labels_ = labels;
+		histogram_ = nullptr;
+	}
+
+    private:
+	// Enough for every boundary in latencyBuckets and requestSizeBuckets
+	// plus the +Inf bucket.
+	static constexpr size_t kMaxBuckets = 32;
+
+	struct alignas(kCacheLine) Shard {
+		std::atomic<int64_t> sum{ 0 };
+		std::array<std::atomic<int64_t>, kMaxBuckets> buckets{};
+	};
+
+	typename Histogram::Family &family_;
+	LabelsMap labels_;
+	const typename Histogram::BucketBoundaries &buckets_;
+	Histogram *histogram_ = nullptr;
+	std::array<Shard, kShards> shards_;
+};
+
+using ShardedLatencyHistogram = ShardedHistogram<double>;
+using ShardedSizeHistogram = ShardedHistogram<int64_t>;
+
+// Insert-only table of per export metrics, indexed by export id.
+template <typename T> class ExportTable {
+    public:
+	~ExportTable()
+	{
+		for (auto &chunk_slot : chunks_) {
+			Chunk *const chunk = chunk_slot.load();
+
+			if (chunk == nullptr)
+				continue;
+			for (auto &slot : chunk->exports)
+				delete slot.load();
+			delete chunk;
+		}
+	}
+
+	template <typename F> T *Get(export_id_t export_id, F create)
+	{
+		Chunk *const chunk =
+			publish(chunks_[export_id >> kExportChunkBits],
+				[]() { return new Chunk(); });
+
+		return publish(
+			chunk->exports[export_id & (kExportChunkSize - 1)],
+			create);
+	}
+
+	// Only called from the scraping thread.
+	template <typename F> void ForEach(F fn)
+	{
+		for (auto &chunk_slot : chunks_) {
+			Chunk *const chunk =
+				chunk_slot.load(std::memory_order_acquire);
+
+			if (chunk == nullptr)
+				continue;
+			for (auto &slot : chunk->exports) {
+				T *const metrics =
+					slot.load(std::memory_order_acquire);
+
+				if (metrics != nullptr)
+					fn(*metrics);
+			}
+		}
+	}
+
+    private:
+	struct Chunk {
+		std::array<std::atomic<T *>, kExportChunkSize> exports{};
+	};
+
+	std::array<std::atomic<Chunk *>, kExportChunks> chunks_{};
+};
+
+// Labels of the metrics of an export. The export label is only applied when
+// folding, so a label changed by an export update is picked up by the next
+// scrape.
+class ExportLabels {
+    public:
+	ExportLabels(const std::string &operation, export_id_t export_id)
+		: operation_(operation)
+		, export_id_(export_id)
+		, label_(GetExportLabel(export_id))
+	{
+	}
+
+	LabelsMap Labels() const
+	{
+		return { { kOperation, operation_ }, { kExport, label_ } };
+	}
+
+	// Only called from the scraping thread.
+	// @ret whether the export label changed since the last call
+	bool Refresh()
+	{
+		std::string label = GetExportLabel(export_id_);
+
+		if (label == label_)
+			return false;
+		label_ = std::move(label);
+		return true;
+	}
+
+    private:
+	const std::string operation_;
+	const export_id_t export_id_;
+	std::string label_;
+};
+
+// Metrics of one {version, operation, status}.
+struct StatusMetrics {
+	StatusMetrics(const std::string &version, const std::string &operation,
+		      int32_t status, const char *status_label)
+		: status(status)
+		, errors(dynamic_metrics->errorsByVersionOperationStatus,
+			 { { kVersion, version },
+			   { kOperation, operation },
+			   { kStatus, status_label } })
+	{
+	}
+
+	const int32_t status;
+	ShardedCounter errors;
+};
+
+// Request metrics of one {operation, export}.
+struct ExportMetrics {
+	ExportMetrics(const std::string &operation, export_id_t export_id)
+		: labels(operation, export_id)
+		, requests(dynamic_metrics->requestsTotalByOperationExport,
+			   labels.Labels())
+		, latency(dynamic_metrics->latencyByOperationExport,
+			  labels.Labels(), latencyBuckets)
+	{
+	}
+
+	// Only called from the scraping thread.
+	void Fold()
+	{
+		if (labels.Refresh()) {
+			requests.Relabel(labels.Labels());
+			latency.Relabel(labels.Labels());
+		}
+		requests.Fold();
+		latency.Fold();
+	}
+
+	ExportLabels labels;
+	ShardedCounter requests;
+	ShardedLatencyHistogram latency;
+};
+
+// Pre-resolved metrics of one {version, operation}.
+class OperationMetrics {
+    public:
+	OperationMetrics(size_t index, const char *version,
+			 const char *operation)
+		: index_(index)
+		, version_(version)
+		, operation_(operation)
+		, requests_(dynamic_metrics->requestsTotalByOperation,
+			    { { kOperation, operation_ } })
+		, latency_(dynamic_metrics->latencyByOperation,
+			   { { kOperation, operation_ } }, latencyBuckets)
+	{
+	}
+
+	~OperationMetrics()
+	{
+		for (auto &slot : statuses_)
+			delete slot.load();
+	}
+
+	size_t Index() const
+	{
+		return index_;
+	}
+
+	const std::string &Operation() const
+	{
+		return operation_;
+	}
+
+	void Observe(int64_t latency_ms, int32_t status,
+		     const char *status_label, export_id_t export_id)
+	{
+		StatusMetrics *const status_metrics =
+			GetStatus(status, status_label);
+
+		if (status_metrics != nullptr)
+			status_metrics->errors.Increment();
+		requests_.Increment();
+		latency_.Observe(latency_ms);
+
+		if (export_id == 0)
+			return;
+
+		ExportMetrics *const export_metrics =
+			exports_.Get(export_id, [&]() {
+				return new ExportMetrics(operation_, export_id);
+			});
+
+		export_metrics->requests.Increment();
+		export_metrics->latency.Observe(latency_ms);
+	}
+
+	// Only called from the scraping thread.
+	void Fold()
+	{
+		requests_.Fold();
+		latency_.Fold();
+		for (auto &slot : statuses_) {
+			StatusMetrics *const status_metrics =
+				slot.load(std::memory_order_acquire);
+
+			if (status_metrics != nullptr)
+				status_metrics->errors.Fold();
+		}
+		exports_.ForEach([](ExportMetrics &export_metrics) {
+			export_metrics.Fold();
+		});
+	}
+
+    private:
+	// Open addressed, insert-only table keyed by status code.
+	// Returns nullptr if the table is full.
+	StatusMetrics *GetStatus(int32_t status, const char *status_label)
+	{
+		for (size_t i = 0; i < kStatusSlots; i++) {
+			auto &slot = statuses_[(static_cast<uint32_t>(status) + i) %
+					       kStatusSlots];
+			StatusMetrics *const status_metrics =
+				publish(slot, [&]() {
+					return new StatusMetrics(version_,
+								 operation_,
+								 status,
+								 status_label);
+				});
+
+			if (status_metrics->status == status)
+				return status_metrics;
+		}
+		return nullptr;
+	}
+
+	const size_t index_;
+	const std::string version_;
+	const std::string operation_;
+	ShardedCounter requests_;
+	ShardedLatencyHistogram latency_;
+	std::array<std::atomic<StatusMetrics *>, kStatusSlots> statuses_{};
+	ExportTable<ExportMetrics> exports_;
+};
+
+// I/O metrics of one {operation, export}.
+struct IoExportMetrics {
+	IoExportMetrics(const std::string &operation, export_id_t export_id)
+		: labels(operation, export_id)
+		, bytesReceived(
+			  dynamic_metrics->bytesReceivedTotalByOperationExport,
+			  labels.Labels())
+		, bytesSent(dynamic_metrics->bytesSentTotalByOperationExport,
+			    labels.Labels())
+		, requestSize(dynamic_metrics->requestSizeByOperationExport,
+			      labels.Labels(), requestSizeBuckets)
+		, responseSize(dynamic_metrics->responseSizeByOperationExport,
+			       labels.Labels(), requestSizeBuckets)
+	{
+	}
+
+	void Observe(int64_t requested, int64_t received, int64_t sent)
+	{
+		bytesReceived.Increment(received);
+		bytesSent.Increment(sent);
+		requestSize.Observe(requested);
+		responseSize.Observe(sent);
+	}
+
+	// Only called from the scraping thread.
+	void Fold()
+	{
+		if (labels.Refresh()) {
+			bytesReceived.Relabel(labels.Labels());
+			bytesSent.Relabel(labels.Labels());
+			requestSize.Relabel(labels.Labels());
+			responseSize.Relabel(labels.Labels());
+		}
+		bytesReceived.Fold();
+		bytesSent.Fold();
+		requestSize.Fold();
+		responseSize.Fold();
+	}
+
+	ExportLabels labels;
+	ShardedCounter bytesReceived;
+	ShardedCounter bytesSent;
+	ShardedSizeHistogram requestSize;
+	ShardedSizeHistogram responseSize;
+};
+
+// Pre-resolved I/O metrics of READ or WRITE.
+class IoMetrics {
+    public:
+	explicit IoMetrics(const char *operation)
+		: operation_(operation)
+		, bytesReceived_(dynamic_metrics->bytesReceivedTotalByOperation,
+				 { { kOperation, operation_ } })
+		, bytesSent_(dynamic_metrics->bytesSentTotalByOperation,
+			     { { kOperation, operation_ } })
+		, requestSize_(dynamic_metrics->requestSizeByOperation,
+			       { { kOperation, operation_ } },
+			       requestSizeBuckets)
+		, responseSize_(dynamic_metrics->responseSizeByOperation,
+				{ { kOperation, operation_ } },
+				requestSizeBuckets)
+	{
+	}
+
+	void Observe(int64_t requested, int64_t received, int64_t sent,
+		     export_id_t export_id)
+	{
+		bytesReceived_.Increment(received);
+		bytesSent_.Increment(sent);
+		requestSize_.Observe(requested);
+		responseSize_.Observe(sent);
+
+		// Ignore export id 0. It's never used for actual exports, but
+		// can happen during the setup phase, or when the export id is
+		// unknown.
+		if (export_id == 0)
+			return;
+
+		exports_.Get(export_id, [&]() {
+				return new IoExportMetrics(operation_,
+							   export_id);
+			})->Observe(requested, received, sent);
+	}
+
+	// Only called from the scraping thread.
+	void Fold()
+	{
+		bytesReceived_.Fold();
+		bytesSent_.Fold();
+		requestSize_.Fold();
+		responseSize_.Fold();
+		exports_.ForEach(
+			[](IoExportMetrics &metrics) { metrics.Fold(); });
+	}
+
+    private:
+	const std::string operation_;
+	ShardedCounter bytesReceived_;
+	ShardedCounter bytesSent_;
+	ShardedSizeHistogram requestSize_;
+	ShardedSizeHistogram responseSize_;
+	ExportTable<IoExportMetrics> exports_;
+};
+
+static std::mutex operationMetricsMutex;
+static std::vector<std::unique_ptr<OperationMetrics> > operationMetrics;
+
+// Indexed by is_write.
+static std::array<std::unique_ptr<IoMetrics>, 2> ioMetrics;
+
+// Per client metrics, resolved when the client is first seen. Unlike the
+// metrics above, these are not sharded: a client is usually served by few
+// threads at a time, and sharding them would cost too much memory per client.
+class ClientMetrics {
+    public:
+	explicit ClientMetrics(const std::string &client)
+		: client_(client)
+		, lastUpdate_(dynamic_metrics->lastClientUpdate.Add(
+			  { { kClient, client } }))
+	{
+		static const char *const ioOperations[] = { "read", "write" };
+
+		for (size_t i = 0; i < 2; i++) {
+			bytesReceived_[i] =
+				&dynamic_metrics->clientBytesReceivedTotal.Add(
+					{ { kClient, client },
+					  { kOperation, ioOperations[i] } });
+			bytesSent_[i] =
+				&dynamic_metrics->clientBytesSentTotal.Add(
+					{ { kClient, client },
+					  { kOperation, ioOperations[i] } });
+		}
+
+		std::lock_guard<std::mutex> lock(operationMetricsMutex);
+		numRequests_ = operationMetrics.size();
+		requests_ = std::make_unique<std::atomic<CounterInt *>[]>(
+			numRequests_);
+	}
+
+	void ObserveRequest(const OperationMetrics &operation)
+	{
+		const size_t index = operation.Index();
+
+		if (index < numRequests_) {
+			CounterInt *counter = requests_[index].load(
+				std::memory_order_acquire);
+
+			// Family::Add() returns the same counter to racing
+			// callers, so whoever stores it last is fine.
+			if (counter == nullptr) {
+				counter = &dynamic_metrics->clientRequestsTotal.Add(
+					{ { kClient, client_ },
+					  { kOperation, operation.Operation() } });
+				requests_[index].store(
+					counter, std::memory_order_release);
+			}
+			counter->Increment();
+		}
+
+		lastUpdate_.Set(std::chrono::duration_cast<std::chrono::seconds>(
+					std::chrono::system_clock::now()
+						.time_since_epoch())
+					.count());
+	}
+
+	void ObserveIo(bool is_write, int64_t received, int64_t sent)
+	{
+		if (received != 0)
+			bytesReceived_[is_write]->Increment(received);
+		if (sent != 0)
+			bytesSent_[is_write]->Increment(sent);
+	}
+
+    private:
+	const std::string client_;
+	GaugeInt &lastUpdate_;
+	// Indexed by is_write.
+	std::array<CounterInt *, 2> bytesReceived_;
+	std::array<CounterInt *, 2> bytesSent_;
+	// Indexed by OperationMetrics::Index(), resolved on first use.
+	size_t numRequests_;
+	std::unique_ptr<std::atomic<CounterInt *>[]> requests_;
+};
+
+// Called by the Exposer right before the registry is collected.
+static void foldOperationMetrics(void)
+{
+	std::lock_guard<std::mutex> lock(operationMetricsMutex);
+
+	for (auto &operation : operationMetrics)
+		operation->Fold();
+	for (auto &io : ioMetrics)
+		io->Fold();
+}
+
 /**
  * @brief Formats full description from metadata into output buffer.
  *
@@ -456,126 +1060,75 @@ void monitoring__init(uint16_t port, bool enable_dynamic_metrics)
 	static bool initialized = false;
 	if (initialized)
 		return;
-	if (enable_dynamic_metrics)
+	if (enable_dynamic_metrics) {
 		dynamic_metrics = std::make_unique<DynamicMetrics>(registry);
+		ioMetrics[false] = std::make_unique<IoMetrics>("read");
+		ioMetrics[true] = std::make_unique<IoMetrics>("write");
+		exposer.set_collect_hook(foldOperationMetrics);
+	}
 	exposer.start(port);
 	initialized = true;
 }
 
-void monitoring__dynamic_observe_nfs_request(const char *operation,
-					     nsecs_elapsed_t request_time,
-					     const char *version,
-					     const char *status_label,
-					     export_id_t export_id,
-					     const char *client_ip)
+dynamic_op_metric_handle_t
+monitoring__dynamic_register_nfs_op(const char *version, const char *operation)
 {
 	if (!dynamic_metrics)
-		return;
-	const int64_t latency_ms = request_time / NS_PER_MSEC;
-	std::string operationLowerCase = std::string(operation);
+		return { nullptr };
+	std::string operationLowerCase(operation);
 	toLowerCase(operationLowerCase);
-	if (client_ip != NULL) {
-		std::string client(client_ip);
-		int64_t epoch =
-			std::chrono::duration_cast<std::chrono::seconds>(
-				std::chrono::system_clock::now()
-					.time_since_epoch())
-				.count();
-		client = trimIPv6Prefix(client);
-		dynamic_metrics->clientRequestsTotal
-			.Add({ { kClient, client },
-			       { kOperation, operationLowerCase } })
-			.Increment();
-		dynamic_metrics->lastClientUpdate.Add({ { kClient, client } })
-			.Set(epoch);
-	}
-	dynamic_metrics->errorsByVersionOperationStatus
-		.Add({ { kVersion, version },
-		       { kOperation, operationLowerCase },
-		       { kStatus, status_label } })
-		.Increment();
+	std::lock_guard<std::mutex> lock(operationMetricsMutex);
+	operationMetrics.emplace_back(std::make_unique<OperationMetrics>(
+		operationMetrics.size(), version, operationLowerCase.c_str()));
+	return convert_to_handle<dynamic_op_metric_handle_t>(
+		operationMetrics.back().get());
+}
 
-	// Observe metrics.
-	dynamic_metrics->requestsTotalByOperation
-		.Add({ { kOperation, operationLowerCase } })
-		.Increment();
-	dynamic_metrics->latencyByOperation
-		.Add({ { kOperation, operationLowerCase } }, latencyBuckets)
-		.Observe(latency_ms);
+dynamic_client_metric_handle_t
+monitoring__dynamic_register_client(const char *client_ip)
+{
+	if (!dynamic_metrics || client_ip == NULL || client_ip[0] == '\0')
+		return { nullptr };
+	return convert_to_handle<dynamic_client_metric_handle_t>(
+		new ClientMetrics(trimIPv6Prefix(client_ip)));
+}
 
-	if (export_id == 0) {
-		return;
-	}
+void monitoring__dynamic_unregister_client(
+	dynamic_client_metric_handle_t handle)
+{
+	delete convert_from_handle<ClientMetrics>(handle);
+}
 
-	// Observe metrics, by export.
-	const std::string exportLabel = GetExportLabel(export_id);
-	dynamic_metrics->requestsTotalByOperationExport
-		.Add({ { kOperation, operationLowerCase },
-		       { kExport, exportLabel } })
-		.Increment();
-	dynamic_metrics->latencyByOperationExport
-		.Add({ { kOperation, operationLowerCase },
-		       { kExport, exportLabel } },
-		     latencyBuckets)
-		.Observe(latency_ms);
+void monitoring__dynamic_observe_nfs_request(
+	dynamic_op_metric_handle_t handle, nsecs_elapsed_t request_time,
+	int32_t status, const char *status_label, export_id_t export_id,
+	dynamic_client_metric_handle_t client)
+{
+	if (!dynamic_metrics || handle.metric == nullptr)
+		return;
+	OperationMetrics *const operation =
+		convert_from_handle<OperationMetrics>(handle);
+	const int64_t latency_ms = request_time / NS_PER_MSEC;
+	if (client.metric != nullptr)
+		convert_from_handle<ClientMetrics>(client)->ObserveRequest(
+			*operation);
+	operation->Observe(latency_ms, status, status_label, export_id);
 }
 
 void monitoring__dynamic_observe_nfs_io(size_t bytes_requested,
 					size_t bytes_transferred, bool success,
 					bool is_write, export_id_t export_id,
-					const char *client_ip)
+					dynamic_client_metric_handle_t client)
 {
 	if (!dynamic_metrics)
 		return;
-	const std::string operation(is_write ? "write" : "read");
-	const size_t bytes_received = (is_write ? 0 : bytes_transferred);
-	const size_t bytes_sent = (is_write ? bytes_transferred : 0);
-	if (client_ip != NULL) {
-		std::string client(client_ip);
-		client = trimIPv6Prefix(client);
-		dynamic_metrics->clientBytesReceivedTotal
-			.Add({ { kClient, client }, { kOperation, operation } })
-			.Increment(bytes_received);
-		dynamic_metrics->clientBytesSentTotal
-			.Add({ { kClient, client }, { kOperation, operation } })
-			.Increment(bytes_sent);
-	}
-
-	// Observe metrics.
-	dynamic_metrics->bytesReceivedTotalByOperation
-		.Add({ { kOperation, operation } })
-		.Increment(bytes_received);
-	dynamic_metrics->bytesSentTotalByOperation
-		.Add({ { kOperation, operation } })
-		.Increment(bytes_sent);
-	dynamic_metrics->requestSizeByOperation
-		.Add({ { kOperation, operation } }, requestSizeBuckets)
-		.Observe(bytes_requested);
-	dynamic_metrics->responseSizeByOperation
-		.Add({ { kOperation, operation } }, requestSizeBuckets)
-		.Observe(bytes_sent);
-
-	// Ignore export id 0. It's never used for actual exports, but can happen
-	// during the setup phase, or when the export id is unknown.
-	if (export_id == 0)
-		return;
-
-	// Observe by export metrics.
-	const std::string exportLabel = GetExportLabel(export_id);
-	dynamic_metrics->bytesReceivedTotalByOperationExport
-		.Add({ { kOperation, operation }, { kExport, exportLabel } })
-		.Increment(bytes_received);
-	dynamic_metrics->bytesSentTotalByOperationExport
-		.Add({ { kOperation, operation }, { kExport, exportLabel } })
-		.Increment(bytes_sent);
-	dynamic_metrics->requestSizeByOperationExport
-		.Add({ { kOperation, operation }, { kExport, exportLabel } },
-		     requestSizeBuckets)
-		.Observe(bytes_requested);
-	dynamic_metrics->responseSizeByOperationExport
-		.Add({ { kOperation, operation }, { kExport, exportLabel } },
-		     requestSizeBuckets)
-		.Observe(bytes_sent);
+	const int64_t bytes_received = (is_write ? 0 : bytes_transferred);
+	const int64_t bytes_sent = (is_write ? bytes_transferred : 0);
+	if (client.metric != nullptr)
+		convert_from_handle<ClientMetrics>(client)->ObserveIo(
+			is_write, bytes_received, bytes_sent);
+	ioMetrics[is_write]->Observe(bytes_requested, bytes_received,
+				     bytes_sent, export_id);
 }
 
 void monitoring__dynamic_mdcache_cache_hit(const char *operation,
@@ -182,6 +182,10 @@ struct gsh_client *get_gsh_client(sockaddr_t *client_ipaddr, bool lookup_only)
 			   sizeof(cl->hostaddr_str))) {
 		(void)strlcpy(cl->hostaddr_str, "<unknown>",
 			      sizeof(cl->hostaddr_str));
+	} else {
+		/* Resolve the per client metrics once, not on every request */
+		cl->monitoring =
+			monitoring__dynamic_register_client(cl->hostaddr_str);
 	}
 
 	LogDebug(COMPONENT_HASHTABLE,
@@ -191,7 +195,9 @@ struct gsh_client *get_gsh_client(sockaddr_t *client_ipaddr, bool lookup_only)
 	PTHREAD_RWLOCK_wrlock(&client_by_ip.cip_lock);
 	node = avltree_insert(&cl->node_k, &client_by_ip.t);
 	if (node) {
-		gsh_free(server_st); /* somebody beat us to it */
+		/* somebody beat us to it */
+		monitoring__dynamic_unregister_client(cl->monitoring);
+		gsh_free(server_st);
 		cl = avltree_container_of(node, struct gsh_client, node_k);
 	} else {
 		PTHREAD_RWLOCK_init(&cl->client_lock, NULL);
@@ -269,6 +275,7 @@ out:
 		server_stats_free(&server_st->st);
 		server_stats_allops_free(&server_st->c_all);
 		connection_manager__client_fini(&cl->connection_manager);
+		monitoring__dynamic_unregister_client(cl->monitoring);
 		PTHREAD_RWLOCK_destroy(&cl->client_lock);
 		gsh_free(server_st);
 	}
@@ -1511,6 +1518,152 @@ out:
 	return errcnt;
 }
 
+/**
+ * @brief Per call state shared by the checks of one client lookup
+ *
+ * The host prefix, the printable address and the host name are only
+ * computed once, the first time an entry needs them.
+ */
+struct client_match_state {
+	sockaddr_t *hostaddr;
+	CIDR *host_prefix;
+	int ipvalid; /* -1 need to print, 0 - invalid, 1 - ok */
+	bool have_name; /* name lookup has been done */
+	bool name_ok; /* hostname is valid */
+	bool used_name; /* result depends on the name lookup */
+	char hostname[NI_MAXHOST];
+	char ipstring[SOCK_NAME_MAX];
+};
+
+/**
+ * @brief Look up the host name of the address being matched
+ *
+ * @param[in,out] st  Match state
+ *
+ * @return true if st->hostname holds the host name.
+ */
+static bool client_match_name(struct client_match_state *st)
+{
+	int rc;
+
+	st->used_name = true;
+
+	if (st->have_name)
+		return st->name_ok;
+
+	/* Try to get the entry from th IP/name cache */
+	rc = nfs_ip_name_get(st->hostaddr, st->hostname, sizeof(st->hostname));
+
+	if (rc == IP_NAME_NOT_FOUND) {
+		/* IPaddr was not cached, add it to the cache */
+
+		/** @todo this change from 1.5 is not IPv6
+		 * useful.  come back to this and use the
+		 * string from client mgr inside op_context...
+		 */
+		rc = nfs_ip_name_add(st->hostaddr, st->hostname,
+				     sizeof(st->hostname));
+	}
+
+	st->have_name = true;
+	st->name_ok = rc == IP_NAME_SUCCESS;
+
+	return st->name_ok;
+}
+
+/**
+ * @brief Check a single client list entry against an address
+ *
+ * @param[in]     component  Component to log to
+ * @param[in]     client     Client entry to check
+ * @param[in,out] st         Match state
+ *
+ * @return true if the entry matches.
+ */
+static bool client_match_entry(enum log_components component,
+			       struct base_client_entry *client,
+			       struct client_match_state *st)
+{
+	LogMidDebug_ClientListEntry(component, "Match V4: ", client);
+
+	switch (client->type) {
+	case NETWORK_CLIENT:
+		if (st->host_prefix == NULL) {
+			if (st->hostaddr->ss_family == AF_INET6) {
+				st->host_prefix = cidr_from_in6addr(
+					&((struct sockaddr_in6 *)st->hostaddr)
+						 ->sin6_addr);
+			} else {
+				st->host_prefix = cidr_from_inaddr(
+					&((struct sockaddr_in *)st->hostaddr)
+						 ->sin_addr);
+			}
+		}
+
+		return cidr_contains(client->client.network.cidr,
+				     st->host_prefix) == 0;
+
+	case NETGROUP_CLIENT:
+		if (!client_match_name(st))
+			return false; /* Fatal failure */
+
+		/* At this point 'hostname' should contain the
+		 * name that was found
+		 */
+		return ng_innetgr(client->client.netgroup.netgroupname,
+				  st->hostname);
+
+	case WILDCARDHOST_CLIENT:
+		/* Now checking for IP wildcards */
+		if (st->ipvalid < 0)
+			st->ipvalid = sprint_sockip(st->hostaddr, st->ipstring,
+						    sizeof(st->ipstring));
+
+		if (st->ipvalid &&
+		    (fnmatch(client->client.wildcard.wildcard, st->ipstring,
+			     FNM_PATHNAME) == 0)) {
+			return true;
+		}
+
+		if (!client_match_name(st))
+			return false;
+
+		/* At this point 'hostname' should contain the
+		 * name that was found
+		 */
+		return fnmatch(client->client.wildcard.wildcard, st->hostname,
+			       FNM_PATHNAME) == 0;
+
+	case GSSPRINCIPAL_CLIENT:
+		/** @todo BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
+		LogCrit(COMPONENT_EXPORT,
+			"Unsupported type GSS_PRINCIPAL_CLIENT");
+		return false;
+
+	case MATCH_ANY_CLIENT:
+		return true;
+
+	case BAD_CLIENT:
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Log the address about to be matched
+ */
+static void client_match_log(enum log_components component, const char *str,
+			     sockaddr_t *hostaddr)
+{
+	char ipstring[SOCK_NAME_MAX];
+	struct display_buffer dspbuf = { sizeof(ipstring), ipstring, ipstring };
+
+	display_sockip(&dspbuf, hostaddr);
+
+	LogMidDebug(component, "Check for address %s%s", ipstring,
+		    str ? str : "");
+}
+
 /**
  * @brief Match a specific client in a client list
  *
@@ -1524,139 +1677,448 @@ struct base_client_entry *client_match(enum log_components component,
 				       struct glist_head *clients)
 {
 	struct glist_head *glist;
-	int rc;
-	int ipvalid = -1; /* -1 need to print, 0 - invalid, 1 - ok */
-	char hostname[NI_MAXHOST];
-	char ipstring[SOCK_NAME_MAX];
-	CIDR *host_prefix = NULL;
 	struct base_client_entry *client;
 	sockaddr_t alt_hostaddr;
-	sockaddr_t *hostaddr = NULL;
+	struct client_match_state st = { .ipvalid = -1 };
 
-	hostaddr = convert_ipv6_to_ipv4(clientaddr, &alt_hostaddr);
+	st.hostaddr = convert_ipv6_to_ipv4(clientaddr, &alt_hostaddr);
 
-	if (isMidDebug(component)) {
-		char ipstring[SOCK_NAME_MAX];
-		struct display_buffer dspbuf = { sizeof(ipstring), ipstring,
-						 ipstring };
+	if (isMidDebug(component))
+		client_match_log(component, str, st.hostaddr);
 
-		display_sockip(&dspbuf, hostaddr);
+	glist_for_each(glist, clients)
+	{
+		client = glist_entry(glist, struct base_client_entry, cle_list);
 
-		LogMidDebug(component, "Check for address %s%s", ipstring,
-			    str ? str : "");
+		if (client_match_entry(component, client, &st))
+			goto out;
 	}
 
+	client = NULL;
+
+out:
+
+	if (st.host_prefix != NULL)
+		cidr_free(st.host_prefix);
+
+	return client;
+}
+
+/**
+ * @page ClientIndex Compiled client lists
+ *
+ * An export's client list is matched first-entry-wins, in list order.
+ * client_match() does that by walking the list, which gets expensive
+ * for exports with hundreds of entries since it runs for every request.
+ *
+ * client_match_index() instead compiles the list, on first use, into a
+ * struct client_list_index.  Network (CIDR) entries go into a binary
+ * prefix trie per address family, each trie node remembering the
+ * lowest list position of the prefixes ending there, so one walk down
+ * the trie gives the first network entry matching an address.  The
+ * remaining entries (netgroups, wildcards, anything else) are kept in
+ * list order and only those placed before that network entry are
+ * checked one by one.
+ *
+ * The outcome is then remembered per client address in a small direct
+ * mapped decision cache inside the index.  Slots are guarded by a
+ * sequence count so readers never block; a writer that loses the race
+ * for a slot simply does not cache its result.  Decisions that needed
+ * the client's host name expire with the IP/name cache or the netgroup
+ * cache, whichever is sooner, and are dropped as soon as either cache is
+ * purged; all others live as long as the index.
+ *
+ * The index is immutable once built, and is discarded by whoever
+ * replaces or frees the client list, under the lock protecting it.
+ */
+
+#define CLIENT_NO_MATCH UINT32_MAX
+#define CLIENT_INDEX_MAX_POS 0x00ffffff
+#define CLIENT_CACHE_BITS 8
+#define CLIENT_CACHE_SIZE (1 << CLIENT_CACHE_BITS)
+
+struct client_trie_node {
+	uint32_t child[2]; /*< Child node, 0 for none */
+	uint32_t first; /*< First list position of a prefix ending here */
+};
+
+struct client_cache_slot {
+	uint64_t seq; /*< Odd while being written, 0 if never written */
+	uint64_t addr[2];
+	uint64_t val; /*< expiry << 32 | family << 24 | (position + 1) */
+	uint64_t names_gen; /*< client_names_gen the decision was made in */
+};
+
+/* Bumped whenever host names or netgroups may have changed, invalidating
+ * every cached decision that depended on them.
+ */
+static uint64_t client_names_gen;
+
+struct client_list_index {
+	struct base_client_entry **entries; /*< Entries in list order */
+	uint32_t *others; /*< Positions of entries checked one by one */
+	struct client_trie_node *nodes; /*< Node 0 is IPv4, 1 is IPv6 */
+	uint32_t nentries;
+	uint32_t nothers;
+	uint32_t nnodes;
+	time_t created;
+	struct client_cache_slot cache[CLIENT_CACHE_SIZE];
+};
+
+static inline int client_index_root(int proto)
+{
+	return proto == CIDR_IPV4 ? 0 : 1;
+}
+
+/**
+ * @brief Compile a client list
+ *
+ * @param[in] clients  Client list, must not change while the index lives
+ *
+ * @return the new index.
+ */
+struct client_list_index *client_list_index_build(struct glist_head *clients)
+{
+	struct client_list_index *cidx;
+	struct glist_head *glist;
+	struct base_client_entry *client;
+	size_t maxnodes = 2;
+	uint32_t pos = 0;
+
+	cidx = gsh_calloc(1, sizeof(*cidx));
+	cidx->created = time(NULL);
+
 	glist_for_each(glist, clients)
 	{
 		client = glist_entry(glist, struct base_client_entry, cle_list);
-		LogMidDebug_ClientListEntry(component, "Match V4: ", client);
+		cidx->nentries++;
 
-		switch (client->type) {
-		case NETWORK_CLIENT:
-			if (host_prefix == NULL) {
-				if (hostaddr->ss_family == AF_INET6) {
-					host_prefix = cidr_from_in6addr(
-						&((struct sockaddr_in6 *)
-							  hostaddr)
-							 ->sin6_addr);
-				} else {
-					host_prefix = cidr_from_inaddr(
-						&((struct sockaddr_in *)hostaddr)
-							 ->sin_addr);
-				}
-			}
+		if (client->type == NETWORK_CLIENT)
+			maxnodes += 128;
+	}
 
-			if (cidr_contains(client->client.network.cidr,
-					  host_prefix) == 0) {
-				goto out;
-			}
-			break;
+	cidx->entries = gsh_calloc(cidx->nentries + 1, sizeof(*cidx->entries));
+	cidx->others = gsh_calloc(cidx->nentries + 1, sizeof(*cidx->others));
+	cidx->nodes = gsh_calloc(maxnodes, sizeof(*cidx->nodes));
+	cidx->nodes[0].first = CLIENT_NO_MATCH;
+	cidx->nodes[1].first = CLIENT_NO_MATCH;
+	cidx->nnodes = 2;
 
-		case NETGROUP_CLIENT:
-			/* Try to get the entry from th IP/name cache */
-			rc = nfs_ip_name_get(hostaddr, hostname,
-					     sizeof(hostname));
-
-			if (rc == IP_NAME_NOT_FOUND) {
-				/* IPaddr was not cached, add it to the cache */
-				rc = nfs_ip_name_add(hostaddr, hostname,
-						     sizeof(hostname));
-			}
+	glist_for_each(glist, clients)
+	{
+		CIDR *cidr;
+		int pflen, start, i;
+		uint32_t node;
 
-			if (rc != IP_NAME_SUCCESS)
-				break; /* Fatal failure */
+		client = glist_entry(glist, struct base_client_entry, cle_list);
+		cidx->entries[pos] = client;
 
-			/* At this point 'hostname' should contain the
-			 * name that was found
-			 */
-			if (ng_innetgr(client->client.netgroup.netgroupname,
-				       hostname)) {
-				goto out;
-			}
-			break;
+		if (client->type != NETWORK_CLIENT) {
+			cidx->others[cidx->nothers++] = pos++;
+			continue;
+		}
 
-		case WILDCARDHOST_CLIENT:
-			/* Now checking for IP wildcards */
-			if (ipvalid < 0)
-				ipvalid = sprint_sockip(hostaddr, ipstring,
-							sizeof(ipstring));
-
-			if (ipvalid &&
-			    (fnmatch(client->client.wildcard.wildcard, ipstring,
-				     FNM_PATHNAME) == 0)) {
-				goto out;
-			}
+		cidr = client->client.network.cidr;
+		pflen = cidr_get_pflen(cidr);
 
-			/* Try to get the entry from th IP/name cache */
-			rc = nfs_ip_name_get(hostaddr, hostname,
-					     sizeof(hostname));
+		if (pflen < 0 || (cidr->proto != CIDR_IPV4 &&
+				  cidr->proto != CIDR_IPV6)) {
+			/* Not a plain prefix, leave it to cidr_contains() */
+			cidx->others[cidx->nothers++] = pos++;
+			continue;
+		}
 
-			if (rc == IP_NAME_NOT_FOUND) {
-				/* IPaddr was not cached, add it to the cache */
+		/* IPv4 addresses live in the last 4 bytes of a CIDR */
+		start = cidr->proto == CIDR_IPV4 ? 96 : 0;
+		node = client_index_root(cidr->proto);
 
-				/** @todo this change from 1.5 is not IPv6
-				 * useful.  come back to this and use the
-				 * string from client mgr inside op_context...
-				 */
-				rc = nfs_ip_name_add(hostaddr, hostname,
-						     sizeof(hostname));
+		for (i = start; i < start + pflen; i++) {
+			int bit = (cidr->addr[i / 8] >> (7 - (i % 8))) & 1;
+
+			if (cidx->nodes[node].child[bit] == 0) {
+				cidx->nodes[cidx->nnodes].first =
+					CLIENT_NO_MATCH;
+				cidx->nodes[node].child[bit] = cidx->nnodes++;
 			}
 
-			if (rc != IP_NAME_SUCCESS)
-				break;
+			node = cidx->nodes[node].child[bit];
+		}
 
-			/* At this point 'hostname' should contain the
-			 * name that was found
-			 */
-			if (fnmatch(client->client.wildcard.wildcard, hostname,
-				    FNM_PATHNAME) == 0) {
-				goto out;
-			}
-			break;
+		/* Entries are visited in list order, so the first one to
+		 * land on a node is the one that wins there.
+		 */
+		if (cidx->nodes[node].first == CLIENT_NO_MATCH)
+			cidx->nodes[node].first = pos;
 
-		case GSSPRINCIPAL_CLIENT:
-			/** @todo BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
-			LogCrit(COMPONENT_EXPORT,
-				"Unsupported type GSS_PRINCIPAL_CLIENT");
+		pos++;
+	}
+
+	LogDebug(COMPONENT_EXPORT,
+		 "Compiled %" PRIu32 " clients, %" PRIu32
+		 " trie nodes, %" PRIu32 " checked in order",
+		 cidx->nentries, cidx->nnodes, cidx->nothers);
+
+	return cidx;
+}
+
+/**
+ * @brief Free a compiled client list
+ *
+ * @param[in] cidx  Index to free, may be NULL
+ */
+void client_list_index_free(struct client_list_index *cidx)
+{
+	if (cidx == NULL)
+		return;
+
+	gsh_free(cidx->entries);
+	gsh_free(cidx->others);
+	gsh_free(cidx->nodes);
+	gsh_free(cidx);
+}
+
+/**
+ * @brief Forget every cached decision made with a host name
+ *
+ * Called when the IP/name or the netgroup cache drops entries.
+ */
+void client_list_index_purge_names(void)
+{
+	atomic_inc_uint64_t(&client_names_gen);
+}
+
+/**
+ * @brief Find the first matching list position for an address
+ *
+ * @param[in]     component  Component to log to
+ * @param[in]     cidx       Compiled client list
+ * @param[in]     addr       Address bytes, network order
+ * @param[in]     proto      CIDR_IPV4 or CIDR_IPV6
+ * @param[in,out] st         Match state
+ *
+ * @return the list position or CLIENT_NO_MATCH.
+ */
+static uint32_t client_index_lookup(enum log_components component,
+				    struct client_list_index *cidx,
+				    const uint8_t *addr, int proto,
+				    struct client_match_state *st)
+{
+	uint32_t node = client_index_root(proto);
+	uint32_t best = cidx->nodes[node].first;
+	int bits = proto == CIDR_IPV4 ? 32 : 128;
+	uint32_t i;
+	int b;
+
+	for (b = 0; b < bits; b++) {
+		node = cidx->nodes[node].child[(addr[b / 8] >> (7 - (b % 8))) &
+						1];
+		if (node == 0)
 			break;
 
-		case MATCH_ANY_CLIENT:
-			goto out;
+		if (cidx->nodes[node].first < best)
+			best = cidx->nodes[node].first;
+	}
 
-		case BAD_CLIENT:
-		default:
-			continue;
+	for (i = 0; i < cidx->nothers && cidx->others[i] < best; i++) {
+		if (client_match_entry(component,
+				       cidx->entries[cidx->others[i]], st))
+			return cidx->others[i];
+	}
+
+	return best;
+}
+
+static inline struct client_cache_slot *
+client_cache_slot(struct client_list_index *cidx, const uint64_t *key)
+{
+	uint64_t h = (key[0] ^ key[1]) * 0x9E3779B97F4A7C15ULL;
+
+	return &cidx->cache[h >> (64 - CLIENT_CACHE_BITS)];
+}
+
+/**
+ * @brief Look up a cached decision
+ *
+ * @param[in]  cidx   Compiled client list
+ * @param[in]  key    Client address
+ * @param[in]  proto  CIDR_IPV4 or CIDR_IPV6
+ * @param[out] pos    Cached list position or CLIENT_NO_MATCH
+ *
+ * @return true if a valid decision was found.
+ */
+static bool client_cache_get(struct client_list_index *cidx,
+			     const uint64_t *key, int proto, uint32_t *pos)
+{
+	struct client_cache_slot *slot = client_cache_slot(cidx, key);
+	uint64_t seq, a0, a1, val, gen, expiry;
+
+	seq = atomic_fetch_uint64_t(&slot->seq);
+
+	if (seq == 0 || (seq & 1) != 0)
+		return false;
+
+	a0 = atomic_fetch_uint64_t(&slot->addr[0]);
+	a1 = atomic_fetch_uint64_t(&slot->addr[1]);
+	val = atomic_fetch_uint64_t(&slot->val);
+	gen = atomic_fetch_uint64_t(&slot->names_gen);
+
+	if (atomic_fetch_uint64_t(&slot->seq) != seq)
+		return false;
+
+	if (a0 != key[0] || a1 != key[1] || ((val >> 24) & 0xff) != proto)
+		return false;
+
+	expiry = val >> 32;
+
+	/* Only decisions made with a host name expire */
+	if (expiry != 0 &&
+	    (time(NULL) >= cidx->created + (time_t)expiry ||
+	     gen != atomic_fetch_uint64_t(&client_names_gen)))
+		return false;
+
+	*pos = (uint32_t)(val & CLIENT_INDEX_MAX_POS) - 1;
+	return true;
+}
+
+/**
+ * @brief Remember a decision
+ *
+ * @param[in] cidx   Compiled client list
+ * @param[in] key    Client address
+ * @param[in] proto  CIDR_IPV4 or CIDR_IPV6
+ * @param[in] pos    List position or CLIENT_NO_MATCH
+ * @param[in] ttl    Seconds the decision is valid, 0 for ever
+ * @param[in] gen    client_names_gen before the decision was made
+ */
+static void client_cache_put(struct client_list_index *cidx,
+			     const uint64_t *key, int proto, uint32_t pos,
+			     uint32_t ttl, uint64_t gen)
+{
+	struct client_cache_slot *slot = client_cache_slot(cidx, key);
+	uint64_t seq, expiry = 0;
+
+	if (ttl != 0)
+		expiry = time(NULL) - cidx->created + ttl;
+
+	if (expiry > UINT32_MAX)
+		return;
+
+	seq = atomic_fetch_uint64_t(&slot->seq);
+
+	if ((seq & 1) != 0 ||
+	    !__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		return;
+
+	atomic_store_uint64_t(&slot->addr[0], key[0]);
+	atomic_store_uint64_t(&slot->addr[1], key[1]);
+	atomic_store_uint64_t(&slot->names_gen, gen);
+	atomic_store_uint64_t(&slot->val,
+			      expiry << 32 | (uint64_t)proto << 24 |
+				      ((pos + 1) & CLIENT_INDEX_MAX_POS));
+	atomic_store_uint64_t(&slot->seq, seq + 2);
+}
+
+/**
+ * @brief Match a client using a compiled client list
+ *
+ * Returns the same entry client_match() would.  The index is built on
+ * first use and published in *indexp; the caller must hold the lock
+ * protecting @a clients, and whoever changes the list under that lock
+ * must discard the index with client_list_index_free().
+ *
+ * @param[in]     component  Component to log to
+ * @param[in]     str        Extra string for the debug log
+ * @param[in]     clientaddr Host to search for
+ * @param[in]     clients    Client list to search
+ * @param[in,out] indexp     Compiled form of @a clients
+ *
+ * @return the client entry or NULL if failure.
+ */
+struct base_client_entry *client_match_index(enum log_components component,
+					     const char *str,
+					     sockaddr_t *clientaddr,
+					     struct glist_head *clients,
+					     struct client_list_index **indexp)
+{
+	struct client_list_index *cidx;
+	sockaddr_t alt_hostaddr;
+	sockaddr_t *hostaddr;
+	struct client_match_state st = { .ipvalid = -1 };
+	uint64_t key[2] = { 0, 0 };
+	uint64_t names_gen;
+	const uint8_t *addr;
+	uint32_t pos, ttl;
+	int proto;
+
+	hostaddr = convert_ipv6_to_ipv4(clientaddr, &alt_hostaddr);
+
+	if (hostaddr->ss_family == AF_INET) {
+		struct in_addr *in =
+			&((struct sockaddr_in *)hostaddr)->sin_addr;
+
+		proto = CIDR_IPV4;
+		addr = (const uint8_t *)in;
+		memcpy(&key[1], in, sizeof(*in));
+	} else if (hostaddr->ss_family == AF_INET6) {
+		struct in6_addr *in6 =
+			&((struct sockaddr_in6 *)hostaddr)->sin6_addr;
+
+		proto = CIDR_IPV6;
+		addr = (const uint8_t *)in6;
+		memcpy(key, in6, sizeof(*in6));
+	} else {
+		/* Nothing to index on, e.g. vsock */
+		return client_match(component, str, clientaddr, clients);
+	}
+
+	cidx = atomic_fetch_voidptr((void **)indexp);
+
+	if (cidx == NULL) {
+		struct client_list_index *cur = NULL;
+
+		cidx = client_list_index_build(clients);
+
+		if (!__atomic_compare_exchange_n(indexp, &cur, cidx, false,
+						 __ATOMIC_SEQ_CST,
+						 __ATOMIC_SEQ_CST)) {
+			/* Someone else got there first */
+			client_list_index_free(cidx);
+			cidx = cur;
 		}
 	}
 
-	client = NULL;
+	if (isMidDebug(component))
+		client_match_log(component, str, hostaddr);
 
-out:
+	if (client_cache_get(cidx, key, proto, &pos)) {
+		LogMidDebug(component, "Cached decision %s",
+			    pos == CLIENT_NO_MATCH ? "no match" : "match");
+		goto out;
+	}
+
+	/* Read before the names are looked up, so a purge racing with the
+	 * lookup leaves an already stale decision.
+	 */
+	names_gen = atomic_fetch_uint64_t(&client_names_gen);
 
-	if (host_prefix != NULL)
-		cidr_free(host_prefix);
+	st.hostaddr = hostaddr;
+	pos = client_index_lookup(component, cidx, addr, proto, &st);
 
-	return client;
+	if (st.host_prefix != NULL)
+		cidr_free(st.host_prefix);
+
+	/* A decision made with a host name may be based on netgroup or
+	 * IP/name cache entries, don't keep it longer than either.
+	 */
+	ttl = st.used_name ? MIN(expiration_time, NG_CACHE_EXPIRATION) : 0;
+
+	if (cidx->nentries <= CLIENT_INDEX_MAX_POS &&
+	    (!st.used_name || ttl != 0))
+		client_cache_put(cidx, key, proto, pos, ttl, names_gen);
+
+out:
+	return pos == CLIENT_NO_MATCH ? NULL : cidx->entries[pos];
 }
 
 bool haproxy_match(SVCXPRT *xprt)
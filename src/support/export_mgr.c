@@ -704,6 +704,7 @@ void _put_gsh_export(struct gsh_export *export, bool config, char *file,
 {
 	int64_t refcount = atomic_dec_int64_t(&export->refcnt);
 	struct export_stats *export_st;
+	int i;
 
 	assert(refcount >= 0);
 
@@ -729,6 +730,8 @@ void _put_gsh_export(struct gsh_export *export, bool config, char *file,
 	free_export_resources(export, config);
 	export_st = container_of(export, struct export_stats, export);
 	server_stats_free(&export_st->st);
+	for (i = 0; i < SERVER_STATS_SHARDS; i++)
+		server_stats_free(&export_st->shards[i]);
 	PTHREAD_RWLOCK_destroy(&export->exp_lock);
 	gsh_free(export_st);
 }
@@ -1529,6 +1532,7 @@ static bool export_to_dbus(struct gsh_export *exp_node, void *state)
 	tmp_put_exp_paths(&tmp);
 
 	exp = container_of(exp_node, struct export_stats, export);
+	server_stats_fold_export(exp);
 
 	dbus_message_iter_open_container(&iter_state->export_iter,
 					 DBUS_TYPE_STRUCT, NULL, &struct_iter);
@@ -1612,6 +1616,8 @@ void reset_export_stats(void)
 	{
 		export = glist_entry(glist, struct gsh_export, exp_list);
 		exp = container_of(export, struct export_stats, export);
+		/* Fold the shards first so that their counts are reset too */
+		server_stats_fold_export(exp);
 		reset_gsh_stats(&exp->st);
 	}
 	PTHREAD_RWLOCK_unlock(&export_by_id.eid_lock);
@@ -1833,6 +1839,7 @@ static bool get_nfsv3_export_io(DBusMessageIter *args, DBusMessage *reply,
 		errormsg = "No export available";
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st.nfsv3 == NULL) {
 			success = false;
 			errormsg = "Export does not have any NFSv3 activity";
@@ -1877,6 +1884,7 @@ static bool get_nfsv40_export_io(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st.nfsv40 == NULL) {
 			success = false;
 			errormsg = "Export does not have any NFSv4.0 activity";
@@ -1920,6 +1928,7 @@ static bool get_nfsv41_export_io(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st.nfsv41 == NULL) {
 			success = false;
 			errormsg = "Export does not have any NFSv4.1 activity";
@@ -1963,6 +1972,7 @@ static bool get_nfsv41_export_layouts(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st.nfsv41 == NULL) {
 			success = false;
 			errormsg = "Export does not have any NFSv4.1 activity";
@@ -1999,6 +2009,7 @@ static bool get_nfsv42_export_io(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st.nfsv42 == NULL) {
 			success = false;
 			errormsg = "Export does not have any NFSv4.2 activity";
@@ -2042,6 +2053,7 @@ static bool get_nfsv42_export_layouts(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st.nfsv42 == NULL) {
 			success = false;
 			errormsg = "Export does not have any NFSv4.2 activity";
@@ -2743,6 +2755,7 @@ static bool get_9p_export_io(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st._9p == NULL) {
 			success = false;
 			errormsg = "Export does not have any 9p activity";
@@ -2784,6 +2797,7 @@ static bool get_9p_export_op_stats(DBusMessageIter *args, DBusMessage *reply,
 		success = false;
 	} else {
 		export_st = container_of(export, struct export_stats, export);
+		server_stats_fold_export(export_st);
 		if (export_st->st._9p == NULL) {
 			success = false;
 			errormsg = "Export does not have any 9p activity";
@@ -887,6 +887,8 @@ static inline void copy_gsh_export(struct gsh_export *dest,
 		     src->clients.prev);
 
 	glist_swap_lists(&dest->clients, &src->clients);
+	client_list_index_free(dest->clients_index);
+	dest->clients_index = NULL;
 
 	PTHREAD_RWLOCK_unlock(&dest->exp_lock);
 }
@@ -1645,6 +1647,8 @@ static int export_defaults_commit(void *node, void *link_mem, void *self_struct,
 		     export_opt_cfg.clients.next, export_opt_cfg.clients.prev);
 
 	glist_swap_lists(&export_opt.clients, &export_opt_cfg.clients);
+	client_list_index_free(export_opt.clients_index);
+	export_opt.clients_index = NULL;
 
 	PTHREAD_RWLOCK_unlock(&export_opt_lock);
 
@@ -2613,6 +2617,8 @@ void free_export_resources(struct gsh_export *export, bool config)
 	LogDebug(COMPONENT_EXPORT, "release_export complete");
 
 	FreeClientList(&export->clients, FreeExportClient);
+	client_list_index_free(export->clients_index);
+	export->clients_index = NULL;
 	if (export->fsal_export != NULL) {
 		struct fsal_module *fsal = export->fsal_export->fsal;
 
@@ -3190,13 +3196,16 @@ void export_check_access(void)
 		/* No client list so use the export defaults client list to
 		 * see if there's a match.
 		 */
-		client = client_match(COMPONENT_EXPORT, exp_str,
-				      op_ctx->caller_addr, &export_opt.clients);
+		client = client_match_index(COMPONENT_EXPORT, exp_str,
+					    op_ctx->caller_addr,
+					    &export_opt.clients,
+					    &export_opt.clients_index);
 	} else {
 		/* Does the client match anyone on the client list? */
-		client = client_match(COMPONENT_EXPORT, exp_str,
-				      op_ctx->caller_addr,
-				      &op_ctx->ctx_export->clients);
+		client = client_match_index(
+			COMPONENT_EXPORT, exp_str, op_ctx->caller_addr,
+			&op_ctx->ctx_export->clients,
+			&op_ctx->ctx_export->clients_index);
 	}
 
 	if (client != NULL) {
@@ -0,0 +1,274 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file io_buf_pool.c
+ * @brief Pool of page aligned I/O payload buffers
+ *
+ * Large buffers come from mmap in malloc, so allocating and freeing an
+ * rsize buffer per READ means an mmap, page faults on first touch and a
+ * munmap for every request.  The pool keeps the buffers around instead.
+ *
+ * Each thread caches a few buffers of each class, bounded so the thread
+ * holds about IO_BUF_THREAD_BYTES per class.  Buffers that do not fit in
+ * the releasing thread's cache go to the per class depot, and past the
+ * depot limit they are freed.  A thread's cache is handed to the depot
+ * when the thread exits.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include "abstract_mem.h"
+#include "gsh_intrinsic.h"
+#include "common_utils.h"
+#include "log.h"
+#include "io_buf_pool.h"
+
+/** Smallest class is one page */
+#define IO_BUF_MIN_SHIFT 12
+/** Largest class is 2 MiB, above that buffers are not pooled */
+#define IO_BUF_MAX_SHIFT 21
+#define IO_BUF_CLASSES (IO_BUF_MAX_SHIFT - IO_BUF_MIN_SHIFT + 1)
+
+/** How much each thread keeps per class, at least one buffer */
+#define IO_BUF_THREAD_BYTES (2 * 1024 * 1024)
+/** Most buffers a thread keeps per class */
+#define IO_BUF_THREAD_MAX 16
+/** How much the depot keeps per class */
+#define IO_BUF_DEPOT_BYTES (64 * 1024 * 1024)
+
+struct io_buf_cache {
+	struct io_buf *ibc_head;
+	uint32_t ibc_count;
+};
+
+struct io_buf_depot {
+	pthread_mutex_t ibd_mutex;
+	struct io_buf *ibd_head;
+	uint32_t ibd_count;
+	uint32_t ibd_max;
+};
+
+static struct io_buf_depot io_buf_depots[IO_BUF_CLASSES];
+static pthread_once_t io_buf_once = PTHREAD_ONCE_INIT;
+static pthread_key_t io_buf_key;
+
+static __thread struct io_buf_cache *io_buf_caches;
+
+static inline size_t io_buf_class_size(int class)
+{
+	return (size_t)1 << (class + IO_BUF_MIN_SHIFT);
+}
+
+static inline uint32_t io_buf_thread_max(int class)
+{
+	size_t max = IO_BUF_THREAD_BYTES / io_buf_class_size(class);
+
+	if (max < 1)
+		return 1;
+
+	return max > IO_BUF_THREAD_MAX ? IO_BUF_THREAD_MAX : max;
+}
+
+/**
+ * @brief Find the class for a size
+ *
+ * @param[in] size Requested size
+ *
+ * @return the class or IO_BUF_NO_CLASS if too big to pool.
+ */
+static inline int io_buf_size_class(size_t size)
+{
+	int class = 0;
+
+	if (size > io_buf_class_size(IO_BUF_CLASSES - 1))
+		return IO_BUF_NO_CLASS;
+
+	while (io_buf_class_size(class) < size)
+		class++;
+
+	return class;
+}
+
+static void io_buf_free(struct io_buf *buf)
+{
+	gsh_free(buf->ib_base);
+	gsh_free(buf);
+}
+
+/**
+ * @brief Put a buffer in the depot, or free it if the depot is full
+ */
+static void io_buf_depot_put(struct io_buf *buf)
+{
+	struct io_buf_depot *depot = &io_buf_depots[buf->ib_class];
+
+	PTHREAD_MUTEX_lock(&depot->ibd_mutex);
+
+	if (depot->ibd_count < depot->ibd_max) {
+		buf->ib_next = depot->ibd_head;
+		depot->ibd_head = buf;
+		depot->ibd_count++;
+		buf = NULL;
+	}
+
+	PTHREAD_MUTEX_unlock(&depot->ibd_mutex);
+
+	if (buf != NULL)
+		io_buf_free(buf);
+}
+
+/**
+ * @brief Hand a thread's cached buffers to the depot on thread exit
+ */
+static void io_buf_thread_exit(void *arg)
+{
+	struct io_buf_cache *caches = arg;
+	struct io_buf *buf;
+	int class;
+
+	io_buf_caches = NULL;
+
+	for (class = 0; class < IO_BUF_CLASSES; class++) {
+		while ((buf = caches[class].ibc_head) != NULL) {
+			caches[class].ibc_head = buf->ib_next;
+			io_buf_depot_put(buf);
+		}
+	}
+
+	gsh_free(caches);
+}
+
+static void io_buf_init(void)
+{
+	int class;
+
+	for (class = 0; class < IO_BUF_CLASSES; class++) {
+		PTHREAD_MUTEX_init(&io_buf_depots[class].ibd_mutex, NULL);
+		io_buf_depots[class].ibd_max =
+			IO_BUF_DEPOT_BYTES / io_buf_class_size(class);
+	}
+
+	if (pthread_key_create(&io_buf_key, io_buf_thread_exit) != 0)
+		LogFatal(COMPONENT_INIT, "Could not create io buffer key");
+}
+
+static struct io_buf_cache *io_buf_thread_caches(void)
+{
+	struct io_buf_cache *caches = io_buf_caches;
+
+	if (likely(caches != NULL))
+		return caches;
+
+	(void)pthread_once(&io_buf_once, io_buf_init);
+
+	caches = gsh_calloc(IO_BUF_CLASSES, sizeof(*caches));
+	(void)pthread_setspecific(io_buf_key, caches);
+	io_buf_caches = caches;
+
+	return caches;
+}
+
+/**
+ * @brief Get a page aligned buffer of at least size bytes
+ *
+ * @param[in] size Size needed
+ *
+ * @return the buffer, release it with io_buf_release().
+ */
+struct io_buf *io_buf_get(size_t size)
+{
+	struct io_buf_cache *cache;
+	struct io_buf_depot *depot;
+	struct io_buf *buf;
+	int class = io_buf_size_class(size);
+
+	if (class == IO_BUF_NO_CLASS) {
+		buf = gsh_malloc(sizeof(*buf));
+		buf->ib_size = size;
+		buf->ib_class = IO_BUF_NO_CLASS;
+		buf->ib_base = gsh_malloc_aligned(4096, size);
+		return buf;
+	}
+
+	cache = &io_buf_thread_caches()[class];
+	buf = cache->ibc_head;
+
+	if (buf != NULL) {
+		cache->ibc_head = buf->ib_next;
+		cache->ibc_count--;
+		return buf;
+	}
+
+	depot = &io_buf_depots[class];
+
+	PTHREAD_MUTEX_lock(&depot->ibd_mutex);
+
+	buf = depot->ibd_head;
+	if (buf != NULL) {
+		depot->ibd_head = buf->ib_next;
+		depot->ibd_count--;
+	}
+
+	PTHREAD_MUTEX_unlock(&depot->ibd_mutex);
+
+	if (buf != NULL)
+		return buf;
+
+	buf = gsh_malloc(sizeof(*buf));
+	buf->ib_size = io_buf_class_size(class);
+	buf->ib_class = class;
+	buf->ib_base = gsh_malloc_aligned(4096, buf->ib_size);
+
+	return buf;
+}
+
+/**
+ * @brief Release a buffer back to the pool
+ *
+ * Has the signature of an iov_release/io_data release function so the
+ * buffer can be handed to the reply as is.
+ *
+ * @param[in] release_data The struct io_buf
+ */
+void io_buf_release(void *release_data)
+{
+	struct io_buf *buf = release_data;
+	struct io_buf_cache *cache;
+
+	if (buf->ib_class == IO_BUF_NO_CLASS) {
+		io_buf_free(buf);
+		return;
+	}
+
+	cache = &io_buf_thread_caches()[buf->ib_class];
+
+	if (cache->ibc_count < io_buf_thread_max(buf->ib_class)) {
+		buf->ib_next = cache->ibc_head;
+		cache->ibc_head = buf;
+		cache->ibc_count++;
+		return;
+	}
+
+	io_buf_depot_put(buf);
+}
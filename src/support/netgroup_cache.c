@@ -31,6 +31,7 @@
 #include "netdb.h"
 #include "abstract_mem.h"
 #include "netgroup_cache.h"
+#include "client_mgr.h"
 
 /* Netgroup cache information */
 struct ng_cache_info {
@@ -107,8 +108,7 @@ static bool ng_expired(struct avltree_node *node)
 
 	info = avltree_container_of(node, struct ng_cache_info, ng_node);
 
-	/* Hardcoded to 30 minutes for now */
-	if (time(NULL) - info->ng_epoch > 30 * 60)
+	if (time(NULL) - info->ng_epoch > NG_CACHE_EXPIRATION)
 		return true;
 
 	return false;
@@ -337,4 +337,7 @@ void ng_clear_cache(void)
 	assert(avltree_first(&neg_ng_tree) == NULL);
 
 	PTHREAD_RWLOCK_unlock(&ng_lock);
+
+	/* Access decisions may have been made with the purged entries */
+	client_list_index_purge_names();
 }
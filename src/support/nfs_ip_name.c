@@ -36,6 +36,7 @@
 #include "nfs_core.h"
 #include "nfs_exports.h"
 #include "nfs_ip_stats.h"
+#include "client_mgr.h"
 #include "config_parsing.h"
 #include <stdlib.h>
 #include <string.h>
@@ -288,6 +289,7 @@ int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname, size_t size)
 					     ipstring, nfs_ip_name->hostname);
 
 				gsh_free(nfs_ip_name);
+				client_list_index_purge_names();
 			}
 			return IP_NAME_NOT_FOUND;
 		}
@@ -343,6 +345,7 @@ int nfs_ip_name_remove(sockaddr_t *ipaddr)
 			     ipstring, nfs_ip_name->hostname);
 
 		gsh_free(nfs_ip_name);
+		client_list_index_purge_names();
 		return IP_NAME_SUCCESS;
 	}
 
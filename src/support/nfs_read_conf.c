@@ -371,6 +371,12 @@ static struct config_item core_params[] = {
 		       nfs_core_param, connection_manager_timeout_sec),
 	CONF_ITEM_BOOL("Allow_Set_Io_Flusher_Fail", false, nfs_core_param,
 		       allow_set_io_flusher_fail),
+	CONF_ITEM_PATH("RPC_Capture_File", 1, MAXPATHLEN, NULL, nfs_core_param,
+		       rpc_capture_file),
+	CONF_ITEM_UI64("RPC_Capture_Size", 1024 * 1024, 1ULL << 40,
+		       64 * 1024 * 1024, nfs_core_param, rpc_capture_size),
+	CONF_ITEM_BOOL("RPC_Capture_Elide_Payload", false, nfs_core_param,
+		       rpc_capture_elide_payload),
 	CONFIG_EOL
 };
 
@@ -386,6 +386,64 @@ struct proto_op v3_full_stats[NFS_V3_NB_COMMAND];
 /* NFSv4 Detailed stats holder */
 struct proto_op v4_full_stats[NFS4_OP_LAST_ONE];
 
+/* Per worker thread shard of the global and detailed stats.
+ * Folded into global_st and v[34]_full_stats by server_stats_fold_global().
+ */
+struct global_stats_shard {
+	struct global_stats st;
+#ifdef _USE_NFS3
+	struct proto_op v3_full[NFS_V3_NB_COMMAND];
+#endif
+	struct proto_op v4_full[NFS4_OP_LAST_ONE];
+};
+
+static struct global_stats_shard *global_shards[SERVER_STATS_SHARDS];
+static uint32_t next_stats_shard;
+static __thread int32_t stats_shard = -1;
+
+/**
+ * @brief Get the stats shard of the calling thread
+ *
+ * Shards are handed out round robin the first time a thread records
+ * stats.  Threads may share a shard so updates remain atomic, but
+ * each shard is only contended by a fraction of the workers.
+ */
+
+static inline uint32_t get_stats_shard(void)
+{
+	if (unlikely(stats_shard < 0))
+		stats_shard = atomic_postinc_uint32_t(&next_stats_shard) %
+			      SERVER_STATS_SHARDS;
+	return stats_shard;
+}
+
+static struct global_stats_shard *get_global_shard(void)
+{
+	uint32_t shard = get_stats_shard();
+	struct global_stats_shard *sp = atomic_fetch_voidptr(
+		(void **)&global_shards[shard]);
+
+	if (unlikely(sp == NULL)) {
+		struct global_stats_shard *expected = NULL;
+
+		sp = gsh_calloc(1, sizeof(struct global_stats_shard));
+		if (!__atomic_compare_exchange_n(&global_shards[shard],
+						 &expected, sp, false,
+						 __ATOMIC_SEQ_CST,
+						 __ATOMIC_SEQ_CST)) {
+			/* Another thread of this shard won the race */
+			gsh_free(sp);
+			sp = expected;
+		}
+	}
+	return sp;
+}
+
+static inline struct gsh_stats *get_export_shard(struct export_stats *exp_st)
+{
+	return &exp_st->shards[get_stats_shard()];
+}
+
 /**
  * @brief Get stats struct helpers
  *
@@ -714,6 +772,244 @@ static void record_clnt_ops(struct op_count *op, bool success, bool dup)
 		(void)atomic_inc_uint64_t(&op->dups);
 }
 
+/* Functions for folding stats shards
+ *
+ * Each shard counter is atomically taken (read and zeroed) and added to
+ * the shared stats, so concurrent folds and recording never lose counts.
+ * min/max are folded the same racy way record_latency() updates them.
+ */
+
+static inline uint64_t take_count(uint64_t *var)
+{
+	return atomic_postclear_uint64_t_bits(var, UINT64_MAX);
+}
+
+static void fold_count(uint64_t *dst, uint64_t *src)
+{
+	uint64_t count = take_count(src);
+
+	if (count != 0)
+		(void)atomic_add_uint64_t(dst, count);
+}
+
+static void fold_latency(struct op_latency *dst, struct op_latency *src)
+{
+	uint64_t min = take_count(&src->min);
+	uint64_t max = take_count(&src->max);
+
+	fold_count(&dst->latency, &src->latency);
+	if (min != 0 && (dst->min == 0 || dst->min > min))
+		(void)atomic_store_uint64_t(&dst->min, min);
+	if (dst->max < max)
+		(void)atomic_store_uint64_t(&dst->max, max);
+}
+
+static void fold_op(struct proto_op *dst, struct proto_op *src)
+{
+	fold_count(&dst->total, &src->total);
+	fold_count(&dst->errors, &src->errors);
+	fold_count(&dst->dups, &src->dups);
+	fold_latency(&dst->latency, &src->latency);
+	fold_latency(&dst->dup_latency, &src->dup_latency);
+}
+
+static void fold_xfer_op(struct xfer_op *dst, struct xfer_op *src)
+{
+	fold_op(&dst->cmd, &src->cmd);
+	fold_count(&dst->requested, &src->requested);
+	fold_count(&dst->transferred, &src->transferred);
+}
+
+static void fold_layout_op(struct layout_op *dst, struct layout_op *src)
+{
+	fold_count(&dst->total, &src->total);
+	fold_count(&dst->errors, &src->errors);
+	fold_count(&dst->delays, &src->delays);
+}
+
+#ifdef _USE_NFS3
+static void fold_nfsv3_stats(struct nfsv3_stats *dst, struct nfsv3_stats *src)
+{
+	fold_op(&dst->cmds, &src->cmds);
+	fold_xfer_op(&dst->read, &src->read);
+	fold_xfer_op(&dst->write, &src->write);
+}
+
+static void fold_mnt_stats(struct mnt_stats *dst, struct mnt_stats *src)
+{
+	fold_op(&dst->v1_ops, &src->v1_ops);
+	fold_op(&dst->v3_ops, &src->v3_ops);
+}
+#endif
+
+#ifdef _USE_RQUOTA
+static void fold_rquota_stats(struct rquota_stats *dst,
+			      struct rquota_stats *src)
+{
+	fold_op(&dst->ops, &src->ops);
+	fold_op(&dst->ext_ops, &src->ext_ops);
+}
+#endif
+
+static void fold_nfsv40_stats(struct nfsv40_stats *dst,
+			      struct nfsv40_stats *src)
+{
+	fold_op(&dst->compounds, &src->compounds);
+	fold_count(&dst->ops_per_compound, &src->ops_per_compound);
+	fold_xfer_op(&dst->read, &src->read);
+	fold_xfer_op(&dst->write, &src->write);
+}
+
+static void fold_nfsv41_stats(struct nfsv41_stats *dst,
+			      struct nfsv41_stats *src)
+{
+	fold_op(&dst->compounds, &src->compounds);
+	fold_count(&dst->ops_per_compound, &src->ops_per_compound);
+	fold_xfer_op(&dst->read, &src->read);
+	fold_xfer_op(&dst->write, &src->write);
+	fold_layout_op(&dst->getdevinfo, &src->getdevinfo);
+	fold_layout_op(&dst->layout_get, &src->layout_get);
+	fold_layout_op(&dst->layout_commit, &src->layout_commit);
+	fold_layout_op(&dst->layout_return, &src->layout_return);
+	fold_layout_op(&dst->recall, &src->recall);
+}
+
+#ifdef _USE_9P
+static void fold__9p_stats(struct _9p_stats *dst, struct _9p_stats *src,
+			   pthread_rwlock_t *lock)
+{
+	u8 opc;
+
+	fold_op(&dst->cmds, &src->cmds);
+	fold_xfer_op(&dst->read, &src->read);
+	fold_xfer_op(&dst->write, &src->write);
+	fold_count(&dst->trans.rx_bytes, &src->trans.rx_bytes);
+	fold_count(&dst->trans.rx_pkt, &src->trans.rx_pkt);
+	fold_count(&dst->trans.rx_err, &src->trans.rx_err);
+	fold_count(&dst->trans.tx_bytes, &src->trans.tx_bytes);
+	fold_count(&dst->trans.tx_pkt, &src->trans.tx_pkt);
+	fold_count(&dst->trans.tx_err, &src->trans.tx_err);
+	for (opc = 0; opc <= _9P_RWSTAT; opc++) {
+		if (src->opcodes[opc] == NULL)
+			continue;
+		if (unlikely(dst->opcodes[opc] == NULL)) {
+			PTHREAD_RWLOCK_wrlock(lock);
+			if (dst->opcodes[opc] == NULL)
+				dst->opcodes[opc] =
+					gsh_calloc(1, sizeof(struct proto_op));
+			PTHREAD_RWLOCK_unlock(lock);
+		}
+		fold_op(dst->opcodes[opc], src->opcodes[opc]);
+	}
+}
+#endif
+
+/**
+ * @brief Fold a stats shard into the shared stats
+ *
+ * Protocol structs are only allocated in dst if the shard has them.
+ *
+ * @param dst  [IN] shared stats
+ * @param src  [IN] shard to fold and zero
+ * @param lock [IN] lock of the owning struct, for allocation
+ */
+
+static void fold_gsh_stats(struct gsh_stats *dst, struct gsh_stats *src,
+			   pthread_rwlock_t *lock)
+{
+#ifdef _USE_NFS3
+	if (src->nfsv3 != NULL)
+		fold_nfsv3_stats(get_v3(dst, lock), src->nfsv3);
+	if (src->mnt != NULL)
+		fold_mnt_stats(get_mnt(dst, lock), src->mnt);
+#endif
+#ifdef _USE_NLM
+	if (src->nlm4 != NULL)
+		fold_op(&get_nlm4(dst, lock)->ops, &src->nlm4->ops);
+#endif
+#ifdef _USE_RQUOTA
+	if (src->rquota != NULL)
+		fold_rquota_stats(get_rquota(dst, lock), src->rquota);
+#endif
+	if (src->nfsv40 != NULL)
+		fold_nfsv40_stats(get_v40(dst, lock), src->nfsv40);
+	if (src->nfsv41 != NULL)
+		fold_nfsv41_stats(get_v41(dst, lock), src->nfsv41);
+	if (src->nfsv42 != NULL)
+		fold_nfsv41_stats(get_v42(dst, lock), src->nfsv42);
+#ifdef _USE_9P
+	if (src->_9p != NULL)
+		fold__9p_stats(get_9p(dst, lock), src->_9p, lock);
+#endif
+}
+
+/**
+ * @brief Fold the per thread shards of an export into its stats
+ *
+ * Must be called before export_st->st is read or reset.
+ *
+ * @param export_st [IN] export stats to fold
+ */
+
+void server_stats_fold_export(struct export_stats *export_st)
+{
+	int i;
+
+	for (i = 0; i < SERVER_STATS_SHARDS; i++)
+		fold_gsh_stats(&export_st->st, &export_st->shards[i],
+			       &export_st->export.exp_lock);
+}
+
+static void fold_ops(uint64_t *dst, uint64_t *src, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		fold_count(&dst[i], &src[i]);
+}
+
+/**
+ * @brief Fold the per thread shards into the global and detailed stats
+ *
+ * Must be called before global_st, v3_full_stats or v4_full_stats
+ * are read or reset.
+ */
+
+void server_stats_fold_global(void)
+{
+	int i, op;
+
+	for (i = 0; i < SERVER_STATS_SHARDS; i++) {
+		struct global_stats_shard *sp =
+			atomic_fetch_voidptr((void **)&global_shards[i]);
+
+		if (sp == NULL)
+			continue;
+#ifdef _USE_NFS3
+		fold_nfsv3_stats(&global_st.nfsv3, &sp->st.nfsv3);
+		fold_mnt_stats(&global_st.mnt, &sp->st.mnt);
+		fold_ops(global_st.v3.op, sp->st.v3.op, NFS_V3_NB_COMMAND);
+		fold_ops(global_st.mn.op, sp->st.mn.op, MNT_V3_NB_COMMAND);
+		for (op = 0; op < NFS_V3_NB_COMMAND; op++)
+			fold_op(&v3_full_stats[op], &sp->v3_full[op]);
+#endif
+#ifdef _USE_NLM
+		fold_op(&global_st.nlm4.ops, &sp->st.nlm4.ops);
+		fold_ops(global_st.lm.op, sp->st.lm.op, NLM_V4_NB_OPERATION);
+#endif
+#ifdef _USE_RQUOTA
+		fold_rquota_stats(&global_st.rquota, &sp->st.rquota);
+		fold_ops(global_st.qt.op, sp->st.qt.op, RQUOTA_NB_COMMAND);
+#endif
+		fold_nfsv40_stats(&global_st.nfsv40, &sp->st.nfsv40);
+		fold_nfsv41_stats(&global_st.nfsv41, &sp->st.nfsv41);
+		fold_nfsv41_stats(&global_st.nfsv42, &sp->st.nfsv42);
+		fold_ops(global_st.v4.op, sp->st.v4.op, NFS4_OP_LAST_ONE);
+		for (op = 0; op < NFS4_OP_LAST_ONE; op++)
+			fold_op(&v4_full_stats[op], &sp->v4_full[op]);
+	}
+}
+
 #ifdef USE_DBUS
 /**
  *  @brief reset the counts for protocol operation
@@ -1172,6 +1468,8 @@ static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 	struct svc_req *req = &reqdata->svc;
 	uint32_t proto_op = req->rq_msg.cb_proc;
 	uint32_t program_op = req->rq_msg.cb_prog;
+	struct global_stats *global_sp = global ? &get_global_shard()->st :
+						  NULL;
 
 	if (program_op == NFS_program[P_NFS]) {
 		if (proto_op == 0)
@@ -1182,7 +1480,7 @@ static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 
 			/* record stuff */
 			if (global)
-				record_op(&global_st.nfsv3.cmds, request_time,
+				record_op(&global_sp->nfsv3.cmds, request_time,
 					  success, dup);
 			switch (nfsv3_optype[proto_op]) {
 			case READ_OP:
@@ -1205,10 +1503,10 @@ static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 		struct mnt_stats *sp = get_mnt(gsh_st, lock);
 
 		if (global && req->rq_msg.cb_vers == MOUNT_V1)
-			record_op(&global_st.mnt.v1_ops, request_time, success,
+			record_op(&global_sp->mnt.v1_ops, request_time, success,
 				  dup);
 		else if (global)
-			record_op(&global_st.mnt.v3_ops, request_time, success,
+			record_op(&global_sp->mnt.v3_ops, request_time, success,
 				  dup);
 
 		/* record stuff */
@@ -1222,7 +1520,7 @@ static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 		struct nlmv4_stats *sp = get_nlm4(gsh_st, lock);
 
 		if (global)
-			record_op(&global_st.nlm4.ops, request_time, success,
+			record_op(&global_sp->nlm4.ops, request_time, success,
 				  dup);
 		/* record stuff */
 		record_op(&sp->ops, request_time, success, dup);
@@ -1232,7 +1530,7 @@ static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 		struct rquota_stats *sp = get_rquota(gsh_st, lock);
 
 		if (global)
-			record_op(&global_st.rquota.ops, request_time, success,
+			record_op(&global_sp->rquota.ops, request_time, success,
 				  dup);
 		/* record stuff */
 		if (req->rq_msg.cb_vers == RQUOTAVERS)
@@ -1313,7 +1611,7 @@ void server_stats_9p_done(u8 opc, struct _9p_request_data *req9p)
 
 		export = op_ctx->ctx_export;
 		exp_st = container_of(export, struct export_stats, export);
-		sp = get_9p(&exp_st->st, &export->exp_lock);
+		sp = get_9p(get_export_shard(exp_st), &export->exp_lock);
 		if (sp->opcodes[opc] == NULL)
 			sp->opcodes[opc] =
 				gsh_calloc(1, sizeof(struct proto_op));
@@ -1346,23 +1644,26 @@ void server_stats_nfs_done(nfs_request_t *reqdata, int rc, bool dup)
 	uint32_t proto_op = req->rq_msg.cb_proc;
 	uint32_t program_op = req->rq_msg.cb_prog;
 
+	struct global_stats *global_sp;
+
 	if (!nfs_param.core_param.enable_NFSSTATS)
 		return;
+	global_sp = &get_global_shard()->st;
 #ifdef _USE_NFS3
 	if (program_op == NFS_PROGRAM && op_ctx->nfs_vers == NFS_V3)
-		global_st.v3.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&global_sp->v3.op[proto_op]);
 #endif
 #ifdef _USE_NLM
 	else if (program_op == NFS_program[P_NLM])
-		global_st.lm.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&global_sp->lm.op[proto_op]);
 #endif
 #ifdef _USE_NFS3
 	else if (program_op == NFS_program[P_MNT])
-		global_st.mn.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&global_sp->mn.op[proto_op]);
 #endif
 #ifdef _USE_RQUOTA
 	else if (program_op == NFS_program[P_RQUOTA])
-		global_st.qt.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&global_sp->qt.op[proto_op]);
 #endif
 
 	if (nfs_param.core_param.enable_FASTSTATS)
@@ -1393,8 +1694,9 @@ void server_stats_nfs_done(nfs_request_t *reqdata, int rc, bool dup)
 
 		exp_st = container_of(op_ctx->ctx_export, struct export_stats,
 				      export);
-		record_stats(&exp_st->st, &op_ctx->ctx_export->exp_lock,
-			     reqdata, time_diff, rc == NFS_REQ_OK, dup, true);
+		record_stats(get_export_shard(exp_st),
+			     &op_ctx->ctx_export->exp_lock, reqdata, time_diff,
+			     rc == NFS_REQ_OK, dup, true);
 		timespec_update(&op_ctx->ctx_export->last_update,
 				&current_time);
 	}
@@ -1412,11 +1714,13 @@ void server_stats_nfsv4_op_done(int proto_op, struct timespec *start_time,
 	struct gsh_client *client = op_ctx->client;
 	struct timespec current_time;
 	nsecs_elapsed_t time_diff;
+	struct global_stats *global_sp;
 
 	if (!nfs_param.core_param.enable_NFSSTATS)
 		return;
+	global_sp = &get_global_shard()->st;
 	if (op_ctx->nfs_vers == NFS_V4)
-		global_st.v4.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&global_sp->v4.op[proto_op]);
 
 	if (nfs_param.core_param.enable_FASTSTATS)
 		return;
@@ -1446,13 +1750,13 @@ void server_stats_nfsv4_op_done(int proto_op, struct timespec *start_time,
 	}
 
 	if (op_ctx->nfs_minorvers == 0)
-		record_op(&global_st.nfsv40.compounds, time_diff,
+		record_op(&global_sp->nfsv40.compounds, time_diff,
 			  status == NFS4_OK, false);
 	else if (op_ctx->nfs_minorvers == 1)
-		record_op(&global_st.nfsv41.compounds, time_diff,
+		record_op(&global_sp->nfsv41.compounds, time_diff,
 			  status == NFS4_OK, false);
 	else if (op_ctx->nfs_minorvers == 2)
-		record_op(&global_st.nfsv42.compounds, time_diff,
+		record_op(&global_sp->nfsv42.compounds, time_diff,
 			  status == NFS4_OK, false);
 
 	if (op_ctx->ctx_export != NULL) {
@@ -1460,9 +1764,9 @@ void server_stats_nfsv4_op_done(int proto_op, struct timespec *start_time,
 
 		exp_st = container_of(op_ctx->ctx_export, struct export_stats,
 				      export);
-		record_nfsv4_op(&exp_st->st, &op_ctx->ctx_export->exp_lock,
-				proto_op, op_ctx->nfs_minorvers, time_diff,
-				status, true);
+		record_nfsv4_op(get_export_shard(exp_st),
+				&op_ctx->ctx_export->exp_lock, proto_op,
+				op_ctx->nfs_minorvers, time_diff, status, true);
 		timespec_update(&op_ctx->ctx_export->last_update,
 				&current_time);
 	}
@@ -1501,7 +1805,8 @@ void server_stats_compound_done(int num_ops, int status)
 
 		exp_st = container_of(op_ctx->ctx_export, struct export_stats,
 				      export);
-		record_compound(&exp_st->st, &op_ctx->ctx_export->exp_lock,
+		record_compound(get_export_shard(exp_st),
+				&op_ctx->ctx_export->exp_lock,
 				op_ctx->nfs_minorvers, num_ops, time_diff,
 				status == NFS4_OK);
 		timespec_update(&op_ctx->ctx_export->last_update,
@@ -1534,22 +1839,23 @@ void server_stats_io_done(size_t requested, size_t transferred, bool success,
 
 		exp_st = container_of(op_ctx->ctx_export, struct export_stats,
 				      export);
-		record_io_stats(&exp_st->st, &op_ctx->ctx_export->exp_lock,
-				requested, transferred, success, is_write);
+		record_io_stats(get_export_shard(exp_st),
+				&op_ctx->ctx_export->exp_lock, requested,
+				transferred, success, is_write);
 	}
 #ifdef USE_MONITORING
 	if (op_ctx->req_type == NFS_REQUEST) {
 		uint16_t export_id = 0;
 		struct fsal_export *export = op_ctx->fsal_export;
-		struct gsh_client *client = op_ctx->client;
-		const char *client_ip = client == NULL ? "" :
-							 client->hostaddr_str;
+		dynamic_client_metric_handle_t client = { NULL };
 
+		if (op_ctx->client != NULL)
+			client = op_ctx->client->monitoring;
 		if (export != NULL)
 			export_id = export->export_id;
 		monitoring__dynamic_observe_nfs_io(requested, transferred,
 						   success, is_write, export_id,
-						   client_ip);
+						   client);
 	}
 #endif
 }
@@ -2123,6 +2429,7 @@ void server_dbus_export_details(DBusMessageIter *iter,
 	dbus_bool_t stats_available;
 
 	exp_st = container_of(g_export, struct export_stats, export);
+	server_stats_fold_export(exp_st);
 	st = &exp_st->st;
 
 	gsh_dbus_append_timestamp(iter, &g_export->last_update);
@@ -2174,6 +2481,7 @@ void server_dbus_total(struct export_stats *export_st, DBusMessageIter *iter)
 	uint64_t total = 0;
 	char *version;
 
+	server_stats_fold_export(export_st);
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
 					 &struct_iter);
 
@@ -2227,6 +2535,8 @@ void global_dbus_total(DBusMessageIter *iter)
 	DBusMessageIter struct_iter;
 	char *version;
 
+	server_stats_fold_global();
+
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
 					 &struct_iter);
 
@@ -2288,6 +2598,8 @@ void global_dbus_fast(DBusMessageIter *iter)
 	char *op;
 	int i;
 
+	server_stats_fold_global();
+
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
 					 &struct_iter);
 
@@ -2401,7 +2713,10 @@ void server_nfsmon_export_iostats(struct export_stats *export_st,
 				  struct xfer_op *opread,
 				  struct xfer_op *opwrite)
 {
-	struct gsh_stats gsh_st = export_st->st;
+	struct gsh_stats gsh_st;
+
+	server_stats_fold_export(export_st);
+	gsh_st = export_st->st;
 
 #ifdef _USE_NFS3
 	if (gsh_st.nfsv3 != NULL) {
@@ -2551,6 +2866,7 @@ void server_dbus_fill_io(DBusMessageIter *array_iter, uint16_t *export_id,
 void server_dbus_all_iostats(struct export_stats *export_statistics,
 			     DBusMessageIter *array_iter)
 {
+	server_stats_fold_export(export_statistics);
 #ifdef _USE_NFS3
 	if (export_statistics->st.nfsv3 != NULL) {
 		server_dbus_fill_io(array_iter,
@@ -2643,6 +2959,9 @@ void reset_gsh_allops_stats(struct gsh_clnt_allops_stats *st)
 void reset_global_stats(void)
 {
 	int i;
+
+	/* Fold the shards first so that their counts are reset as well */
+	server_stats_fold_global();
 #ifdef _USE_NFS3
 	/* Reset all ops counters of nfsv3 */
 	for (i = 0; i < NFS_V3_NB_COMMAND; i++)
@@ -2828,6 +3147,8 @@ void server_dbus_v3_full_stats(DBusMessageIter *iter)
 	uint64_t op_counter = 0;
 	char *message, *op_name;
 
+	server_stats_fold_global();
+
 	gsh_dbus_append_timestamp(iter, &v3_full_stats_time);
 	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(stttddd)",
 					 &array_iter);
@@ -2901,6 +3222,8 @@ void server_dbus_v4_full_stats(DBusMessageIter *iter)
 	uint64_t op_counter = 0;
 	char *message, *op_name;
 
+	server_stats_fold_global();
+
 	gsh_dbus_append_timestamp(iter, &v4_full_stats_time);
 	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(sttddd)",
 					 &array_iter);
@@ -3059,13 +3382,14 @@ static void record_v3_full_stats(struct svc_req *req,
 	if (prog == NFS_PROGRAM) {
 		uint16_t export_id = 0;
 		struct fsal_export *export = op_ctx->fsal_export;
-		struct gsh_client *client = op_ctx->client;
-		const char *client_ip = client == NULL ? "" :
-							 client->hostaddr_str;
+		dynamic_client_metric_handle_t client = { NULL };
+
+		if (op_ctx->client != NULL)
+			client = op_ctx->client->monitoring;
 		if (export != NULL)
 			export_id = export->export_id;
 		nfs_metrics__nfs3_request(proc, request_time, status, export_id,
-					  client_ip);
+					  client);
 	}
 #endif
 
@@ -3076,7 +3400,7 @@ static void record_v3_full_stats(struct svc_req *req,
 				proc);
 			return;
 		}
-		record_op(&v3_full_stats[proc], request_time,
+		record_op(&get_global_shard()->v3_full[proc], request_time,
 			  status == NFS_REQ_OK, dup);
 	}
 }
@@ -3085,6 +3409,8 @@ void reset_v3_full_stats(void)
 {
 	int op;
 
+	server_stats_fold_global();
+
 	for (op = 1; op < NFS_V3_NB_COMMAND; op++) {
 		v3_full_stats[op].total = 0;
 		v3_full_stats[op].errors = 0;
@@ -3102,26 +3428,30 @@ static void record_v4_full_stats(uint32_t proc, nsecs_elapsed_t request_time,
 #ifdef USE_MONITORING
 	uint16_t export_id = 0;
 	struct fsal_export *export = op_ctx->fsal_export;
-	struct gsh_client *client = op_ctx->client;
-	const char *client_ip = client == NULL ? "" : client->hostaddr_str;
+	dynamic_client_metric_handle_t client = { NULL };
 
+	if (op_ctx->client != NULL)
+		client = op_ctx->client->monitoring;
 	if (export != NULL)
 		export_id = export->export_id;
 	nfs_metrics__nfs4_request(proc, request_time, status, export_id,
-				  client_ip);
+				  client);
 #endif
 	if (proc >= NFS4_OP_LAST_ONE) {
 		LogCrit(COMPONENT_DBUS,
 			"proc is more than NFS4_OP_LAST_ONE: %d\n", proc);
 		return;
 	}
-	record_op(&v4_full_stats[proc], request_time, status == NFS4_OK, false);
+	record_op(&get_global_shard()->v4_full[proc], request_time,
+		  status == NFS4_OK, false);
 }
 
 void reset_v4_full_stats(void)
 {
 	int op;
 
+	server_stats_fold_global();
+
 	for (op = 1; op < NFS4_OP_LAST_ONE; op++) {
 		v4_full_stats[op].total = 0;
 		v4_full_stats[op].errors = 0;